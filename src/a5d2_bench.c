@@ -0,0 +1,531 @@
+/*
+ * Copyright (c) 2026 Douglas Gilbert.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+/*****************************************************************
+ * a5d2_bench.c
+ *
+ * Benchmarks of the register access paths the other utilities use, run
+ * by 'make bench'. Always built with SA_INSTR (so mmap_regs counts its
+ * calls, see sa_instr.h) and never installed. Each scenario prints one
+ * line in the same layout so runs (e.g. before and after a change, or
+ * with and without SCHED_FIFO) can be compared:
+ *   store      get_mmp() then one store (a5d2_pio_set, mem2io)
+ *   toggle     PIO_SODR/PIO_CODR stores through kept pointers
+ *   snapshot   PDSR, ODSR, IMR and LOCKSR of 4 banks (a5d2_pio_status)
+ *   switch     reads alternating between PIO, PMC and TC pages
+ *   remap      mmap() and munmap() of a page (cost of a page miss)
+ *   jitter     lateness of periodic absolute deadlines, as a5d2_tc_freq
+ *              segment boundaries, with normal then SCHED_FIFO scheduling
+ * By default no lines change: the toggle stores write a mask of 0 unless
+ * '-m MASK' is given. PIO_ISR is not read since that clears it. Unless
+ * soc_identify() finds a SAMA5D2 it will not touch /dev/mem (on any other
+ * machine those are arbitrary physical addresses), use '-M FILE' there.
+ *
+ ****************************************************************/
+
+#ifndef SA_INSTR
+#define SA_INSTR 1
+#endif
+
+#define _XOPEN_SOURCE 600
+#define _GNU_SOURCE 1
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+
+#include "mmap_regs.h"
+#include "a5d2_regs.h"
+#include "sa_misc.h"
+#include "sa_instr.h"
+#include "soc_id.h"
+
+
+static const char * version_str = "1.00 20261014";
+
+#define DEF_COUNT 100000
+#define DEF_JITTER_NUM 1000
+#define DEF_PERIOD_US 1000
+#define TC1_CV (TCB0_BASE + TC_CHAN_STRIDE + TC_CV_OFF)  /* ro */
+
+#define SCEN_STORE 0x1
+#define SCEN_TOGGLE 0x2
+#define SCEN_SNAPSHOT 0x4
+#define SCEN_SWITCH 0x8
+#define SCEN_REMAP 0x10
+#define SCEN_JITTER 0x20
+
+struct opts_t {
+    int bank;
+    int jitter_num;
+    int period_us;
+    int verbose;
+    unsigned int mask;
+    unsigned int scen_mask;
+    unsigned long count;
+    const char * mem_fn;
+};
+
+struct value_str_t {
+    int val;
+    const char *str;
+};
+
+static struct value_str_t scen_arr[] = {
+    {SCEN_STORE, "store"},
+    {SCEN_TOGGLE, "toggle"},
+    {SCEN_SNAPSHOT, "snapshot"},
+    {SCEN_SWITCH, "switch"},
+    {SCEN_REMAP, "remap"},
+    {SCEN_JITTER, "jitter"},
+    {0, NULL},
+};
+
+static volatile unsigned int bench_sink;       /* keeps reads alive */
+
+
+static void
+usage(void)
+{
+    pr2serr("Usage: a5d2_bench [-b BANK] [-c COUNT] [-h] [-i US] "
+            "[-j NUM] [-m MASK]\n"
+            "                  [-M FILE] [-s LIST] [-v] [-V]\n"
+            "  where:\n"
+            "    -b BANK      PIO bank (A to D) for 'store' and 'toggle' "
+            "(def: A)\n"
+            "    -c COUNT     iterations of each timed loop (def: %d)\n"
+            "    -h           print usage message\n"
+            "    -i US        'jitter' boundary period in microseconds "
+            "(def: %d)\n"
+            "    -j NUM       'jitter' boundaries in each run (def: %d)\n"
+            "    -m MASK      lines (hex) that 'toggle' sets and clears "
+            "(def: 0,\n"
+            "                 the stores are done but no line changes)\n"
+            "    -M FILE      map FILE rather than " DEV_MEM " (e.g. a "
+            "4 GiB sparse\n"
+            "                 file to compare hosts). " DEV_MEM " is only "
+            "used on a\n"
+            "                 SAMA5D2\n"
+            "    -s LIST      comma separated scenarios (def: all): "
+            "store,toggle,\n"
+            "                 snapshot,switch,remap,jitter\n"
+            "    -v           increase verbosity\n"
+            "    -V           print version string then exit\n\n"
+            "Times the register access paths used by the other utilities, "
+            "one line\nper scenario. Times are in %s (see sa_instr.h). "
+            "Also run by 'make bench'.\n", DEF_COUNT, DEF_PERIOD_US,
+            DEF_JITTER_NUM, SA_CYCLES_UNIT);
+}
+
+static void
+print_line(const char * name, unsigned long count, uint64_t cyc,
+           const char * what)
+{
+    printf("%-9s %9lu  %10.1f %s/op  %s\n", name, count,
+           count ? ((double)cyc / count) : 0.0, SA_CYCLES_UNIT, what);
+}
+
+/* 'store': a get_mmp() lookup (same page as last time) then a store */
+static int
+bench_store(int mem_fd, struct mmap_state * msp, const struct opts_t * op)
+{
+    unsigned long k;
+    uint64_t c0;
+    unsigned int codr = pio_addr(op->bank, PIO_CODR_OFF);
+    volatile unsigned int * mmp;
+
+    c0 = sa_cycles();
+    for (k = 0; k < op->count; ++k) {
+        if (NULL == ((mmp = get_mmp(mem_fd, codr, msp))))
+            return 1;
+        *mmp = op->mask;
+    }
+    print_line("store", op->count, sa_cycles_diff(c0, sa_cycles()),
+               "get_mmp() + store to PIO_CODR");
+    return 0;
+}
+
+/* 'toggle': alternate PIO_SODR and PIO_CODR stores, pointers kept */
+static int
+bench_toggle(int mem_fd, struct mmap_state * msp, const struct opts_t * op)
+{
+    unsigned long k;
+    uint64_t c0;
+    unsigned int mask = op->mask;
+    unsigned int base = pio_addr(op->bank, 0);
+    volatile unsigned int * sodr_p;
+    volatile unsigned int * codr_p;
+
+    if ((NULL == ((sodr_p = get_mmp(mem_fd, base + PIO_SODR_OFF, msp)))) ||
+        (NULL == ((codr_p = get_mmp(mem_fd, base + PIO_CODR_OFF, msp)))))
+        return 1;
+    c0 = sa_cycles();
+    for (k = 0; k < op->count; k += 2) {
+        *sodr_p = mask;
+        *codr_p = mask;
+    }
+    print_line("toggle", k, sa_cycles_diff(c0, sa_cycles()),
+               "PIO_SODR/PIO_CODR store");
+    return 0;
+}
+
+/* 'snapshot': the registers a5d2_pio_status reads per bank, all banks */
+static int
+bench_snapshot(int mem_fd, struct mmap_state * msp, const struct opts_t * op)
+{
+    int b;
+    unsigned int v, base;
+    unsigned long k, n;
+    uint64_t c0;
+    volatile unsigned int * mmp;
+
+    n = op->count / (4 * PIO_BANKS_SAMA5D2);
+    if (0 == n)
+        n = 1;
+    v = 0;
+    c0 = sa_cycles();
+    for (k = 0; k < n; ++k) {
+        for (b = 0; b < PIO_BANKS_SAMA5D2; ++b) {
+            base = pio_addr(b, 0);
+            if (NULL == ((mmp = get_mmp(mem_fd, base + PIO_PDSR_OFF, msp))))
+                return 1;
+            v ^= *mmp;
+            if (NULL == ((mmp = get_mmp(mem_fd, base + PIO_ODSR_OFF, msp))))
+                return 1;
+            v ^= *mmp;
+            if (NULL == ((mmp = get_mmp(mem_fd, base + PIO_IMR_OFF, msp))))
+                return 1;
+            v ^= *mmp;
+            if (NULL == ((mmp = get_mmp(mem_fd, base + PIO_LOCKSR_OFF, msp))))
+                return 1;
+            v ^= *mmp;
+        }
+    }
+    bench_sink = v;
+    print_line("snapshot", n, sa_cycles_diff(c0, sa_cycles()),
+               "16 register reads (4 banks)");
+    return 0;
+}
+
+/* 'switch': each read is on a different (already mapped) page than the
+ * previous one so get_mmp() falls back to the check_mmap() table scan */
+static int
+bench_switch(int mem_fd, struct mmap_state * msp, const struct opts_t * op)
+{
+    unsigned int v;
+    unsigned long k;
+    uint64_t c0;
+    volatile unsigned int * mmp;
+    static const unsigned int addr_arr[3] = {PIO_BASE + PIO_PDSR_OFF,
+                                             PMC_SCSR, TC1_CV};
+
+    v = 0;
+    c0 = sa_cycles();
+    for (k = 0; k < op->count; ++k) {
+        if (NULL == ((mmp = get_mmp(mem_fd, addr_arr[k % 3], msp))))
+            return 1;
+        v ^= *mmp;
+    }
+    bench_sink = v;
+    print_line("switch", op->count, sa_cycles_diff(c0, sa_cycles()),
+               "read, page changes each time");
+    return 0;
+}
+
+/* 'remap': a fresh table each time, so mmap() plus munmap() per read, as
+ * when the table overflows or a utility is run once per access */
+static int
+bench_remap(int mem_fd, const struct opts_t * op)
+{
+    unsigned int v;
+    unsigned long k, n;
+    uint64_t c0;
+    volatile unsigned int * mmp;
+    struct mmap_state mstat;
+
+    n = op->count / 100;
+    if (0 == n)
+        n = 1;
+    v = 0;
+    c0 = sa_cycles();
+    for (k = 0; k < n; ++k) {
+        init_mmap_state(&mstat, -1);    /* -1: no counter report */
+        if (NULL == ((mmp = get_mmp(mem_fd, PIO_BASE + PIO_PDSR_OFF, &mstat))))
+            return 1;
+        v ^= *mmp;
+        release_mmap_state(&mstat);
+    }
+    bench_sink = v;
+    print_line("remap", n, sa_cycles_diff(c0, sa_cycles()),
+               "mmap() + read + munmap()");
+    return 0;
+}
+
+static int
+cmp_ll(const void * ap, const void * bp)
+{
+    long long a = *(const long long *)ap;
+    long long b = *(const long long *)bp;
+
+    return (a < b) ? -1 : (a > b);
+}
+
+/* One 'jitter' run: op->jitter_num absolute deadlines op->period_us apart
+ * on CLOCK_MONOTONIC; at each one a store (as a5d2_tc_freq's segment
+ * change) then the lateness is taken. Returns 0 if okay, else 1 */
+static int
+jitter_run(int mem_fd, struct mmap_state * msp, const struct opts_t * op,
+           const char * name, long long * late_arr)
+{
+    int k, n, res;
+    uint64_t start_ns, due_ns;
+    struct sa_stat st;
+    struct timespec ts;
+    volatile unsigned int * mmp;
+    char b[80];
+
+    mmp = get_mmp(mem_fd, pio_addr(op->bank, PIO_CODR_OFF), msp);
+    if (NULL == mmp)
+        return 1;
+    memset(&st, 0, sizeof(st));
+    n = op->jitter_num;
+    start_ns = sa_ts_ns(CLOCK_MONOTONIC);
+    for (k = 0; k < n; ++k) {
+        due_ns = start_ns + ((uint64_t)(k + 1) * op->period_us * 1000);
+        ts.tv_sec = due_ns / 1000000000;
+        ts.tv_nsec = due_ns % 1000000000;
+        while ((res = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts,
+                                      NULL)) == EINTR)
+            ;
+        if (res) {
+            pr2serr("clock_nanosleep: %s\n", strerror(res));
+            return 1;
+        }
+        *mmp = 0;               /* PIO_CODR with no lines selected */
+        late_arr[k] = (long long)(sa_ts_ns(CLOCK_MONOTONIC) - due_ns);
+        sa_stat_add(&st, late_arr[k]);
+    }
+    qsort(late_arr, n, sizeof(long long), cmp_ll);
+    printf("%-9s %9d  p50=%.1f p99=%.1f max=%.1f us  %s\n", "jitter", n,
+           late_arr[n / 2] / 1000.0, late_arr[(n * 99) / 100] / 1000.0,
+           late_arr[n - 1] / 1000.0, name);
+    if (op->verbose) {
+        snprintf(b, sizeof(b), "    %s", name);
+        sa_stat_print(stdout, b, &st, 1000.0, "us");
+    }
+    return 0;
+}
+
+static int
+bench_jitter(int mem_fd, struct mmap_state * msp, const struct opts_t * op)
+{
+    int k;
+    int res = 1;
+    long long * late_arr;
+    struct sched_param spr;
+
+    late_arr = (long long *)calloc(op->jitter_num, sizeof(long long));
+    if (NULL == late_arr) {
+        pr2serr("unable to allocate %d samples\n", op->jitter_num);
+        return 1;
+    }
+    if (jitter_run(mem_fd, msp, op, "normal scheduling", late_arr))
+        goto fini;
+    k = sched_get_priority_min(SCHED_FIFO);
+    memset(&spr, 0, sizeof(spr));
+    spr.sched_priority = (k < 0) ? 1 : k;
+    if (sched_setscheduler(0, SCHED_FIFO, &spr) < 0) {
+        printf("%-9s %9s  SCHED_FIFO not permitted: %s\n", "jitter", "-",
+               strerror(errno));
+        res = 0;
+        goto fini;
+    }
+    res = jitter_run(mem_fd, msp, op, "SCHED_FIFO", late_arr);
+    spr.sched_priority = 0;
+    sched_setscheduler(0, SCHED_OTHER, &spr);
+fini:
+    free(late_arr);
+    return res;
+}
+
+/* Returns mask of SCEN_* in comma separated 'list' or 0 if problem */
+static unsigned int
+parse_scen(const char * list)
+{
+    int len;
+    unsigned int mask = 0;
+    const char * cp;
+    const struct value_str_t * vp;
+
+    for (cp = list; *cp; cp += len + (',' == cp[len])) {
+        len = strcspn(cp, ",");
+        for (vp = scen_arr; vp->str; ++vp) {
+            if ((len == (int)strlen(vp->str)) &&
+                (0 == strncmp(cp, vp->str, len)))
+                break;
+        }
+        if (NULL == vp->str) {
+            pr2serr("unknown scenario: %.*s\n", len, cp);
+            return 0;
+        }
+        mask |= vp->val;
+    }
+    return mask;
+}
+
+
+int
+main(int argc, char * argv[])
+{
+    int opt, mem_fd;
+    int res = 1;
+    unsigned int u;
+    struct opts_t opts;
+    struct opts_t * op;
+    struct mmap_state mstat;
+    struct mmap_state * msp = &mstat;
+    struct soc_id sid;
+
+    op = &opts;
+    memset(op, 0, sizeof(opts));
+    op->count = DEF_COUNT;
+    op->jitter_num = DEF_JITTER_NUM;
+    op->period_us = DEF_PERIOD_US;
+    op->scen_mask = ~0U;
+    op->mem_fn = DEV_MEM;
+    while ((opt = getopt(argc, argv, "b:c:hi:j:m:M:s:vV")) != -1) {
+        switch (opt) {
+        case 'b':
+            op->bank = toupper((unsigned char)optarg[0]) - 'A';
+            if ((op->bank < 0) || (op->bank >= PIO_BANKS_SAMA5D2) ||
+                optarg[1]) {
+                pr2serr("-b expects a PIO bank: A, B, C or D\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'c':
+            if ((1 != sscanf(optarg, "%lu", &op->count)) ||
+                (0 == op->count)) {
+                pr2serr("-c expects a count (1 or more)\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'h':
+            usage();
+            exit(EXIT_SUCCESS);
+        case 'i':
+            if ((1 != sscanf(optarg, "%d", &op->period_us)) ||
+                (op->period_us < 1)) {
+                pr2serr("-i expects microseconds (1 or more)\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'j':
+            if ((1 != sscanf(optarg, "%d", &op->jitter_num)) ||
+                (op->jitter_num < 1)) {
+                pr2serr("-j expects a number (1 or more)\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'm':
+            if (1 != sscanf(optarg, "%x", &u)) {
+                pr2serr("-m expects a hex mask\n");
+                exit(EXIT_FAILURE);
+            }
+            op->mask = u;
+            break;
+        case 'M':
+            op->mem_fn = optarg;
+            break;
+        case 's':
+            if (0 == (op->scen_mask = parse_scen(optarg)))
+                exit(EXIT_FAILURE);
+            break;
+        case 'v':
+            ++op->verbose;
+            break;
+        case 'V':
+            printf("%s\n", version_str);
+            exit(EXIT_SUCCESS);
+        default: /* '?' */
+            usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (optind < argc) {
+        for (; optind < argc; ++optind)
+            pr2serr("Unexpected extra argument: %s\n", argv[optind]);
+        usage();
+        exit(EXIT_FAILURE);
+    }
+    if ((0 == strcmp(op->mem_fn, DEV_MEM)) &&
+        (SOC_FAM_SAMA5D2 != soc_identify(&sid, NULL, op->verbose))) {
+        pr2serr("SoC family is %s, not sama5d2, so will not touch %s; "
+                "use '-M FILE'\n", soc_family_str(sid.family), DEV_MEM);
+        return 1;
+    }
+    if ((mem_fd = open(op->mem_fn, O_RDWR | O_SYNC)) < 0) {
+        pr2serr("open of %s failed: %s\n", op->mem_fn, strerror(errno));
+        return 1;
+    }
+    init_mmap_state(msp, op->verbose);
+    /* map the pages up front so the first scenario does not pay for it */
+    if ((NULL == get_mmp(mem_fd, PMC_SCSR, msp)) ||
+        (NULL == get_mmp(mem_fd, TC1_CV, msp)) ||
+        (NULL == get_mmp(mem_fd, PIO_BASE + PIO_MSKR_OFF, msp)))
+        goto clean_up;
+    printf("a5d2_bench %s on %s, %s timing\n", version_str, op->mem_fn,
+           SA_CYCLES_UNIT);
+    if ((op->scen_mask & SCEN_STORE) && bench_store(mem_fd, msp, op))
+        goto clean_up;
+    if ((op->scen_mask & SCEN_TOGGLE) && bench_toggle(mem_fd, msp, op))
+        goto clean_up;
+    if ((op->scen_mask & SCEN_SNAPSHOT) && bench_snapshot(mem_fd, msp, op))
+        goto clean_up;
+    if ((op->scen_mask & SCEN_SWITCH) && bench_switch(mem_fd, msp, op))
+        goto clean_up;
+    if ((op->scen_mask & SCEN_REMAP) && bench_remap(mem_fd, op))
+        goto clean_up;
+    if ((op->scen_mask & SCEN_JITTER) && bench_jitter(mem_fd, msp, op))
+        goto clean_up;
+    res = 0;
+clean_up:
+    fflush(stdout);
+    if (release_mmap_state(msp))
+        res = 1;
+    close(mem_fd);
+    return res;
+}
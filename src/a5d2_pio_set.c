@@ -37,12 +37,11 @@
  *
  ****************************************************/
 
-#define _XOPEN_SOURCE 500
+#define _XOPEN_SOURCE 600
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
-#include <stdarg.h>
 #include <ctype.h>
 #include <string.h>
 #include <unistd.h>
@@ -53,16 +52,18 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <libgen.h>
+#include <time.h>
+#include <sched.h>
 
+#include "mmap_regs.h"
+#include "sa_misc.h"
 
-static const char * version_str = "1.01 20180730";
+
+static const char * version_str = "1.04 20261014";
 
 
 #define PIO_BANKS_SAMA5D2 4  /* PA0-31, PB0-31, PC0-31 and PD0-32 */
 #define LINES_PER_BANK 32
-#define MAP_SIZE 4096   /* assume to be power of 2 */
-#define MAP_MASK (MAP_SIZE - 1)
-#define DEV_MEM "/dev/mem"
 
 #define GPIO_BANK_ORIGIN "/sys/class/gpio/gpiochip0"
 /* Earlier kernels (G20+G25) offset GPIO numbers by 32 so
@@ -149,12 +150,30 @@ struct opts_t {
     bool dir_given;
 };
 
-struct mmap_state {
-    void * mmap_ptr;
-    off_t prev_mask_addrp;
-    int mmap_ok;
+/* Lines given by '-l LIST' and/or '-c FILE'. Each selected line has its
+ * own copy of the options, starting from those on the command line. */
+struct line_set {
+    unsigned int sel_mask[PIO_BANKS_SAMA5D2];
+    struct opts_t lop[PIO_BANKS_SAMA5D2][LINES_PER_BANK];
+};
+
+/* Selectors for bank_line_mask() */
+#define LS_DI_INT 0
+#define LS_EN_INT 1
+#define LS_CLR_OUT 2
+#define LS_SET_OUT 3
+#define LS_FREEZE 4     /* also needs PHY1INT2B3 value */
+
+/* One record of a '-x FILE' pattern: the lines set in 'msk' are driven to
+ * 'dat' and then 'delay_ns' nanoseconds pass before the next record. */
+struct pat_rec {
+    unsigned int msk;
+    unsigned int dat;
+    unsigned int delay_ns;
 };
 
+#define PAT_SPIN_NS 100000      /* shorter delays are busy waited */
+
 struct periph_name {
     int pin;            /* 0 to 31 (PIO line number within bank) */
     int periph;         /* 1 for A, 2 for B, etc */
@@ -585,44 +604,30 @@ static const char * bank_str_arr[] = {
 static const char * dir_arr[] = {"io", "i", "o", "output", " "};
 
 
-#ifdef __GNUC__
-static int pr2serr(const char * fmt, ...)
-        __attribute__ ((format (printf, 1, 2)));
-#else
-static int pr2serr(const char * fmt, ...);
-#endif
-
-
-static int
-pr2serr(const char * fmt, ...)
-{
-    va_list args;
-    int n;
-
-    va_start(args, fmt);
-    n = vfprintf(stderr, fmt, args);
-    va_end(args);
-    return n;
-}
-
 static void
 usage(int help_val)
 {
     if (1 == help_val)
-        pr2serr("Usage: a5d2_pio_set [-b BN] [-d DIV] [-D DRVSTR] [-e] "
-                "[-E EVT]\n"
-                "                    [-f FUNC] [-F PHY1INT2B3] [-g|G] "
-                "[-h] [-i|I]\n"
-                "                    [-m|M] [-p PORT] [-r DIR] "
-                "[-s FUNC] [-S LEV]\n"
-                "                    [-t|T] [-u|U] [-uu|UU] [-v] [-V] "
-                "[-w WPEN]\n"
-                "                    [-X MSK,DAT] [-z|Z]\n"
+        pr2serr("Usage: a5d2_pio_set [-b BN] [-c FILE] [-d DIV] [-D DRVSTR] "
+                "[-e]\n"
+                "                    [-E EVT] [-f FUNC] [-F PHY1INT2B3] "
+                "[-g|G] [-h]\n"
+                "                    [-i|I] [-l LIST] [-m|M] [-n] [-p PORT] "
+                "[-r DIR]\n"
+                "                    [-s FUNC] [-S LEV] [-t|T] [-u|U] "
+                "[-uu|UU] [-v]\n"
+                "                    [-V] [-w WPEN] [-x FILE] [-X MSK,DAT] "
+                "[-z|Z]\n"
                 "  where the main options are:\n"
                 "    -b BN        bit number within port (0 to 31). Also "
                 "accepts full\n"
                 "                 GPIO name (e.g. '-b PC7' equivalent to "
                 "'-p c -b 7')\n"
+                "    -c FILE      read a LIST of lines from FILE, one or "
+                "more per\n"
+                "                 text line; '#' starts a comment. If FILE "
+                "is '-' then\n"
+                "                 stdin is read. See '-hh' for LIST syntax\n"
                 "    -D DRVSTR    IO drive: 0->LO, 1->LO, 2->ME, 3->HI; "
                 "alternatively\n"
                 "                 the letter L, M or H can be given\n"
@@ -642,6 +647,10 @@ usage(int help_val)
                 "    -h           print usage message; use twice for "
                 "more help\n"
                 "    -i|I         interrupt disable|enable\n"
+                "    -l LIST      apply settings to several lines in one "
+                "pass. LIST\n"
+                "                 is like 'PC7:func=A,pu=1;PC8:func=A,pu=1'"
+                "\n"
                 "    -m|M         disable|enable open drain (formerly "
                 "multi-drive)\n"
                 "    -p PORT      port bank ('A' to 'D') or gpio kernel "
@@ -668,15 +677,16 @@ usage(int help_val)
                 "for more.\n"
                );
     else    /* -hh */
-        pr2serr("Usage: a5d2_pio_set [-b BN] [-d DIV] [-D DRVSTR] [-e] "
-                "[-E EVT]\n"
-                "                    [-f FUNC] [-F PHY1INT2B3] [-g|G] "
-                "[-h] [-i|I]\n"
-                "                    [-m|M] [-p PORT] [-r DIR] "
-                "[-s FUNC] [-S LEV]\n"
-                "                    [-t|T] [-u|U] [-uu|UU] [-v] [-V] "
-                "[-w WPEN]\n"
-                "                    [-X MSK,DAT] [-z|Z]\n\n"
+        pr2serr("Usage: a5d2_pio_set [-b BN] [-c FILE] [-d DIV] [-D DRVSTR] "
+                "[-e]\n"
+                "                    [-E EVT] [-f FUNC] [-F PHY1INT2B3] "
+                "[-g|G] [-h]\n"
+                "                    [-i|I] [-l LIST] [-m|M] [-n] [-p PORT] "
+                "[-r DIR]\n"
+                "                    [-s FUNC] [-S LEV] [-t|T] [-u|U] "
+                "[-uu|UU] [-v]\n"
+                "                    [-V] [-w WPEN] [-x FILE] [-X MSK,DAT] "
+                "[-z|Z]\n\n"
                 "  where the remaining options are:\n"
                 "    -d DIV       slow clock divider [period=2*(DIV+1)"
                 "*slow_clock_per]\n"
@@ -688,10 +698,18 @@ usage(int help_val)
                 "2 -> interrupt\n"
                 "                       3 -> physical+interrupt\n"
                 "    -g|G         disable|enable (glitch) input filter\n"
+                "    -n           no realtime scheduling with '-x FILE' "
+                "(def: set\n"
+                "                 SCHED_FIFO)\n"
                 "    -w WPEN      write protect mode (for whole PIO) set to "
                 "WPEN\n"
                 "                 0->disabled (def, no write protection), "
                 "1->enabled\n"
+                "    -x FILE      play a pattern on PORT from FILE ('-' for "
+                "stdin); each\n"
+                "                 line is MSK,DAT[,DELAY_NS]. The whole "
+                "FILE is read\n"
+                "                 before the first record is written\n"
                 "    -X MSK,DAT   write DAT to PORT for those lines set "
                 "in MSK\n"
                 "                 MSK and DAT are 32 bit hexadecimal "
@@ -713,75 +731,32 @@ usage(int help_val)
                 "disable write protection, followed\nby any requested "
                 "change to FUNC. The final three actions, if\nrequested, "
                 "are to enable write protection, enable interrupts, then\n"
-                "freeze physical or interrupts (or both) respectively.\n"
+                "freeze physical or interrupts (or both) respectively.\n\n"
+                "LIST (from '-l' or in FILE) is a sequence of entries "
+                "separated by ';'.\nEach entry is a line name (e.g. 'PC7') "
+                "optionally followed by a colon\nand a comma separated list "
+                "of KEY=VAL. KEYs are: func=FUNC, dir=DIR,\ndrv=DRVSTR, "
+                "evt=EVT, freeze=PHY1INT2B3, lev=LEV (like the options\n"
+                "above) plus these which take 0 (disable) or 1 (enable): "
+                "if, ifsc,\nint, opd, pd, pu and schmitt. Other options "
+                "given on the command line\nact as defaults for every line "
+                "in LIST. Lines needing the same PIO_CFGR\nvalue are "
+                "written together with one PIO_MSKR mask so there is one\n"
+                "PIO_CFGR write per distinct configuration in each bank. "
+                "The ordering\nabove holds across all lines. If write "
+                "protection is on, it is\ndisabled once before the first "
+                "change and enabled again after the last\n(unless '-w WPEN' "
+                "is given).\n\n"
+                "With '-x FILE' each record is one PIO_ODSR write (and a "
+                "PIO_MSKR write\nwhen MSK differs from the previous record) "
+                "so the lines in MSK change\ntogether. DELAY_NS (decimal, "
+                "default 0) is the time from that record\nto the next; "
+                "delays are measured from the start so they do not "
+                "drift.\nOnly PORT is needed; lines must already be set "
+                "up as PIO outputs.\n"
                );
 }
 
-#ifdef __cplusplus
-
-static inline volatile unsigned int *
-mmp_add(void * p, unsigned int v)
-{
-    return (volatile unsigned int *)((unsigned char *)p + v);
-}
-
-#else
-
-static inline volatile unsigned int *
-mmp_add(unsigned char * p, unsigned int v)
-{
-    return (volatile unsigned int *)(p + v);
-}
-#endif
-
-/* Since we map a whole page (MAP_SIZE) then that page may already be
- * mapped which means we can skip a munmap() and mmap() call. Returns
- * new or re-used pointer to mmapped page, or returns NULL if problem. */
-static void *
-check_mmap(int mem_fd, unsigned int wanted_addr, struct mmap_state * msp,
-           const struct opts_t * op)
-{
-    off_t mask_addr;
-
-    mask_addr = (wanted_addr & ~MAP_MASK);
-    if ((0 == msp->mmap_ok) || (msp->prev_mask_addrp != mask_addr)) {
-        if (msp->mmap_ok) {
-            if (-1 == munmap(msp->mmap_ptr, MAP_SIZE)) {
-                pr2serr("mmap_ptr=%p:\n", msp->mmap_ptr);
-                perror("    munmap");
-                return NULL;
-            } else if (op->verbose > 2)
-                pr2serr("munmap() ok, mmap_ptr=%p\n", msp->mmap_ptr);
-        }
-        msp->mmap_ptr = mmap(0, MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED,
-                             mem_fd, mask_addr);
-        if ((void *)-1 == msp->mmap_ptr) {
-            msp->mmap_ok = 0;
-            pr2serr("addr=0x%x, mask_addr=0x%lx :\n", wanted_addr, mask_addr);
-            perror("    mmap");
-            return NULL;
-        }
-        msp->mmap_ok = 1;
-        msp->prev_mask_addrp = mask_addr;
-        if (op->verbose > 2)
-            pr2serr("mmap() ok, addr=0x%x, mask_addr=0x%lx, mmap_ptr=%p\n",
-                    wanted_addr, mask_addr, msp->mmap_ptr);
-    }
-    return msp->mmap_ptr;
-}
-
-static volatile unsigned int *
-get_mmp(int mem_fd, unsigned int wanted_addr, struct mmap_state * msp,
-        const struct opts_t * op)
-{
-    void * mmap_ptr;
-
-    mmap_ptr = check_mmap(mem_fd, wanted_addr, msp, op);
-    if (NULL == mmap_ptr)
-        return NULL;
-    return mmp_add(mmap_ptr, wanted_addr & MAP_MASK);
-}
-
 static char *
 translate_peri(char * b, int max_blen, int pioc_num, int bit_num,
                int peri_num, bool show_dir)
@@ -874,23 +849,21 @@ do_enumerate(int enum_val, int bank, int orig0, int do_dir)
 }
 
 static volatile unsigned int *
-do_mask_get_cfgr(int mem_fd, int bit_num, int pioc_num,
-                 const struct opts_t * op)
+do_mask_get_cfgr(int mem_fd, struct mmap_state * msp, int bit_num,
+                 int pioc_num, const struct opts_t * op)
 {
     unsigned int bit_mask;
     volatile unsigned int * mmp;
-    struct mmap_state mstat;
 
-    memset(&mstat, 0, sizeof(mstat));
     bit_mask = 1 << bit_num;
-    if (NULL == ((mmp = get_mmp(mem_fd, pio_mskr[pioc_num], &mstat, op))))
+    if (NULL == ((mmp = get_mmp(mem_fd, pio_mskr[pioc_num], msp))))
         return NULL;
     if (bit_mask != *mmp) {
         *mmp = bit_mask;
         if (op->verbose > 1)
             pr2serr("  assert 0x%u in PIO_MSKR%d\n", bit_mask, pioc_num);
     }
-    mmp = get_mmp(mem_fd, pio_cfgr[pioc_num], &mstat, op);
+    mmp = get_mmp(mem_fd, pio_cfgr[pioc_num], msp);
     if (op->verbose > 1) {
         unsigned int ui;
 
@@ -900,238 +873,272 @@ do_mask_get_cfgr(int mem_fd, int bit_num, int pioc_num,
     return mmp;
 }
 
+/* Returns FUNC number (0 to 7) decoded from 'P', 'A' to 'G' or a digit;
+ * else returns -1 . */
 static int
-do_set(int mem_fd, int bit_num, int pioc_num, const struct opts_t * op)
+parse_func(const char * cp)
 {
-    unsigned int addr, bit_mask, ui;
-    unsigned int cfgr;
-    bool equal, cfgr_changed;
-    volatile unsigned int * ommp;
-    volatile unsigned int * cmmp = NULL;
-    struct mmap_state mstat;
+    int k;
 
-    memset(&mstat, 0, sizeof(mstat));
-    bit_mask = 1 << bit_num;
-    cfgr_changed = false;
-    cfgr = 0;
+    switch (cp[0]) {
+    case 'a': case 'A':
+        return PERI_A;
+    case 'b': case 'B':
+        return PERI_B;
+    case 'c': case 'C':
+        return PERI_C;
+    case 'd': case 'D':
+        return PERI_D;
+    case 'e': case 'E':
+        return PERI_E;
+    case 'f': case 'F':
+        return PERI_F;
+    case 'g': case 'G':
+        return PERI_G;
+    case 'p': case 'P':
+        return FUNC_GPIO;
+    default:
+        if (isdigit(cp[0])) {
+            k = atoi(cp);
+            if ((k >= 0) && (k <= 7))
+                return k;
+        }
+        break;
+    }
+    return -1;
+}
 
-    if (op->di_interrupt) {
-        if (NULL == ((ommp = get_mmp(mem_fd, pio_idr[pioc_num], &mstat, op))))
-            return 1;
-        *ommp = bit_mask;
-        if (op->verbose > 1)
-            pr2serr("  disable interrupt: 0x%x in PIO_IDR%d\n", bit_mask,
-                    pioc_num);
+/* Returns 0 (pure input) or 1 (output) decoded from a digit, 'I' or 'O';
+ * else returns -1 . */
+static int
+parse_dir(const char * cp)
+{
+    int k;
+
+    if (isdigit(*cp)) {
+        k = atoi(cp);
+        return ((k < 0) || (k > 1)) ? -1 : k;
     }
-    if (op->wp_given && (0 == op->wpen)) {
-        if (NULL == ((ommp = get_mmp(mem_fd, PIO_WPMR, &mstat, op))))
-            return 1;
-        *ommp = (SAMA5D2_PIO_WPKEY << 8) | op->wpen;
-        if (op->verbose > 1)
-            pr2serr("  disable WPEN\n");
+    switch (toupper(*cp)) {
+    case 'I':
+        return 0;
+    case 'O':
+        return 1;
+    default:
+        return -1;
     }
+}
+
+/* Returns DRVSTR (0 to 3) decoded from a digit or a word starting with
+ * 'L', 'M' or 'H'; else returns -1 . */
+static int
+parse_drvstr(const char * cp)
+{
+    int k;
+
+    if (isdigit(*cp)) {
+        k = atoi(cp);
+        return ((k < 0) || (k > 3)) ? -1 : k;
+    }
+    switch (toupper(*cp)) {
+    case 'L':       /* lo, low or LOW should work */
+        return 0;
+    case 'M':       /* me, medium or MEDIUM should work */
+        return 2;
+    case 'H':       /* he, high or HIGH should work */
+        return 3;
+    default:
+        return -1;
+    }
+}
+
+/* Returns true if any option that changes a line's PIO_CFGR is given */
+static bool
+cfgr_opts_given(const struct opts_t * op)
+{
+    return ((op->do_func >= 0) || op->dir_given || op->di_schmitt ||
+            op->en_schmitt || op->di_if_slow || op->en_if_slow ||
+            op->di_if || op->en_if || op->evtsel_given || op->di_opd ||
+            op->en_opd || (op->di_pullup1dn2 > 0) ||
+            (op->en_pullup1dn2 > 0) || op->drvstr_given);
+}
+
+/* Applies the PIO_CFGR related options in *op to 'cfgr' and returns the
+ * result. Nothing is written to the hardware. */
+static unsigned int
+calc_cfgr(unsigned int cfgr, const struct opts_t * op)
+{
     if (op->do_func >= 0) {
-        if (NULL == cmmp) {
-            cmmp = do_mask_get_cfgr(mem_fd, bit_num, pioc_num, op);
-            if (NULL == cmmp)
-                return 1;
-            cfgr = *cmmp;
-        }
         if ((unsigned int)op->do_func != (CFGR_FUNC_MSK & cfgr)) {
             cfgr = ((~CFGR_FUNC_MSK & cfgr) | op->do_func);
-            cfgr_changed = true;
             if (op->verbose > 1)
                 pr2serr("  assert function=%d\n", op->do_func);
         }
     }
     if (op->dir_given) {
-        if (NULL == cmmp) {
-            cmmp = do_mask_get_cfgr(mem_fd, bit_num, pioc_num, op);
-            if (NULL == cmmp)
-                return 1;
-            cfgr = *cmmp;
-        }
         if (op->dir != !!(CFGR_DIR_MSK & cfgr)) {
             if (op->dir)
                 cfgr |= CFGR_DIR_MSK;
             else
                 cfgr &= ~CFGR_DIR_MSK;
-            cfgr_changed = true;
             if (op->verbose > 1)
                 pr2serr("  assert direction=%d\n", op->dir);
         }
     }
     if (op->di_schmitt || op->en_schmitt) {
-        if (NULL == cmmp) {
-            if (! (cmmp = do_mask_get_cfgr(mem_fd, bit_num, pioc_num, op)))
-                return 1;
-            cfgr = *cmmp;
-        }
         if (!!(CFGR_SCHMITT_MSK & cfgr) != !!op->di_schmitt) {
             if (op->di_schmitt)
                 cfgr |= CFGR_SCHMITT_MSK;
             else
                 cfgr &= ~CFGR_SCHMITT_MSK;
-            cfgr_changed = true;
             if (op->verbose > 1)
                 pr2serr("  assert schmitt=%d\n", op->en_schmitt);
         }
     }
-    if (op->scdr_given) {
-        if (NULL == ((ommp = get_mmp(mem_fd, S_PIO_SCDR, &mstat, op))))
-            return 1;
-        *ommp = op->scdr_div;
-        if (op->verbose > 1)
-            pr2serr("  assert scdiv=%d in S_PIO_SCDR\n", op->scdr_div);
-    }
     if (op->di_if_slow || op->en_if_slow) {
-        if (NULL == cmmp) {
-            if (! (cmmp = do_mask_get_cfgr(mem_fd, bit_num, pioc_num, op)))
-                return 1;
-            cfgr = *cmmp;
-        }
         if (!!(CFGR_IFSCEN_MSK & cfgr) != !!op->en_if_slow) {
             if (op->en_if_slow)
                 cfgr |= CFGR_IFSCEN_MSK;
             else
                 cfgr &= ~CFGR_IFSCEN_MSK;
-            cfgr_changed = true;
             if (op->verbose > 1)
                 pr2serr("  assert IFSCEN=%d\n", op->en_if_slow);
         }
     }
     if (op->di_if || op->en_if) {
-        if (NULL == cmmp) {
-            if (! (cmmp = do_mask_get_cfgr(mem_fd, bit_num, pioc_num, op)))
-                return 1;
-            cfgr = *cmmp;
-        }
         if (!!(CFGR_IFEN_MSK & cfgr) != !!op->en_if) {
             if (op->en_if)
                 cfgr |= CFGR_IFEN_MSK;
             else
                 cfgr &= ~CFGR_IFEN_MSK;
-            cfgr_changed = true;
             if (op->verbose > 1)
                 pr2serr("  assert IFEN=%d\n", op->en_if);
         }
     }
     if (op->evtsel_given) {
-        if (NULL == cmmp) {
-            if (! (cmmp = do_mask_get_cfgr(mem_fd, bit_num, pioc_num, op)))
-                return 1;
-            cfgr = *cmmp;
-        }
         if ((unsigned int)op->evtsel !=
             ((CFGR_EVTSEL_MSK & cfgr) >> CFGR_EVTSEL_SHIFT)) {
             cfgr = ((~CFGR_EVTSEL_MSK & cfgr) |
                     ((unsigned int)op->evtsel << CFGR_EVTSEL_SHIFT));
-            cfgr_changed = true;
             if (op->verbose > 1)
                 pr2serr("  assert EVTSEL=%d\n", op->evtsel);
         }
     }
     if (op->di_opd || op->en_opd) {
-        if (NULL == cmmp) {
-            if (! (cmmp = do_mask_get_cfgr(mem_fd, bit_num, pioc_num, op)))
-                return 1;
-            cfgr = *cmmp;
-        }
-        if (!!(CFGR_OPD_MSK & cfgr) != !!op->en_if) {
+        if (!!(CFGR_OPD_MSK & cfgr) != !!op->en_opd) {
             if (op->en_opd)
                 cfgr |= CFGR_OPD_MSK;
             else
                 cfgr &= ~CFGR_OPD_MSK;
-            cfgr_changed = true;
             if (op->verbose > 1)
                 pr2serr("  assert OPD=%d\n", op->en_opd);
         }
     }
-
     if ((op->di_pullup1dn2 > 0) || (op->en_pullup1dn2 > 0)) {
-        bool pullup_en, pulldown_en, changed;
-
-        if (NULL == cmmp) {
-            if (! (cmmp = do_mask_get_cfgr(mem_fd, bit_num, pioc_num, op)))
-                return 1;
-            cfgr = *cmmp;
-        }
-        pullup_en = !!(cfgr & ~CFGR_PUEN_MSK);
-        pulldown_en = !!(cfgr & ~CFGR_PDEN_MSK);
-        changed = false;
+        bool changed = false;
 
         /* Apply disables, if any, first */
         if (op->di_pullup1dn2 > 0) {
-            if ((1 & op->di_pullup1dn2) && pullup_en) {
+            if ((1 & op->di_pullup1dn2) && (CFGR_PUEN_MSK & cfgr)) {
                 cfgr &= ~CFGR_PUEN_MSK;
                 changed = true;
             }
-            if ((2 & op->di_pullup1dn2) && pulldown_en) {
+            if ((2 & op->di_pullup1dn2) && (CFGR_PDEN_MSK & cfgr)) {
                 cfgr &= ~CFGR_PDEN_MSK;
                 changed = true;
             }
-            if (changed) {
-                cfgr_changed = true;
-                if (op->verbose > 1)
-                    pr2serr("  P%c disable\n",
-                            ((1 & op->di_pullup1dn2) ? 'U' : 'D'));
-            }
+            if (changed && (op->verbose > 1))
+                pr2serr("  P%c disable\n",
+                        ((1 & op->di_pullup1dn2) ? 'U' : 'D'));
         }
         if (op->en_pullup1dn2 > 0) {
-            if ((1 & op->en_pullup1dn2) && (! pullup_en)) {
+            changed = false;
+            if ((1 & op->en_pullup1dn2) && (! (CFGR_PUEN_MSK & cfgr))) {
                 cfgr |= CFGR_PUEN_MSK;
                 changed = true;
             }
-            if ((2 & op->en_pullup1dn2) && (! pulldown_en)) {
+            if ((2 & op->en_pullup1dn2) && (! (CFGR_PDEN_MSK & cfgr))) {
                 cfgr |= CFGR_PDEN_MSK;
                 changed = true;
             }
-            if (changed) {
-                cfgr_changed = true;
-                if (op->verbose > 1)
-                    pr2serr("  P%c enable\n",
-                            ((1 & op->en_pullup1dn2) ? 'U' : 'D'));
-            }
+            if (changed && (op->verbose > 1))
+                pr2serr("  P%c enable\n",
+                        ((1 & op->en_pullup1dn2) ? 'U' : 'D'));
         }
     }
-    if (op->out_level >= 0) {
-        addr = ((op->out_level > 0) ? pio_sodr[pioc_num] : pio_codr[pioc_num]);
-        if (NULL == ((ommp = get_mmp(mem_fd, addr, &mstat, op))))
-            return 1;
-        *ommp = bit_mask;
-        if (op->verbose > 1)
-            pr2serr("  %s output\n", (op->out_level ? "Set" : "Clear"));
-    }
     if (op->drvstr_given) {
-        if (NULL == cmmp) {
-            if (! (cmmp = do_mask_get_cfgr(mem_fd, bit_num, pioc_num, op)))
-                return 1;
-            cfgr = *cmmp;
-        }
         if ((unsigned int)op->drvstr !=
             ((CFGR_DRVSTR_MSK & cfgr) >> CFGR_DRVSTR_SHIFT)) {
             cfgr = ((~CFGR_DRVSTR_MSK & cfgr) |
                     ((unsigned int)op->drvstr << CFGR_DRVSTR_SHIFT));
-            cfgr_changed = true;
             if (op->verbose > 1)
                 pr2serr("  assert drvstr=%d\n", op->drvstr);
         }
     }
-    if (cfgr_changed) {
-        if (cmmp) {
-            *cmmp = cfgr;
+    return cfgr;
+}
+
+static int
+do_set(int mem_fd, struct mmap_state * msp, int bit_num, int pioc_num,
+       const struct opts_t * op)
+{
+    unsigned int addr, bit_mask, ui;
+    unsigned int cfgr, new_cfgr;
+    bool equal;
+    volatile unsigned int * ommp;
+    volatile unsigned int * cmmp = NULL;
+
+    bit_mask = 1 << bit_num;
+
+    if (op->di_interrupt) {
+        if (NULL == ((ommp = get_mmp(mem_fd, pio_idr[pioc_num], msp))))
+            return 1;
+        *ommp = bit_mask;
+        if (op->verbose > 1)
+            pr2serr("  disable interrupt: 0x%x in PIO_IDR%d\n", bit_mask,
+                    pioc_num);
+    }
+    if (op->wp_given && (0 == op->wpen)) {
+        if (NULL == ((ommp = get_mmp(mem_fd, PIO_WPMR, msp))))
+            return 1;
+        *ommp = (SAMA5D2_PIO_WPKEY << 8) | op->wpen;
+        if (op->verbose > 1)
+            pr2serr("  disable WPEN\n");
+    }
+    if (op->scdr_given) {
+        if (NULL == ((ommp = get_mmp(mem_fd, S_PIO_SCDR, msp))))
+            return 1;
+        *ommp = op->scdr_div;
+        if (op->verbose > 1)
+            pr2serr("  assert scdiv=%d in S_PIO_SCDR\n", op->scdr_div);
+    }
+    if (op->out_level >= 0) {
+        addr = ((op->out_level > 0) ? pio_sodr[pioc_num] : pio_codr[pioc_num]);
+        if (NULL == ((ommp = get_mmp(mem_fd, addr, msp))))
+            return 1;
+        *ommp = bit_mask;
+        if (op->verbose > 1)
+            pr2serr("  %s output\n", (op->out_level ? "Set" : "Clear"));
+    }
+    if (cfgr_opts_given(op)) {
+        if (! (cmmp = do_mask_get_cfgr(mem_fd, msp, bit_num, pioc_num, op)))
+            return 1;
+        cfgr = *cmmp;
+        new_cfgr = calc_cfgr(cfgr, op);
+        if (new_cfgr != cfgr) {
+            *cmmp = new_cfgr;
             if (op->verbose > 1)
                 pr2serr("  cfgr changed so new PIO_CFGR%d=0x%x\n", pioc_num,
-                        cfgr);
-        } else
-            pr2serr(">>> bad logic: cfgr changed but NULL cmmp\n");
+                        new_cfgr);
+        } else if (op->verbose > 2)
+            pr2serr("  no change to PIO_CFGR%d\n", pioc_num);
     } else if (op->verbose > 2)
         pr2serr("  no change to PIO_CFGR%d\n", pioc_num);
     if (op->wr_dat_given) {
-        if (NULL == ((ommp = get_mmp(mem_fd, pio_mskr[pioc_num], &mstat, op))))
+        if (NULL == ((ommp = get_mmp(mem_fd, pio_mskr[pioc_num], msp))))
             return 1;
         *ommp = op->msk;
-        if (NULL == ((ommp = get_mmp(mem_fd, pio_odsr[pioc_num], &mstat, op))))
+        if (NULL == ((ommp = get_mmp(mem_fd, pio_odsr[pioc_num], msp))))
             return 1;
         ui = *ommp;
         equal = false;
@@ -1145,14 +1152,14 @@ do_set(int mem_fd, int bit_num, int pioc_num, const struct opts_t * op)
                     equal ? ", same so ignore" : "");
     }
     if (op->wp_given && op->wpen) {
-        if (NULL == ((ommp = get_mmp(mem_fd, PIO_WPMR, &mstat, op))))
+        if (NULL == ((ommp = get_mmp(mem_fd, PIO_WPMR, msp))))
             return 1;
         *ommp = (SAMA5D2_PIO_WPKEY << 8) | op->wpen;
         if (op->verbose > 1)
-            pr2serr("  disable WPEN\n");
+            pr2serr("  enable WPEN\n");
     }
     if (op->en_interrupt) {
-        if (NULL == ((ommp = get_mmp(mem_fd, pio_ier[pioc_num], &mstat, op))))
+        if (NULL == ((ommp = get_mmp(mem_fd, pio_ier[pioc_num], msp))))
             return 1;
         *ommp = bit_mask;
         if (op->verbose > 1)
@@ -1166,12 +1173,11 @@ do_set(int mem_fd, int bit_num, int pioc_num, const struct opts_t * op)
         } else {
             if (NULL == cmmp) {
                 /* need pio_msk written to prior to write to pio_iofr */
-                if (! (cmmp = do_mask_get_cfgr(mem_fd, bit_num, pioc_num,
-                                               op)))
+                if (! (cmmp = do_mask_get_cfgr(mem_fd, msp, bit_num,
+                                               pioc_num, op)))
                     return 1;
             }
-            if (NULL == ((ommp = get_mmp(mem_fd, pio_iofr[pioc_num], &mstat,
-                                         op))))
+            if (NULL == ((ommp = get_mmp(mem_fd, pio_iofr[pioc_num], msp))))
                 return 1;
             ui = 0;
             if (1 & op->freeze_phy1int2b3)
@@ -1199,17 +1205,566 @@ do_set(int mem_fd, int bit_num, int pioc_num, const struct opts_t * op)
         }
     }
 
-    if (mstat.mmap_ok) {
-        if (-1 == munmap(mstat.mmap_ptr, MAP_SIZE)) {
-            pr2serr("mmap_ptr=%p:\n", mstat.mmap_ptr);
-            perror("    munmap");
+    return 0;
+}
+
+/* Parses one LIST entry (e.g. "PC7:func=A,pu=1") into *lsp. The line's
+ * options start as a copy of *op (the command line) unless that line was
+ * given in an earlier entry. Returns 0 if okay, else 1 . */
+static int
+parse_line_entry(char * ep, const struct opts_t * op, struct line_set * lsp)
+{
+    int k, val, pioc_num, bit_num;
+    char ch;
+    char * cp;
+    char * kp;
+    char * vp;
+    char * savep;
+    struct opts_t * lop;
+
+    for (cp = ep, kp = ep; *cp; ++cp) {   /* remove all white space */
+        if (! isspace(*cp))
+            *kp++ = *cp;
+    }
+    *kp = '\0';
+    if ('\0' == *ep)
+        return 0;       /* empty entry (e.g. trailing ';') */
+    cp = ep;
+    if (('P' == toupper(cp[0])) && isalpha(cp[1]))
+        ++cp;
+    ch = toupper(*cp);
+    if ((ch < 'A') || (ch > 'D') || (! isdigit(cp[1]))) {
+        pr2serr("LIST entry '%s' should start with a line name like "
+                "'PC7'\n", ep);
+        return 1;
+    }
+    pioc_num = ch - 'A';
+    bit_num = (int)strtol(cp + 1, &cp, 10);
+    if ((bit_num < 0) || (bit_num > 31) ||
+        ((':' != *cp) && ('\0' != *cp))) {
+        pr2serr("LIST entry '%s': bad line name\n", ep);
+        return 1;
+    }
+    lop = &lsp->lop[pioc_num][bit_num];
+    if (! (lsp->sel_mask[pioc_num] & (1 << bit_num))) {
+        *lop = *op;
+        lsp->sel_mask[pioc_num] |= (1 << bit_num);
+    }
+    if ('\0' == *cp)
+        return 0;
+    for (kp = strtok_r(cp + 1, ",", &savep); kp;
+         kp = strtok_r(NULL, ",", &savep)) {
+        if (NULL == (vp = strchr(kp, '='))) {
+            pr2serr("P%c%d: expected KEY=VAL, got '%s'\n", 'A' + pioc_num,
+                    bit_num, kp);
             return 1;
-        } else if (op->verbose > 2)
-            pr2serr("trailing munmap() ok, mmap_ptr=%p\n", mstat.mmap_ptr);
+        }
+        *vp++ = '\0';
+        if ((0 == strcmp(kp, "func")) || (0 == strcmp(kp, "f"))) {
+            if ((k = parse_func(vp)) < 0)
+                goto bad_val;
+            lop->do_func = k;
+        } else if (0 == strcmp(kp, "dir")) {
+            if ((k = parse_dir(vp)) < 0)
+                goto bad_val;
+            lop->dir = k;
+            lop->dir_given = true;
+        } else if (0 == strcmp(kp, "drv")) {
+            if ((k = parse_drvstr(vp)) < 0)
+                goto bad_val;
+            lop->drvstr = k;
+            lop->drvstr_given = true;
+        } else if (0 == strcmp(kp, "evt")) {
+            k = atoi(vp);
+            if ((! isdigit(*vp)) || (k > 4))
+                goto bad_val;
+            lop->evtsel = k;
+            lop->evtsel_given = true;
+        } else if (0 == strcmp(kp, "freeze")) {
+            k = atoi(vp);
+            if ((! isdigit(*vp)) || (k > 3))
+                goto bad_val;
+            lop->freeze_phy1int2b3 = k;
+            lop->freeze_given = true;
+        } else {
+            /* the remaining keys are all 0 (disable) or 1 (enable) */
+            if ((('0' != vp[0]) && ('1' != vp[0])) || ('\0' != vp[1]))
+                goto bad_val;
+            val = ('1' == vp[0]);
+            if (0 == strcmp(kp, "lev"))
+                lop->out_level = val;
+            else if ((0 == strcmp(kp, "pu")) || (0 == strcmp(kp, "pd"))) {
+                k = ('u' == kp[1]) ? 1 : 2;
+                if (val) {
+                    lop->en_pullup1dn2 |= k;
+                    lop->di_pullup1dn2 &= ~k;
+                } else {
+                    lop->di_pullup1dn2 |= k;
+                    lop->en_pullup1dn2 &= ~k;
+                }
+            } else if (0 == strcmp(kp, "opd")) {
+                lop->en_opd = val;
+                lop->di_opd = ! val;
+            } else if (0 == strcmp(kp, "schmitt")) {
+                lop->en_schmitt = val;
+                lop->di_schmitt = ! val;
+            } else if (0 == strcmp(kp, "if")) {
+                lop->en_if = val;
+                lop->di_if = ! val;
+            } else if (0 == strcmp(kp, "ifsc")) {
+                lop->en_if_slow = val;
+                lop->di_if_slow = ! val;
+            } else if (0 == strcmp(kp, "int")) {
+                lop->en_interrupt = val;
+                lop->di_interrupt = ! val;
+            } else {
+                pr2serr("P%c%d: unknown KEY '%s'\n", 'A' + pioc_num,
+                        bit_num, kp);
+                return 1;
+            }
+        }
+    }
+    return 0;
+
+bad_val:
+    pr2serr("P%c%d: bad value '%s' for KEY '%s'\n", 'A' + pioc_num, bit_num,
+            vp, kp);
+    return 1;
+}
+
+/* Parses LIST, entries separated by ';' (or newline). Returns 0 if okay,
+ * else 1 . */
+static int
+parse_line_list(char * lp, const struct opts_t * op, struct line_set * lsp)
+{
+    char * ep;
+    char * savep;
+
+    for (ep = strtok_r(lp, ";\n", &savep); ep;
+         ep = strtok_r(NULL, ";\n", &savep)) {
+        if (parse_line_entry(ep, op, lsp))
+            return 1;
+    }
+    return 0;
+}
+
+/* Reads a LIST from file named 'fn' ('-' for stdin). Anything from '#'
+ * to the end of a text line is ignored. Returns 0 if okay, else 1 . */
+static int
+read_line_file(const char * fn, const struct opts_t * op,
+               struct line_set * lsp)
+{
+    int res = 0;
+    int n = 0;
+    bool from_stdin;
+    char * cp;
+    FILE * fp;
+    char b[1024];
+
+    from_stdin = ((1 == strlen(fn)) && ('-' == fn[0]));
+    if (from_stdin)
+        fp = stdin;
+    else if (NULL == (fp = fopen(fn, "r"))) {
+        pr2serr("unable to open %s: %s\n", fn, strerror(errno));
+        return 1;
+    }
+    while (fgets(b, sizeof(b), fp)) {
+        ++n;
+        if ((cp = strchr(b, '#')))
+            *cp = '\0';
+        if (parse_line_list(b, op, lsp)) {
+            pr2serr("  problem at line %d of %s\n", n, fn);
+            res = 1;
+            break;
+        }
+    }
+    if (! from_stdin)
+        fclose(fp);
+    return res;
+}
+
+/* Returns mask of lines in bank 'pioc_num' selected by 'which' (LS_*).
+ * For LS_FREEZE only lines with PHY1INT2B3 equal to 'val' are included. */
+static unsigned int
+bank_line_mask(const struct line_set * lsp, int pioc_num, int which, int val)
+{
+    int j;
+    unsigned int bit_mask;
+    unsigned int res = 0;
+    const struct opts_t * lop;
+
+    for (j = 0, bit_mask = 1; j < LINES_PER_BANK; ++j, bit_mask <<= 1) {
+        if (! (lsp->sel_mask[pioc_num] & bit_mask))
+            continue;
+        lop = &lsp->lop[pioc_num][j];
+        switch (which) {
+        case LS_DI_INT:
+            if (lop->di_interrupt)
+                res |= bit_mask;
+            break;
+        case LS_EN_INT:
+            if (lop->en_interrupt)
+                res |= bit_mask;
+            break;
+        case LS_CLR_OUT:
+            if (0 == lop->out_level)
+                res |= bit_mask;
+            break;
+        case LS_SET_OUT:
+            if (lop->out_level > 0)
+                res |= bit_mask;
+            break;
+        case LS_FREEZE:
+            if (lop->freeze_given && (val == lop->freeze_phy1int2b3))
+                res |= bit_mask;
+            break;
+        }
+    }
+    return res;
+}
+
+/* Applies the settings of all lines in *lsp in one pass, keeping the same
+ * order of actions as do_set(). Each of PIO_IDR, PIO_SODR, PIO_CODR and
+ * PIO_IER is written at most once per bank, and lines needing the same
+ * new PIO_CFGR value share one PIO_MSKR mask and one PIO_CFGR write. */
+static int
+do_multi_set(int mem_fd, struct mmap_state * msp,
+             const struct line_set * lsp, const struct opts_t * op)
+{
+    int k, j, g, v, num_grp, num_lines, num_wr;
+    unsigned int bit_mask, mask, cfgr, new_cfgr, ui;
+    bool wp_was_on, wp_on;
+    volatile unsigned int * mmp;
+    volatile unsigned int * mskr_p;
+    volatile unsigned int * cfgr_p;
+    unsigned int grp_val[LINES_PER_BANK];
+    unsigned int grp_mask[LINES_PER_BANK];
+
+    for (k = 0; k < PIO_BANKS_SAMA5D2; ++k) {
+        if ((mask = bank_line_mask(lsp, k, LS_DI_INT, 0))) {
+            if (NULL == ((mmp = get_mmp(mem_fd, pio_idr[k], msp))))
+                return 1;
+            *mmp = mask;
+            if (op->verbose > 1)
+                pr2serr("  disable interrupt: 0x%x in PIO_IDR%d\n", mask, k);
+        }
+    }
+    /* Write protection: dropped once (if on) and restored once at end */
+    if (NULL == ((mmp = get_mmp(mem_fd, PIO_WPMR, msp))))
+        return 1;
+    wp_was_on = !!(0x1 & *mmp);
+    wp_on = op->wp_given ? !!op->wpen : wp_was_on;
+    if (wp_was_on) {
+        *mmp = (SAMA5D2_PIO_WPKEY << 8);
+        if (op->verbose > 1)
+            pr2serr("  disable WPEN\n");
+    }
+    if (op->scdr_given) {
+        if (NULL == ((mmp = get_mmp(mem_fd, S_PIO_SCDR, msp))))
+            return 1;
+        *mmp = op->scdr_div;
+        if (op->verbose > 1)
+            pr2serr("  assert scdiv=%d in S_PIO_SCDR\n", op->scdr_div);
+    }
+    for (k = 0; k < PIO_BANKS_SAMA5D2; ++k) {
+        if ((mask = bank_line_mask(lsp, k, LS_SET_OUT, 0))) {
+            if (NULL == ((mmp = get_mmp(mem_fd, pio_sodr[k], msp))))
+                return 1;
+            *mmp = mask;
+            if (op->verbose > 1)
+                pr2serr("  set output: 0x%x in PIO_SODR%d\n", mask, k);
+        }
+        if ((mask = bank_line_mask(lsp, k, LS_CLR_OUT, 0))) {
+            if (NULL == ((mmp = get_mmp(mem_fd, pio_codr[k], msp))))
+                return 1;
+            *mmp = mask;
+            if (op->verbose > 1)
+                pr2serr("  clear output: 0x%x in PIO_CODR%d\n", mask, k);
+        }
+    }
+    num_lines = 0;
+    num_wr = 0;
+    for (k = 0; k < PIO_BANKS_SAMA5D2; ++k) {
+        if (0 == lsp->sel_mask[k])
+            continue;
+        num_grp = 0;
+        for (j = 0, bit_mask = 1; j < LINES_PER_BANK; ++j, bit_mask <<= 1) {
+            if (! (lsp->sel_mask[k] & bit_mask))
+                continue;
+            if (! cfgr_opts_given(&lsp->lop[k][j]))
+                continue;
+            if (op->verbose > 1)
+                pr2serr("P%c%d:\n", 'A' + k, j);
+            if (! (cfgr_p = do_mask_get_cfgr(mem_fd, msp, j, k, op)))
+                return 1;
+            cfgr = *cfgr_p;
+            new_cfgr = calc_cfgr(cfgr, &lsp->lop[k][j]);
+            if (new_cfgr == cfgr) {
+                if (op->verbose > 2)
+                    pr2serr("  no change to PIO_CFGR%d\n", k);
+                continue;
+            }
+            ++num_lines;
+            for (g = 0; g < num_grp; ++g) {
+                if (new_cfgr == grp_val[g])
+                    break;
+            }
+            if (g == num_grp) {
+                grp_val[g] = new_cfgr;
+                grp_mask[g] = 0;
+                ++num_grp;
+            }
+            grp_mask[g] |= bit_mask;
+        }
+        if (0 == num_grp)
+            continue;
+        if (NULL == ((mskr_p = get_mmp(mem_fd, pio_mskr[k], msp))))
+            return 1;
+        if (NULL == ((cfgr_p = get_mmp(mem_fd, pio_cfgr[k], msp))))
+            return 1;
+        for (g = 0; g < num_grp; ++g, ++num_wr) {
+            *mskr_p = grp_mask[g];
+            *cfgr_p = grp_val[g];
+            if (op->verbose > 1)
+                pr2serr("  PIO_MSKR%d=0x%x, new PIO_CFGR%d=0x%x\n", k,
+                        grp_mask[g], k, grp_val[g]);
+        }
+    }
+    if (op->verbose)
+        pr2serr("%d line%s needed PIO_CFGR changed, used %d PIO_CFGR "
+                "write%s\n", num_lines, ((1 == num_lines) ? "" : "s"),
+                num_wr, ((1 == num_wr) ? "" : "s"));
+    if (wp_on) {
+        if (NULL == ((mmp = get_mmp(mem_fd, PIO_WPMR, msp))))
+            return 1;
+        *mmp = (SAMA5D2_PIO_WPKEY << 8) | 0x1;
+        if (op->verbose > 1)
+            pr2serr("  enable WPEN\n");
+    }
+    for (k = 0; k < PIO_BANKS_SAMA5D2; ++k) {
+        if ((mask = bank_line_mask(lsp, k, LS_EN_INT, 0))) {
+            if (NULL == ((mmp = get_mmp(mem_fd, pio_ier[k], msp))))
+                return 1;
+            *mmp = mask;
+            if (op->verbose > 1)
+                pr2serr("  enable interrupt: 0x%x in PIO_IER%d\n", mask, k);
+        }
+    }
+    for (k = 0; k < PIO_BANKS_SAMA5D2; ++k) {
+        for (v = 1; v < 4; ++v) {
+            if (0 == (mask = bank_line_mask(lsp, k, LS_FREEZE, v)))
+                continue;
+            /* PIO_IOFR acts on the lines selected in PIO_MSKR */
+            if (NULL == ((mmp = get_mmp(mem_fd, pio_mskr[k], msp))))
+                return 1;
+            *mmp = mask;
+            if (NULL == ((mmp = get_mmp(mem_fd, pio_iofr[k], msp))))
+                return 1;
+            ui = 0;
+            if (1 & v)
+                ui |= IOFR_FPHY_MSK;
+            if (2 & v)
+                ui |= IOFR_FINT_MSK;
+            *mmp = (SAMA5D2_PIO_FRZKEY << 8) | ui;
+            if (op->verbose > 1)
+                pr2serr("  set IOFR_%s for 0x%x in bank %c\n",
+                        ((3 == v) ? "FPHY+IOFR_FINT" :
+                                    ((1 == v) ? "FPHY" : "FINT")),
+                        mask, 'A' + k);
+        }
+    }
+    return 0;
+}
+
+
+/* Reads MSK,DAT[,DELAY_NS] records from file named 'fn' ('-' for stdin)
+ * into a growing array. MSK and DAT are hexadecimal (as for '-X'),
+ * DELAY_NS is decimal. Returns number of records (>= 0) with the array
+ * in *prpp (caller frees), else -1 on error. */
+static int
+read_pattern_file(const char * fn, struct pat_rec ** prpp, int verbose)
+{
+    int k, n, num;
+    int max_num = 0;
+    int res = -1;
+    bool from_stdin;
+    char * cp;
+    FILE * fp;
+    struct pat_rec * arr = NULL;
+    struct pat_rec * prp;
+    char b[256];
+
+    *prpp = NULL;
+    from_stdin = ((1 == strlen(fn)) && ('-' == fn[0]));
+    if (from_stdin)
+        fp = stdin;
+    else if (NULL == (fp = fopen(fn, "r"))) {
+        pr2serr("unable to open %s: %s\n", fn, strerror(errno));
+        return -1;
+    }
+    for (n = 0, num = 0; fgets(b, sizeof(b), fp); ) {
+        ++n;
+        if ((cp = strchr(b, '#')))
+            *cp = '\0';
+        for (cp = b; isspace(*cp); ++cp)
+            ;
+        if ('\0' == *cp)
+            continue;
+        if (num >= max_num) {
+            max_num = max_num ? (2 * max_num) : 1024;
+            prp = (struct pat_rec *)realloc(arr, max_num * sizeof(*arr));
+            if (NULL == prp) {
+                pr2serr("unable to allocate %d pattern records\n", max_num);
+                goto fini;
+            }
+            arr = prp;
+        }
+        prp = arr + num;
+        prp->delay_ns = 0;
+        k = sscanf(cp, "%8x,%8x,%u", &prp->msk, &prp->dat, &prp->delay_ns);
+        if (k < 2) {
+            pr2serr("%s: line %d: expected MSK,DAT[,DELAY_NS]\n", fn, n);
+            goto fini;
+        }
+        prp->dat &= prp->msk;
+        ++num;
+    }
+    if (verbose > 1)
+        pr2serr("read %d pattern records from %s\n", num, fn);
+    res = num;
+fini:
+    if (! from_stdin)
+        fclose(fp);
+    if (res < 0)
+        free(arr);
+    else
+        *prpp = arr;
+    return res;
+}
+
+static void
+ts_add_ns(struct timespec * tsp, unsigned int ns)
+{
+    tsp->tv_nsec += ns % 1000000000;
+    tsp->tv_sec += ns / 1000000000;
+    if (tsp->tv_nsec >= 1000000000) {
+        tsp->tv_nsec -= 1000000000;
+        ++tsp->tv_sec;
+    }
+}
+
+/* Waits until CLOCK_MONOTONIC reaches *tsp. Short waits are spun since
+ * the scheduler's wake-up latency would swamp them. */
+static void
+wait_until(const struct timespec * tsp, unsigned int ns)
+{
+    struct timespec now;
+
+    if (ns >= PAT_SPIN_NS) {
+        while (EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, tsp,
+                                        NULL))
+            ;
+        return;
+    }
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    } while ((now.tv_sec < tsp->tv_sec) ||
+             ((now.tv_sec == tsp->tv_sec) && (now.tv_nsec < tsp->tv_nsec)));
+}
+
+/* Plays 'num' pattern records out of bank 'pioc_num'. Each record is one
+ * store to PIO_ODSR (plus one to PIO_MSKR when MSK changes from the
+ * previous record) so all lines in MSK change together. Record k is
+ * applied at the start time plus the sum of the earlier DELAY_NS values
+ * (or as soon as possible if already late). */
+static int
+do_pattern(int mem_fd, struct mmap_state * msp, int pioc_num,
+           const struct pat_rec * arr, int num, const struct opts_t * op)
+{
+    int k;
+    unsigned int cur_msk;
+    double el;
+    const struct pat_rec * prp;
+    volatile unsigned int * mskr_p;
+    volatile unsigned int * odsr_p;
+    struct timespec start, next, end;
+
+    if (NULL == ((mskr_p = get_mmp(mem_fd, pio_mskr[pioc_num], msp))))
+        return 1;
+    if (NULL == ((odsr_p = get_mmp(mem_fd, pio_odsr[pioc_num], msp))))
+        return 1;
+    cur_msk = *mskr_p;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    next = start;
+    for (k = 0, prp = arr; k < num; ++k, ++prp) {
+        if (prp->msk != cur_msk) {
+            *mskr_p = prp->msk;
+            cur_msk = prp->msk;
+        }
+        *odsr_p = prp->dat;
+        if (prp->delay_ns) {
+            ts_add_ns(&next, prp->delay_ns);
+            wait_until(&next, prp->delay_ns);
+        }
+    }
+    if (op->verbose) {
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        el = (end.tv_sec - start.tv_sec) +
+             ((end.tv_nsec - start.tv_nsec) / 1e9);
+        pr2serr("%d records written to PIO%c in %.6f seconds", num,
+                'A' + pioc_num, el);
+        if (el > 0.0)
+            pr2serr(", %.1f records per second\n", num / el);
+        else
+            pr2serr("\n");
     }
     return 0;
 }
 
+/* Handles '-x FILE': parse whole FILE first, then map the PIO page and
+ * (unless '-n') switch to SCHED_FIFO before writing anything. */
+static int
+do_pattern_file(const char * fn, int pioc_num, bool no_sched,
+                const struct opts_t * op)
+{
+    int k, num, mem_fd;
+    int res = 1;
+    struct pat_rec * arr;
+    struct mmap_state mstat;
+    struct sched_param spr;
+
+    if ((num = read_pattern_file(fn, &arr, op->verbose)) < 0)
+        return 1;
+    if (0 == num) {
+        pr2serr("no pattern records found in %s\n", fn);
+        return 1;
+    }
+    if ((mem_fd = open(DEV_MEM, O_RDWR | O_SYNC)) < 0) {
+        perror("open of " DEV_MEM " failed");
+        goto fini;
+    } else if (op->verbose > 2)
+        printf("open(" DEV_MEM "O_RDWR | O_SYNC) okay\n");
+    init_mmap_state(&mstat, op->verbose);
+
+    if (! no_sched) {
+        k = sched_get_priority_min(SCHED_FIFO);
+        if (k < 0)
+            pr2serr("sched_get_priority_min: %s\n", strerror(errno));
+        else {
+            spr.sched_priority = k;
+            if (sched_setscheduler(0, SCHED_FIFO, &spr) < 0)
+                pr2serr("sched_setscheduler: %s\n", strerror(errno));
+        }
+    }
+    res = do_pattern(mem_fd, &mstat, pioc_num, arr, num, op);
+
+    if (release_mmap_state(&mstat))
+        res = 1;
+    close(mem_fd);
+fini:
+    free(arr);
+    return res;
+}
 
 int
 main(int argc, char ** argv)
@@ -1222,18 +1777,25 @@ main(int argc, char ** argv)
     int bit_num = -1;
     const char * cp;
     const char * funcp = NULL;
+    const char * list_fn = NULL;
+    const char * pat_fn = NULL;
+    char * listp = NULL;
+    bool no_sched = false;
     char ch;
     char bank = '\0';
     struct opts_t opts;
     struct opts_t * op;
     struct stat sb;
+    struct mmap_state mstat;
+    static struct line_set lset;
 
     op = &opts;
     memset(op, 0, sizeof(opts));
     op->out_level = -1;
     op->do_func = -1;
     while ((c = getopt(argc, argv,
-                       "b:d:D:eE:f:F:gGhiImMp:r:s:S:tTuUvVw:X:zZ")) != -1) {
+                       "b:c:d:D:eE:f:F:gGhiIl:mMnp:r:s:S:tTuUvVw:x:X:zZ"))
+           != -1) {
         switch (c) {
         case 'b':
             cp = optarg;
@@ -1256,6 +1818,9 @@ main(int argc, char ** argv)
             }
             bit_num = k;
             break;
+        case 'c':
+            list_fn = optarg;
+            break;
         case 'd':
             k = atoi(optarg);
             if ((k < 0) || (k > 16383)) {
@@ -1266,30 +1831,12 @@ main(int argc, char ** argv)
             op->scdr_given = true;
             break;
         case 'D':
-            if (isdigit(*optarg)) {
-                k = atoi(optarg);
-                if ((k < 0) || (k > 3)) {
-                    pr2serr("'-D' expects a bit number from 0 to 3\n");
-                    return 1;
-                }
-                op->drvstr = k;
-            } else {
-                switch (toupper(*optarg)) {
-                case 'L':       /* lo, low or LOW should work */
-                    op->drvstr = 0;
-                    break;
-                case 'M':       /* me, medium or MEDIUM should work */
-                    op->drvstr = 2;
-                    break;
-                case 'H':       /* he, high or HIGH should work */
-                    op->drvstr = 3;
-                    break;
-                default:
-                    pr2serr("'-D' expects a word starting with 'L', 'M' or "
-                            "'H'\n");
-                    return 1;
-                }
+            if ((k = parse_drvstr(optarg)) < 0) {
+                pr2serr("'-D' expects a number from 0 to 3, or a word "
+                        "starting with\n'L', 'M' or 'H'\n");
+                return 1;
             }
+            op->drvstr = k;
             op->drvstr_given = true;
             break;
         case 'E':
@@ -1335,12 +1882,18 @@ main(int argc, char ** argv)
         case 'I':
             ++op->en_interrupt;
             break;
+        case 'l':
+            listp = optarg;
+            break;
         case 'm':
             ++op->di_opd;
             break;
         case 'M':
             ++op->en_opd;
             break;
+        case 'n':
+            no_sched = true;
+            break;
         case 'p':
             if (isalpha(*optarg)) {
                 ch = toupper(*optarg);
@@ -1364,28 +1917,12 @@ main(int argc, char ** argv)
             }
             break;
         case 'r':
-            if (isdigit(*optarg)) {
-                k = atoi(optarg);
-                if ((k < 0) || (k > 1)) {
-                    pr2serr("'-r' expects 0 (pure input) or 1 (output "
-                            "enabled)\n");
-                    return 1;
-                }
-                op->dir = k;
-            } else {
-                switch (toupper(*optarg)) {
-                case 'I':
-                    op->dir = 0;
-                    break;
-                case 'O':
-                    op->dir = 1;
-                    break;
-                default:
-                    pr2serr("'-r' expects 'I' (pure input) or 'O' (output "
-                            "enabled)\n");
-                    return 1;
-                }
+            if ((k = parse_dir(optarg)) < 0) {
+                pr2serr("'-r' expects 0 or 'I' (pure input); or 1 or 'O' "
+                        "(output enabled)\n");
+                return 1;
             }
+            op->dir = k;
             op->dir_given = true;
             break;
         case 's':
@@ -1435,6 +1972,9 @@ main(int argc, char ** argv)
             op->wp_given = true;
             op->wpen = k;
             break;
+        case 'x':
+            pat_fn = optarg;
+            break;
         case 'X':
             k = sscanf(optarg, "%8x,%8x", &op->msk, &op->dat);
             if (2 != k) {
@@ -1469,39 +2009,7 @@ main(int argc, char ** argv)
         exit(help_exit);
     }
     if (funcp) {
-        switch (funcp[0]) {
-        case 'a': case 'A':
-            op->do_func = PERI_A;
-            break;
-        case 'b': case 'B':
-            op->do_func = PERI_B;
-            break;
-        case 'c': case 'C':
-            op->do_func = PERI_C;
-            break;
-        case 'd': case 'D':
-            op->do_func = PERI_D;
-            break;
-        case 'e': case 'E':
-            op->do_func = PERI_E;
-            break;
-        case 'f': case 'F':
-            op->do_func = PERI_F;
-            break;
-        case 'g': case 'G':
-            op->do_func = PERI_G;
-            break;
-        case 'p': case 'P':
-            op->do_func = FUNC_GPIO;
-            break;
-        default:
-            if (isdigit(funcp[0])) {
-                k = atoi(funcp);
-                if ((k >= 0) && (k <= 7)) {
-                    op->do_func = k;
-                    break;
-                }
-            }
+        if ((op->do_func = parse_func(funcp)) < 0) {
             pr2serr("'-s' expects 'P', or 'A' to 'G'; or 0 to 7\n");
             return 1;
         }
@@ -1518,7 +2026,24 @@ main(int argc, char ** argv)
     if (op->enumerate)
         return do_enumerate(op->enumerate, bank, origin0, op->enumerate > 2);
 
-    if (op->wr_dat_given) {
+    if (pat_fn) {
+        if (('\0' == bank) || (bit_num >= 0) || listp || list_fn ||
+            op->wr_dat_given) {
+            pr2serr("'-x FILE' needs '-p PORT' (a bank letter) and cannot "
+                    "be used with\n'-b BN', '-c FILE', '-l LIST' or "
+                    "'-X MSK,DAT'\n");
+            goto help_exit;
+        }
+        return do_pattern_file(pat_fn, bank - 'A', no_sched, op);
+    }
+    if (listp || list_fn) {
+        if ((knum >= 0) || (bit_num >= 0) || bank || op->wr_dat_given) {
+            pr2serr("With '-l LIST' or '-c FILE' the lines are named in "
+                    "LIST so\n'-b BN', '-p PORT' and '-X MSK,DAT' are not "
+                    "permitted\n");
+            goto help_exit;
+        }
+    } else if (op->wr_dat_given) {
         if ('\0' == bank) {
             pr2serr("With '-X MSK,DAT' require '-p PORT' since it will "
                     "potentially\nwrite to all 32 lines in that bank\n");
@@ -1548,7 +2073,7 @@ main(int argc, char ** argv)
             }
         } else
             knum = (((! origin0) + bank - 'A') * 32) + bit_num;
-    } else {
+    } else if (! (listp || list_fn)) {
         pr2serr("Need to give gpio line with '-p PORT' and/or "
                 "'-b BN'\n");
         goto help_exit;
@@ -1577,6 +2102,33 @@ main(int argc, char ** argv)
         pr2serr("Can only have one of '-z' and '-Z'\n");
         goto help_exit;
     }
+    if (listp || list_fn) {
+        if (listp && parse_line_list(listp, op, &lset))
+            return 1;
+        if (list_fn && read_line_file(list_fn, op, &lset))
+            return 1;
+        for (k = 0; k < PIO_BANKS_SAMA5D2; ++k) {
+            if (lset.sel_mask[k])
+                break;
+        }
+        if (k >= PIO_BANKS_SAMA5D2) {
+            pr2serr("no lines found in LIST\n");
+            return 1;
+        }
+        if ((mem_fd = open(DEV_MEM, O_RDWR | O_SYNC)) < 0) {
+            perror("open of " DEV_MEM " failed");
+            return 1;
+        } else if (op->verbose > 2)
+            printf("open(" DEV_MEM "O_RDWR | O_SYNC) okay\n");
+        init_mmap_state(&mstat, op->verbose);
+
+        res = do_multi_set(mem_fd, &mstat, &lset, op);
+
+        if (release_mmap_state(&mstat))
+            res = 1;
+        close(mem_fd);
+        return res;
+    }
 
     pioc_num = bank ? (bank - 'A') : ((knum - (origin0 ? 0 : 32)) / 32);
     if (bit_num < 0)
@@ -1591,9 +2143,12 @@ main(int argc, char ** argv)
         return 1;
     } else if (op->verbose > 2)
         printf("open(" DEV_MEM "O_RDWR | O_SYNC) okay\n");
+    init_mmap_state(&mstat, op->verbose);
 
-    res = do_set(mem_fd, bit_num, pioc_num, op);
+    res = do_set(mem_fd, &mstat, bit_num, pioc_num, op);
 
+    if (release_mmap_state(&mstat))
+        res = 1;
     if (mem_fd >= 0)
         close(mem_fd);
     return res;
@@ -33,16 +33,17 @@
  * Utility for fetching SAMA5D2 family SoC PIO status values.
  * The SAMA5D2 family has 4 PIOs each with 32 gpio lines: PA0-PA31, PB0-PB31,
  * PC0-PC31 and PD0-PD31.
- * This utility uses memory mapped IO.
+ * This utility uses memory mapped IO. The registers of each selected bank
+ * are read once into a snapshot which is then used for all output.
  *
  ****************************************************/
 
-#define _XOPEN_SOURCE 500
+#define _XOPEN_SOURCE 600
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <stdbool.h>
-#include <stdarg.h>
 #include <ctype.h>
 #include <string.h>
 #include <unistd.h>
@@ -52,17 +53,20 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <signal.h>
 #include <libgen.h>
 
+#include "mmap_regs.h"
+#include "sa_misc.h"
 
-static const char * version_str = "1.02 20160220";
+
+static const char * version_str = "1.03 20261014";
 
 
 #define PIO_BANKS_SAMA5D2 4  /* PIOA, PIOB, PIOC and PIOD */
 #define LINES_PER_BANK 32
-#define MAP_SIZE 4096   /* assume to be power of 2 */
-#define MAP_MASK (MAP_SIZE - 1)
-#define DEV_MEM "/dev/mem"
 
 #define PIO_WPMR 0xfc0385e0     /* Write protection mode (rw) */
 #define PIO_WPSR 0xfc0385e4     /* Write protection status (ro) */
@@ -111,12 +115,48 @@ static const char * version_str = "1.02 20160220";
  */
 
 
-struct mmap_state {
-    void * mmap_ptr;
-    off_t prev_mask_addrp;
-    int mmap_ok;
+/* Registers of one PIO bank captured by snap_bank(). PIO_CFGR is per line
+ * (selected by PIO_MSKR) while the others hold one bit per line so they
+ * are read once, giving a consistent view of the whole bank. */
+struct bank_snap {
+    unsigned int line_mask;     /* lines whose cfgr[] entry is valid */
+    unsigned int pdsr;
+    unsigned int odsr;
+    unsigned int imr;
+    unsigned int isr;           /* only valid if pio_snap::interrupt */
+    unsigned int locksr;
+    unsigned int cfgr[LINES_PER_BANK];
+};
+
+struct pio_snap {
+    int interrupt;      /* ISR read (which clears it) */
+    int write_prot;     /* WPSR read (which clears it) */
+    int scd;            /* -1 if S_PIO_SCDR not read */
+    unsigned int wpm;
+    unsigned int wps;
+    struct bank_snap bank[PIO_BANKS_SAMA5D2];
+};
+
+/* Fixed layout record written for each line by '-r' (raw binary output),
+ * in host byte order (little endian on the SAMA5D2). */
+struct pio_line_rec {
+    uint8_t bank;       /* 0 -> PIOA, 1 -> PIOB, 2 -> PIOC, 3 -> PIOD */
+    uint8_t line;       /* 0 to 31 */
+    uint8_t func;       /* 0 -> GPIO, 1 -> peri_a, ... 7 -> peri_g */
+    uint8_t status;     /* PIO_REC_* bits */
+    uint32_t cfgr;      /* PIO_CFGR value for this line */
 };
 
+#define PIO_REC_PDS 0x1         /* pin data status */
+#define PIO_REC_ODS 0x2         /* output data status */
+#define PIO_REC_IM 0x4          /* interrupt mask */
+#define PIO_REC_IS 0x8          /* interrupt status, only with '-i' */
+#define PIO_REC_LOCKS 0x10      /* lock status */
+
+#define OUT_FMT_TEXT 0
+#define OUT_FMT_JSON 1
+#define OUT_FMT_RAW 2
+
 struct periph_name {
     int pin;            /* 0 to 31 (PIO line number within bank) */
     int periph;         /* 1 for A, 2 for B, etc */
@@ -165,6 +205,7 @@ static unsigned int s_pio_iofr[] = {0xfc03903c, 0xfc03907c, 0xfc0390bc,
 #endif
 
 static int verbose = 0;
+static volatile sig_atomic_t watch_stop = 0;
 
 static const char * driv_arr[] = {"LO_DRIVE", "LO_DRIVE", "ME_DRIVE",
                                   "HI_DRIVE"};
@@ -554,34 +595,15 @@ static const char * bank_str_arr[] = {
 };
 
 
-#ifdef __GNUC__
-static int pr2serr(const char * fmt, ...)
-        __attribute__ ((format (printf, 1, 2)));
-#else
-static int pr2serr(const char * fmt, ...);
-#endif
-
-
-static int
-pr2serr(const char * fmt, ...)
-{
-    va_list args;
-    int n;
-
-    va_start(args, fmt);
-    n = vfprintf(stderr, fmt, args);
-    va_end(args);
-    return n;
-}
-
 static void
 usage(int hval)
 {
     if (1 == hval) {
         pr2serr("Usage: a5d2_pio_status [-a] [-b BN] [-B] [-d] [-e] "
                 "[-f STR] [-h]\n"
-                "                       [-i] [-p PORT] [-s] [-S] [-t] [-v] "
-                "[-V] [-w]\n"
+                "                       [-i] [-j] [-p PORT] [-r] [-s] [-S] "
+                "[-t] [-v]\n"
+                "                       [-V] [-w] [-W INTERVAL]\n"
                 "  where:\n"
                 "    -a           list all lines within a bank (def: "
                 "'-p A')\n"
@@ -609,9 +631,13 @@ usage(int hval)
                 "abbreviations\n"
                 "    -i           read interrupt status register which "
                 "then clears it\n"
+                "    -j           output selected lines as a JSON document\n"
                 "    -p PORT      port bank ('A' to 'D') or gpio kernel "
                 "line number\n"
                 "                 0 -> PA0, 1 -> PA1 ... 127 -> PD31\n"
+                "    -r           output selected lines as raw binary "
+                "records, 8\n"
+                "                 bytes per line (see '-hh')\n"
                 "    -s           summarize all lines in a bank, equivalent "
                 "to\n"
                 "                 '-a -BB -t'. Example: 'a5d2_pio_status "
@@ -628,7 +654,13 @@ usage(int hval)
                 "    -V           print version string then exit\n");
         pr2serr("    -w           reads the write protect status register "
                 "which\n"
-                "                 then clears that register\n");
+                "                 then clears that register\n"
+                "    -W INTERVAL    after normal output, re-read selected "
+                "lines every\n"
+                "                   INTERVAL milliseconds (suffix 's' for "
+                "seconds)\n"
+                "                   and print those whose CFGR, PDSR or "
+                "ODSR changed\n");
         pr2serr("\nSAMA5D2x SoC PIO fetch status program. Uses memory "
                 "mapped IO to\nfetch PIO registers and shows settings for "
                 "given line(s). Try '-hh'\nfor more help.\n");
@@ -672,72 +704,15 @@ usage(int hval)
                 "GPIO line. An\nentry like 'is=-1' means that this entry "
                 "(the interrupt status\nregister) has not been read.\n"
                );
+        pr2serr("\nWith '-r' each line is a record of 8 bytes: bank (0 "
+                "-> PIOA), line\n(0 to 31), func, status bits (0x1: pds, "
+                "0x2: ods, 0x4: im, 0x8: is,\n0x10: locks) then the 32 bit "
+                "PIO_CFGR value in host byte order.\n'-j' outputs the same "
+                "information (plus decoded CFGR fields) as JSON.\nBoth "
+                "may be combined with '-a', '-s' or '-S' (all banks).\n");
     }
 }
 
-#ifdef __cplusplus
-
-static inline volatile unsigned int *
-mmp_add(void * p, unsigned int v)
-{
-    return (volatile unsigned int *)((unsigned char *)p + v);
-}
-
-#else
-
-static inline volatile unsigned int *
-mmp_add(unsigned char * p, unsigned int v)
-{
-    return (volatile unsigned int *)(p + v);
-}
-#endif
-
-/* Since we map a whole page (MAP_SIZE) then that page may already be
- * mapped which means we can skip a munmap() and mmap() call. Returns
- * new or re-used pointer to mmapped page, or returns NULL if problem. */
-static void *
-check_mmap(int mem_fd, unsigned int wanted_addr, struct mmap_state * msp)
-{
-    off_t mask_addr;
-
-    mask_addr = (wanted_addr & ~MAP_MASK);
-    if ((0 == msp->mmap_ok) || (msp->prev_mask_addrp != mask_addr)) {
-        if (msp->mmap_ok) {
-            if (-1 == munmap(msp->mmap_ptr, MAP_SIZE)) {
-                pr2serr("mmap_ptr=%p:\n", msp->mmap_ptr);
-                perror("    munmap");
-                return NULL;
-            } else if (verbose > 2)
-                pr2serr("munmap() ok, mmap_ptr=%p\n", msp->mmap_ptr);
-        }
-        msp->mmap_ptr = mmap(0, MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED,
-                             mem_fd, mask_addr);
-        if ((void *)-1 == msp->mmap_ptr) {
-            msp->mmap_ok = 0;
-            pr2serr("addr=0x%x, mask_addr=0x%lx :\n", wanted_addr, mask_addr);
-            perror("    mmap");
-            return NULL;
-        }
-        msp->mmap_ok = 1;
-        msp->prev_mask_addrp = mask_addr;
-        if (verbose > 2)
-            pr2serr("mmap() ok, mask_addr=0x%lx, mmap_ptr=%p\n", mask_addr,
-                    msp->mmap_ptr);
-    }
-    return msp->mmap_ptr;
-}
-
-static volatile unsigned int *
-get_mmp(int mem_fd, unsigned int wanted_addr, struct mmap_state * msp)
-{
-    void * mmap_ptr;
-
-    mmap_ptr = check_mmap(mem_fd, wanted_addr, msp);
-    if (NULL == mmap_ptr)
-        return NULL;
-    return mmp_add(mmap_ptr, wanted_addr & MAP_MASK);
-}
-
 /* Format==0 yields PA21 for a GPIO (for example); format==1 yields GPIO
  * for a GPIO; format==2 as 1 plus surrounds returned string with "[..]".
  * Format=3 as 1 plus surrounds returned string with "<<...>>". Returns
@@ -819,32 +794,132 @@ th_end:
     return b;
 }
 
+/* Reads the registers of bank 'pioc_num' into *bsp. PIO_MSKR is only
+ * written when the next line in 'line_mask' differs from what it holds.
+ * Returns 0 if okay, else 1 . */
 static int
-pio_status(int mem_fd, unsigned int bit_mask, int bit_num, int brief,
-           int interrupt, int translate, int pioc_num, int write_prot,
-           int do_dir)
+snap_bank(int mem_fd, struct mmap_state * msp, int pioc_num,
+          unsigned int line_mask, bool interrupt, struct bank_snap * bsp)
 {
-    int ifen, ifscen, ods, pds, im, is, opd, puen, scd, pden, evtsel;
-    int wpm, wps, schmitt, driv, func, pcfs, icfs;
-    unsigned int cfgr, locks;
-    struct mmap_state mstat;
+    int k;
+    unsigned int bit_mask, mskr;
+    volatile unsigned int * mskr_p;
+    volatile unsigned int * cfgr_p;
     volatile unsigned int * mmp;
-    const char * cp;
-    char b[32];
-    char e[32];
-
 
-    memset(&mstat, 0, sizeof(mstat));
+    /* level and mask registers first, they are a single read per bank */
+    if (NULL == ((mmp = get_mmp(mem_fd, pio_pdsr[pioc_num], msp))))
+        return 1;
+    bsp->pdsr = *mmp;
+    if (NULL == ((mmp = get_mmp(mem_fd, pio_odsr[pioc_num], msp))))
+        return 1;
+    bsp->odsr = *mmp;
+    if (NULL == ((mmp = get_mmp(mem_fd, pio_imr[pioc_num], msp))))
+        return 1;
+    bsp->imr = *mmp;
+    if (NULL == ((mmp = get_mmp(mem_fd, pio_locksr[pioc_num], msp))))
+        return 1;
+    bsp->locksr = *mmp;
+    if (interrupt) {
+        if (NULL == ((mmp = get_mmp(mem_fd, pio_isr[pioc_num], msp))))
+            return 1;
+        bsp->isr = *mmp;
+    } else
+        bsp->isr = 0;
 
-    if (NULL == ((mmp = get_mmp(mem_fd, pio_mskr[pioc_num], &mstat))))
+    /* The datasheet does not define what PIO_CFGR reads back when more
+     * than one line is selected by PIO_MSKR, so one line at a time. */
+    if (NULL == ((mskr_p = get_mmp(mem_fd, pio_mskr[pioc_num], msp))))
         return 1;
-    if (*mmp != bit_mask)
-        *mmp = bit_mask;
-    if (NULL == ((mmp = get_mmp(mem_fd, pio_cfgr[pioc_num], &mstat))))
+    if (NULL == ((cfgr_p = get_mmp(mem_fd, pio_cfgr[pioc_num], msp))))
+        return 1;
+    mskr = *mskr_p;
+    for (k = 0, bit_mask = 1; k < LINES_PER_BANK; ++k, bit_mask <<= 1) {
+        if (0 == (line_mask & bit_mask))
+            continue;
+        if (mskr != bit_mask) {
+            *mskr_p = bit_mask;
+            mskr = bit_mask;
+        }
+        bsp->cfgr[k] = *cfgr_p;
+        if (verbose > 1)
+            pr2serr("  PIO_CFGR%d[%d] value=0x%x\n", pioc_num, k,
+                    bsp->cfgr[k]);
+    }
+    bsp->line_mask = line_mask;
+    return 0;
+}
+
+/* Takes a snapshot of the lines in line_mask_arr[] (one mask per bank,
+ * 0 to skip that bank) plus the registers common to all banks. Returns 0
+ * if okay, else 1 . */
+static int
+snap_pio(int mem_fd, struct mmap_state * msp,
+         const unsigned int * line_mask_arr, int interrupt, int write_prot,
+         struct pio_snap * psp)
+{
+    int k;
+    bool need_scd = false;
+    volatile unsigned int * mmp;
+    struct bank_snap * bsp;
+
+    psp->interrupt = interrupt;
+    psp->write_prot = write_prot;
+    for (k = 0; k < PIO_BANKS_SAMA5D2; ++k) {
+        bsp = psp->bank + k;
+        if (0 == line_mask_arr[k]) {
+            bsp->line_mask = 0;
+            continue;
+        }
+        if (snap_bank(mem_fd, msp, k, line_mask_arr[k], !!interrupt, bsp))
+            return 1;
+        if (! need_scd) {
+            int j;
+
+            for (j = 0; j < LINES_PER_BANK; ++j) {
+                if (((1U << j) & bsp->line_mask) &&
+                    (CFGR_IFSCEN_MSK & bsp->cfgr[j])) {
+                    need_scd = true;
+                    break;
+                }
+            }
+        }
+    }
+    if (need_scd) {
+        if (NULL == ((mmp = get_mmp(mem_fd, S_PIO_SCDR, msp))))
+            return 1;
+        psp->scd = *mmp & 0x3fff;
+    } else
+        psp->scd = -1;
+    if (NULL == ((mmp = get_mmp(mem_fd, PIO_WPMR, msp))))
         return 1;
-    cfgr = *mmp;
-    if (verbose > 1)
-        pr2serr("  PIO_CFGR%d value=0x%x\n", pioc_num, cfgr);
+    psp->wpm = *mmp;
+    if (write_prot) {
+        if (NULL == ((mmp = get_mmp(mem_fd, PIO_WPSR, msp))))
+            return 1;
+        psp->wps = *mmp & 0xffffff;
+    } else
+        psp->wps = 0;
+    return 0;
+}
+
+/* Prints the status of one line from a snapshot previously taken by
+ * snap_pio(). */
+static void
+pio_status(const struct pio_snap * psp, int bit_num, int brief,
+           int translate, int pioc_num, int do_dir)
+{
+    int ifen, ifscen, ods, pds, im, is, opd, puen, scd, pden, evtsel;
+    int wpm, wps, schmitt, driv, func, pcfs, icfs, locks;
+    int write_prot = psp->write_prot;
+    unsigned int cfgr;
+    unsigned int bit_mask = 1U << bit_num;
+    const struct bank_snap * bsp = psp->bank + pioc_num;
+    const char * cp;
+    char b[32];
+    char e[32];
+
+    cfgr = bsp->cfgr[bit_num];
     func = (cfgr & CFGR_FUNC_MSK);
 
     ifen = !!(CFGR_IFEN_MSK & cfgr);
@@ -872,31 +947,23 @@ pio_status(int mem_fd, unsigned int bit_mask, int bit_num, int brief,
             printf("  input filter %senabled\n",
                    (ifscen ? "slow clock " : ""));
     }
-    if (NULL == ((mmp = get_mmp(mem_fd, pio_odsr[pioc_num], &mstat))))
-        return 1;
-    ods = !!(*mmp & bit_mask);
+    ods = !!(bsp->odsr & bit_mask);
     if (0 == brief) {
         if (func || (0 == (CFGR_DIR_MSK & cfgr)))
             printf("  [output data status: %d]\n", ods);
         else
             printf("  output data status: %d\n", ods);
     }
-    if (NULL == ((mmp = get_mmp(mem_fd, pio_pdsr[pioc_num], &mstat))))
-        return 1;
-    pds = !!(*mmp & bit_mask);
+    pds = !!(bsp->pdsr & bit_mask);
     if (0 == brief)
         printf("  pin data status: %d\n", pds);
-    if (NULL == ((mmp = get_mmp(mem_fd, pio_imr[pioc_num], &mstat))))
-        return 1;
-    im = !!(*mmp & bit_mask);
+    im = !!(bsp->imr & bit_mask);
     if (0 == brief)
         printf("  interrupt mask: %d (%s)\n", im,
                (im ? "ENabled" : "DISabled"));
 
-    if (interrupt) {
-        if (NULL == ((mmp = get_mmp(mem_fd, pio_isr[pioc_num], &mstat))))
-            return 1;
-        is = !!(*mmp & bit_mask);
+    if (psp->interrupt) {
+        is = !!(bsp->isr & bit_mask);
         if (0 == brief)
             printf("  interrupt status: %d (%s)\n", is,
                    (is ? "input CHANGE" : "NO input change"));
@@ -917,9 +984,7 @@ pio_status(int mem_fd, unsigned int bit_mask, int bit_num, int brief,
                (puen ? "ENabled" : "DISabled"));
 
     if (CFGR_IFSCEN_MSK & cfgr) {
-        if (NULL == ((mmp = get_mmp(mem_fd, S_PIO_SCDR, &mstat))))
-            return 1;
-        scd = *mmp & 0x3fff;
+        scd = psp->scd;
         if (0 == brief)
             printf("  (secure) slow clock divider debouncing register: %d "
                    "[0x%x]\n", scd, scd);
@@ -937,23 +1002,17 @@ pio_status(int mem_fd, unsigned int bit_mask, int bit_num, int brief,
         else
             printf("  [input event: %s]\n", evtsel_arr[evtsel]);
     }
-    if (NULL == ((mmp = get_mmp(mem_fd, pio_locksr[pioc_num], &mstat))))
-        return 1;
-    locks = !!(*mmp & bit_mask);
+    locks = !!(bsp->locksr & bit_mask);
     if (0 == brief)
         printf("  locked status: %d (%slocked)\n", locks,
                (locks ? "" : "not "));
 
-    if (NULL == ((mmp = get_mmp(mem_fd, PIO_WPMR, &mstat))))
-        return 1;
-    wpm = *mmp;
+    wpm = psp->wpm;
     if (0 == brief)
         printf("  write protect mode: WPEN: %d (%s)\n",
                wpm & 1, ((wpm & 1) ? "ENabled" : "DISabled"));
     if (write_prot) {
-        if (NULL == ((mmp = get_mmp(mem_fd, PIO_WPSR, &mstat))))
-            return 1;
-        wps = *mmp & 0xffffff;
+        wps = psp->wps;
         if (0 == brief)
             printf("  write protect violation status: %d (%s), WPCSRC: "
                    "0x%x\n", (wps & 1), ((wps & 1) ? "VIOLATED" :
@@ -1044,15 +1103,184 @@ pio_status(int mem_fd, unsigned int bit_mask, int bit_num, int brief,
                 printf(" %-2d: %s pds=%d opd=%d\n", bit_num, cp, pds, opd);
         }
     }
+}
+
+/* Outputs the lines held in snapshot *psp as a JSON document (out_fmt ==
+ * OUT_FMT_JSON) or as an array of struct pio_line_rec (OUT_FMT_RAW) to
+ * stdout. Returns 0 if okay, else 1 . */
+static int
+pio_struct_out(const struct pio_snap * psp, int out_fmt)
+{
+    int k, j, n, func;
+    unsigned int cfgr, bit_mask;
+    bool first = true;
+    const struct bank_snap * bsp;
+    struct pio_line_rec * rp;
+    struct pio_line_rec rec_arr[LINES_PER_BANK];
+    char b[32];
 
-    if (mstat.mmap_ok) {
-        if (-1 == munmap(mstat.mmap_ptr, MAP_SIZE)) {
-            pr2serr("mmap_ptr=%p:\n", mstat.mmap_ptr);
-            perror("    munmap");
+    if (OUT_FMT_JSON == out_fmt)
+        printf("{\n  \"wpm\": %u,\n  \"wps\": %d,\n  \"scd\": %d,\n"
+               "  \"lines\": [", psp->wpm,
+               (psp->write_prot ? (int)psp->wps : -1), psp->scd);
+    for (k = 0; k < PIO_BANKS_SAMA5D2; ++k) {
+        bsp = psp->bank + k;
+        for (j = 0, n = 0, bit_mask = 1; j < LINES_PER_BANK;
+             ++j, bit_mask <<= 1) {
+            if (0 == (bsp->line_mask & bit_mask))
+                continue;
+            cfgr = bsp->cfgr[j];
+            func = CFGR_FUNC_MSK & cfgr;
+            if (OUT_FMT_RAW == out_fmt) {
+                rp = rec_arr + n++;
+                rp->bank = k;
+                rp->line = j;
+                rp->func = func;
+                rp->status = ((bsp->pdsr & bit_mask) ? PIO_REC_PDS : 0) |
+                             ((bsp->odsr & bit_mask) ? PIO_REC_ODS : 0) |
+                             ((bsp->imr & bit_mask) ? PIO_REC_IM : 0) |
+                             ((bsp->isr & bit_mask) ? PIO_REC_IS : 0) |
+                             ((bsp->locksr & bit_mask) ? PIO_REC_LOCKS : 0);
+                rp->cfgr = cfgr;
+                continue;
+            }
+            translate_peri(b, sizeof(b), k, j, func, false, 1);
+            printf("%s\n    {\"name\": \"%s%d\", \"func\": %d, "
+                   "\"periph\": \"%s\", \"cfgr\": %u, \"dir\": %d, "
+                   "\"pds\": %d, \"ods\": %d, \"im\": %d, \"is\": %d, "
+                   "\"locks\": %d, \"puen\": %d, \"pden\": %d, "
+                   "\"opd\": %d, \"ifen\": %d, \"ifscen\": %d, "
+                   "\"schmitt\": %d, \"driv\": %d, \"evtsel\": %d, "
+                   "\"pcfs\": %d, \"icfs\": %d}",
+                   (first ? "" : ","), bank_str_arr[k], j, func, b, cfgr,
+                   !!(CFGR_DIR_MSK & cfgr), !!(bsp->pdsr & bit_mask),
+                   !!(bsp->odsr & bit_mask), !!(bsp->imr & bit_mask),
+                   (psp->interrupt ? !!(bsp->isr & bit_mask) : -1),
+                   !!(bsp->locksr & bit_mask), !!(CFGR_PUEN_MSK & cfgr),
+                   !!(CFGR_PDEN_MSK & cfgr), !!(CFGR_OPD_MSK & cfgr),
+                   !!(CFGR_IFEN_MSK & cfgr), !!(CFGR_IFSCEN_MSK & cfgr),
+                   !!(CFGR_SCHMITT_MSK & cfgr),
+                   (int)((CFGR_DRVSTR_MSK & cfgr) >> CFGR_DRVSTR_SHIFT),
+                   (int)((CFGR_EVTSEL_MSK & cfgr) >> CFGR_EVTSEL_SHIFT),
+                   !!(CFGR_PCFS_MSK & cfgr), !!(CFGR_ICFS_MSK & cfgr));
+            first = false;
+        }
+        if ((OUT_FMT_RAW == out_fmt) && (n > 0)) {
+            if ((size_t)n != fwrite(rec_arr, sizeof(rec_arr[0]), n, stdout)) {
+                perror("fwrite(stdout)");
+                return 1;
+            }
+        }
+    }
+    if (OUT_FMT_JSON == out_fmt)
+        printf("\n  ]\n}\n");
+    return 0;
+}
+
+static void
+watch_sig_handler(int signum)
+{
+    if (signum)
+        watch_stop = 1;
+}
+
+/* Decodes INTERVAL which is a number of milliseconds, optionally followed
+ * by "ms" or "s" (seconds). Returns milliseconds or -1 if error. */
+static int
+get_interval_ms(const char * cp)
+{
+    int n;
+    char * endp;
+
+    n = (int)strtol(cp, &endp, 10);
+    if ((endp == cp) || (n < 1))
+        return -1;
+    if (('\0' == *endp) || (0 == strcmp(endp, "ms")))
+        return n;
+    if ((0 == strcmp(endp, "s")) && (n <= (INT_MAX / 1000)))
+        return n * 1000;
+    return -1;
+}
+
+/* Re-reads the lines selected in line_mask_arr[] every 'interval_ms'
+ * using the mappings in *msp and prints, with a CLOCK_MONOTONIC timestamp,
+ * each line whose PIO_CFGR, PDSR or ODSR bit differs from the previous
+ * snapshot. *psp holds the initial snapshot. Runs until SIGINT or SIGTERM
+ * is received. Returns 0 if okay, else 1 . */
+static int
+do_watch(int mem_fd, struct mmap_state * msp,
+         const unsigned int * line_mask_arr, struct pio_snap * psp,
+         int interval_ms, int brief, int translate, int do_dir)
+{
+    int k, j, res;
+    unsigned int bit_mask, diff;
+    struct pio_snap snap2;
+    struct pio_snap * prevp = psp;
+    struct pio_snap * curp = &snap2;
+    struct pio_snap * tp;
+    const struct bank_snap * pbsp;
+    const struct bank_snap * cbsp;
+    struct timespec next, now;
+    struct sigaction sa;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = watch_sig_handler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    if (brief < 2)
+        brief = 2;
+    fflush(stdout);
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (! watch_stop) {
+        next.tv_sec += interval_ms / 1000;
+        next.tv_nsec += (interval_ms % 1000) * 1000000;
+        if (next.tv_nsec >= 1000000000) {
+            ++next.tv_sec;
+            next.tv_nsec -= 1000000000;
+        }
+        do {
+            res = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next,
+                                  NULL);
+        } while ((EINTR == res) && (! watch_stop));
+        if (watch_stop)
+            break;
+        if (res) {
+            pr2serr("clock_nanosleep: %s\n", strerror(res));
+            return 1;
+        }
+        if (snap_pio(mem_fd, msp, line_mask_arr, psp->interrupt,
+                     psp->write_prot, curp))
             return 1;
-        } else if (verbose > 2)
-            pr2serr("trailing munmap() ok, mmap_ptr=%p\n", mstat.mmap_ptr);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        for (k = 0; k < PIO_BANKS_SAMA5D2; ++k) {
+            pbsp = prevp->bank + k;
+            cbsp = curp->bank + k;
+            diff = (pbsp->pdsr ^ cbsp->pdsr) | (pbsp->odsr ^ cbsp->odsr);
+            for (j = 0, bit_mask = 1; j < LINES_PER_BANK;
+                 ++j, bit_mask <<= 1) {
+                if (0 == (bit_mask & cbsp->line_mask))
+                    continue;
+                if ((0 == (bit_mask & diff)) &&
+                    (pbsp->cfgr[j] == cbsp->cfgr[j]))
+                    continue;
+                printf("%ld.%06ld %s", (long)now.tv_sec,
+                       (long)(now.tv_nsec / 1000), bank_str_arr[k]);
+                pio_status(curp, j, brief, translate, k, do_dir);
+            }
+        }
+        fflush(stdout);
+        tp = prevp;
+        prevp = curp;
+        curp = tp;
+        /* if we have fallen behind, restart the period from now */
+        if ((now.tv_sec > next.tv_sec) ||
+            ((now.tv_sec == next.tv_sec) && (now.tv_nsec > next.tv_nsec)))
+            next = now;
     }
+    if (verbose)
+        pr2serr("watch stopped by signal\n");
     return 0;
 }
 
@@ -1099,25 +1327,36 @@ do_enumerate(int enum_val, int bank, int orig0, int do_dir)
 }
 
 static int
-do_show_all(int show_val, int do_dir)
+do_show_all(int show_val, int do_dir, int out_fmt, int watch_ms)
 {
     int k, j, n, num, format;
     int res = 1;
     int mem_fd = -1;
     unsigned int bit_mask, cfgr;
+    unsigned int line_mask_arr[PIO_BANKS_SAMA5D2];
     char b[32];
     size_t blen = sizeof(b) - 1;
     struct mmap_state mstat;
-    volatile unsigned int * mmp;
+    struct pio_snap snap;
+    const struct bank_snap * bsp;
 
     if ((mem_fd = open(DEV_MEM, O_RDWR | O_SYNC)) < 0) {
         perror("open of " DEV_MEM " failed");
         return 1;
     } else if (verbose > 2)
         printf("open(" DEV_MEM "O_RDWR | O_SYNC) okay\n");
-    memset(&mstat, 0, sizeof(mstat));
+    init_mmap_state(&mstat, verbose);
 
     num = PIO_BANKS_SAMA5D2;
+    for (j = 0; j < num; ++j)
+        line_mask_arr[j] = 0xffffffff;
+    if (snap_pio(mem_fd, &mstat, line_mask_arr, 0, 0, &snap))
+        goto clean_up;
+    if (out_fmt) {
+        res = pio_struct_out(&snap, out_fmt);
+        goto clean_up;
+    }
+
     printf("PIN  PIO_A             PIO_B             PIO_C             "
            "PIO_D\n");
     for (k = 0; k < LINES_PER_BANK; ++k) {
@@ -1127,18 +1366,11 @@ do_show_all(int show_val, int do_dir)
             printf("%d:   ", k);
         bit_mask = 1 << k;
         for (j = 0; j < num; ++j) {
-            if (NULL == ((mmp = get_mmp(mem_fd, pio_mskr[j], &mstat))))
-                goto clean_up;
-            if (bit_mask != *mmp)
-                *mmp = bit_mask;
-            if (NULL == ((mmp = get_mmp(mem_fd, pio_cfgr[j], &mstat))))
-                goto clean_up;
-            cfgr = *mmp;
+            bsp = snap.bank + j;
+            cfgr = bsp->cfgr[k];
             format = 1;
             if (2 == show_val) {
-                if (NULL == ((mmp = get_mmp(mem_fd, pio_locksr[j], &mstat))))
-                    goto clean_up;
-                if (bit_mask & *mmp)
+                if (bit_mask & bsp->locksr)
                     format = 2;
             } else if (3 == show_val) {
                 if ((CFGR_PCFS_MSK | CFGR_ICFS_MSK) & cfgr)
@@ -1153,8 +1385,13 @@ do_show_all(int show_val, int do_dir)
         printf("\n");
     }
     res = 0;
+    if (watch_ms > 0)
+        res = do_watch(mem_fd, &mstat, line_mask_arr, &snap, watch_ms, 2, 1,
+                       do_dir);
 
 clean_up:
+    if (release_mmap_state(&mstat))
+        res = 1;
     if (mem_fd >= 0)
         close(mem_fd);
     return res;
@@ -1179,6 +1416,8 @@ main(int argc, char ** argv)
     int translate = 0;
     int show_all = 0;
     int write_prot = 0;
+    int out_fmt = OUT_FMT_TEXT;
+    int watch_ms = 0;
     int knum = -1;
     int bit_num = -1;
     int ret = 0;
@@ -1187,8 +1426,11 @@ main(int argc, char ** argv)
     const char * str = NULL;
     char ch;
     char bank = '\0';
+    unsigned int line_mask_arr[PIO_BANKS_SAMA5D2];
+    struct mmap_state mstat;
+    struct pio_snap snap;
 
-    while ((opt = getopt(argc, argv, "ab:Bdef:hip:sStvVw")) != -1) {
+    while ((opt = getopt(argc, argv, "ab:Bdef:hijp:rsStvVwW:")) != -1) {
         switch (opt) {
         case 'a':
             ++do_all;
@@ -1233,6 +1475,9 @@ main(int argc, char ** argv)
         case 'i':
             ++interrupt;
             break;
+        case 'j':
+            out_fmt = OUT_FMT_JSON;
+            break;
         case 'p':
             cp = optarg;
             if (isalpha(cp[0])) {
@@ -1255,6 +1500,9 @@ main(int argc, char ** argv)
                 exit(EXIT_FAILURE);
             }
             break;
+        case 'r':
+            out_fmt = OUT_FMT_RAW;
+            break;
         case 's':
             ++do_all;
             ++translate;
@@ -1275,6 +1523,14 @@ main(int argc, char ** argv)
         case 'w':
             ++write_prot;
             break;
+        case 'W':
+            watch_ms = get_interval_ms(optarg);
+            if (watch_ms < 1) {
+                pr2serr("'-W' expects a positive number of milliseconds "
+                        "(or seconds with\na trailing 's')\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
         default: /* '?' */
             do_help = 1;
             ret = 1;
@@ -1293,6 +1549,10 @@ main(int argc, char ** argv)
         usage(do_help);
         exit(ret ? EXIT_FAILURE : EXIT_SUCCESS);
     }
+    if ((watch_ms > 0) && (OUT_FMT_TEXT != out_fmt)) {
+        pr2serr("'-W INTERVAL' cannot be combined with '-j' or '-r'\n");
+        exit(EXIT_FAILURE);
+    }
     if (str) {  /* -f STR  */
         struct periph_name ** bpnpp;
         struct periph_name * pnp;
@@ -1365,7 +1625,7 @@ main(int argc, char ** argv)
         return do_enumerate(enumerate, bank, origin0,
                             (do_dir || (enumerate > 2)));
     if (show_all)
-        return do_show_all(show_all, do_dir);
+        return do_show_all(show_all, do_dir, out_fmt, watch_ms);
 
     if (knum >= 0) {
         if (bit_num >= 0) {
@@ -1393,7 +1653,8 @@ main(int argc, char ** argv)
             knum = (((! origin0) + bank - 'A') * 32) + bit_num;
     } else {
         if (do_all) {
-            printf(">>> Assuming bank A, use '-p PORT' to change\n");
+            if (OUT_FMT_TEXT == out_fmt)
+                printf(">>> Assuming bank A, use '-p PORT' to change\n");
             knum = origin0 ? 0 : 32;
         } else {
             pr2serr("Need to give gpio line with '-p PORT' and/or "
@@ -1421,28 +1682,38 @@ main(int argc, char ** argv)
         return 1;
     } else if (verbose > 2)
         printf("open(" DEV_MEM "O_RDWR | O_SYNC) okay\n");
-
-    if (do_all) {
+    init_mmap_state(&mstat, verbose);
+
+    memset(line_mask_arr, 0, sizeof(line_mask_arr));
+    line_mask_arr[pioc_num] = do_all ? 0xffffffff : bit_mask;
+    res = snap_pio(mem_fd, &mstat, line_mask_arr, interrupt, write_prot,
+                   &snap);
+    if (res)
+        goto clean_up;
+
+    if (out_fmt)
+        res = pio_struct_out(&snap, out_fmt);
+    else if (do_all) {
         num = LINES_PER_BANK;
-        res = 0;
         if (brief > 1)
             printf("PIO %c:\n", 'A' + pioc_num);
         for (bit_num = 0; bit_num < num; ++bit_num) {
-            bit_mask = 1 << bit_num;
             if (brief < 2)
                 printf("%s%d:\n", bank_str_arr[pioc_num], bit_num);
-            res = pio_status(mem_fd, bit_mask, bit_num, brief, interrupt,
-                             translate, pioc_num, write_prot, do_dir);
-            if (res)
-                break;
+            pio_status(&snap, bit_num, brief, translate, pioc_num, do_dir);
         }
     } else {
         if (brief < 2)
             printf("%s%d:\n", bank_str_arr[pioc_num], bit_num);
-        res = pio_status(mem_fd, bit_mask, bit_num, brief, interrupt,
-                         translate, pioc_num, write_prot, do_dir);
+        pio_status(&snap, bit_num, brief, translate, pioc_num, do_dir);
     }
+    if (watch_ms > 0)
+        res = do_watch(mem_fd, &mstat, line_mask_arr, &snap, watch_ms, brief,
+                       translate, do_dir);
 
+clean_up:
+    if (release_mmap_state(&mstat))
+        res = 1;
     if (mem_fd >= 0)
         close(mem_fd);
     return res;
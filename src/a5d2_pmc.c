@@ -48,7 +48,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <stdarg.h>
+#include <stdint.h>
 #include <stdbool.h>
 #include <ctype.h>
 #include <string.h>
@@ -64,15 +64,15 @@
 #include <signal.h>
 #include <sched.h>
 
+#include "mmap_regs.h"
+#include "sa_misc.h"
+
 // #include <sys/ioctl.h>
 
 
-static const char * version_str = "1.01 20160121";
+static const char * version_str = "1.03 20261014";
 
 #define MAX_ELEMS 256
-#define DEV_MEM "/dev/mem"
-#define MAP_SIZE 4096   /* assume to be power of 2 */
-#define MAP_MASK (MAP_SIZE - 1)
 #define CLK_SRC_DEF (-1)   /* leave as is */
 
 /* SAMA5D2* memory mapped registers for PMC unit */
@@ -93,6 +93,7 @@ static const char * version_str = "1.01 20160121";
 #define PMC_PCR    0xf001410c   /* peripheral control (rw) */
 
 #define A5D2_PMC_WPKEY 0x504d43  /* "PMC" in ASCII */
+#define PMC_PCR_PID_MSK 0x7f
 #define PMC_PCR_WR_CMD_MSK 0x1000
 #define PMC_PCR_EN_MSK 0x10000000
 #define PMC_PCR_GCKEN_MSK 0x20000000
@@ -109,12 +110,8 @@ static const char * version_str = "1.01 20160121";
 #define PMC_PCKX_PRES_MSK 0xff0
 #define PMC_PCKX_PRES_SHIFT 4
 
+#define MAX_PHASES 16   /* '-S' profile: phases advanced by SIGUSR1 */
 
-struct mmap_state {
-    void * mmap_ptr;
-    off_t prev_mask_addrp;
-    int mmap_ok;
-};
 
 struct bit_acron_desc {
     int bit_num;        /* for peripherals, also identifier (PID) */
@@ -123,12 +120,48 @@ struct bit_acron_desc {
     const char * desc;
 };
 
+/* Fixed layout record written for each clock by '-r' (raw binary output),
+ * in host byte order (little endian on the SAMA5D2). */
+struct pmc_clk_rec {
+    uint8_t kind;       /* PMC_REC_SYS or PMC_REC_PERI */
+    uint8_t id;         /* bit_num in PMC_SCSR or peripheral id (PID) */
+    uint8_t enabled;    /* 1 if clock enabled, else 0 */
+    uint8_t in_table;   /* 1 if id known (i.e. has an acronym), else 0 */
+    uint32_t pcr;       /* PMC_PCR for that PID (only with '-a'), else 0 */
+};
+
+#define PMC_REC_SYS 0
+#define PMC_REC_PERI 1
+
+#define OUT_FMT_TEXT 0
+#define OUT_FMT_JSON 1
+#define OUT_FMT_RAW 2
+
+/* '-S' profile counters for one clock in one phase */
+struct prof_clk {
+    unsigned int on_cnt;        /* samples with clock enabled */
+    unsigned int gck_cnt;       /* samples with GCKEN set (needs '-g') */
+    unsigned int toggles;       /* enable state changes between samples */
+    unsigned int div_min;       /* GCKDIV range while GCKEN set */
+    unsigned int div_max;
+};
+
+struct prof_phase {
+    unsigned int samples;
+    double secs;
+    struct prof_clk sys[32];
+    struct prof_clk peri[64];
+};
+
 struct opts_t {
     int css;
     int divisor;
     int do_disable;
     int enumerate;
     int do_enable;
+    int interval_ms;    /* '-S INTERVAL', 0 -> not profiling */
+    int num_samples;    /* '-n NUM', 0 -> until SIGINT or SIGTERM */
+    int out_fmt;
     int pgc;
     int verbose;
     int wpen;
@@ -139,6 +172,10 @@ struct opts_t {
     bool sel_peri_clks;
     bool sel_sys_clks;
     bool wpen_given;
+    bool list_given;
+    bool num_given;
+    unsigned int l_sys_mask;            /* from '-l LIST' */
+    unsigned int l_peri_mask[2];        /* from '-l LIST' */
     const char * acronp;
 };
 
@@ -236,32 +273,19 @@ static struct bit_acron_desc peri_id_arr[] = {
 };
 
 
-#ifdef __GNUC__
-static int pr2serr(const char * fmt, ...)
-        __attribute__ ((format (printf, 1, 2)));
-#else
-static int pr2serr(const char * fmt, ...);
-#endif
-
-
-static int
-pr2serr(const char * fmt, ...)
-{
-    va_list args;
-    int n;
+static struct prof_phase prof_arr[MAX_PHASES];
 
-    va_start(args, fmt);
-    n = vfprintf(stderr, fmt, args);
-    va_end(args);
-    return n;
-}
+static volatile sig_atomic_t prof_stop = 0;
+static volatile sig_atomic_t prof_phase_req = 0;
 
 static void
 usage(void)
 {
     pr2serr("Usage: a5d2_pmc [-a ACRON] [-c CSS] [-d DIV] [-D] [-e] [-E] "
             "[-g] [-h]\n"
-            "                [-p] [-P PGC] [-s] [-v] [-V] [-w WPEN]\n"
+            "                [-j] [-l LIST] [-n NUM] [-p] [-P PGC] [-r] "
+            "[-s]\n"
+            "                [-S INTERVAL] [-v] [-V] [-w WPEN]\n"
             "  where:\n"
             "    -a ACRON    ACRON is a system or peripheral id acronym\n"
             "    -c CSS      CSS is clock source select (def: leave as is)\n"
@@ -279,6 +303,16 @@ usage(void)
             "both\n"
             "    -g          want generic clock (use with '-E' or '-D')\n"
             "    -h          print usage message\n"
+            "    -j          show clocks as a JSON document (all known "
+            "clocks\n"
+            "                with their enable state)\n"
+            "    -l LIST     LIST is comma separated ACRONs or ids; with "
+            "'-E' or '-D'\n"
+            "                acts on all of them in one pass (one WP "
+            "toggle), with\n"
+            "                '-S' only those clocks are profiled\n"
+            "    -n NUM      with '-S' stop after NUM samples (def: 0 -> "
+            "until SIGINT)\n"
             "    -p          select peripheral clock. When no (other) "
             "options\n"
             "                given, shows all enabled peripheral clocks\n"
@@ -286,9 +320,19 @@ usage(void)
             "PCK1\n"
             "                or PCK2 as indicated by accompanying '-E' "
             "or '-D'\n"
+            "    -r          as '-j' but output 8 byte binary records: "
+            "kind (0:\n"
+            "                sys, 1: peri), id, enabled, known, then "
+            "32 bit PCR\n"
             "    -s          select system clock. When no other options "
             "given\n"
             "                shows all enabled system clocks\n"
+            "    -S INTERVAL profile: sample clock enables every "
+            "INTERVAL ms ('s'\n"
+            "                suffix for seconds); SIGUSR1 starts the next "
+            "workload\n"
+            "                phase. With '-g' also samples PMC_PCR GCKEN "
+            "and GCKDIV\n"
             "    -v          increase verbosity (multiple times for more)\n"
             "    -V          print version string then exit\n"
             "    -w WPEN     set or show write protect (WP) information "
@@ -305,71 +349,6 @@ usage(void)
             "options this utility will list active peripheral clocks.\n");
 }
 
-#ifdef __cplusplus
-
-static inline volatile unsigned int *
-mmp_add(void * p, unsigned int v)
-{
-    return (volatile unsigned int *)((unsigned char *)p + v);
-}
-
-#else
-
-static inline volatile unsigned int *
-mmp_add(unsigned char * p, unsigned int v)
-{
-    return (volatile unsigned int *)(p + v);
-}
-#endif
-
-
-/* Since we map a whole page (MAP_SIZE) then that page may already be
- * mapped which means we can skip a munmap() and mmap() call. Returns
- * new or re-used pointer to mmapped page, or returns NULL if problem. */
-static void *
-check_mmap(int mem_fd, unsigned int wanted_addr, struct mmap_state * msp,
-           const struct opts_t * op)
-{
-    off_t mask_addr;
-
-    mask_addr = (wanted_addr & ~MAP_MASK);
-    if ((0 == msp->mmap_ok) || (msp->prev_mask_addrp != mask_addr)) {
-        if (msp->mmap_ok) {
-            if (-1 == munmap(msp->mmap_ptr, MAP_SIZE)) {
-                pr2serr("mmap_ptr=%p:\n", msp->mmap_ptr);
-                perror("    munmap");
-                return NULL;
-            } else if (op->verbose > 2)
-                pr2serr("munmap() ok, mmap_ptr=%p\n", msp->mmap_ptr);
-        }
-        msp->mmap_ptr = mmap(0, MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED,
-                             mem_fd, mask_addr);
-        if ((void *)-1 == msp->mmap_ptr) {
-            msp->mmap_ok = 0;
-            pr2serr("addr=0x%x, mask_addr=0x%lx :\n", wanted_addr, mask_addr);
-            perror("    mmap");
-            return NULL;
-        }
-        msp->mmap_ok = 1;
-        msp->prev_mask_addrp = mask_addr;
-        if (op->verbose > 2)
-            pr2serr("mmap() ok, mask_addr=0x%lx, mmap_ptr=%p\n", mask_addr,
-                    msp->mmap_ptr);
-    }
-    return msp->mmap_ptr;
-}
-
-static volatile unsigned int *
-get_mmp(int mem_fd, unsigned int wanted_addr, struct mmap_state * msp,
-        const struct opts_t * op)
-{
-    void * mmap_ptr;
-
-    mmap_ptr = check_mmap(mem_fd, wanted_addr, msp, op);
-    if (NULL == mmap_ptr)
-        return NULL;
-    return mmp_add(mmap_ptr, wanted_addr & MAP_MASK);
-}
 
 static void
 do_enumerate(const struct opts_t * op)
@@ -418,7 +397,7 @@ en_dis_peri_sys_clk(int mem_fd, struct mmap_state * msp, int bn,
     volatile unsigned int * mmp;
 
     if (op->sel_peri_clks) {
-        if (NULL == ((mmp = get_mmp(mem_fd, PMC_PCR, msp, op))))
+        if (NULL == ((mmp = get_mmp(mem_fd, PMC_PCR, msp))))
             goto clean_up;
         reg = PMC_PCR_WR_CMD_MSK | (op->css << PMC_PCR_GCKCSS_SHIFT) | bn;
         if (op->divisor_given && (op->divisor > 0))
@@ -444,7 +423,7 @@ en_dis_peri_sys_clk(int mem_fd, struct mmap_state * msp, int bn,
             ui = (bn > 31) ? PMC_PCDR1 : PMC_PCDR0;
     }
     mask = (bn > 31) ? (1 << (bn - 32)) : (1 << bn);
-    if (NULL == ((mmp = get_mmp(mem_fd, ui, msp, op))))
+    if (NULL == ((mmp = get_mmp(mem_fd, ui, msp))))
         goto clean_up;
     if (op->verbose > 1)
         printf("Writing 0x%x to %p [IO addr: 0x%x]\n", mask, mmp, ui);
@@ -466,7 +445,7 @@ do_pgc(int mem_fd, struct mmap_state * msp, const struct opts_t * op)
     const char * cp;
 
     if (op->verbose) {
-        if (NULL == ((mmp = get_mmp(mem_fd, PMC_SCSR, msp, op))))
+        if (NULL == ((mmp = get_mmp(mem_fd, PMC_SCSR, msp))))
             goto clean_up;
         pr2serr("PMC_SCSR=0x%x\n", *mmp);
     }
@@ -492,7 +471,7 @@ do_pgc(int mem_fd, struct mmap_state * msp, const struct opts_t * op)
         if (op->verbose)
             pr2serr("Use '-E' or '-D' to enable or disable, now "
                     "providing information about PCK%d\n", op->pgc);
-        if (NULL == ((mmp = get_mmp(mem_fd, pckx, msp, op))))
+        if (NULL == ((mmp = get_mmp(mem_fd, pckx, msp))))
             goto clean_up;
         reg = *mmp;
         n = ((PMC_PCKX_PRES_MSK & reg) >> PMC_PCKX_PRES_SHIFT);
@@ -502,19 +481,19 @@ do_pgc(int mem_fd, struct mmap_state * msp, const struct opts_t * op)
                 break;
         }
         cp = (badp->bit_num >= 0) ? badp->acron : "?";
-        if (NULL == ((mmp = get_mmp(mem_fd, PMC_SCSR, msp, op))))
+        if (NULL == ((mmp = get_mmp(mem_fd, PMC_SCSR, msp))))
             goto clean_up;
         printf("PCK%d: %sabled, CSS: %s [%d], PRES=%d [divisor=%d]\n",
                op->pgc, (ui & *mmp) ? "EN" : "DIS", cp, k, n, n + 1);
     } else if (op->do_disable) {/* disabling PCK0, PCK1 or PCK2 */
-        if (NULL == ((mmp = get_mmp(mem_fd, PMC_SCDR, msp, op))))
+        if (NULL == ((mmp = get_mmp(mem_fd, PMC_SCDR, msp))))
             goto clean_up;
         *mmp = ui;
         if (op->verbose)
             pr2serr("wrote: 0x%x to SCDR [0x%x] to disable PCK%d\n", ui,
                     pckx, op->pgc);
     } else {                /* enabling PCK0, PCK1 or PCK2 */
-        if (NULL == ((mmp = get_mmp(mem_fd, pckx, msp, op))))
+        if (NULL == ((mmp = get_mmp(mem_fd, pckx, msp))))
             goto clean_up;
         reg = *mmp;
         hreg = reg;
@@ -534,7 +513,7 @@ do_pgc(int mem_fd, struct mmap_state * msp, const struct opts_t * op)
         } else if (op->verbose > 1)
             pr2serr("did not write to PMC_PCK%d [0x%x], 0x%x unchanged\n",
                     op->pgc, pckx, reg);
-        if (NULL == ((mmp = get_mmp(mem_fd, PMC_SCER, msp, op))))
+        if (NULL == ((mmp = get_mmp(mem_fd, PMC_SCER, msp))))
             goto clean_up;
         *mmp = ui;
         if (op->verbose)
@@ -557,7 +536,7 @@ show_sys_clks(int mem_fd, struct mmap_state * msp, int bn,
     struct bit_acron_desc * badp;
     volatile unsigned int * mmp;
 
-    if (NULL == ((mmp = get_mmp(mem_fd, PMC_SCSR, msp, op))))
+    if (NULL == ((mmp = get_mmp(mem_fd, PMC_SCSR, msp))))
         goto clean_up;
     reg = *mmp;
     if (op->verbose)
@@ -604,7 +583,7 @@ show_peri_clks(int mem_fd, struct mmap_state * msp, int bn,
     volatile unsigned int * mmp;
 
     if (op->acronp) {
-        if (NULL == ((mmp = get_mmp(mem_fd, PMC_PCR, msp, op))))
+        if (NULL == ((mmp = get_mmp(mem_fd, PMC_PCR, msp))))
             goto clean_up;
         /* write a read cmd for given bn (in the PID field) */
         *mmp = bn;
@@ -623,7 +602,7 @@ show_peri_clks(int mem_fd, struct mmap_state * msp, int bn,
             printf("\n");
     }
 
-    if (NULL == ((mmp = get_mmp(mem_fd, PMC_PCSR0, msp, op))))
+    if (NULL == ((mmp = get_mmp(mem_fd, PMC_PCSR0, msp))))
         goto clean_up;
     reg = *mmp;
     if (op->verbose > 1)
@@ -660,7 +639,7 @@ show_peri_clks(int mem_fd, struct mmap_state * msp, int bn,
         }
     }
 
-    if (NULL == ((mmp = get_mmp(mem_fd, PMC_PCSR1, msp, op))))
+    if (NULL == ((mmp = get_mmp(mem_fd, PMC_PCSR1, msp))))
         goto clean_up;
     reg = *mmp;
     if (op->verbose > 1)
@@ -702,19 +681,644 @@ clean_up:
     return res;
 }
 
+/* Looks up bit_num 'id' in table starting at 'badp'. Returns matching
+ * entry or NULL. */
+static const struct bit_acron_desc *
+find_bad(const struct bit_acron_desc * badp, int id)
+{
+    for ( ; badp->bit_num >= 0; ++badp) {
+        if (id == badp->bit_num)
+            return badp;
+        if (id < badp->bit_num)
+            break;
+    }
+    return NULL;
+}
+
+/* Emits one JSON object or raw record for clock 'id' of type 'kind'.
+ * Returns 0 if okay, else 1 . */
+static int
+clk_struct_out(int kind, int id, bool enabled, unsigned int pcr,
+               bool * firstp, const struct opts_t * op)
+{
+    const struct bit_acron_desc * badp;
+    struct pmc_clk_rec rec;
+
+    badp = find_bad((PMC_REC_SYS == kind) ? sys_id_arr : peri_id_arr, id);
+    if (OUT_FMT_RAW == op->out_fmt) {
+        rec.kind = kind;
+        rec.id = id;
+        rec.enabled = enabled;
+        rec.in_table = !!badp;
+        rec.pcr = pcr;
+        if (1 != fwrite(&rec, sizeof(rec), 1, stdout)) {
+            perror("fwrite(stdout)");
+            return 1;
+        }
+        return 0;
+    }
+    if (pcr)
+        printf("%s\n    {\"id\": %d, \"acron\": \"%s\", \"en\": %d, "
+               "\"pcr_en\": %d, \"gcken\": %d, \"gckcss\": %u, "
+               "\"gckdiv\": %u}", (*firstp ? "" : ","), id,
+               (badp ? badp->acron : ""), (int)enabled,
+               !!(PMC_PCR_EN_MSK & pcr), !!(PMC_PCR_GCKEN_MSK & pcr),
+               ((PMC_PCR_GCKCSS_MSK & pcr) >> PMC_PCR_GCKCSS_SHIFT),
+               ((PMC_PCR_GCKDIV_MSK & pcr) >> PMC_PCR_GCKDIV_SHIFT));
+    else
+        printf("%s\n    {\"id\": %d, \"acron\": \"%s\", \"en\": %d}",
+               (*firstp ? "" : ","), id, (badp ? badp->acron : ""),
+               (int)enabled);
+    *firstp = false;
+    return 0;
+}
+
+/* Structured (JSON or raw binary) counterpart of show_sys_clks() and
+ * show_peri_clks(). Every clock in the tables is output (enabled or not)
+ * plus any other status bit that is set. If '-a ACRON' was given only
+ * that clock ('bn') is output. Returns 0 if okay, else 1 . */
+static int
+show_clks_struct(int mem_fd, struct mmap_state * msp, int bn,
+                 const struct opts_t * op)
+{
+    int k;
+    bool en;
+    bool first;
+    unsigned int scsr, pcr;
+    unsigned int pcsr[2];
+    volatile unsigned int * mmp;
+    const struct bit_acron_desc * badp;
+
+    if (NULL == ((mmp = get_mmp(mem_fd, PMC_SCSR, msp))))
+        return 1;
+    scsr = *mmp;
+    if (NULL == ((mmp = get_mmp(mem_fd, PMC_PCSR0, msp))))
+        return 1;
+    pcsr[0] = *mmp;
+    if (NULL == ((mmp = get_mmp(mem_fd, PMC_PCSR1, msp))))
+        return 1;
+    pcsr[1] = *mmp;
+    if (op->verbose > 1)
+        pr2serr("PMC_SCSR=0x%x, PMC_PCSR0=0x%x, PMC_PCSR1=0x%x\n", scsr,
+                pcsr[0], pcsr[1]);
+
+    if (OUT_FMT_JSON == op->out_fmt)
+        printf("{\n  \"scsr\": %u,\n  \"pcsr0\": %u,\n  \"pcsr1\": %u",
+               scsr, pcsr[0], pcsr[1]);
+    if (op->sel_sys_clks) {
+        if (OUT_FMT_JSON == op->out_fmt)
+            printf(",\n  \"sys_clks\": [");
+        first = true;
+        for (k = 0; k < 32; ++k) {
+            if (op->acronp && (k != bn))
+                continue;
+            en = !!(scsr & (1U << k));
+            if ((! en) && (NULL == find_bad(sys_id_arr, k)))
+                continue;
+            if (clk_struct_out(PMC_REC_SYS, k, en, 0, &first, op))
+                return 1;
+        }
+        if (OUT_FMT_JSON == op->out_fmt)
+            printf("\n  ]");
+    }
+    if (op->sel_peri_clks) {
+        if (OUT_FMT_JSON == op->out_fmt)
+            printf(",\n  \"peri_clks\": [");
+        first = true;
+        for (k = 0; k < 64; ++k) {
+            if (op->acronp && (k != bn))
+                continue;
+            en = !!(pcsr[k / 32] & (1U << (k % 32)));
+            badp = find_bad(peri_id_arr, k);
+            if ((! en) && (NULL == badp))
+                continue;
+            pcr = 0;
+            if (op->acronp) {
+                if (NULL == ((mmp = get_mmp(mem_fd, PMC_PCR, msp))))
+                    return 1;
+                *mmp = k;       /* read cmd for this PID */
+                pcr = *mmp;
+            }
+            if (clk_struct_out(PMC_REC_PERI, k, en, pcr, &first, op))
+                return 1;
+        }
+        if (OUT_FMT_JSON == op->out_fmt)
+            printf("\n  ]");
+    }
+    if (OUT_FMT_JSON == op->out_fmt)
+        printf("\n}\n");
+    return 0;
+}
+
+/* Matches 'cp' (case insensitive, at most 15 characters) against the
+ * acronyms in sys_id_arr[] (if 'try_sys') then peri_id_arr[] (if
+ * 'try_peri'). A peripheral acronym like "PIOA_PIOB" is also matched by
+ * its leading part (e.g. "PIOA"). Returns bit_num and sets *is_sysp, or
+ * returns -1 if no match. */
+static int
+match_acron(const char * cp, bool try_sys, bool try_peri, bool * is_sysp)
+{
+    int k;
+    const char * ccp;
+    const struct bit_acron_desc * badp;
+    char b[16];
+
+    for (k = 0; (k < (int)(sizeof(b) - 1)) && cp[k]; ++k)
+        b[k] = toupper(cp[k]);
+    b[k] = '\0';
+    if (try_sys) {
+        for (badp = sys_id_arr; badp->bit_num >= 0; ++badp) {
+            if (0 == strcmp(b, badp->acron)) {
+                *is_sysp = true;
+                return badp->bit_num;
+            }
+        }
+    }
+    if (try_peri) {
+        for (badp = peri_id_arr; badp->bit_num >= 0; ++badp) {
+            if ((0 == strcmp(b, badp->acron)) ||
+                ((ccp = strchr(badp->acron, '_')) &&
+                 (0 == strncmp(b, badp->acron, ccp - badp->acron)))) {
+                *is_sysp = false;
+                return badp->bit_num;
+            }
+        }
+    }
+    return -1;
+}
+
+/* Decodes '-l LIST' into op->l_sys_mask and op->l_peri_mask[]. Entries
+ * are separated by commas and are acronyms (system clocks are tried
+ * first, as with '-a ACRON') or numbers. A number is a peripheral id
+ * unless '-s' (and not '-p') is given. Returns 0 if okay, else 1 . */
+static int
+parse_clk_list(const char * lp, struct opts_t * op)
+{
+    int bn, res;
+    bool is_sys;
+    bool num_is_sys = op->sel_sys_clks && (! op->sel_peri_clks);
+    char * cp;
+    char * kp;
+    char * savep;
+    char * endp;
+
+    if (NULL == (cp = strdup(lp))) {
+        pr2serr("%s: strdup() failed\n", __func__);
+        return 1;
+    }
+    res = 1;
+    for (kp = strtok_r(cp, ",", &savep); kp;
+         kp = strtok_r(NULL, ",", &savep)) {
+        if (isdigit(*kp)) {
+            bn = (int)strtol(kp, &endp, 10);
+            is_sys = num_is_sys;
+            if (('\0' != *endp) || (bn > (is_sys ? 31 : 63))) {
+                pr2serr("'-l LIST' entry '%s' should be a %s id from 0 to "
+                        "%d\n", kp, (is_sys ? "system" : "peripheral"),
+                        (is_sys ? 31 : 63));
+                goto clean_up;
+            }
+        } else {
+            bn = match_acron(kp, op->sel_sys_clks || ! op->sel_peri_clks,
+                             op->sel_peri_clks || ! op->sel_sys_clks,
+                             &is_sys);
+            if (bn < 0) {
+                pr2serr("Could not match '-l LIST' entry: %s, use '-e' to "
+                        "see what is available\n", kp);
+                goto clean_up;
+            }
+        }
+        if (is_sys)
+            op->l_sys_mask |= (1U << bn);
+        else
+            op->l_peri_mask[bn / 32] |= (1U << (bn % 32));
+    }
+    if (0 == (op->l_sys_mask | op->l_peri_mask[0] | op->l_peri_mask[1]))
+        pr2serr("'-l LIST' is empty\n");
+    else
+        res = 0;
+
+clean_up:
+    free(cp);
+    return res;
+}
+
+/* Writes 'val' to the PMC register at 'addr'. Returns 0 if okay, else 1 */
+static int
+pmc_write(int mem_fd, struct mmap_state * msp, unsigned int addr,
+          unsigned int val, const char * name, const struct opts_t * op)
+{
+    volatile unsigned int * mmp;
+
+    if (NULL == ((mmp = get_mmp(mem_fd, addr, msp))))
+        return 1;
+    if (op->verbose > 1)
+        printf("Writing 0x%x to %s [IO addr: 0x%x]\n", val, name, addr);
+    *mmp = val;
+    return 0;
+}
+
+/* Enables ('-E') or disables ('-D') every clock in '-l LIST'. PMC write
+ * protection, if on, is turned off once at the start and back on at the
+ * end. System clocks take one PMC_SCER or PMC_SCDR write. Peripheral
+ * clocks take one PMC_PCERx or PMC_PCDRx write per 32 ids, whatever the
+ * level, as en_dis_peri_sys_clk() does for a single id. Generic clocks
+ * (level bit 1) also need a PMC_PCR read command then a write for each
+ * id: the other PCR fields are kept apart from GCKCSS and GCKDIV when
+ * '-c CSS' and '-d DIV' are given with '-E'. Returns 0 if okay, else 1 . */
+static int
+do_batch(int mem_fd, struct mmap_state * msp, const struct opts_t * op)
+{
+    int k, level;
+    int res = 1;
+    bool wp_on;
+    unsigned int reg, mask;
+    volatile unsigned int * wpmrp;
+    volatile unsigned int * mmp;
+
+    level = op->do_enable ? op->do_enable : op->do_disable;
+    if (NULL == ((wpmrp = get_mmp(mem_fd, PMC_WPMR, msp))))
+        return 1;
+    wp_on = !!(1 & *wpmrp);
+    if (wp_on) {
+        *wpmrp = (A5D2_PMC_WPKEY << 8);
+        if (op->verbose)
+            pr2serr("PMC write protection turned off for batch\n");
+    }
+    if (op->l_sys_mask) {
+        if (op->do_enable)
+            k = pmc_write(mem_fd, msp, PMC_SCER, op->l_sys_mask, "PMC_SCER",
+                          op);
+        else
+            k = pmc_write(mem_fd, msp, PMC_SCDR, op->l_sys_mask, "PMC_SCDR",
+                          op);
+        if (k)
+            goto clean_up;
+    }
+    if (op->l_peri_mask[0] &&
+        pmc_write(mem_fd, msp, (op->do_enable ? PMC_PCER0 : PMC_PCDR0),
+                  op->l_peri_mask[0],
+                  (op->do_enable ? "PMC_PCER0" : "PMC_PCDR0"), op))
+        goto clean_up;
+    if (op->l_peri_mask[1] &&
+        pmc_write(mem_fd, msp, (op->do_enable ? PMC_PCER1 : PMC_PCDR1),
+                  op->l_peri_mask[1],
+                  (op->do_enable ? "PMC_PCER1" : "PMC_PCDR1"), op))
+        goto clean_up;
+    if (2 & level) {
+        if (NULL == ((mmp = get_mmp(mem_fd, PMC_PCR, msp))))
+            goto clean_up;
+        for (k = 0; k < 64; ++k) {
+            mask = 1U << (k % 32);
+            if (0 == (op->l_peri_mask[k / 32] & mask))
+                continue;
+            *mmp = k;           /* read cmd for this PID */
+            reg = *mmp & ~(PMC_PCR_PID_MSK | PMC_PCR_WR_CMD_MSK);
+            if (op->do_enable) {
+                reg |= PMC_PCR_GCKEN_MSK;
+                if (op->css_given) {
+                    reg &= ~PMC_PCR_GCKCSS_MSK;
+                    reg |= (op->css << PMC_PCR_GCKCSS_SHIFT);
+                }
+                if (op->divisor_given && (op->divisor > 0)) {
+                    reg &= ~PMC_PCR_GCKDIV_MSK;
+                    reg |= ((op->divisor - 1) << PMC_PCR_GCKDIV_SHIFT);
+                }
+            } else
+                reg &= ~PMC_PCR_GCKEN_MSK;
+            reg |= PMC_PCR_WR_CMD_MSK | k;
+            if (op->verbose > 1)
+                printf("Writing 0x%x to PMC_PCR [IO addr: 0x%x]\n", reg,
+                       PMC_PCR);
+            *mmp = reg;
+        }
+    }
+    res = 0;
+
+clean_up:
+    if (wp_on) {
+        *wpmrp = (A5D2_PMC_WPKEY << 8) | 1;
+        if (op->verbose)
+            pr2serr("PMC write protection turned back on\n");
+    }
+    return res;
+}
+
+static void
+prof_sig_handler(int signum)
+{
+    if (SIGUSR1 == signum)
+        ++prof_phase_req;
+    else
+        prof_stop = 1;
+}
+
+/* Decodes INTERVAL which is a number of milliseconds, optionally followed
+ * by "ms" or "s" (seconds). Returns milliseconds or -1 if error. */
+static int
+get_interval_ms(const char * cp)
+{
+    int n;
+    char * endp;
+
+    n = (int)strtol(cp, &endp, 10);
+    if ((endp == cp) || (n < 1))
+        return -1;
+    if (('\0' == *endp) || (0 == strcmp(endp, "ms")))
+        return n;
+    if ((0 == strcmp(endp, "s")) && (n <= (INT_MAX / 1000)))
+        return n * 1000;
+    return -1;
+}
+
+static double
+ts_diff_secs(const struct timespec * ap, const struct timespec * bp)
+{
+    return (double)(ap->tv_sec - bp->tv_sec) +
+           ((double)(ap->tv_nsec - bp->tv_nsec) / 1000000000.0);
+}
+
+/* Name of clock 'id' (system if 'is_sys') placed in b[] if not in the
+ * tables. */
+static const char *
+clk_name(bool is_sys, int id, char * b, int blen)
+{
+    const struct bit_acron_desc * badp;
+
+    badp = find_bad(is_sys ? sys_id_arr : peri_id_arr, id);
+    if (badp)
+        return badp->acron;
+    snprintf(b, blen, "%s[%d]", (is_sys ? "sys" : "peri"), id);
+    return b;
+}
+
+/* Prints the '-S' histogram: per phase, the fraction of samples each
+ * clock was on (and with '-g' had GCKEN set, with the GCKDIV range seen)
+ * and how often it changed state; clocks that were never on are only
+ * shown with '-v'. Then clocks on in every sample (nothing turned them
+ * off during the workload so check those first when looking for clocks
+ * to cut) and clocks whose on fraction differs between phases. */
+static void
+prof_report(int num_phases, const unsigned int * sel, const struct opts_t * op)
+{
+    int j, k, id, n;
+    bool is_sys, first;
+    unsigned int total = 0;
+    unsigned int on_all, min_cnt, max_cnt;
+    double pc, min_pc, max_pc;
+    const struct prof_phase * ppp;
+    const struct prof_clk * pcp;
+    char b[16];
+
+    for (j = 0; j < num_phases; ++j)
+        total += prof_arr[j].samples;
+    printf("PMC clock profile: %u samples every %d ms in %d phase%s\n",
+           total, op->interval_ms, num_phases, ((1 == num_phases) ? "" :
+           "s"));
+    for (j = 0; j < num_phases; ++j) {
+        ppp = prof_arr + j;
+        if (0 == ppp->samples)
+            continue;
+        printf("\nPhase %d: %u samples, %.3f s\n", j, ppp->samples,
+               ppp->secs);
+        printf("    Clock        on%%  toggles%s\n",
+               (op->do_generic ? "     gck%  GCKDIV" : ""));
+        for (k = 0; k < 96; ++k) {
+            is_sys = (k < 32);
+            id = is_sys ? k : k - 32;
+            if (0 == (sel[k / 32] & (1U << (k % 32))))
+                continue;
+            pcp = is_sys ? (ppp->sys + id) : (ppp->peri + id);
+            if ((0 == pcp->on_cnt) && (0 == pcp->gck_cnt) &&
+                (op->verbose < 1))
+                continue;
+            printf("    %-10s %5.1f  %7u", clk_name(is_sys, id, b, sizeof(b)),
+                   100.0 * pcp->on_cnt / ppp->samples, pcp->toggles);
+            if (op->do_generic && (! is_sys)) {
+                printf("   %5.1f", 100.0 * pcp->gck_cnt / ppp->samples);
+                if (pcp->gck_cnt)
+                    printf("  %u..%u", pcp->div_min, pcp->div_max);
+            }
+            printf("\n");
+        }
+    }
+
+    for (n = 0; n < 2; ++n) {
+        first = true;
+        for (k = 0; k < 96; ++k) {
+            is_sys = (k < 32);
+            id = is_sys ? k : k - 32;
+            if (0 == (sel[k / 32] & (1U << (k % 32))))
+                continue;
+            on_all = 0;
+            min_cnt = UINT_MAX;
+            max_cnt = 0;
+            min_pc = 100.0;
+            max_pc = 0.0;
+            for (j = 0; j < num_phases; ++j) {
+                ppp = prof_arr + j;
+                if (0 == ppp->samples)
+                    continue;
+                pcp = is_sys ? (ppp->sys + id) : (ppp->peri + id);
+                on_all += pcp->on_cnt;
+                pc = 100.0 * pcp->on_cnt / ppp->samples;
+                if (pc < min_pc)
+                    min_pc = pc;
+                if (pc > max_pc)
+                    max_pc = pc;
+                if (pcp->on_cnt < min_cnt)
+                    min_cnt = pcp->on_cnt;
+                if (pcp->on_cnt > max_cnt)
+                    max_cnt = pcp->on_cnt;
+            }
+            if (0 == n) {
+                if ((0 == total) || (on_all != total))
+                    continue;
+                printf("%s %s", (first ? "\nOn in every sample:\n   " :
+                       ""), clk_name(is_sys, id, b, sizeof(b)));
+            } else {
+                if ((num_phases < 2) || (0 == max_cnt) ||
+                    ((max_pc - min_pc) < 1.0))
+                    continue;
+                printf("%s    %-10s", (first ? "\nOn fraction varies "
+                       "by phase (% in phase 0, 1, ...):\n" : ""),
+                       clk_name(is_sys, id, b, sizeof(b)));
+                for (j = 0; j < num_phases; ++j) {
+                    ppp = prof_arr + j;
+                    pcp = is_sys ? (ppp->sys + id) : (ppp->peri + id);
+                    if (ppp->samples)
+                        printf(" %5.1f", 100.0 * pcp->on_cnt / ppp->samples);
+                    else
+                        printf("     -");
+                }
+                printf("\n");
+            }
+            first = false;
+        }
+        if ((0 == n) && (! first))
+            printf("\n");
+    }
+}
+
+/* Profiles the clocks selected by '-l LIST' (def: every clock in the
+ * tables plus any other enabled id) by reading PMC_SCSR, PMC_PCSR0 and
+ * PMC_PCSR1 every op->interval_ms into prof_arr[]. With '-g' the PMC_PCR
+ * of each selected peripheral id is also read; that needs a PID write to
+ * PMC_PCR, which could race with the kernel's clock driver doing the
+ * same, hence it is optional. SIGUSR1 (e.g. from a workload script)
+ * starts the next phase, SIGINT or SIGTERM (or '-n NUM' samples) stops and
+ * prints the report. Returns 0 if okay, else 1 . */
+static int
+do_profile(int mem_fd, struct mmap_state * msp, const struct opts_t * op)
+{
+    int k, id, res, phase, req;
+    unsigned int n, mask, pcr, div;
+    bool on, warned;
+    unsigned int sel[3];        /* [0]: sys, [1], [2]: peri ids */
+    unsigned int reg[3];
+    unsigned int prev[3];
+    volatile unsigned int * scsrp;
+    volatile unsigned int * pcsr0p;
+    volatile unsigned int * pcsr1p;
+    volatile unsigned int * pcrp = NULL;
+    struct prof_phase * ppp;
+    struct prof_clk * pcp;
+    const struct bit_acron_desc * badp;
+    struct timespec next, now, phase_start;
+    struct sigaction sa;
+
+    if ((NULL == ((scsrp = get_mmp(mem_fd, PMC_SCSR, msp)))) ||
+        (NULL == ((pcsr0p = get_mmp(mem_fd, PMC_PCSR0, msp)))) ||
+        (NULL == ((pcsr1p = get_mmp(mem_fd, PMC_PCSR1, msp)))))
+        return 1;
+    if (op->do_generic && (NULL == ((pcrp = get_mmp(mem_fd, PMC_PCR, msp)))))
+        return 1;
+    if (op->list_given) {
+        sel[0] = op->l_sys_mask;
+        sel[1] = op->l_peri_mask[0];
+        sel[2] = op->l_peri_mask[1];
+    } else {
+        memset(sel, 0, sizeof(sel));
+        for (badp = sys_id_arr; badp->bit_num >= 0; ++badp)
+            sel[0] |= 1U << badp->bit_num;
+        for (badp = peri_id_arr; badp->bit_num >= 0; ++badp)
+            sel[1 + (badp->bit_num / 32)] |= 1U << (badp->bit_num % 32);
+        /* plus anything enabled at the start */
+        sel[0] |= *scsrp;
+        sel[1] |= *pcsr0p;
+        sel[2] |= *pcsr1p;
+    }
+    memset(prof_arr, 0, sizeof(prof_arr));
+    memset(prev, 0, sizeof(prev));
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = prof_sig_handler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGUSR1, &sa, NULL);
+    pr2serr("Profiling PMC clocks every %d ms, pid=%d; SIGUSR1 starts the "
+            "next phase,\nSIGINT stops\n", op->interval_ms, (int)getpid());
+
+    phase = 0;
+    warned = false;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    phase_start = next;
+    for (n = 0; ; ) {
+        ppp = prof_arr + phase;
+        reg[0] = *scsrp;
+        reg[1] = *pcsr0p;
+        reg[2] = *pcsr1p;
+        for (k = 0; k < 96; ++k) {
+            mask = 1U << (k % 32);
+            if (0 == (sel[k / 32] & mask))
+                continue;
+            id = (k < 32) ? k : k - 32;
+            pcp = (k < 32) ? (ppp->sys + id) : (ppp->peri + id);
+            on = !!(reg[k / 32] & mask);
+            if (on)
+                ++pcp->on_cnt;
+            if ((ppp->samples > 0) && (on != !!(prev[k / 32] & mask)))
+                ++pcp->toggles;
+            if (pcrp && (k >= 32)) {
+                *pcrp = id;     /* read cmd for this PID */
+                pcr = *pcrp;
+                if (PMC_PCR_GCKEN_MSK & pcr) {
+                    div = (PMC_PCR_GCKDIV_MSK & pcr) >> PMC_PCR_GCKDIV_SHIFT;
+                    if ((0 == pcp->gck_cnt) || (div < pcp->div_min))
+                        pcp->div_min = div;
+                    if ((0 == pcp->gck_cnt) || (div > pcp->div_max))
+                        pcp->div_max = div;
+                    ++pcp->gck_cnt;
+                }
+            }
+        }
+        memcpy(prev, reg, sizeof(prev));
+        ++ppp->samples;
+        ++n;
+        if ((op->num_samples > 0) && (n >= (unsigned int)op->num_samples)) {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            break;
+        }
+
+        next.tv_sec += op->interval_ms / 1000;
+        next.tv_nsec += (op->interval_ms % 1000) * 1000000;
+        if (next.tv_nsec >= 1000000000) {
+            ++next.tv_sec;
+            next.tv_nsec -= 1000000000;
+        }
+        do {
+            res = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next,
+                                  NULL);
+        } while ((EINTR == res) && (! prof_stop));
+        if (res && (EINTR != res)) {
+            pr2serr("clock_nanosleep: %s\n", strerror(res));
+            return 1;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (prof_stop)
+            break;
+        req = prof_phase_req;
+        if (req >= MAX_PHASES) {
+            req = MAX_PHASES - 1;
+            if (! warned) {
+                pr2serr("more than %d phases, later ones merged into the "
+                        "last\n", MAX_PHASES);
+                warned = true;
+            }
+        }
+        if (req != phase) {
+            prof_arr[phase].secs = ts_diff_secs(&now, &phase_start);
+            phase_start = now;
+            phase = req;
+            if (op->verbose)
+                pr2serr("phase %d starts after %u samples\n", phase, n);
+        }
+        /* if we have fallen behind, restart the period from now */
+        if ((now.tv_sec > next.tv_sec) ||
+            ((now.tv_sec == next.tv_sec) && (now.tv_nsec > next.tv_nsec)))
+            next = now;
+    }
+    prof_arr[phase].secs = ts_diff_secs(&now, &phase_start);
+    prof_report(phase + 1, sel, op);
+    return 0;
+}
+
 int
 main(int argc, char * argv[])
 {
-    int mem_fd, k, opt, no_clock_preference, found;
+    int mem_fd, k, opt, no_clock_preference;
     int bn = 0;
     int res = 1;
     unsigned int reg;
+    bool is_sys;
     struct bit_acron_desc * badp;
     volatile unsigned int * mmp;
     struct mmap_state mstat;
     struct mmap_state * msp;
-    char b[16];
+    char * endp;
     const char * cp;
+    const char * listp = NULL;
     struct opts_t opts;
     struct opts_t * op;
 
@@ -723,7 +1327,7 @@ main(int argc, char * argv[])
     op = &opts;
     memset(op, 0, sizeof(opts));
     op->css = CLK_SRC_DEF;
-    while ((opt = getopt(argc, argv, "a:c:d:DeEghpP:svVw:")) != -1) {
+    while ((opt = getopt(argc, argv, "a:c:d:DeEghjl:n:pP:rsS:vVw:")) != -1) {
         switch (opt) {
         case 'a':
             op->acronp = optarg;
@@ -785,6 +1389,21 @@ main(int argc, char * argv[])
         case '?':
             usage();
             return 0;
+        case 'j':
+            op->out_fmt = OUT_FMT_JSON;
+            break;
+        case 'l':
+            listp = optarg;
+            op->list_given = true;
+            break;
+        case 'n':
+            op->num_samples = (int)strtol(optarg, &endp, 10);
+            if ((endp == optarg) || *endp || (op->num_samples < 0)) {
+                pr2serr("expect argument to '-n' to be 0 or more\n");
+                return 1;
+            }
+            op->num_given = true;
+            break;
         case 'p':
             op->sel_peri_clks = true;
             break;
@@ -797,9 +1416,20 @@ main(int argc, char * argv[])
             op->pgc = k;
             op->pgc_given = true;
             break;
+        case 'r':
+            op->out_fmt = OUT_FMT_RAW;
+            break;
         case 's':
             op->sel_sys_clks = true;
             break;
+        case 'S':
+            op->interval_ms = get_interval_ms(optarg);
+            if (op->interval_ms < 1) {
+                pr2serr("bad '-S INTERVAL', expect milliseconds or a "
+                        "number with a 's' suffix\n");
+                return 1;
+            }
+            break;
         case 'v':
             ++op->verbose;
             break;
@@ -841,9 +1471,39 @@ main(int argc, char * argv[])
         pr2serr("Cannot give both '-D' and '-E' options\n");
         return 1;
     }
+    if (op->list_given) {
+        if (op->acronp || op->pgc_given) {
+            pr2serr("'-l LIST' cannot be used with '-a ACRON' or "
+                    "'-P PGC'\n");
+            return 1;
+        }
+        if (! (op->do_disable || op->do_enable || op->interval_ms)) {
+            pr2serr("'-l LIST' needs '-E', '-D' or '-S INTERVAL'\n");
+            return 1;
+        }
+        if (parse_clk_list(listp, op))
+            return 1;
+    }
+    if (op->interval_ms && (op->do_disable || op->do_enable ||
+                            op->acronp || op->pgc_given)) {
+        pr2serr("'-S INTERVAL' cannot be used with '-E', '-D', '-a ACRON' "
+                "or '-P PGC'\n");
+        return 1;
+    }
+    if (op->num_given && (! op->interval_ms)) {
+        pr2serr("'-n NUM' only applies to '-S INTERVAL'\n");
+        return 1;
+    }
+    if (op->out_fmt && (op->interval_ms || op->do_disable ||
+                        op->do_enable)) {
+        pr2serr("'-j' and '-r' cannot be used with '-S INTERVAL', '-E' or "
+                "'-D'\n");
+        return 1;
+    }
     if (op->divisor_given) {
-        if (! (op->acronp || op->pgc_given)) {
-            pr2serr("with '-d DIV' must also give '-a ACRON' or '-P PGC'\n");
+        if (! (op->acronp || op->pgc_given || op->list_given)) {
+            pr2serr("with '-d DIV' must also give '-a ACRON', '-l LIST' or "
+                    "'-P PGC'\n");
             return 1;
         }
         if (! (op->do_disable || op->do_enable)) {
@@ -867,39 +1527,14 @@ main(int argc, char * argv[])
                 return 1;
             }
         } else { /* try to match (case insensitive) with the acron field */
-            for (k = 0; k < (int)(sizeof(b) - 1); ++k)
-                b[k] = toupper(op->acronp[k]);
-            b[sizeof(b) - 1] = '\0';
-            found = 0;
-            if (no_clock_preference || op->sel_sys_clks) {
-                for (badp = sys_id_arr; badp->bit_num >= 0; ++badp) {
-                    if (0 == strcmp(b, badp->acron))
-                        break;
-                }
-                if (badp->bit_num >= 0) {
-                    bn = badp->bit_num;
-                    ++found;
-                    op->sel_sys_clks = true;
-                    op->sel_peri_clks = false;
-                }
-            }
-            if (! found && ((no_clock_preference || op->sel_peri_clks))) {
-                for (badp = peri_id_arr; badp->bit_num >= 0; ++badp) {
-                    if (0 == strcmp(b, badp->acron))
-                        break;
-                    if ((cp = strchr(badp->acron, '_')) &&
-                        (0 == strncmp(b, badp->acron, cp - badp->acron)))
-                        /* allow 'PIOA' to match 'PIOA_PIOB' */
-                        break;
-                }
-                if (badp->bit_num >= 0) {
-                    bn = badp->bit_num;
-                    ++found;
-                    op->sel_peri_clks = true;
-                    op->sel_sys_clks = false;
-                }
-            }
-            if (! found) {
+            bn = match_acron(op->acronp,
+                             no_clock_preference || op->sel_sys_clks,
+                             no_clock_preference || op->sel_peri_clks,
+                             &is_sys);
+            if (bn >= 0) {
+                op->sel_sys_clks = is_sys;
+                op->sel_peri_clks = ! is_sys;
+            } else {
                 pr2serr("Could not match ACRON: %s, use '-e' to see what is "
                         "available\n", op->acronp);
                 return 1;
@@ -911,7 +1546,8 @@ main(int argc, char * argv[])
             return 1;
         }
     }
-    if ((op->divisor_given) && (! (op->sel_peri_clks || op->pgc_given))) {
+    if ((op->divisor_given) && (! (op->sel_peri_clks || op->pgc_given ||
+                                   op->list_given))) {
         pr2serr("'-d DIV' only applies to peripheral and programmable "
                 "clocks\n");
         return 1;
@@ -922,6 +1558,12 @@ main(int argc, char * argv[])
         if (op->do_disable)
             ++op->do_disable;
     }
+    if (op->list_given && (op->css_given || op->divisor_given) &&
+        (! (2 & (op->do_enable | op->do_disable)))) {
+        pr2serr("with '-l LIST' the '-c CSS' and '-d DIV' options only "
+                "apply to\ngeneric clocks, so need '-g'\n");
+        return 1;
+    }
 
     if (! (op->sel_peri_clks || op->sel_sys_clks || op->pgc_given))
         op->sel_peri_clks = true;
@@ -934,23 +1576,23 @@ main(int argc, char * argv[])
     } else if (op->verbose)
         printf("open(" DEV_MEM "O_RDWR | O_SYNC) okay\n");
 
-    memset(msp, 0, sizeof(mstat));
+    init_mmap_state(msp, op->verbose);
 
     if (op->wpen_given) {
         if (-1 == op->wpen) {
-            if (NULL == ((mmp = get_mmp(mem_fd, PMC_WPMR, msp, op))))
+            if (NULL == ((mmp = get_mmp(mem_fd, PMC_WPMR, msp))))
                 goto clean_up;
             reg = *mmp;
             printf("Write protect mode: %sabled\n",
                    ((reg & 1) ? "EN" : "DIS"));
-            if (NULL == ((mmp = get_mmp(mem_fd, PMC_WPSR, msp, op))))
+            if (NULL == ((mmp = get_mmp(mem_fd, PMC_WPSR, msp))))
                 goto clean_up;
             reg = *mmp & 0xffffff;
             printf("Write protect violation status: %d (%s), WPCSRC: "
                    "0x%x\n", (reg & 1), ((reg & 1) ? "VIOLATED" :
                    "NOT violated"), (reg >> 8) & 0xffff);
         } else if ((0 == op->wpen) || (1 == op->wpen)) {
-            if (NULL == ((mmp = get_mmp(mem_fd, PMC_WPMR, msp, op))))
+            if (NULL == ((mmp = get_mmp(mem_fd, PMC_WPMR, msp))))
                 goto clean_up;
             *mmp = (A5D2_PMC_WPKEY << 8) | op->wpen;
         }
@@ -961,10 +1603,22 @@ main(int argc, char * argv[])
         res = do_pgc(mem_fd, msp, op);
         goto clean_up;
     }
+    if (op->interval_ms) {
+        res = do_profile(mem_fd, msp, op);
+        goto clean_up;
+    }
+    if (op->list_given) {
+        res = do_batch(mem_fd, msp, op);
+        goto clean_up;
+    }
     if (op->do_enable || op->do_disable) {
         res = en_dis_peri_sys_clk(mem_fd, msp, bn, op);
         goto clean_up;
     }
+    if (op->out_fmt) {
+        res = show_clks_struct(mem_fd, msp, bn, op);
+        goto clean_up;
+    }
     if (op->sel_sys_clks) {
         res = show_sys_clks(mem_fd, msp, bn, op);
         if (res)
@@ -980,14 +1634,8 @@ main(int argc, char * argv[])
     res = 0;
 
 clean_up:
-    if (msp->mmap_ok) {
-        if (-1 == munmap(msp->mmap_ptr, MAP_SIZE)) {
-            pr2serr("mmap_ptr=%p:\n", msp->mmap_ptr);
-            perror("    munmap");
-            res = 1;
-        } else if (op->verbose > 2)
-            pr2serr("trailing munmap() ok, mmap_ptr=%p\n", msp->mmap_ptr);
-    }
+    if (release_mmap_state(msp))
+        res = 1;
     if (mem_fd >= 0)
         close(mem_fd);
     return res;
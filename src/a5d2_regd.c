@@ -0,0 +1,957 @@
+/*
+ * Copyright (c) 2026 Douglas Gilbert.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+/*****************************************************************
+ * a5d2_regd.c
+ *
+ * Register and GPIO server. With '-D' this utility opens /dev/mem once,
+ * maps the PIO, TC and PMC pages, optionally requests GPIO lines (via
+ * gpio_cdev.c) then serves batches of operations sent over a Unix domain
+ * socket (see a5d2_regd.h for the protocol). Without '-D' it is a client
+ * of that daemon: operations given on the command line (or in a file) are
+ * sent as one batch and results printed, in hex as mem2io does.
+ *
+ * Each operation is what a5d2_pio_status (read bank), a5d2_pio_set (set
+ * or clear output lines), mem2io (read or write lists) or a5d2_tc_freq
+ * (change a running channel's frequency) would do, without the start up
+ * cost of a process per operation.
+ *
+ ****************************************************************/
+
+#define _XOPEN_SOURCE 600
+#define _GNU_SOURCE 1
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <limits.h>
+#include <signal.h>
+#include <poll.h>
+#include <syslog.h>
+#include <grp.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "mmap_regs.h"
+#include "a5d2_regs.h"
+#include "gpio_cdev.h"
+#include "sa_misc.h"
+#include "a5d2_regd.h"
+
+
+static const char * version_str = "1.01 20261014";
+
+#define MAX_CLIENTS 16
+#define DEF_MIN_ADDR 0xf0000000         /* as mem2io */
+#define MAX_OP_LINE 256
+
+struct opts_t {
+    int do_daemon;
+    int foreground;
+    int repeat;
+    int verbose;
+    const char * sock_path;
+    const char * group;         /* '-g': may also connect, else NULL */
+    const char * chip;
+    const char * in_list;
+    const char * out_list;
+    const char * fname;
+};
+
+/* Daemon state, set up once then used for every request */
+struct srv_t {
+    int mem_fd;
+    int in_fd;                  /* '-i' lines, or -1 */
+    int in_num;
+    int out_fd;                 /* '-o' lines, or -1 */
+    int out_num;
+    int gckdiv[2];              /* of TCB0 and TCB1, from PMC_PCR */
+    int verbose;
+    unsigned long reqs;
+    unsigned long ops;
+    unsigned int req_delay_us;  /* delayed so far in current request */
+    struct mmap_state mstate;
+};
+
+static const char * st_str_arr[] = {
+    "good",
+    "bad request",
+    "bad op or argument",
+    "bad address",
+    "no GPIO lines held for that",
+    "frequency or delay out of range",
+    "IO error",
+};
+
+static volatile sig_atomic_t stop_sig;
+
+
+static void
+usage(void)
+{
+    pr2serr("Usage: a5d2_regd -D [-C CHIP] [-F] [-g GROUP] [-i LIST] "
+            "[-o LIST]\n"
+            "                   [-s SOCK] [-v]\n"
+            "       a5d2_regd [-f FILE] [-n NUM] [-s SOCK] [-v] [OP...]\n"
+            "       a5d2_regd [-h] [-V]\n"
+            "  where:\n"
+            "    -C CHIP      GPIO chip for '-i' and '-o' (def: %s)\n"
+            "    -D           run as daemon: hold /dev/mem mappings and "
+            "GPIO lines,\n"
+            "                 serve requests on SOCK\n"
+            "    -f FILE      client: read OPs from FILE (one per line, "
+            "'#' comments)\n"
+            "    -F           with '-D' stay in the foreground\n"
+            "    -g GROUP     with '-D' members of GROUP (name or number) "
+            "may also\n"
+            "                 connect (SOCK mode 0660, def: 0600)\n"
+            "    -h           print usage message\n"
+            "    -i LIST      with '-D' request the GPIO lines in LIST "
+            "(e.g. 'PC7,PC8')\n"
+            "                 as inputs\n"
+            "    -n NUM       client: send the batch NUM times and report "
+            "latency\n"
+            "    -o LIST      with '-D' request the GPIO lines in LIST as "
+            "outputs\n"
+            "    -s SOCK      Unix socket name (def: %s)\n"
+            "    -v           increase verbosity\n"
+            "    -V           print version string then exit\n\n"
+            "A client sends its OPs as one batch, each OP is one of:\n"
+            "    r,ADDR           read 32 bits at ADDR\n"
+            "    w,ADDR,VAL       write VAL to ADDR\n"
+            "    m,ADDR,MSK,VAL   write VAL in MSK bits at ADDR, read prior "
+            "value\n"
+            "    pr,BANK          read PIO_PDSR of BANK (A to D)\n"
+            "    ps,BANK,MSK,VAL  set lines in MSK of BANK to VAL\n"
+            "    gg               get '-i' lines (bit k is k-th line)\n"
+            "    gs,MSK,VAL       set '-o' lines in MSK to VAL\n"
+            "    tc,TC,HZ         change TC (0 to 5) to HZ Hz keeping "
+            "TCCLKS, reads RC\n"
+            "    d,US             delay US microseconds (at most %d, and "
+            "%d in all\n"
+            "                     the delays of one batch)\n"
+            "ADDR, MSK and VAL are in hex, TC, HZ and US in decimal. Values "
+            "read are\nprinted in hex, one per line. The TC channel should "
+            "already be running\n(e.g. from 'a5d2_tc_freq'). Only root and "
+            "the daemon's user may connect,\nplus GROUP if '-g' is "
+            "given.\n",
+            GC_DEF_CHIP, REGD_DEF_SOCK, REGD_MAX_DELAY_US,
+            REGD_MAX_REQ_DELAY_US);
+}
+
+static void
+stop_handler(int signum)
+{
+    stop_sig = signum;
+}
+
+static const char *
+st_str(int status)
+{
+    if ((status < 0) ||
+        (status >= (int)(sizeof(st_str_arr) / sizeof(st_str_arr[0]))))
+        return "unknown status";
+    return st_str_arr[status];
+}
+
+static volatile unsigned int *
+srv_mmp(struct srv_t * sp, unsigned int addr)
+{
+    return get_mmp(sp->mem_fd, addr, &sp->mstate);
+}
+
+/* Reads GCKDIV of both TC blocks (as a5d2_tc_freq does), which also maps
+ * the PMC page. Returns 0 if okay, else 1 */
+static int
+read_gckdiv(struct srv_t * sp)
+{
+    int k;
+    unsigned int r;
+    volatile unsigned int * mmp;
+
+    for (k = 0; k < 2; ++k) {
+        if (NULL == ((mmp = srv_mmp(sp, PMC_PCR))))
+            return 1;
+        /* write a read cmd for given peripheral id (in the PID field) */
+        *mmp = SAMA5D2_PERI_ID_TCB0 + k;
+        r = *mmp;
+        sp->gckdiv[k] = (r & PMC_PCR_GCKDIV_MSK) >> PMC_PCR_GCKDIV_SHIFT;
+    }
+    return 0;
+}
+
+/* Changes the frequency of running TC channel 'ch' to 'hz' keeping its
+ * clock source (TCCLKS) and the RA to RC ratio (so the mark space ratio).
+ * Like a5d2_tc_freq's write_seg(), RC is written first if the period is
+ * growing so RA and RB never exceed RC. */
+static int
+tc_freq(struct srv_t * sp, int ch, unsigned int hz, unsigned int * rcp)
+{
+    unsigned int rc, ra, old_rc, old_ra;
+    unsigned int base;
+    double clk;
+    volatile unsigned int * cmr_p;
+    volatile unsigned int * ra_p;
+    volatile unsigned int * rb_p;
+    volatile unsigned int * rc_p;
+
+    if ((ch < 0) || (ch >= TC_CHANS))
+        return REGD_ST_BAD_OP;
+    if (0 == hz)
+        return REGD_ST_RANGE;
+    base = tc_addr(ch, 0);
+    if ((NULL == ((cmr_p = srv_mmp(sp, base + TC_CMR_OFF)))) ||
+        (NULL == ((ra_p = srv_mmp(sp, base + TC_RA_OFF)))) ||
+        (NULL == ((rb_p = srv_mmp(sp, base + TC_RB_OFF)))) ||
+        (NULL == ((rc_p = srv_mmp(sp, base + TC_RC_OFF)))))
+        return REGD_ST_IO;
+    clk = tc_tcclks_hz(*cmr_p & TC_CMR_TCCLKS_MSK,
+                       (double)TIMER_CLOCK1 / (sp->gckdiv[ch / 3] + 1));
+    if (clk <= 0.0)
+        return REGD_ST_RANGE;   /* XC0, XC1 or XC2: rate unknown */
+    if (tc_calc_rc(clk, hz, &rc))
+        return REGD_ST_RANGE;
+    old_rc = *rc_p;
+    old_ra = *ra_p;
+    /* RA is the space, RB (RC - RA) the mark */
+    if (old_rc && (old_ra < old_rc))
+        ra = tc_calc_ra(rc, old_rc - old_ra, old_ra);
+    else
+        ra = tc_calc_ra(rc, 1, 1);
+    if (0 == ra)
+        ra = 1;
+    else if (ra >= rc)
+        ra = rc - 1;
+    if (rc > old_rc) {
+        *rc_p = rc;
+        *ra_p = ra;
+        *rb_p = rc - ra;
+    } else {
+        *ra_p = ra;
+        *rb_p = rc - ra;
+        *rc_p = rc;
+    }
+    *rcp = rc;
+    return REGD_ST_GOOD;
+}
+
+static void
+delay_us(unsigned int us)
+{
+    struct timespec request;
+
+    request.tv_sec = us / 1000000;
+    request.tv_nsec = (us % 1000000) * 1000;
+    while ((nanosleep(&request, &request) < 0) && (EINTR == errno) &&
+           (! stop_sig))
+        ;
+}
+
+/* Does one operation, placing a value read (if any) in rop->val. Returns
+ * REGD_ST_GOOD or the reason it was not done. */
+static int
+do_op(struct srv_t * sp, struct regd_op * rop)
+{
+    unsigned int u;
+    uint64_t vals;
+    volatile unsigned int * mmp;
+
+    switch (rop->op) {
+    case REGD_OP_READ:
+    case REGD_OP_WRITE:
+    case REGD_OP_RMW:
+        if ((rop->addr < DEF_MIN_ADDR) || (rop->addr & 0x3))
+            return REGD_ST_BAD_ADDR;
+        if (NULL == ((mmp = srv_mmp(sp, rop->addr))))
+            return REGD_ST_IO;
+        if (REGD_OP_WRITE == rop->op)
+            *mmp = rop->val;
+        else if (REGD_OP_READ == rop->op)
+            rop->val = *mmp;
+        else {
+            u = *mmp;
+            *mmp = (u & ~rop->mask) | (rop->val & rop->mask);
+            rop->val = u;
+        }
+        break;
+    case REGD_OP_PIO_READ:
+        if (rop->arg >= PIO_BANKS_SAMA5D2)
+            return REGD_ST_BAD_OP;
+        if (NULL == ((mmp = srv_mmp(sp, pio_addr(rop->arg, PIO_PDSR_OFF)))))
+            return REGD_ST_IO;
+        rop->val = *mmp;
+        break;
+    case REGD_OP_PIO_SET:
+        if (rop->arg >= PIO_BANKS_SAMA5D2)
+            return REGD_ST_BAD_OP;
+        if (rop->mask & rop->val) {
+            mmp = srv_mmp(sp, pio_addr(rop->arg, PIO_SODR_OFF));
+            if (NULL == mmp)
+                return REGD_ST_IO;
+            *mmp = rop->mask & rop->val;
+        }
+        if (rop->mask & ~rop->val) {
+            mmp = srv_mmp(sp, pio_addr(rop->arg, PIO_CODR_OFF));
+            if (NULL == mmp)
+                return REGD_ST_IO;
+            *mmp = rop->mask & ~rop->val;
+        }
+        break;
+    case REGD_OP_GPIO_GET:
+        if (sp->in_fd < 0)
+            return REGD_ST_NO_LINES;
+        if (gc_get_values(sp->in_fd, sp->in_num, &vals))
+            return REGD_ST_IO;
+        rop->val = (unsigned int)vals;
+        break;
+    case REGD_OP_GPIO_SET:
+        if (sp->out_fd < 0)
+            return REGD_ST_NO_LINES;
+        if (gc_set_values(sp->out_fd, rop->mask, rop->val))
+            return REGD_ST_IO;
+        break;
+    case REGD_OP_TC_FREQ:
+        return tc_freq(sp, rop->arg, rop->val, &rop->val);
+    case REGD_OP_DELAY_US:
+        if ((rop->val > REGD_MAX_DELAY_US) ||
+            ((sp->req_delay_us + rop->val) > REGD_MAX_REQ_DELAY_US))
+            return REGD_ST_RANGE;
+        sp->req_delay_us += rop->val;
+        delay_us(rop->val);
+        break;
+    default:
+        return REGD_ST_BAD_OP;
+    }
+    return REGD_ST_GOOD;
+}
+
+/* Checks the request of 'len' bytes in *mp and does its ops until one
+ * fails, turning *mp into the response. Returns length of response. */
+static int
+do_req(struct srv_t * sp, struct regd_msg * mp, int len)
+{
+    int k, n, res;
+
+    ++sp->reqs;
+    if ((len < (int)sizeof(mp->hdr)) || (REGD_MAGIC != mp->hdr.magic) ||
+        (REGD_VERSION != mp->hdr.version) ||
+        (mp->hdr.num_ops > REGD_MAX_OPS) ||
+        (len != (int)(sizeof(mp->hdr) +
+                      (mp->hdr.num_ops * sizeof(struct regd_op))))) {
+        if (len < (int)sizeof(mp->hdr))
+            memset(mp, 0, sizeof(mp->hdr));
+        mp->hdr.magic = REGD_MAGIC;
+        mp->hdr.version = REGD_VERSION;
+        mp->hdr.num_ops = 0;
+        mp->hdr.status = REGD_ST_BAD_REQ;
+        return sizeof(mp->hdr);
+    }
+    n = mp->hdr.num_ops;
+    res = REGD_ST_GOOD;
+    sp->req_delay_us = 0;
+    for (k = 0; k < n; ++k) {
+        if (REGD_ST_GOOD != (res = do_op(sp, mp->op_arr + k)))
+            break;
+    }
+    sp->ops += k;
+    if (res && sp->verbose)
+        cl_print(LOG_WARNING, "op %d [%u] of request tag=%u: %s\n", k,
+                 mp->op_arr[k].op, mp->hdr.tag, st_str(res));
+    mp->hdr.num_ops = k;
+    mp->hdr.status = res;
+    return len;
+}
+
+/* Binds SOCK (removing a stale one left by a daemon that did not exit
+ * cleanly). Returns listening fd, or -1 if problem. */
+static int
+srv_listen(const char * sock_path, const char * group)
+{
+    int fd, res;
+    mode_t old_mask;
+    gid_t gid = (gid_t)-1;
+    char * cp;
+    struct group * grp;
+    struct stat st;
+    struct sockaddr_un sun;
+
+    if (strlen(sock_path) >= sizeof(sun.sun_path)) {
+        pr2serr("socket name too long: %s\n", sock_path);
+        return -1;
+    }
+    if (group) {
+        gid = (gid_t)strtoul(group, &cp, 10);
+        if ((cp == group) || *cp) {
+            if (NULL == (grp = getgrnam(group))) {
+                pr2serr("group '%s' not found\n", group);
+                return -1;
+            }
+            gid = grp->gr_gid;
+        }
+    }
+    if ((fd = regd_connect(sock_path)) >= 0) {
+        close(fd);
+        pr2serr("a daemon is already serving %s\n", sock_path);
+        return -1;
+    }
+    /* only ever remove a socket: '-s' may name anything */
+    if (0 == lstat(sock_path, &st)) {
+        if (! S_ISSOCK(st.st_mode)) {
+            pr2serr("%s: not a socket\n", sock_path);
+            return -1;
+        }
+        unlink(sock_path);
+    }
+    if ((fd = socket(AF_UNIX, SOCK_SEQPACKET, 0)) < 0) {
+        perror("socket");
+        return -1;
+    }
+    memset(&sun, 0, sizeof(sun));
+    sun.sun_family = AF_UNIX;
+    strcpy(sun.sun_path, sock_path);
+    /* the daemon writes SoC registers for its clients so never rely on
+     * the inherited umask: no access for others from bind() onwards */
+    old_mask = umask(0177);
+    res = bind(fd, (struct sockaddr *)&sun, sizeof(sun));
+    umask(old_mask);
+    if ((res < 0) || (listen(fd, MAX_CLIENTS) < 0)) {
+        perror("bind/listen");
+        pr2serr("  [%s]\n", sock_path);
+        close(fd);
+        return -1;
+    }
+    if (group && ((chown(sock_path, (uid_t)-1, gid) < 0) ||
+                  (chmod(sock_path, 0660) < 0))) {
+        perror("chown/chmod");
+        pr2serr("  [%s, group %s]\n", sock_path, group);
+        unlink(sock_path);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* SO_PEERCRED check of a new connection: root and this daemon's effective
+ * user are allowed; with '-g' the socket's group permission has already
+ * admitted its members (SO_PEERCRED only gives the primary group, so
+ * leave supplementary groups to connect()). Returns 1 if allowed. */
+static int
+srv_peer_ok(int cfd, const char * group)
+{
+    struct ucred uc;
+    socklen_t len = sizeof(uc);
+
+    if (getsockopt(cfd, SOL_SOCKET, SO_PEERCRED, &uc, &len) < 0) {
+        cl_print(LOG_WARNING, "SO_PEERCRED: %s\n", strerror(errno));
+        return 0;
+    }
+    if ((0 == uc.uid) || (geteuid() == uc.uid) || group)
+        return 1;
+    cl_print(LOG_WARNING, "refused client pid=%d uid=%d\n", (int)uc.pid,
+             (int)uc.uid);
+    return 0;
+}
+
+/* Requests the '-i' or '-o' lines from chip_fd. Returns line fd (and
+ * their number in *nump) or -1 if problem. */
+static int
+srv_lines(int chip_fd, const char * list, unsigned int flags, int * nump,
+          int verbose)
+{
+    int n;
+    unsigned int offsets[GC_MAX_LINES];
+
+    if ((n = gc_parse_lines(list, offsets, GC_MAX_LINES)) < 1)
+        return -1;
+    if (n > 32) {
+        pr2serr("at most 32 lines in each of '-i' and '-o'\n");
+        return -1;
+    }
+    *nump = n;
+    return gc_request_lines(chip_fd, offsets, n, flags, 0, 0, verbose);
+}
+
+/* Daemon: sets up *sp, then serves requests from up to MAX_CLIENTS
+ * connections until SIGTERM or SIGINT. */
+static int
+run_daemon(const struct opts_t * op)
+{
+    int k, n, len, chip_fd, nfds, cfd;
+    int lfd = -1;
+    int res = 1;
+    struct srv_t srv;
+    struct srv_t * sp = &srv;
+    struct pollfd pfd_arr[MAX_CLIENTS + 1];
+    struct sigaction sa;
+    static struct regd_msg msg;
+
+    memset(sp, 0, sizeof(*sp));
+    sp->in_fd = -1;
+    sp->out_fd = -1;
+    sp->verbose = op->verbose;
+    init_mmap_state(&sp->mstate, op->verbose);
+    if ((sp->mem_fd = open(DEV_MEM, O_RDWR | O_SYNC)) < 0) {
+        perror("open of " DEV_MEM " failed");
+        return 1;
+    }
+    /* map the pages most requests need now, so none pays for it later */
+    if (read_gckdiv(sp) || (NULL == srv_mmp(sp, PIO_BASE)) ||
+        (NULL == srv_mmp(sp, TCB0_BASE)) || (NULL == srv_mmp(sp, TCB1_BASE)))
+        goto clean_up;
+    if (op->in_list || op->out_list) {
+        if ((chip_fd = gc_open_chip(op->chip, NULL, op->verbose)) < 0)
+            goto clean_up;
+        if (op->in_list)
+            sp->in_fd = srv_lines(chip_fd, op->in_list, GC_FL_INPUT,
+                                  &sp->in_num, op->verbose);
+        if (op->out_list)
+            sp->out_fd = srv_lines(chip_fd, op->out_list, GC_FL_OUTPUT,
+                                   &sp->out_num, op->verbose);
+        close(chip_fd);
+        if ((op->in_list && (sp->in_fd < 0)) ||
+            (op->out_list && (sp->out_fd < 0)))
+            goto clean_up;
+    }
+    if ((lfd = srv_listen(op->sock_path, op->group)) < 0)
+        goto clean_up;
+    if (op->verbose)
+        pr2serr("serving %s, GCKDIV=%d,%d, %d input and %d output GPIO "
+                "lines\n", op->sock_path, sp->gckdiv[0], sp->gckdiv[1],
+                sp->in_num, sp->out_num);
+    if (! op->foreground)
+        cl_daemonize("a5d2_regd", 0, 1, op->verbose);
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = stop_handler;
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    pfd_arr[0].fd = lfd;
+    pfd_arr[0].events = POLLIN;
+    nfds = 1;
+    while (! stop_sig) {
+        if (poll(pfd_arr, nfds, -1) < 0) {
+            if (EINTR == errno)
+                continue;
+            cl_print(LOG_ERR, "poll: %s\n", strerror(errno));
+            break;
+        }
+        for (k = 1; k < nfds; ++k) {
+            if (0 == pfd_arr[k].revents)
+                continue;
+            len = recv(pfd_arr[k].fd, &msg, sizeof(msg), 0);
+            if (len > 0) {
+                n = do_req(sp, &msg, len);
+                if (send(pfd_arr[k].fd, &msg, n, MSG_NOSIGNAL) == n)
+                    continue;
+            }
+            /* client closed (or failed): drop it */
+            close(pfd_arr[k].fd);
+            pfd_arr[k--] = pfd_arr[--nfds];
+        }
+        if (pfd_arr[0].revents & POLLIN) {
+            if ((cfd = accept(lfd, NULL, NULL)) < 0)
+                continue;
+            if (! srv_peer_ok(cfd, op->group))
+                close(cfd);
+            else if (nfds > MAX_CLIENTS) {
+                cl_print(LOG_WARNING, "more than %d clients, closing "
+                         "newest\n", MAX_CLIENTS);
+                close(cfd);
+            } else {
+                pfd_arr[nfds].fd = cfd;
+                pfd_arr[nfds].events = POLLIN;
+                pfd_arr[nfds++].revents = 0;
+            }
+        }
+    }
+    for (k = 1; k < nfds; ++k)
+        close(pfd_arr[k].fd);
+    unlink(op->sock_path);
+    cl_print(LOG_INFO, "a5d2_regd stopped by signal %d after %lu requests "
+             "(%lu ops)\n", (int)stop_sig, sp->reqs, sp->ops);
+    res = 0;
+clean_up:
+    if (lfd >= 0)
+        close(lfd);
+    if (sp->in_fd >= 0)
+        close(sp->in_fd);
+    if (sp->out_fd >= 0)
+        close(sp->out_fd);
+    release_mmap_state(&sp->mstate);
+    close(sp->mem_fd);
+    return res;
+}
+
+/* Decodes up to 'max' comma separated numbers after the OP name, hex
+ * unless bit k of 'dec_mask' is set. If 'bank_first' the first is a PIO
+ * bank letter (e.g. 'C') or number. Returns number decoded or -1 if
+ * problem. */
+static int
+get_nums(const char * cp, unsigned int * arr, int max, int dec_mask,
+         int bank_first)
+{
+    int k;
+    unsigned long ul;
+    char * endp;
+
+    for (k = 0; (k < max) && (',' == *cp); ++k) {
+        ++cp;
+        if ((0 == k) && bank_first && isalpha((unsigned char)*cp)) {
+            ul = toupper((unsigned char)*cp) - 'A';
+            endp = (char *)cp + 1;
+        } else {
+            errno = 0;
+            ul = strtoul(cp, &endp, ((dec_mask >> k) & 1) ? 10 : 16);
+            if (errno || (endp == cp) || (ul > UINT_MAX))
+                return -1;
+        }
+        arr[k] = (unsigned int)ul;
+        cp = endp;
+    }
+    return (*cp && (! isspace((unsigned char)*cp))) ? -1 : k;
+}
+
+static struct op_name_t {
+    const char * name;
+    int op;
+    int num_args;
+    int dec_mask;               /* bit k set: k-th argument decimal */
+    int bank_first;             /* first argument is PIO bank */
+} op_name_arr[] = {
+    {"r", REGD_OP_READ, 1, 0, 0},
+    {"w", REGD_OP_WRITE, 2, 0, 0},
+    {"m", REGD_OP_RMW, 3, 0, 0},
+    {"pr", REGD_OP_PIO_READ, 1, 0, 1},
+    {"ps", REGD_OP_PIO_SET, 3, 0, 1},
+    {"gg", REGD_OP_GPIO_GET, 0, 0, 0},
+    {"gs", REGD_OP_GPIO_SET, 2, 0, 0},
+    {"tc", REGD_OP_TC_FREQ, 2, 0x3, 0},
+    {"d", REGD_OP_DELAY_US, 1, 0x1, 0},
+    {NULL, 0, 0, 0, 0},
+};
+
+/* Parses one client OP (e.g. "w,fc038010,80") into *rop. Returns 0 if
+ * okay, else 1 . */
+static int
+parse_op(const char * cp, struct regd_op * rop)
+{
+    int n, len;
+    unsigned int a[3];
+    const struct op_name_t * onp;
+
+    len = strcspn(cp, ", \t\r\n");
+    for (onp = op_name_arr; onp->name; ++onp) {
+        if ((len == (int)strlen(onp->name)) &&
+            (0 == strncmp(cp, onp->name, len)))
+            break;
+    }
+    if (NULL == onp->name) {
+        pr2serr("unknown OP: %s\n", cp);
+        return 1;
+    }
+    n = get_nums(cp + len, a, 3, onp->dec_mask, onp->bank_first);
+    if (n != onp->num_args) {
+        pr2serr("OP '%s' expects %d argument%s: %s\n", onp->name,
+                onp->num_args, ((1 == onp->num_args) ? "" : "s"), cp);
+        return 1;
+    }
+    memset(rop, 0, sizeof(*rop));
+    rop->op = onp->op;
+    switch (rop->op) {
+    case REGD_OP_READ:
+        rop->addr = a[0];
+        break;
+    case REGD_OP_WRITE:
+        rop->addr = a[0];
+        rop->val = a[1];
+        break;
+    case REGD_OP_RMW:
+        rop->addr = a[0];
+        rop->mask = a[1];
+        rop->val = a[2];
+        break;
+    case REGD_OP_PIO_READ:
+        rop->arg = a[0];
+        break;
+    case REGD_OP_PIO_SET:
+        rop->arg = a[0];
+        rop->mask = a[1];
+        rop->val = a[2];
+        break;
+    case REGD_OP_GPIO_SET:
+        rop->mask = a[0];
+        rop->val = a[1];
+        break;
+    case REGD_OP_TC_FREQ:
+        rop->arg = a[0];
+        rop->val = a[1];
+        break;
+    case REGD_OP_DELAY_US:
+        rop->val = a[0];
+        break;
+    }
+    return 0;
+}
+
+/* Reads OPs from file 'fname', one per line, appending to mp->op_arr[].
+ * Returns 0 if okay, else 1 . */
+static int
+read_op_file(const char * fname, struct regd_msg * mp)
+{
+    int k;
+    int res = 1;
+    char * cp;
+    FILE * fp;
+    char b[MAX_OP_LINE];
+
+    if (NULL == (fp = (('-' == fname[0]) && ('\0' == fname[1])) ? stdin :
+                      fopen(fname, "r"))) {
+        pr2serr("unable to open %s\n", fname);
+        return 1;
+    }
+    for (k = 1; fgets(b, sizeof(b), fp); ++k) {
+        if ((cp = strchr(b, '#')))
+            *cp = '\0';
+        for (cp = b; isspace((unsigned char)*cp); ++cp)
+            ;
+        if ('\0' == *cp)
+            continue;
+        if (mp->hdr.num_ops >= REGD_MAX_OPS) {
+            pr2serr("%s: more than %d OPs\n", fname, REGD_MAX_OPS);
+            goto fini;
+        }
+        if (parse_op(cp, mp->op_arr + mp->hdr.num_ops)) {
+            pr2serr("  at line %d of %s\n", k, fname);
+            goto fini;
+        }
+        ++mp->hdr.num_ops;
+    }
+    res = 0;
+fini:
+    if (stdin != fp)
+        fclose(fp);
+    return res;
+}
+
+static long long
+ts_diff_ns(const struct timespec * ap, const struct timespec * bp)
+{
+    return ((long long)(bp->tv_sec - ap->tv_sec) * 1000000000LL) +
+           (bp->tv_nsec - ap->tv_nsec);
+}
+
+/* Client: sends the batch in *mp op->repeat times, printing values read
+ * by the first one. Returns 0 if okay, else 1 . */
+static int
+run_client(const struct opts_t * op, struct regd_msg * mp)
+{
+    int k, fd, res, num;
+    long long ns;
+    long long min_ns = 0;
+    long long max_ns = 0;
+    long long tot_ns = 0;
+    static struct regd_msg req;
+    struct timespec t0, t1;
+
+    if ((fd = regd_connect(op->sock_path)) < 0) {
+        pr2serr("unable to connect to %s: %s\n", op->sock_path,
+                strerror(errno));
+        return 1;
+    }
+    num = mp->hdr.num_ops;
+    req = *mp;
+    for (k = 0; k < op->repeat; ++k) {
+        if (k > 0)
+            *mp = req;
+        mp->hdr.tag = k;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        res = regd_xfer(fd, mp);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        if (res < 0) {
+            pr2serr("exchange with %s failed: %s\n", op->sock_path,
+                    strerror(errno));
+            goto fini;
+        }
+        if (REGD_ST_GOOD != res) {
+            pr2serr("OP %d failed: %s\n", mp->hdr.num_ops + 1, st_str(res));
+            goto fini;
+        }
+        ns = ts_diff_ns(&t0, &t1);
+        if ((0 == k) || (ns < min_ns))
+            min_ns = ns;
+        if (ns > max_ns)
+            max_ns = ns;
+        tot_ns += ns;
+        if (0 == k) {
+            for (res = 0; res < num; ++res) {
+                switch (mp->op_arr[res].op) {
+                case REGD_OP_READ:
+                case REGD_OP_RMW:
+                case REGD_OP_PIO_READ:
+                case REGD_OP_GPIO_GET:
+                case REGD_OP_TC_FREQ:
+                    printf("%x\n", mp->op_arr[res].val);
+                    break;
+                default:
+                    break;
+                }
+            }
+        }
+    }
+    if ((op->repeat > 1) || op->verbose)
+        pr2serr("%d exchange%s of %d OP%s, latency (us): min=%.1f "
+                "mean=%.1f max=%.1f\n", op->repeat,
+                ((1 == op->repeat) ? "" : "s"), num,
+                ((1 == num) ? "" : "s"), min_ns / 1000.0,
+                (tot_ns / 1000.0) / op->repeat, max_ns / 1000.0);
+    close(fd);
+    return 0;
+fini:
+    close(fd);
+    return 1;
+}
+
+
+int
+main(int argc, char * argv[])
+{
+    int opt, n;
+    struct opts_t opts;
+    struct opts_t * op;
+    static struct regd_msg msg;
+    static char abs_sock[PATH_MAX];
+
+    op = &opts;
+    memset(op, 0, sizeof(opts));
+    op->sock_path = REGD_DEF_SOCK;
+    op->chip = GC_DEF_CHIP;
+    op->repeat = 1;
+    while ((opt = getopt(argc, argv, "C:Df:Fg:hi:n:o:s:vV")) != -1) {
+        switch (opt) {
+        case 'C':
+            op->chip = optarg;
+            break;
+        case 'D':
+            ++op->do_daemon;
+            break;
+        case 'f':
+            op->fname = optarg;
+            break;
+        case 'F':
+            ++op->foreground;
+            break;
+        case 'g':
+            op->group = optarg;
+            break;
+        case 'h':
+            usage();
+            exit(EXIT_SUCCESS);
+        case 'i':
+            op->in_list = optarg;
+            break;
+        case 'n':
+            if ((1 != sscanf(optarg, "%d", &op->repeat)) ||
+                (op->repeat < 1)) {
+                pr2serr("-n expects a number (1 or more)\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'o':
+            op->out_list = optarg;
+            break;
+        case 's':
+            op->sock_path = optarg;
+            break;
+        case 'v':
+            ++op->verbose;
+            break;
+        case 'V':
+            printf("%s\n", version_str);
+            exit(EXIT_SUCCESS);
+        default: /* '?' */
+            usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (op->do_daemon) {
+        if ((optind < argc) || op->fname) {
+            pr2serr("with '-D' no OPs are expected\n");
+            usage();
+            exit(EXIT_FAILURE);
+        }
+        if ('/' != op->sock_path[0]) {
+            /* cl_daemonize() does chdir("/"), the unlink() at exit must
+             * still find SOCK */
+            if (NULL == getcwd(abs_sock, sizeof(abs_sock))) {
+                perror("getcwd");
+                exit(EXIT_FAILURE);
+            }
+            n = strlen(abs_sock);
+            if (snprintf(abs_sock + n, sizeof(abs_sock) - n, "/%s",
+                         op->sock_path) >= (int)(sizeof(abs_sock) - n)) {
+                pr2serr("socket name too long: %s\n", op->sock_path);
+                exit(EXIT_FAILURE);
+            }
+            op->sock_path = abs_sock;
+        }
+        return run_daemon(op) ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+    if (op->in_list || op->out_list || op->foreground || op->group) {
+        pr2serr("'-F', '-g', '-i' and '-o' only apply to the daemon "
+                "('-D')\n");
+        exit(EXIT_FAILURE);
+    }
+    if (op->fname && read_op_file(op->fname, &msg))
+        exit(EXIT_FAILURE);
+    for ( ; optind < argc; ++optind) {
+        if (msg.hdr.num_ops >= REGD_MAX_OPS) {
+            pr2serr("more than %d OPs\n", REGD_MAX_OPS);
+            exit(EXIT_FAILURE);
+        }
+        if (parse_op(argv[optind], msg.op_arr + msg.hdr.num_ops))
+            exit(EXIT_FAILURE);
+        ++msg.hdr.num_ops;
+    }
+    if (0 == msg.hdr.num_ops) {
+        pr2serr("no OPs given, please give '-D', '-f FILE' or OP(s)\n");
+        usage();
+        exit(EXIT_FAILURE);
+    }
+    return run_client(op, &msg) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2026 Douglas Gilbert.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+#ifndef A5D2_REGD_H
+#define A5D2_REGD_H
+
+/*****************************************************************
+ * a5d2_regd.h
+ *
+ * Request and response layout used over the Unix domain socket of
+ * 'a5d2_regd -D'. The daemon keeps /dev/mem pages mapped and GPIO lines
+ * requested, so a client pays one send() and one recv() for a whole
+ * batch of operations rather than a process start, open(/dev/mem) and
+ * mmap() per operation. The socket is SOCK_SEQPACKET so each request is
+ * one message: a struct regd_hdr followed by hdr.num_ops struct regd_op.
+ * The response has the same layout: the ops are echoed back with 'val'
+ * holding what was read, hdr.status is REGD_ST_GOOD or the reason the
+ * op at index hdr.num_ops failed (ops after that one are not done).
+ * All fields are in host byte order.
+ *
+ ****************************************************/
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define REGD_MAGIC 0x44474552           /* "REGD" */
+#define REGD_VERSION 1
+#define REGD_DEF_SOCK "/run/a5d2_regd.sock"
+
+#define REGD_MAX_OPS 256
+
+/* struct regd_op::op values. 'arg' is the PIO bank (0 for PA to 3 for
+ * PD) or TC channel (0 to 5) where relevant. */
+#define REGD_OP_READ 1          /* val <- *addr */
+#define REGD_OP_WRITE 2         /* *addr <- val */
+#define REGD_OP_RMW 3           /* *addr <- (*addr & ~mask) | (val & mask),
+                                 * val <- prior value */
+#define REGD_OP_PIO_READ 4      /* val <- PIO_PDSR of bank 'arg' */
+#define REGD_OP_PIO_SET 5       /* bank 'arg' lines in mask set to val
+                                 * (one PIO_SODR and one PIO_CODR write) */
+#define REGD_OP_GPIO_GET 6      /* val <- daemon's '-i' lines, bit k for the
+                                 * k-th line of that list */
+#define REGD_OP_GPIO_SET 7      /* daemon's '-o' lines in mask set to val */
+#define REGD_OP_TC_FREQ 8       /* TC channel 'arg' to val Hz keeping its
+                                 * TCCLKS and mark space ratio, val <- RC */
+#define REGD_OP_DELAY_US 9      /* wait val microseconds */
+
+/* The daemon serves one client at a time so bound how long a batch can
+ * keep the others waiting */
+#define REGD_MAX_DELAY_US 1000000       /* per REGD_OP_DELAY_US */
+#define REGD_MAX_REQ_DELAY_US 2000000   /* sum over one request */
+
+/* struct regd_hdr::status values */
+#define REGD_ST_GOOD 0
+#define REGD_ST_BAD_REQ 1       /* bad magic, version or length */
+#define REGD_ST_BAD_OP 2        /* unknown op or bad 'arg' */
+#define REGD_ST_BAD_ADDR 3      /* below minimum address or not modulo 4 */
+#define REGD_ST_NO_LINES 4      /* no GPIO lines of that direction held */
+#define REGD_ST_RANGE 5         /* TC frequency not possible with TCCLKS,
+                                 * or delay above the limits */
+#define REGD_ST_IO 6            /* mmap() or GPIO ioctl failed */
+
+struct regd_hdr {
+    uint32_t magic;             /* REGD_MAGIC */
+    uint16_t version;           /* REGD_VERSION */
+    uint16_t num_ops;           /* response: number of ops done */
+    uint32_t tag;               /* echoed back, for the client's use */
+    int32_t status;             /* REGD_ST_*, 0 in requests */
+};
+
+struct regd_op {
+    uint16_t op;                /* REGD_OP_* */
+    uint16_t arg;
+    uint32_t addr;
+    uint32_t mask;
+    uint32_t val;
+};
+
+struct regd_msg {
+    struct regd_hdr hdr;
+    struct regd_op op_arr[REGD_MAX_OPS];
+};
+
+/* Connects to the daemon listening on 'sock_path'. Returns socket fd or
+ * -1 (and errno set) if problem. */
+static inline int
+regd_connect(const char * sock_path)
+{
+    int fd;
+    struct sockaddr_un sun;
+
+    if (strlen(sock_path) >= sizeof(sun.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    if ((fd = socket(AF_UNIX, SOCK_SEQPACKET, 0)) < 0)
+        return -1;
+    memset(&sun, 0, sizeof(sun));
+    sun.sun_family = AF_UNIX;
+    strcpy(sun.sun_path, sock_path);
+    if (connect(fd, (struct sockaddr *)&sun, sizeof(sun)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* Sends the request in *mp (mp->hdr.num_ops ops; magic, version and
+ * status are filled in here) and waits for its response which replaces
+ * the contents of *mp. Returns mp->hdr.status (REGD_ST_*) or -1 (and
+ * errno set) if the exchange failed. */
+static inline int
+regd_xfer(int fd, struct regd_msg * mp)
+{
+    ssize_t n;
+    size_t len;
+
+    mp->hdr.magic = REGD_MAGIC;
+    mp->hdr.version = REGD_VERSION;
+    mp->hdr.status = REGD_ST_GOOD;
+    len = sizeof(mp->hdr) + (mp->hdr.num_ops * sizeof(struct regd_op));
+    if (send(fd, mp, len, MSG_NOSIGNAL) != (ssize_t)len)
+        return -1;
+    n = recv(fd, mp, sizeof(*mp), 0);
+    if (n < (ssize_t)sizeof(mp->hdr)) {
+        if (n >= 0)
+            errno = EPROTO;
+        return -1;
+    }
+    return mp->hdr.status;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2026 Douglas Gilbert.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+/*****************************************************************
+ * a5d2_regs.c
+ *
+ * SAMA5D2 TC clock and RC/RA arithmetic. See a5d2_regs.h .
+ *
+ ****************************************************/
+
+#include <stdint.h>
+#include <limits.h>
+
+#include "a5d2_regs.h"
+
+
+/* TIMER_CLOCK1 to TIMER_CLOCK4 divide the generic clock by these */
+static const int tcclks_div_arr[] = {1, 8, 32, 128};
+
+
+double
+tc_tcclks_hz(int tcclks, double tclock1_hz)
+{
+    if ((tcclks >= 0) && (tcclks < TC_TCCLKS_SLOW))
+        return tclock1_hz / tcclks_div_arr[tcclks];
+    else if (TC_TCCLKS_SLOW == tcclks)
+        return TIMER_CLOCK5;
+    return 0.0;
+}
+
+int
+tc_calc_rc(double clk_hz, double want_hz, unsigned int * rcp)
+{
+    unsigned long long rc;
+
+    if ((want_hz <= 0.0) || ((clk_hz / want_hz) < 2.0))
+        return 1;
+    rc = (unsigned long long)((clk_hz / want_hz) + 0.5);
+    if (rc > UINT_MAX)
+        return 1;
+    *rcp = (unsigned int)rc;
+    return 0;
+}
+
+unsigned int
+tc_calc_ra(unsigned int rc, unsigned int mark, unsigned int space)
+{
+    uint64_t mps = (uint64_t)mark + space;
+
+    if (0 == mps)
+        return 0;
+    if (mark >= space)
+        return (unsigned int)(((uint64_t)rc * space) / mps);
+    /* rounds the space up, so the (smaller) mark down */
+    return rc - (unsigned int)(((uint64_t)rc * mark) / mps);
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2026 Douglas Gilbert.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+#ifndef A5D2_REGS_H
+#define A5D2_REGS_H
+
+/*****************************************************************
+ * a5d2_regs.h
+ *
+ * SAMA5D2 PIO, PMC and TC register addresses shared by the utilities
+ * that access them via /dev/mem (see mmap_regs.h), plus the TC clock and
+ * RC/RA arithmetic that a5d2_tc_freq and a5d2_regd both need.
+ *
+ ****************************************************/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* PIO: 4 banks (PIOA to PIOD) of 32 lines, 0x40 bytes apart */
+#define PIO_BANKS_SAMA5D2 4
+#define PIO_BASE 0xfc038000
+#define PIO_BANK_STRIDE 0x40
+#define PIO_MSKR_OFF 0x0        /* Mask (rw) */
+#define PIO_CFGR_OFF 0x4        /* Configuration (rw) */
+#define PIO_PDSR_OFF 0x8        /* Pin data status (ro) */
+#define PIO_LOCKSR_OFF 0xc      /* Lock status (ro) */
+#define PIO_SODR_OFF 0x10       /* Set output data (wo) */
+#define PIO_CODR_OFF 0x14       /* Clear output data (wo) */
+#define PIO_ODSR_OFF 0x18       /* Output data status (rw) */
+#define PIO_IMR_OFF 0x28        /* Interrupt mask (ro) */
+#define PIO_WPMR 0xfc0385e0     /* Write protection mode (rw) */
+#define CFGR_FUNC_MSK 0x7
+#define CFGR_DIR_MSK (1 << 8)   /* 0 -> pure input; 1 -> output */
+#define CFGR_OPD_MSK (1 << 14)  /* open drain (like open collector) */
+#define CFGR_PCFS_MSK (1 << 29) /* physical configuration freezes status */
+
+/* PMC: each TCB has its own peripheral identifier, hence clock */
+#define PMC_SCSR   0xf0014008   /* system clock status (ro) */
+#define PMC_PCER0  0xf0014010   /* peripheral clock enable, reg 0 */
+#define PMC_PCDR0  0xf0014014   /* peripheral clock disable, reg 0 */
+#define PMC_PCSR0  0xf0014018   /* peripheral clock status, reg 0 */
+#define PMC_PCER1  0xf0014100   /* peripheral clock enable, reg 1 */
+#define PMC_PCDR1  0xf0014104   /* peripheral clock disable, reg 1 */
+#define PMC_PCSR1  0xf0014108   /* peripheral clock status, reg 1 */
+#define PMC_PCR    0xf001410c   /* peripheral control register */
+#define PMC_PCR_GCKDIV_MSK 0xff00000
+#define PMC_PCR_GCKDIV_SHIFT 20
+#define SAMA5D2_PERI_ID_TCB0 35 /* contains TC0, TC1 and TC2 */
+#define SAMA5D2_PERI_ID_TCB1 36 /* contains TC3, TC4 and TC5 */
+
+/* TC: 2 blocks (TCB0 and TCB1) of 3 channels, 0x40 bytes apart */
+#define TC_CHANS 6
+#define TCB0_BASE 0xf800c000
+#define TCB1_BASE 0xf8010000
+#define TC_CHAN_STRIDE 0x40
+#define TC_CCR_OFF 0x0          /* offsets from a channel's base */
+#define TC_CMR_OFF 0x4
+#define TC_CV_OFF 0x10
+#define TC_RA_OFF 0x14
+#define TC_RB_OFF 0x18
+#define TC_RC_OFF 0x1c
+#define TC_SR_OFF 0x20
+#define TC_IMR_OFF 0x2c
+#define TC_EMR_OFF 0x30
+#define TC_BCR_OFF 0xc0         /* offsets from a block's base */
+#define TC_WPMR_OFF 0xe4
+
+#define TC_CCR_SWTRG 4          /* Software trigger */
+#define TC_CCR_CLKDIS 2         /* Clock disable */
+#define TC_CCR_CLKEN 1          /* Clock enable, if TC_CCR_CLKDIS not given */
+#define TC_BCR_SYNC 1           /* software trigger to all 3 channels */
+#define TC_CMR_TCCLKS_MSK 0x7
+#define TC_TCCLKS_SLOW 4        /* TIMER_CLOCK5 */
+
+/* TIMER_CLOCK1 is the generic clock (per TCB block) from the PMC which is
+ * the master clock divided by (GCKDIV + 1); TIMER_CLOCK5 is the slow
+ * clock. */
+#define TIMER_CLOCK1 166000000  /* master clock is 166 MHz */
+#define TIMER_CLOCK5 32768
+
+/* Address of the register at 'off' in PIO bank 'bank' (0 for PIOA) */
+static inline unsigned int
+pio_addr(int bank, unsigned int off)
+{
+    return PIO_BASE + (bank * PIO_BANK_STRIDE) + off;
+}
+
+/* Base address of TC block 'tcb' (0 or 1) */
+static inline unsigned int
+tcb_addr(int tcb)
+{
+    return tcb ? TCB1_BASE : TCB0_BASE;
+}
+
+/* Address of the register at 'off' in TC channel 'ch' (0 to 5) */
+static inline unsigned int
+tc_addr(int ch, unsigned int off)
+{
+    return tcb_addr(ch / 3) + ((ch % 3) * TC_CHAN_STRIDE) + off;
+}
+
+/* Returns the rate, in Hz, that TCCLKS 'tcclks' counts at when
+ * TIMER_CLOCK1 is 'tclock1_hz'. Returns 0 for XC0, XC1 and XC2 whose
+ * rate is unknown here. */
+double tc_tcclks_hz(int tcclks, double tclock1_hz);
+
+/* Places in *rcp the RC (rounded) that gives 'want_hz' from a counter
+ * clock of 'clk_hz'. Returns 0 if okay, else 1 when want_hz is above
+ * clk_hz / 2 or RC would not fit in 32 bits. */
+int tc_calc_rc(double clk_hz, double want_hz, unsigned int * rcp);
+
+/* Returns RA for a period of 'rc' split mark:space, RB is rc - RA. RA
+ * (the space) counts from the start of the period, so it is rounded
+ * towards the smaller of mark and space. Returns 0 if the split does not
+ * fit (e.g. mark + space much larger than rc). */
+unsigned int tc_calc_ra(unsigned int rc, unsigned int mark,
+                        unsigned int space);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
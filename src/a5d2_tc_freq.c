@@ -60,54 +60,52 @@
 #include <syslog.h>
 #include <signal.h>
 #include <sched.h>
+#include <math.h>
+
+#include "mmap_regs.h"
+#include "a5d2_regs.h"
+#include "sa_misc.h"
+#include "sa_instr.h"
 
 // #include <sys/ioctl.h>
 
 
-static const char * version_str = "1.00 20160119";
+static const char * version_str = "1.07 20261014";
 
-#define MAX_ELEMS 512
-#define DEV_MEM "/dev/mem"
-#define MAP_SIZE 4096   /* assume to be power of 2 */
-#define MAP_MASK (MAP_SIZE - 1)
+#define ELEM_ARR_INIT_LEN 512   /* grows (doubles) as needed */
 
 /* On the SAMA5D2 each TCB has a separate peripheral identifier:
  * TCB0 is 35 and TCB1 is 36. Since the Linux kernel uses TC0 which is
- * in TCB0 then it should be enabled. */
-#define PMC_PCER0  0xf0014010   /* peripheral clock enable, reg 0 */
-#define PMC_PCDR0  0xf0014014   /* peripheral clock disable, reg 0 */
-#define PMC_PCSR0  0xf0014018   /* peripheral clock status, reg 0 */
-#define PMC_PCER1  0xf0014100   /* peripheral clock enable, reg 1 */
-#define PMC_PCDR1  0xf0014104   /* peripheral clock disable, reg 1 */
-#define PMC_PCSR1  0xf0014108   /* peripheral clock status, reg 1 */
-#define PMC_PCR    0xf001410c   /* peripheral control register */
-                                /* - for peripheral divider */
-#define PMC_PCR_GCKDIV_MSK 0xff00000
-#define PMC_PCR_GCKDIV_SHIFT 20
-
-#define SAMA5D2_PERI_ID_TCB0 35 /* contains TC0, TC1 and TC2 */
-#define SAMA5D2_PERI_ID_TCB1 36 /* contains TC3, TC4 and TC5 */
-
-// wave=1, wavesel=2, T_CLK1 EEVT=1
-#define TC_CMR_VAL_CLK1  0x0000c400
-// wave=1, wavesel=2, T_CLK5 EEVT=1
-#define TC_CMR_VAL_CLK5  0x0000c404
+ * in TCB0 then it should be enabled. PMC, TC and their addresses are in
+ * a5d2_regs.h */
+
+// wave=1, wavesel=2, EEVT=1; OR in TCCLKS (0: T_CLK1 .. 4: T_CLK5)
+#define TC_CMR_VAL_WAVE  0x0000c400
 #define TC_CMR_TCCLKS_DEF 0     /* Generic clock from PMC (divided by 1) */
+#define PLAN_TIE_PPM 1e-6       /* errors this close are equally good */
 
 // BSWTRG=1 BCPC=1 BCPB=2, ASWTRG=2 ACPC=2 ACPA=1 : TIOA? leads with mark
 #define TC_CMR_MS_MASK  0x46890000
 // BSWTRG=2 BCPC=2 BCPB=1, ASWTRG=1 ACPC=1 ACPA=2 : TIOA? leads with space
 #define TC_CMR_MS_INV_MASK  0x89460000
 
-#define TC_CCR_SWTRG 4          /* Software trigger */
-#define TC_CCR_CLKDIS 2         /* Clock disable */
-#define TC_CCR_CLKEN 1          /* Clock enable, if TC_CCR_CLKDIS not given */
+/* capture mode (WAVE=0), TIMER_CLOCK3 (GCLK div 32), no triggers */
+#define TC_CMR_VAL_SEG  0x00000002
+#define SEG_TCCLK_DIV 32
+#define SEG_SPIN_US 200         /* poll TC_CV for this long at boundaries */
+#define SEG_MIN_HZ 1000         /* '-t' timer must resolve milliseconds */
+#define SEG_START_MS 20         /* TC_CV must move within this after SWTRG */
 
-/* TIMER_CLOCK1 is the generic clock (per TCB block) from the PMC which is
- * often the "master" clock (166 MHz). The main clock is often 12 MHz.
- */
-#define TIMER_CLOCK1 166000000 /* master clock is 166 MHz */
-#define TIMER_CLOCK5 32768
+#define MAX_CHANS 3             /* TC_BCR SYNC reaches the 3 in one TCB */
+
+/* capture mode (WAVE=0): ETRGEDG=falling, ABETRG=1 (TIOA is the trigger),
+ * LDRA=rising, LDRB=falling; OR in TCCLKS */
+#define TC_CMR_VAL_CAPT 0x00090600
+#define TC_SR_COVFS 0x1         /* counter overflow */
+#define TC_SR_LOVRS 0x2         /* load overrun (RA or RB reloaded unread) */
+#define TC_SR_LDRAS 0x20        /* RA loaded */
+#define TC_SR_LDRBS 0x40        /* RB loaded */
+#define CAPT_TIMEOUT_MS 5000    /* give up when no edges for this long */
 
 #define A5D2_TCB_WPKEY 0x54494D  /* "TIM" in ASCII */
 
@@ -115,12 +113,6 @@ static const char * version_str = "1.00 20160119";
 /* N.B. the SAMA5D2 Timer Counter unit has 32 bit counters. Some earlier
  * members of the AT91 family had 16 bit counters. */
 
-struct mmap_state {
-    void * mmap_ptr;
-    off_t prev_mask_addrp;
-    bool mmap_ok;
-};
-
 /* when both members are zero then end of elem_arr */
 struct elem_t {
     int frequency;      /* > 0 then Hz; < 0 then period in ms; 0 then low */
@@ -130,14 +122,7 @@ struct elem_t {
 struct table_io_t {
     char tcb;                   /* 0 for TCB0 (TC0, TC1, RC2) else 1 */
     const char * tio_name;
-    unsigned int tc_ccr;
-    unsigned int tc_cmr;
-    unsigned int tc_ra;
-    unsigned int tc_rb;
-    unsigned int tc_rc;
-    unsigned int tc_imr;
-    unsigned int tc_emr;        /* extended mode register */
-    unsigned int tc_wpmr;       /* one write protect mode reg per tcb */
+    int ch;                     /* TC channel, registers via tc_addr() */
     int is_tioa;
 };
 
@@ -146,40 +131,71 @@ struct value_str_t {
     const char *str;
 };
 
+/* Register values for one element on one TIO, worked out before the
+ * list is played so that playback just stores them. */
+struct seg_t {
+    unsigned int cmr;
+    unsigned int ra;            /* RB is rc - ra */
+    unsigned int rc;
+    int on;                     /* 0 -> line at space level, clock off */
+    int duration_ms;            /* as in struct elem_t */
+    int tcclks;                 /* chosen clock source */
+    int gckdiv;                 /* PMC_PCR GCKDIV it was planned with */
+    double act_hz;              /* frequency produced */
+    double ppm;                 /* its error */
+};
+
+/* One per '-b TIO'. '-f', '-m' and '-p' apply to the latest '-b' (or to
+ * the first if they come before it). */
+struct chan_t {
+    int t_ind;
+    int mark;
+    int space;
+    int ms_given;
+    const char * fname;
+    const char * pstring;
+    struct elem_t * elem_arr;
+    int elem_arr_len;           /* allocated elements */
+    struct seg_t * seg_arr;
+    int num_segs;
+    const struct table_io_t * tp;
+    /* playback state */
+    int cur;                    /* index into seg_arr[] */
+    int done;
+    int clk_ena;
+    unsigned int prev_rms;
+    long long next_ms;          /* end of seg_arr[cur], from start */
+};
+
+/* A second TC channel, in capture mode and counting TIMER_CLOCK3, whose
+ * TC_CV times segment boundaries ('-t TC'). */
+struct seg_timer {
+    volatile unsigned int * cvp;        /* that channel's TC_CV */
+    unsigned int last_cv;
+    unsigned long long ticks;   /* since start, extended to 64 bits */
+    unsigned int tick_hz;
+    long long max_late;         /* worst boundary overshoot in ticks */
+    int boundaries;
+};
 
-static struct elem_t elem_arr[MAX_ELEMS];
 
 /* settings for TIOA0-5 and TIOB0-5. */
 static struct table_io_t table_arr[] = {
-    /* TCB0:   base 0xf800c000 */
-    {0, "TIOA0", 0xf800c000, 0xf800c004, 0xf800c014,
-     0xf800c018, 0xf800c01c, 0xf800c02c, 0xf800c030, 0xf800c0e4, 1},
-    {0, "TIOB0", 0xf800c000, 0xf800c004, 0xf800c014,
-     0xf800c018, 0xf800c01c, 0xf800c02c, 0xf800c030, 0xf800c0e4, 0},
-    {0, "TIOA1", 0xf800c040, 0xf800c044, 0xf800c054,
-     0xf800c058, 0xf800c05c, 0xf800c06c, 0xf800c070, 0xf800c0e4, 1},
-    {0, "TIOB1", 0xf800c040, 0xf800c044, 0xf800c054,
-     0xf800c058, 0xf800c05c, 0xf800c06c, 0xf800c070, 0xf800c0e4, 0},
-    {0, "TIOA2", 0xf800c080, 0xf800c084, 0xf800c094,
-     0xf800c098, 0xf800c09c, 0xf800c0ac, 0xf800c0b0, 0xf800c0e4, 1},
-    {0, "TIOB2", 0xf800c080, 0xf800c084, 0xf800c094,
-     0xf800c098, 0xf800c09c, 0xf800c0ac, 0xf800c0b0, 0xf800c0e4, 0},
-
-    /* TCB1:   base 0xf8010000 */
-    {1, "TIOA3", 0xf8010000, 0xf8010004, 0xf8010014,
-     0xf8010018, 0xf801001c, 0xf801002c, 0xf8010030, 0xf80100e4, 1},
-    {1, "TIOB3", 0xf8010000, 0xf8010004, 0xf8010014,
-     0xf8010018, 0xf801001c, 0xf801002c, 0xf8010030, 0xf80100e4, 0},
-    {1, "TIOA4", 0xf8010040, 0xf8010044, 0xf8010054,
-     0xf8010058, 0xf801005c, 0xf801006c, 0xf8010070, 0xf80100e4, 1},
-    {1, "TIOB4", 0xf8010040, 0xf8010044, 0xf8010054,
-     0xf8010058, 0xf801005c, 0xf801006c, 0xf8010070, 0xf80100e4, 0},
-    {1, "TIOA5", 0xf8010080, 0xf8010084, 0xf8010094,
-     0xf8010098, 0xf801009c, 0xf80100ac, 0xf80100b0, 0xf80100e4, 1},
-    {1, "TIOB5", 0xf8010080, 0xf8010084, 0xf8010094,
-     0xf8010098, 0xf801009c, 0xf80100ac, 0xf80100b0, 0xf80100e4, 0},
-
-    {0, NULL, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, "TIOA0", 0, 1},
+    {0, "TIOB0", 0, 0},
+    {0, "TIOA1", 1, 1},
+    {0, "TIOB1", 1, 0},
+    {0, "TIOA2", 2, 1},
+    {0, "TIOB2", 2, 0},
+
+    {1, "TIOA3", 3, 1},
+    {1, "TIOB3", 3, 0},
+    {1, "TIOA4", 4, 1},
+    {1, "TIOB4", 4, 0},
+    {1, "TIOA5", 5, 1},
+    {1, "TIOB5", 5, 0},
+
+    {0, NULL, 0, 0},
 };
 
 static struct value_str_t tcclks_arr[] = {
@@ -195,49 +211,53 @@ static struct value_str_t tcclks_arr[] = {
 };
 
 static int tc_tclock1 = TIMER_CLOCK1;   /* may get divided by up to 256 */
-static int cl_foreground = 1;
-
-static int verbose = 0;
 
+static double plan_src_hz = TIMER_CLOCK1;  /* generic clock prior to GCKDIV */
+static int plan_gckdiv;         /* GCKDIV read from PMC_PCR */
 
-#ifdef __GNUC__
-static int pr2serr(const char * fmt, ...)
-        __attribute__ ((format (printf, 1, 2)));
-#else
-static int pr2serr(const char * fmt, ...);
+#ifdef SA_INSTR
+/* nanoseconds past each segment boundary on waking, and once the next
+ * segment's registers are written */
+static struct sa_stat bnd_wake;
+static struct sa_stat bnd_written;
 #endif
 
+static int verbose = 0;
 
-static int
-pr2serr(const char * fmt, ...)
-{
-    va_list args;
-    int n;
-
-    va_start(args, fmt);
-    n = vfprintf(stderr, fmt, args);
-    va_end(args);
-    return n;
-}
 
 static void
 usage(int do_help)
 {
     if (do_help > 1)
         goto second_help;
-    pr2serr("Usage: a5d2_tc_freq -b TIO [-c TCCLKS] [-d] [-D] [-e] [-f FN] "
-            "[-h]\n"
+    pr2serr("Usage: a5d2_tc_freq -b TIO [-c TCCLKS] [-C NUM] [-d] [-D] [-e] "
+            "[-f FN] [-h]\n"
             "                    [-i] [-I] [-m M,S] [-M] [-n] "
             "[-p F1,D1[,F2,D2...]]\n"
-            "                    [-R RF] [-u] [-v] [-V] [-w WPEN]\n"
+            "                    [-R RF] [-t TC] [-u] [-v] [-V] "
+            "[-w WPEN]\n"
             "  where:\n"
             "    -b TIO       TIO name ('TIOA0', 'TIOB0' to 'TIOA5' or "
-            "'TIOB5')\n"
-            "    -c TCCLKS    clock source (def: 0 -> generic clock from "
-            "PMC)\n"
+            "'TIOB5'). Up to\n"
+            "                 3 (one per channel of a TC block) started "
+            "together by\n"
+            "                 TC_BCR SYNC (in TCB0 by one SWTRG each); "
+            "'-f', '-m'\n"
+            "                 and '-p' after each '-b' apply to that TIO\n"
+            "    -c TCCLKS    clock source (def: lowest error of 0 to 4 for "
+            "each frequency)\n"
+            "    -C NUM       capture mode: measure NUM periods of the "
+            "signal on TIOAn\n"
+            "                 via RA/RB, report period, frequency and "
+            "duty statistics\n"
+            "                 (counting TCCLKS, def: 0; not with '-p' "
+            "or '-f')\n"
             "    -d           dummy mode: decode frequency,duration pairs, "
             "print\n"
-            "                 them then exit; ignore TIO\n"
+            "                 them and the planned clock setup with its "
+            "error in ppm\n"
+            "                 (assuming GCKDIV is 0) then exit; ignore "
+            "TIO\n"
             "    -D           after initial checks, run as daemon which "
             "exits after\n"
             "                 frequency(s) is produced\n"
@@ -264,6 +284,12 @@ usage(int do_help)
             "milliseconds\n"
             "    -R RF        use RF as reference frequency for "
             "TIMER_CLOCK1\n"
+            "    -t TC        time segment boundaries with TC channel TC "
+            "(1 to 5,\n"
+            "                 same TCB as TIO, not TIO's own channel) "
+            "rather than\n"
+            "                 CLOCK_MONOTONIC; sleeps then polls its "
+            "counter\n"
             "    -u           disable the TIO clock prior to exiting\n"
             "    -v           increase verbosity (multiple times for more)\n"
             "    -V           print version string then exit\n"
@@ -300,37 +326,6 @@ second_help:
            );
 }
 
-#ifdef __cplusplus
-
-static inline volatile unsigned int *
-mmp_add(void * p, unsigned int v)
-{
-    return (volatile unsigned int *)((unsigned char *)p + v);
-}
-
-#else
-
-static inline volatile unsigned int *
-mmp_add(unsigned char * p, unsigned int v)
-{
-    return (volatile unsigned int *)(p + v);
-}
-
-#endif
-
-void
-cl_print(int priority, const char *fmt, ...)
-{
-    va_list ap;
-
-    va_start(ap,fmt);
-    if (cl_foreground)
-        vfprintf(stderr, fmt, ap);
-    else
-        vsyslog(priority, fmt, ap);
-    va_end(ap);
-}
-
 /* The number in 'buf' together with an optional multiplier suffix is decoded
  * or -1 is returned. Accepts a hex prefix (0x or 0X) or a decimal multiplier
  * suffix of kHz for x1000 Hz, kiHz for x1024; same pattern for MHz and GHz.
@@ -415,90 +410,153 @@ fr_get_num(const char * buf)
     }
 }
 
-/* Daemonize the current process. */
-void
-cl_daemonize(const char * name, int no_chdir, int no_varrunpid, int verbose)
+/* Returns ticks since the segment timer was started. Must be called at
+ * least once per TC_CV wrap (over 13 minutes at 166 MHz / 32). */
+static unsigned long long
+seg_now(struct seg_timer * stp)
 {
-    pid_t pid, sid, my_pid;
-    char b[64];
-    FILE * fp;
-
-    /* already a daemon */
-    if (getppid() == 1 )
-        return;
-
-    pid = fork();
-    if (pid < 0) {
-        strcpy(b, name);
-        strcat(b, " fork");
-        perror(b);
-        exit(EXIT_FAILURE);
+    unsigned int cv = *stp->cvp;
+
+    stp->ticks += (unsigned int)(cv - stp->last_cv);
+    stp->last_cv = cv;
+    return stp->ticks;
+}
+
+/* Checks the segment timer's TC_CV moves within SEG_START_MS of being
+ * started, otherwise seg_wait() would wait forever. Returns 0 if it
+ * does, else 1 . */
+static int
+seg_started(struct seg_timer * stp)
+{
+    uint64_t end = sa_ts_ns(CLOCK_MONOTONIC) + (SEG_START_MS * 1000000ULL);
+
+    do {
+        if (*stp->cvp != stp->last_cv) {
+            seg_now(stp);
+            return 0;
+        }
+    } while (sa_ts_ns(CLOCK_MONOTONIC) < end);
+    return 1;
+}
+
+/* Waits until the segment timer reaches 'target' ticks. Sleeps (at most a
+ * second at a time) until SEG_SPIN_US before that, then polls TC_CV. So
+ * boundaries are exact multiples of the timer clock from the start and
+ * scheduler latency only matters if it exceeds SEG_SPIN_US. */
+static void
+seg_wait(struct seg_timer * stp, unsigned long long target)
+{
+    long long togo, ns;
+    long long spin = ((long long)stp->tick_hz * SEG_SPIN_US) / 1000000;
+    struct timespec req;
+
+    while ((togo = (long long)(target - seg_now(stp))) > 0) {
+        if (togo <= spin)
+            continue;
+        if ((togo - spin) >= stp->tick_hz)
+            ns = 1000000000LL;
+        else
+            ns = ((togo - spin) * 1000000000LL) / stp->tick_hz;
+        req.tv_sec = ns / 1000000000;
+        req.tv_nsec = ns % 1000000000;
+        nanosleep(&req, NULL);
     }
-    if (pid > 0)
-        exit(EXIT_SUCCESS);
-
-    /* Cancel certain signals */
-    signal(SIGCHLD, SIG_DFL);   /* A child process dies */
-    signal(SIGTSTP, SIG_IGN);   /* Various TTY signals */
-    signal(SIGTTOU, SIG_IGN);
-    signal(SIGTTIN, SIG_IGN);
-    signal(SIGHUP, SIG_IGN);    /* Ignore hangup signal */
-    signal(SIGTERM, SIG_DFL);   /* Die on SIGTERM */
-
-    umask(0);
-
-    sid = setsid();
-    if (sid < 0) {
-        cl_print(LOG_ERR, "setsid: %s\n", strerror(errno));
-        exit(EXIT_FAILURE);
+    if (-togo > stp->max_late)
+        stp->max_late = -togo;
+    ++stp->boundaries;
+}
+
+/* Sleeps until 'ms' milliseconds after *startp (CLOCK_MONOTONIC). Using
+ * absolute deadlines stops oversleeps accumulating over a long list.
+ * Returns 0 if okay, else 1 . */
+static int
+sleep_until(const struct timespec * startp, long long ms)
+{
+    int res;
+    struct timespec ts;
+
+    ts.tv_sec = startp->tv_sec + (ms / 1000);
+    ts.tv_nsec = startp->tv_nsec + (ms % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ++ts.tv_sec;
+        ts.tv_nsec -= 1000000000;
     }
-    if (! no_chdir) {
-        if ((chdir("/")) < 0) {
-            cl_print(LOG_ERR, "chdir(/): %s\n", strerror(errno));
-            exit(EXIT_FAILURE);
-        }
+    while ((res = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts,
+                                  NULL)) == EINTR)
+        ;
+    if (res) {
+        pr2serr("clock_nanosleep: %s\n", strerror(res));
+        return 1;
+    }
+    return 0;
+}
+
+#ifdef SA_INSTR
+/* Nanoseconds since boundary 't' (ms from *startp or, if stp, in segment
+ * timer ticks) */
+static long long
+bnd_late_ns(const struct timespec * startp, struct seg_timer * stp,
+            long long t)
+{
+    long long ticks;
+
+    if (stp) {
+        ticks = (long long)(seg_now(stp) - ((t * stp->tick_hz) / 1000));
+        return (ticks * 1000000000LL) / stp->tick_hz;
     }
+    return (long long)(sa_ts_ns(CLOCK_MONOTONIC) -
+                       (((uint64_t)startp->tv_sec * 1000000000) +
+                        startp->tv_nsec + (t * 1000000)));
+}
+#endif
 
-    fp = freopen("/dev/null", "r", stdin);
-    fp = freopen("/dev/null", "w", stdout);
-    fp = freopen("/dev/null", "w", stderr);
-    /* ignoring handle */
-
-    if (! no_varrunpid) {
-        my_pid = getpid();
-        snprintf(b, sizeof(b), "/var/run/%s.pid", name);
-        fp = fopen(b, "w+");
-        if (fp) {
-            snprintf(b, sizeof(b), "%d\n", my_pid);
-            fputs(b, fp);
-            fclose(fp);
-        } else if (verbose)
-            cl_print(LOG_WARNING, "Unable to open %s to put my pid(%d) in\n",
-                     b, my_pid);
+/* Makes sure (*arrp)[ind] exists, growing (and zero filling) *arrp when
+ * needed. Returns *arrp or NULL if out of memory. */
+static struct elem_t *
+elem_grow(struct elem_t ** arrp, int * arr_lenp, int ind)
+{
+    int n;
+    struct elem_t * arr;
+
+    if (ind < *arr_lenp)
+        return *arrp;
+    for (n = (*arr_lenp > 0) ? *arr_lenp : ELEM_ARR_INIT_LEN; n <= ind;
+         n *= 2)
+        ;
+    arr = (struct elem_t *)realloc(*arrp, n * sizeof(*arr));
+    if (NULL == arr) {
+        pr2serr("%s: unable to allocate %d elements\n", __func__, n);
+        return NULL;
     }
+    memset(arr + *arr_lenp, 0, (n - *arr_lenp) * sizeof(*arr));
+    *arrp = arr;
+    *arr_lenp = n;
+    return arr;
 }
 
 /* Read pairs of numbers from command line (comma (or (single) space)
  * separated list) or from stdin or file (one or two per line, comma
  * separated list or space separated list). Numbers assumed to be decimal.
- * Returns 0 if ok, or 1 if error. The 'arr' has an element with zero
- * fields (frequency and duration_ms) as a terminator */
+ * Returns 0 if ok, or 1 if error. The array at *arrp (*arr_lenp elements
+ * allocated) is grown as needed and has an element with zero fields
+ * (frequency and duration_ms) as a terminator */
 static int
-build_arr(FILE * fp, const char * inp, struct elem_t * arr, int max_arr_len)
+build_arr(FILE * fp, const char * inp, struct elem_t ** arrp, int * arr_lenp)
 {
     int in_len, k, j, m, n, fr, got_freq, neg;
     unsigned int u;
     const char * lcp;
     const char * allowp;
+    struct elem_t * arr;
 
-    if ((NULL == arr) || (max_arr_len < 1))
+    if (NULL == (arr = elem_grow(arrp, arr_lenp, 0)))
         return 1;
     allowp = "-0123456789kKmMgGiIhHzZ ,\t";
     if (fp) {        /* read from file or stdin */
         char line[512];
         int off = 0;
 
-        for (j = 0, fr = 0; j < 512; ++j) {
+        for (j = 0, fr = 0; ; ++j) {
             if (NULL == fgets(line, sizeof(line), fp))
                 break;
             in_len = strlen(line);
@@ -540,10 +598,8 @@ build_arr(FILE * fp, const char * inp, struct elem_t * arr, int max_arr_len)
                     return 1;
                 } else
                     u = (unsigned int)n;
-                if ((off + k) >= max_arr_len) {
-                    pr2serr("%s: array length exceeded\n", __func__);
+                if (NULL == (arr = elem_grow(arrp, arr_lenp, off + k)))
                     return 1;
-                }
                 if (neg) {
                     if ((u - 1) > INT_MAX) {
                         pr2serr("%s: number too small: -%u\n", __func__, u);
@@ -581,10 +637,10 @@ build_arr(FILE * fp, const char * inp, struct elem_t * arr, int max_arr_len)
             pr2serr("%s: got frequency but missing duration\n", __func__);
             return 1;
         }
-        if (off < max_arr_len) {
-            arr[off].frequency = 0;
-            arr[off].duration_ms = 0;
-        }
+        if (NULL == (arr = elem_grow(arrp, arr_lenp, off)))
+            return 1;
+        arr[off].frequency = 0;
+        arr[off].duration_ms = 0;
     } else if (inp) {        /* list of numbers on command line */
         lcp = inp;
         in_len = strlen(inp);
@@ -598,7 +654,9 @@ build_arr(FILE * fp, const char * inp, struct elem_t * arr, int max_arr_len)
             pr2serr("%s: error at pos %d\n", __func__, k + 1);
             return 1;
         }
-        for (k = 0, fr = 0; k < max_arr_len; ++k) {
+        for (k = 0, fr = 0; ; ++k) {
+            if (NULL == (arr = elem_grow(arrp, arr_lenp, k)))
+                return 1;
             if ('-' == *lcp) {
                 neg = 1;
                 ++lcp;
@@ -644,78 +702,14 @@ build_arr(FILE * fp, const char * inp, struct elem_t * arr, int max_arr_len)
             pr2serr("%s: got frequency but missing duration\n", __func__);
             return 1;
         }
-        if (k == max_arr_len) {
-            pr2serr("%s: array length exceeded\n", __func__);
+        if (NULL == (arr = elem_grow(arrp, arr_lenp, k + 1)))
             return 1;
-        }
-        if (k < (max_arr_len - 1)) {
-            arr[k + 1].frequency = 0;
-            arr[k + 1].duration_ms = 0;
-        }
+        arr[k + 1].frequency = 0;
+        arr[k + 1].duration_ms = 0;
     }
     return 0;
 }
 
-/* Since we map a whole page (MAP_SIZE) then that page may already be
- * mapped which means we can skip a munmap() and mmap() call. Returns
- * new or re-used pointer to mmapped page, or returns NULL if problem. */
-static void *
-check_mmap(int mem_fd, unsigned int wanted_addr, struct mmap_state * msp)
-{
-    off_t mask_addr;
-    bool did_unmap = false;
-    void * ommap_ptr = NULL;
-
-    mask_addr = (wanted_addr & ~MAP_MASK);
-    if ((! msp->mmap_ok) || (msp->prev_mask_addrp != mask_addr)) {
-        if (msp->mmap_ok) {
-            if (-1 == munmap(msp->mmap_ptr, MAP_SIZE)) {
-                pr2serr("mmap_ptr=%p:\n", msp->mmap_ptr);
-                perror("    munmap");
-                return NULL;
-            } else if (verbose > 2) {
-                did_unmap = true;
-                ommap_ptr =  msp->mmap_ptr;
-            }
-        }
-        msp->mmap_ptr = mmap(0, MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED,
-                             mem_fd, mask_addr);
-        if ((void *)-1 == msp->mmap_ptr) {
-            msp->mmap_ok = false;
-            pr2serr("addr=0x%x, mask_addr=0x%lx :\n", wanted_addr, mask_addr);
-            perror("    mmap");
-            return NULL;
-        }
-        msp->mmap_ok = true;
-        msp->prev_mask_addrp = mask_addr;
-        if (verbose > 2) {
-            if (did_unmap) {
-                if (ommap_ptr == msp->mmap_ptr)
-                    pr2serr("munmap+mmap() mask_addr=0x%lx; old,new "
-                            "mmap_ptrs=%p,same\n", mask_addr, ommap_ptr);
-                else
-                    pr2serr("munmap+mmap() mask_addr=0x%lx; old,new "
-                            "mmap_ptrs=%p,%p\n", mask_addr, ommap_ptr,
-                            msp->mmap_ptr);
-            } else
-                pr2serr("mmap() mask_addr=0x%lx, mmap_ptr=%p\n",
-                        mask_addr, msp->mmap_ptr);
-        }
-    }
-    return msp->mmap_ptr;
-}
-
-static volatile unsigned int *
-get_mmp(int mem_fd, unsigned int wanted_addr, struct mmap_state * msp)
-{
-    void * mmap_ptr;
-
-    mmap_ptr = check_mmap(mem_fd, wanted_addr, msp);
-    if (NULL == mmap_ptr)
-        return NULL;
-    return mmp_add(mmap_ptr, wanted_addr & MAP_MASK);
-}
-
 /* Looks for match of TIO name (e.g. TIOB3) in table_arr. If found returns
  * index (>= 0). If not found or error, return -1 . */
 static int
@@ -745,11 +739,512 @@ find_table_index(const char * cp)
 }
 
 
+/* Counter clock in Hz that TCCLKS value c selects */
+static double
+tcclks_hz(int c)
+{
+    double hz = tc_tcclks_hz(c, plan_src_hz / (plan_gckdiv + 1));
+
+    /* XC0, XC1 or XC2: assume '-R RF' is its rate */
+    return (hz > 0.0) ? hz : (plan_src_hz / (plan_gckdiv + 1));
+}
+
+/* Finds the TCCLKS and RC that come closest to the frequency (or period)
+ * of 'ep'. Ties go to the setting of 'prevp' (previous active segment, may
+ * be NULL) so consecutive segments reuse a clock setup, then to the
+ * smaller divider (finer RA/RB steps). GCKDIV stays as found in PMC_PCR:
+ * (GCKDIV+1) * divider * RC is an integer, which TIMER_CLOCK1 with RC
+ * alone already covers up to 2**32, and changing it would retime the
+ * other channels of the TCB (in TCB0 that includes the kernel's TC0).
+ * tcclks is -1 unless '-c TCCLKS' was given. Returns 0 if okay, else 1 */
+static int
+plan_clock(const struct elem_t * ep, int k, int tcclks,
+           const struct seg_t * prevp, struct seg_t * sp)
+{
+    int c, c_lo, c_hi, is_prev;
+    int best_prev = 0;
+    unsigned int rc;
+    double clk, want_hz, act, ppm, aerr;
+    double best = -1.0;
+
+    if (ep->frequency < 0) {
+        /* period = abs(ep->frequency) / 1000.0 seconds */
+        if (ep->frequency <= -131072000) {
+            pr2serr("frequency[%d]=%d represent a period of %u "
+                    "seconds which\nis too large (131071.999 seconds "
+                    "is the limit)\n", k + 1, ep->frequency,
+                    (-ep->frequency) / 1000);
+            return 1;
+        }
+        want_hz = 1000.0 / (-(double)ep->frequency);
+    } else
+        want_hz = ep->frequency;
+    c_lo = (tcclks >= 0) ? tcclks : 0;
+    c_hi = (tcclks >= 0) ? tcclks : TC_TCCLKS_SLOW;
+    for (c = c_lo; c <= c_hi; ++c) {
+        clk = tcclks_hz(c);
+        if (tc_calc_rc(clk, want_hz, &rc))
+            continue;   /* above clk / 2 or RC over 32 bits */
+        act = clk / rc;
+        ppm = ((act - want_hz) / want_hz) * 1000000.0;
+        aerr = (ppm < 0.0) ? -ppm : ppm;
+        is_prev = prevp && (c == prevp->tcclks);
+        if ((best < 0.0) || (aerr < (best - PLAN_TIE_PPM)) ||
+            ((aerr <= (best + PLAN_TIE_PPM)) && is_prev && (! best_prev))) {
+            best = aerr;
+            best_prev = is_prev;
+            sp->tcclks = c;
+            sp->rc = rc;
+            sp->act_hz = act;
+            sp->ppm = ppm;
+        }
+    }
+    sp->gckdiv = plan_gckdiv;
+    if (best < 0.0) {
+        if (ep->frequency > 0)  /* c_lo is the fastest clock searched */
+            pr2serr("frequency[%d]=%d too high, limit: %d Hz (TCCLKS=%d)"
+                    "\n", k + 1, ep->frequency, (int)(tcclks_hz(c_lo) / 2),
+                    c_lo);
+        else
+            pr2serr("frequency[%d]=%d: no clock source fits that "
+                    "period\n", k + 1, ep->frequency);
+        return 1;
+    }
+    if (verbose > 1)
+        pr2serr("frequency[%d]: TCCLKS=%d GCKDIV=%d RC=%u, error %.3f "
+                "ppm\n", k + 1, sp->tcclks, sp->gckdiv, sp->rc, sp->ppm);
+    return 0;
+}
+
+/* Works out the register values for element 'ep' (number k, origin 0) on
+ * TIO 'tp' (NULL taken as a TIOA*). Returns 0 if okay, else 1 . */
+static int
+calc_seg(const struct elem_t * ep, int k, const struct table_io_t * tp,
+         int mark, int space, int ms_invert, int tcclks,
+         const struct seg_t * prevp, struct seg_t * sp)
+{
+    unsigned int rms;
+
+    memset(sp, 0, sizeof(*sp));
+    sp->duration_ms = ep->duration_ms;
+    if (0 == ep->frequency)
+        return 0;       /* line held at space level */
+    if (plan_clock(ep, k, tcclks, prevp, sp))
+        return 1;
+    // Calculate the mark space ratio in order to set RA and RB
+    rms = tc_calc_ra(sp->rc, mark, space);
+    if (0 == rms) {
+        pr2serr("mark+space too large, please reduce\n");
+        return 1;
+    }
+    // rms = rc / 2;           // use 1:1 mark space ratio
+    // rms = rc * 1 / 5;       // use 4:1 mark space ratio
+    // rms = rc * 4 / 5;       // use 1:4 mark space ratio
+    sp->cmr = TC_CMR_VAL_WAVE | sp->tcclks;
+    sp->cmr |= (((tp ? tp->is_tioa : 1) == ms_invert) ? TC_CMR_MS_INV_MASK :
+                                                        TC_CMR_MS_MASK);
+    sp->ra = rms;
+    sp->on = 1;
+    return 0;
+}
+
+/* Planning pass: builds chp->seg_arr[] from chp->elem_arr[]. Returns 0 if
+ * okay, else 1 */
+static int
+calc_chan(struct chan_t * chp, int ms_invert, int tcclks)
+{
+    int k, n;
+    const struct seg_t * prevp = NULL;
+
+    for (n = 0; (chp->elem_arr[n].frequency || chp->elem_arr[n].duration_ms);
+         ++n)
+        ;
+    chp->seg_arr = (struct seg_t *)calloc(n + 1, sizeof(struct seg_t));
+    if (NULL == chp->seg_arr) {
+        pr2serr("%s: unable to allocate %d segments\n", __func__, n);
+        return 1;
+    }
+    for (k = 0; k < n; ++k) {
+        if (calc_seg(chp->elem_arr + k, k, chp->tp, chp->mark, chp->space,
+                     ms_invert, tcclks, prevp, chp->seg_arr + k))
+            return 1;
+        if (chp->seg_arr[k].on)
+            prevp = chp->seg_arr + k;
+    }
+    chp->num_segs = n;
+    return 0;
+}
+
+/* For '-d': prints the planned clock setup of each segment and its error */
+static void
+print_plan(const struct chan_t * chp)
+{
+    int k;
+    const struct seg_t * sp;
+
+    for (k = 0, sp = chp->seg_arr; k < chp->num_segs; ++k, ++sp) {
+        if (sp->on)
+            printf("    [%d] TCCLKS=%d GCKDIV=%d RC=%u RA=%u -> %.6f Hz, "
+                   "error %+.3f ppm\n", k + 1, sp->tcclks, sp->gckdiv,
+                   sp->rc, sp->ra, sp->act_hz, sp->ppm);
+        else
+            printf("    [%d] line is low\n", k + 1);
+    }
+}
+
+/* Stores the TC_CMR, RA, RB and RC values of *sp for chp's TIO, RC first
+ * if the period is growing so RA and RB never exceed RC. Returns 0 if
+ * okay, else 1 . */
+static int
+write_seg(int mem_fd, struct mmap_state * msp, struct chan_t * chp,
+          const struct seg_t * sp)
+{
+    unsigned int rc = sp->rc;
+    unsigned int rms = sp->ra;
+    unsigned int base = tc_addr(chp->tp->ch, 0);
+    volatile unsigned int * mmp;
+
+    // Check Channel Mode Register (TC_CMR), change if needed
+    if (NULL == ((mmp = get_mmp(mem_fd, base + TC_CMR_OFF, msp))))
+        return 1;
+    if (sp->cmr != *mmp) {
+        *mmp = sp->cmr;
+        if (verbose > 1)
+            pr2serr("wrote: TC_CMR addr=0x%x, val=0x%x\n",
+                    base + TC_CMR_OFF, *mmp);
+    } else if (verbose > 2)
+        pr2serr(" did not write TC_CMR addr=0x%x because val=0x%x "
+                "already\n", base + TC_CMR_OFF, *mmp);
+    if (rc > chp->prev_rms) {
+        // set up RC prior to RA and RB
+        if (NULL == ((mmp = get_mmp(mem_fd, base + TC_RC_OFF, msp))))
+            return 1;
+        *mmp = rc;
+        if (NULL == ((mmp = get_mmp(mem_fd, base + TC_RA_OFF, msp))))
+            return 1;
+        *mmp = rms;
+        if (NULL == ((mmp = get_mmp(mem_fd, base + TC_RB_OFF, msp))))
+            return 1;
+        *mmp = rc - rms;
+        if (verbose > 1) {
+            pr2serr("TC_RC,A,B addr=0x%x,%x,%x val=%u,%u,%u",
+                    base + TC_RC_OFF, base + TC_RA_OFF, base + TC_RB_OFF, rc,
+                    rms, rc - rms);
+            if (verbose > 2)
+                pr2serr("\n       [0x%x,0x%x,0x%x]\n", rc, rms,
+                        rc - rms);
+            else
+                pr2serr("\n");
+        }
+    } else {
+        // set up RA and RB prior to RC
+        if (NULL == ((mmp = get_mmp(mem_fd, base + TC_RA_OFF, msp))))
+            return 1;
+        *mmp = rms;
+        if (NULL == ((mmp = get_mmp(mem_fd, base + TC_RB_OFF, msp))))
+            return 1;
+        *mmp = rc - rms;
+        if (NULL == ((mmp = get_mmp(mem_fd, base + TC_RC_OFF, msp))))
+            return 1;
+        *mmp = rc;
+        if (verbose > 1) {
+            pr2serr("TC_RA,B,C addr=0x%x,0x%x,0x%x val=%u,%u,%u",
+                    base + TC_RA_OFF, base + TC_RB_OFF, base + TC_RC_OFF, rms,
+                    rc - rms, rc);
+            if (verbose > 2)
+                pr2serr("\n       [0x%x,0x%x,0x%x]\n", rms, rc - rms,
+                        rc);
+            else
+                pr2serr("\n");
+        }
+    }
+    chp->prev_rms = (rms >= (rc - rms)) ? rms : (rc - rms);
+    return 0;
+}
+
+/* Writes val to the TC_CCR of chp's channel. Returns 0 if okay, else 1 */
+static int
+write_ccr(int mem_fd, struct mmap_state * msp, const struct chan_t * chp,
+          unsigned int val, const char * what)
+{
+    unsigned int ccr = tc_addr(chp->tp->ch, TC_CCR_OFF);
+    volatile unsigned int * mmp;
+
+    if (NULL == ((mmp = get_mmp(mem_fd, ccr, msp))))
+        return 1;
+    *mmp = val;
+    if (verbose > 1)
+        pr2serr("wrote: TC_CCR addr=0x%x, val=0x%x [%s]\n", ccr, val, what);
+    return 0;
+}
+
+/* Plays seg_arr[] of each of the nchan channels; every boundary is
+ * cumulative milliseconds from *t_startp (or ticks of *stp if given).
+ * With more than one channel the first segments are all loaded and then
+ * started together by TC_BCR SYNC; later, whenever every running channel
+ * changes segment at the same instant, they are restarted together again
+ * so they stay phase aligned. SYNC triggers all 3 channels of the TCB so
+ * it is only used in TCB1: in TCB0 it would reset the kernel's TC0
+ * clocksource, so there each channel gets its own SWTRG, back to back.
+ * SYNC also resets the '-t' segment timer's TC_CV (same TCB) to 0 so the
+ * ticks up to it are folded into *stp first. Channels whose list ends
+ * (rather than in a continual element) are driven low. Returns 0 if okay,
+ * else 1 . */
+static int
+play_chans(int mem_fd, struct mmap_state * msp, struct chan_t * chans,
+           int nchan, struct seg_timer * stp,
+           const struct timespec * t_startp)
+{
+    int k, all, n_start, n_on, use_sync;
+    long long t;
+    unsigned int bcr;
+    struct chan_t * chp;
+    const struct seg_t * sp;
+    volatile unsigned int * mmp;
+    int changed[MAX_CHANS];
+    int starting[MAX_CHANS];
+    int on[MAX_CHANS];
+
+    for (k = 0, chp = chans; k < nchan; ++k, ++chp) {
+        chp->cur = 0;
+        chp->clk_ena = 0;
+        chp->prev_rms = 0;
+        chp->done = (0 == chp->num_segs);
+        chp->next_ms = chp->done ? 0 : chp->seg_arr[0].duration_ms;
+        changed[k] = ! chp->done;
+    }
+    use_sync = (0 != chans[0].tp->tcb);
+    bcr = tcb_addr(1) + TC_BCR_OFF;
+    for (t = 0; ; ) {
+        /* load the segments that start at t */
+        n_start = 0;
+        n_on = 0;
+        all = 1;
+        for (k = 0, chp = chans; k < nchan; ++k, ++chp) {
+            starting[k] = 0;
+            on[k] = 0;
+            if (! changed[k]) {
+                if (chp->clk_ena)
+                    all = 0;    /* keeps running, so keep its phase */
+                continue;
+            }
+            sp = chp->seg_arr + chp->cur;
+            if ((! chp->done) && sp->on) {
+                if (write_seg(mem_fd, msp, chp, sp))
+                    return 1;
+                on[k] = 1;
+                ++n_on;
+                if (0 == chp->clk_ena) {
+                    starting[k] = 1;
+                    ++n_start;
+                }
+            } else if (chp->clk_ena) {
+                // drive line low
+                if (write_ccr(mem_fd, msp, chp, TC_CCR_SWTRG | TC_CCR_CLKDIS,
+                              "SWTRG | CLKDIS"))
+                    return 1;
+                chp->clk_ena = 0;
+            }
+        }
+        if ((nchan > 1) && all && n_on && use_sync) {
+            // enable clocks then one software trigger for the whole TCB
+            for (k = 0, chp = chans; k < nchan; ++k, ++chp) {
+                if (starting[k]) {
+                    if (write_ccr(mem_fd, msp, chp, TC_CCR_CLKEN, "CLKEN"))
+                        return 1;
+                    chp->clk_ena = 1;
+                }
+            }
+            if (NULL == ((mmp = get_mmp(mem_fd, bcr, msp))))
+                return 1;
+            if (stp)
+                seg_now(stp);   /* TC_CV about to restart from 0 */
+            *mmp = TC_BCR_SYNC;
+            if (stp)
+                stp->last_cv = 0;
+            if (verbose > 1)
+                pr2serr("wrote: TC_BCR addr=0x%x, val=0x%x [SYNC]\n", bcr,
+                        TC_BCR_SYNC);
+        } else if ((nchan > 1) && all && n_on) {
+            // TCB0: restart each channel that is on, back to back
+            for (k = 0, chp = chans; k < nchan; ++k, ++chp) {
+                if (on[k]) {
+                    if (write_ccr(mem_fd, msp, chp,
+                                  TC_CCR_SWTRG | TC_CCR_CLKEN,
+                                  "SWTRG | CLKEN"))
+                        return 1;
+                    chp->clk_ena = 1;
+                }
+            }
+        } else if (n_start) {
+            // everything should be set up, start it ...
+            for (k = 0, chp = chans; k < nchan; ++k, ++chp) {
+                if (starting[k]) {
+                    if (write_ccr(mem_fd, msp, chp,
+                                  TC_CCR_SWTRG | TC_CCR_CLKEN,
+                                  "SWTRG | CLKEN"))
+                        return 1;
+                    chp->clk_ena = 1;
+                }
+            }
+        }
+
+#ifdef SA_INSTR
+        if (t > 0)
+            sa_stat_add(&bnd_written, bnd_late_ns(t_startp, stp, t));
+#endif
+        /* next boundary is the earliest end of a timed segment */
+        for (k = 0, t = -1, chp = chans; k < nchan; ++k, ++chp) {
+            if (chp->done || (chp->seg_arr[chp->cur].duration_ms < 0))
+                continue;       /* finished or continual */
+            if ((t < 0) || (chp->next_ms < t))
+                t = chp->next_ms;
+        }
+        if (t < 0)
+            break;
+        if (stp)
+            seg_wait(stp, (t * stp->tick_hz) / 1000);
+        else if (sleep_until(t_startp, t))
+            return 1;
+#ifdef SA_INSTR
+        sa_stat_add(&bnd_wake, bnd_late_ns(t_startp, stp, t));
+#endif
+        if (verbose > 1)
+            pr2serr("slept until %lld milliseconds from start\n", t);
+        for (k = 0, chp = chans; k < nchan; ++k, ++chp) {
+            changed[k] = 0;
+            if (chp->done || (chp->seg_arr[chp->cur].duration_ms < 0) ||
+                (chp->next_ms != t))
+                continue;
+            changed[k] = 1;
+            if (++chp->cur >= chp->num_segs)
+                chp->done = 1;
+            else
+                chp->next_ms += chp->seg_arr[chp->cur].duration_ms;
+        }
+    }
+    return 0;
+}
+
+
+/* Capture mode ('-C NUM'): TIOA of tp's channel is the input. Each falling
+ * edge is the external trigger (counter reset) and loads RB (so RB is the
+ * period), while the rising edge in between loads RA (so RB - RA is the
+ * mark). TC_SR is polled; the first capture (started mid period) is
+ * dropped. Reports period, frequency and duty statistics over num
+ * captures. Returns 0 if okay, else 1 . */
+static int
+do_capture(int mem_fd, struct mmap_state * msp, const struct table_io_t * tp,
+           int num, int tcclks)
+{
+    int k, have_ra, polls;
+    unsigned int sr, ra, rb, cmr;
+    unsigned int base = tc_addr(tp->ch, 0);
+    unsigned int overruns = 0;
+    unsigned int overflows = 0;
+    long long start_ms, now_ms;
+    double clk, per, duty, delta;
+    double per_min = 0.0, per_max = 0.0, per_mean = 0.0, per_m2 = 0.0;
+    double duty_min = 0.0, duty_max = 0.0, duty_sum = 0.0;
+    volatile unsigned int * srp;
+    volatile unsigned int * rap;
+    volatile unsigned int * rbp;
+    volatile unsigned int * mmp;
+    struct timespec ts;
+
+    clk = tc_tcclks_hz(tcclks, tc_tclock1);
+    if (clk <= 0.0)
+        clk = tc_tclock1;       /* XC0-2: assume '-R RF' is its rate */
+    cmr = TC_CMR_VAL_CAPT | tcclks;
+    if (NULL == ((mmp = get_mmp(mem_fd, base + TC_CMR_OFF, msp))))
+        return 1;
+    *mmp = cmr;
+    if (verbose > 1)
+        pr2serr("wrote: TC_CMR addr=0x%x, val=0x%x [capture]\n",
+                base + TC_CMR_OFF, cmr);
+    if ((NULL == ((srp = get_mmp(mem_fd, base + TC_SR_OFF, msp)))) ||
+        (NULL == ((rap = get_mmp(mem_fd, base + TC_RA_OFF, msp)))) ||
+        (NULL == ((rbp = get_mmp(mem_fd, base + TC_RB_OFF, msp)))) ||
+        (NULL == ((mmp = get_mmp(mem_fd, base + TC_CCR_OFF, msp)))))
+        return 1;
+    sr = *srp;          /* clears status */
+    *mmp = TC_CCR_SWTRG | TC_CCR_CLKEN;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    start_ms = (ts.tv_sec * 1000LL) + (ts.tv_nsec / 1000000);
+
+    for (k = -1, have_ra = 0, polls = 0; k < num; ) {
+        sr = *srp;
+        if (sr & TC_SR_LOVRS)
+            ++overruns;
+        if (sr & TC_SR_COVFS) {
+            ++overflows;        /* this period is longer than 2**32 ticks */
+            have_ra = 0;
+            if (sr & TC_SR_LDRBS)
+                continue;
+        }
+        if (sr & TC_SR_LDRAS)
+            have_ra = 1;
+        if (sr & TC_SR_LDRBS) {
+            ra = *rap;
+            rb = *rbp;
+            if (have_ra && (rb > 0) && (ra <= rb) && (k++ >= 0)) {
+                per = rb / clk;
+                duty = (double)(rb - ra) / rb;
+                if (verbose > 1)
+                    pr2serr("  [%d] RA=%u RB=%u: %.9f s, duty %.3f %%\n", k,
+                            ra, rb, per, duty * 100.0);
+                if ((1 == k) || (per < per_min))
+                    per_min = per;
+                if ((1 == k) || (per > per_max))
+                    per_max = per;
+                if ((1 == k) || (duty < duty_min))
+                    duty_min = duty;
+                if ((1 == k) || (duty > duty_max))
+                    duty_max = duty;
+                duty_sum += duty;
+                /* Welford's running mean and variance */
+                delta = per - per_mean;
+                per_mean += delta / k;
+                per_m2 += delta * (per - per_mean);
+            }
+            have_ra = 0;
+            polls = 0;
+            start_ms = -1;      /* edges seen, restart the timeout */
+        }
+        if (0 == (++polls & 0xfff)) {
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            now_ms = (ts.tv_sec * 1000LL) + (ts.tv_nsec / 1000000);
+            if (start_ms < 0)
+                start_ms = now_ms;
+            else if ((now_ms - start_ms) > CAPT_TIMEOUT_MS) {
+                pr2serr("no capture on %s for %d ms, %d of %d done\n",
+                        tp->tio_name, CAPT_TIMEOUT_MS, (k > 0) ? k : 0, num);
+                break;
+            }
+        }
+    }
+    *mmp = TC_CCR_CLKDIS;
+
+    printf("%s capture: %d periods, TCCLKS=%d (%.0f Hz), %u overruns, %u "
+           "overflows\n", tp->tio_name, (k > 0) ? k : 0, tcclks, clk,
+           overruns, overflows);
+    if (k <= 0)
+        return 1;
+    printf("  period: min %.9f s, mean %.9f s, max %.9f s, std dev %.3e s\n",
+           per_min, per_mean, per_max, (k > 1) ? sqrt(per_m2 / (k - 1)) : 0.0);
+    printf("  frequency: %.6f Hz (from mean period), min %.6f, max %.6f\n",
+           1.0 / per_mean, 1.0 / per_max, 1.0 / per_min);
+    printf("  duty: min %.3f %%, mean %.3f %%, max %.3f %%\n",
+           duty_min * 100.0, (duty_sum / k) * 100.0, duty_max * 100.0);
+    printf("  resolution: %.3e s (one tick)\n", 1.0 / clk);
+    return (k < num) ? 1 : 0;
+}
+
 int
 main(int argc, char * argv[])
 {
-    int mem_fd, k, n, opt, tc_clk_ena, want_clk, mps, peri_id;
-    unsigned int rc, rms, prev_rms, new_cmr, r, pmc_s, pmc_ed;
+    int mem_fd, k, j, n, opt, peri_id, nchan;
+    unsigned int r, pmc_s, pmc_ed;
     int got_div = 0;
     int have_continuous = 0;
     int pcr_gckdiv = 0;
@@ -765,40 +1260,55 @@ main(int argc, char * argv[])
     int no_sched = 0;
     int ref_freq = 0;
     int do_uninit = 0;
-    int mark = 1;
-    int space = 1;
     int ms_invert = 0;
-    int ms_given = 0;
     int wpen = 0;
     int wpen_given = 0;
-    int t_ind = -1;
-    const char * fname = NULL;
-    const char * pstring = NULL;
+    int seg_tc = -1;
+    int capt_num = 0;
+    int mark, space;
     char * cp;
     char b[16];
     struct elem_t * ep;
-    struct table_io_t * tp;
+    const struct table_io_t * tp;
+    struct chan_t * chp;
     volatile unsigned int * mmp;
-    struct timespec request;
-    FILE * input_filep = NULL;
+    struct timespec t_start;
+    struct seg_timer stmr;
+    FILE * input_filep;
     struct sched_param spr;
     struct mmap_state mstat;
     struct mmap_state * msp;
+    struct chan_t chans[MAX_CHANS];
 
     msp = &mstat;
-    memset(msp, 0, sizeof(mstat));
     mem_fd = -1;
-    while ((opt = getopt(argc, argv, "b:c:dDef:hiIm:Mnp:R:uvVw:")) != -1) {
+    memset(chans, 0, sizeof(chans));
+    memset(&stmr, 0, sizeof(stmr));
+    for (k = 0; k < MAX_CHANS; ++k) {
+        chans[k].t_ind = -1;
+        chans[k].mark = 1;
+        chans[k].space = 1;
+    }
+    nchan = 0;
+    chp = chans;        /* '-f', '-m' and '-p' go to the latest '-b' */
+    while ((opt = getopt(argc, argv, "b:c:C:dDef:hiIm:Mnp:R:t:uvVw:")) != -1) {
         switch (opt) {
             break;
         case 'b':
-            t_ind = find_table_index(optarg);
-            if (t_ind < 0) {
+            if (nchan >= MAX_CHANS) {
+                pr2serr("at most %d '-b TIO' options (one TC block)\n",
+                        MAX_CHANS);
+                return 1;
+            }
+            chp = chans + (nchan > 0 ? nchan : 0);
+            chp->t_ind = find_table_index(optarg);
+            if (chp->t_ind < 0) {
                 pr2serr("Unable to match given TIO of %s with available "
                         "names.\nTIOA0-5 and TIOB0-5 are the choices\n",
                         optarg);
                 return 1;
             }
+            ++nchan;
             break;
         case 'c':
             k = atoi(optarg);
@@ -809,6 +1319,13 @@ main(int argc, char * argv[])
             tcclks = k;
             tcclks_given = true;
             break;
+        case 'C':
+            capt_num = atoi(optarg);
+            if (capt_num < 1) {
+                pr2serr("'-C' expects the number of periods to capture\n");
+                return 1;
+            }
+            break;
         case 'd':
             ++dummy;
             break;
@@ -819,7 +1336,7 @@ main(int argc, char * argv[])
             ++do_enum;
             break;
         case 'f':
-            fname = optarg;
+            chp->fname = optarg;
             break;
         case 'h':
         case '?':
@@ -846,7 +1363,9 @@ main(int argc, char * argv[])
                 pr2serr("-m expects both numbers to be greater than zero\n");
                 return 1;
             }
-            ++ms_given;
+            chp->mark = mark;
+            chp->space = space;
+            ++chp->ms_given;
             break;
         case 'M':
             ++show_imr;
@@ -855,7 +1374,7 @@ main(int argc, char * argv[])
             ++no_sched;
             break;
         case 'p':
-            pstring = optarg;
+            chp->pstring = optarg;
             break;
         case 'R':
             k = fr_get_num(optarg);
@@ -865,6 +1384,14 @@ main(int argc, char * argv[])
             }
             ref_freq = k;
             break;
+        case 't':
+            k = atoi(optarg);
+            if ((k < 1) || (k > 5)) {
+                pr2serr("'-t' expects a TC channel from 1 to 5\n");
+                return 1;
+            }
+            seg_tc = k;
+            break;
         case 'u':
             ++do_uninit;
             break;
@@ -917,64 +1444,95 @@ main(int argc, char * argv[])
             printf("    %d: %s\n", vsp->val, vsp->str);
         return 0;
     }
+    if (0 == nchan)
+        nchan = 1;      /* options may still be for chans[0] */
+
+    for (j = 0, chp = chans; j < nchan; ++j, ++chp) {
+        if ((verbose > 3) && chp->ms_given)
+            pr2serr("-m option decodes mark=%d and space=%d\n", chp->mark,
+                    chp->space);
+        input_filep = NULL;
+        if (chp->fname) {
+            if ((1 == strlen(chp->fname)) && ('-' == chp->fname[0]))
+                input_filep = stdin;
+            else {
+                input_filep = fopen(chp->fname, "r");
+                if (NULL == input_filep) {
+                    pr2serr("failed to open %s:  ", chp->fname);
+                    perror("fopen()");
+                    goto clean_up;
+                }
+            }
+        }
 
-    if ((verbose > 3) && ms_given)
-        pr2serr("-m option decodes mark=%d and space=%d\n", mark, space);
-
-    if (fname) {
-        if ((1 == strlen(fname)) && ('-' == fname[0]))
-            input_filep = stdin;
-        else {
-            input_filep = fopen(fname, "r");
-            if (NULL == input_filep) {
-                pr2serr("failed to open %s:  ", fname);
-                perror("fopen()");
-                return 1;
+        if (NULL == elem_grow(&chp->elem_arr, &chp->elem_arr_len, 0))
+            goto clean_up;
+        if (chp->fname || chp->pstring) {
+            n = build_arr(input_filep, chp->pstring, &chp->elem_arr,
+                          &chp->elem_arr_len);
+            if (input_filep && (stdin != input_filep))
+                fclose(input_filep);
+            if (n) {
+                if (chp->fname)
+                    pr2serr("unable to decode contents of FN: %s\n",
+                            chp->fname);
+                else
+                    pr2serr("unable to decode '-p F1,D1[,F2,D2...]'\n");
+                goto clean_up;
             }
         }
-    }
 
-    if (fname || pstring) {
-        n = build_arr(input_filep, pstring, elem_arr, MAX_ELEMS - 1);
-        if (n) {
-            if (fname)
-                pr2serr("unable to decode contents of FN: %s\n", fname);
-            else
-                pr2serr("unable to decode '-p F1,D1[,F2,D2...]'\n");
-            return 1;
+        if (dummy || (verbose > 1)) {
+            if (nchan > 1)
+                printf("%s: ", table_arr[chp->t_ind].tio_name);
+            printf("build_arr after command line input processing:\n");
+            for (k = 0; ((0 != chp->elem_arr[k].frequency) ||
+                         (0 != chp->elem_arr[k].duration_ms)); ++k) {
+                ep = chp->elem_arr + k;
+                if (ep->frequency > 0)
+                    printf("    frequency: %d Hz,", ep->frequency);
+                else if (ep->frequency < 0)
+                    printf("    period: %d ms,", -ep->frequency);
+                else
+                    printf("    line is low,");
+                if (-1 == ep->duration_ms)
+                    printf("\tduration: continual\n");
+                else  if (ep->duration_ms > 0)
+                    printf("\tduration: %d ms\n", ep->duration_ms);
+                else
+                    printf("\tduration: %d is bad\n", ep->duration_ms);
+            }
         }
     }
-
-    if (dummy || (verbose > 1)) {
-        printf("build_arr after command line input processing:\n");
-        for (k = 0; ((0 != elem_arr[k].frequency) ||
-                     (0 != elem_arr[k].duration_ms)); ++k) {
-            ep = elem_arr + k;
-            if (ep->frequency > 0)
-                printf("    frequency: %d Hz,", ep->frequency);
-            else if (ep->frequency < 0)
-                printf("    period: %d ms,", -ep->frequency);
-            else
-                printf("    line is low,");
-            if (-1 == ep->duration_ms)
-                printf("\tduration: continual\n");
-            else  if (ep->duration_ms > 0)
-                printf("\tduration: %d ms\n", ep->duration_ms);
-            else
-                printf("\tduration: %d is bad\n", ep->duration_ms);
+    if (dummy) {
+        /* plan as if GCKDIV is 0 (or '-R RF' is TIMER_CLOCK1) */
+        if (ref_freq)
+            plan_src_hz = ref_freq;
+        for (j = 0, chp = chans; j < nchan; ++j, ++chp) {
+            chp->tp = (chp->t_ind >= 0) ? (table_arr + chp->t_ind) : NULL;
+            if (calc_chan(chp, ms_invert, tcclks_given ? tcclks : -1))
+                goto clean_up;
+            if (nchan > 1)
+                printf("%s: ", chp->tp->tio_name);
+            printf("plan, TIMER_CLOCK1=%.0f Hz when GCKDIV=0:\n",
+                   plan_src_hz);
+            print_plan(chp);
         }
-        if (dummy)
-            return 0;
+        res = 0;
+        goto clean_up;
     }
 
-    if ((0 == elem_arr[0].frequency) && (0 == elem_arr[0].duration_ms) &&
-        (0 == do_init) && (0 == do_uninit) && (0 == wpen_given) &&
-        (0 == show_imr)) {
+    for (j = 0, n = 0; j < nchan; ++j) {
+        if (chans[j].elem_arr[0].frequency || chans[j].elem_arr[0].duration_ms)
+            ++n;
+    }
+    if ((0 == n) && (0 == do_init) && (0 == do_uninit) &&
+        (0 == wpen_given) && (0 == show_imr) && (0 == capt_num)) {
         printf("Nothing to do so exit. Add '-h' for usage.\n");
-        return 1;
+        goto clean_up;
     }
 
-    if (t_ind < 0) {
+    if (chans[0].t_ind < 0) {
         pr2serr("'-b TIO' option is required!\n");
         if ((0 == do_init) && (0 == do_uninit) && (0 == wpen_given) &&
             (0 == show_imr)) {
@@ -982,23 +1540,63 @@ main(int argc, char * argv[])
             usage(1);
         } else
             pr2serr("Add '-h' for usage.\n");
-        return 1;
-    } else {
-        tp = table_arr + t_ind;
+        goto clean_up;
+    }
+    for (j = 0, chp = chans; j < nchan; ++j, ++chp) {
+        chp->tp = table_arr + chp->t_ind;
         if (verbose > 2)
-            pr2serr("t_ind=%d, entry points to %s, TCB%d\n", t_ind,
-                    tp->tio_name, tp->tcb);
+            pr2serr("t_ind=%d, entry points to %s, TCB%d\n", chp->t_ind,
+                    chp->tp->tio_name, chp->tp->tcb);
+        if (chp->tp->tcb != chans[0].tp->tcb) {
+            pr2serr("%s and %s are in different TC blocks, a combined "
+                    "start needs them in one\n", chans[0].tp->tio_name,
+                    chp->tp->tio_name);
+            goto clean_up;
+        }
+        for (k = 0; k < j; ++k) {
+            if ((chans[k].t_ind / 2) == (chp->t_ind / 2)) {
+                pr2serr("%s and %s share one TC channel (and its RC)\n",
+                        chans[k].tp->tio_name, chp->tp->tio_name);
+                goto clean_up;
+            }
+        }
+        if (seg_tc == (chp->t_ind / 2)) {
+            pr2serr("'-t %d' is the channel of %s\n", seg_tc,
+                    chp->tp->tio_name);
+            goto clean_up;
+        }
+    }
+    tp = chans[0].tp;
+    if (capt_num && ((nchan > 1) || (! tp->is_tioa) || (seg_tc >= 0))) {
+        pr2serr("'-C' captures on a single TIOAn (TIOBn is not an input "
+                "here) without '-t'\n");
+        goto clean_up;
+    }
+    if (capt_num && (chans[0].fname || chans[0].pstring)) {
+        pr2serr("'-C' measures an input so no waveform list ('-f' or '-p') "
+                "with it\n");
+        goto clean_up;
     }
     peri_id = (0 == tp->tcb) ? SAMA5D2_PERI_ID_TCB0 : SAMA5D2_PERI_ID_TCB1;
+    if (seg_tc >= 0) {
+        if ((seg_tc / 3) != tp->tcb) {
+            pr2serr("'-t %d' must be another channel in TCB%d (i.e. the "
+                    "same TC block as %s)\n", seg_tc, tp->tcb,
+                    tp->tio_name);
+            goto clean_up;
+        }
+    }
 
     if ((mem_fd = open(DEV_MEM, O_RDWR | O_SYNC)) < 0) {
         perror("open of " DEV_MEM " failed");
-        return 1;
+        goto clean_up;
     } else if (verbose)
         printf("open(" DEV_MEM ", O_RDWR | O_SYNC) okay\n");
+    init_mmap_state(msp, verbose);
 
     if (wpen_given) {
-        if (NULL == ((mmp = get_mmp(mem_fd, tp->tc_wpmr, msp))))
+        r = tcb_addr(tp->tcb) + TC_WPMR_OFF;
+        if (NULL == ((mmp = get_mmp(mem_fd, r, msp))))
             goto clean_up;
         if (-1 == wpen) {
             r = *mmp;
@@ -1010,7 +1608,8 @@ main(int argc, char * argv[])
     }
 
     if (show_imr) {
-        if (NULL == ((mmp = get_mmp(mem_fd, tp->tc_imr, msp))))
+        r = tc_addr(tp->ch, TC_IMR_OFF);
+        if (NULL == ((mmp = get_mmp(mem_fd, r, msp))))
             goto clean_up;
         r = *mmp;
         printf("TC interrupt mask register=0x%x\n", r);
@@ -1034,22 +1633,25 @@ main(int argc, char * argv[])
         }
     }
 
-    for (k = 0; (elem_arr[k].frequency || elem_arr[k].duration_ms); ++k) {
-        if (-1 == elem_arr[k].duration_ms) {
-            ++have_continuous;
-            break;
+    for (j = 0; j < nchan; ++j) {
+        ep = chans[j].elem_arr;
+        for (k = 0; (ep[k].frequency || ep[k].duration_ms); ++k) {
+            if (-1 == ep[k].duration_ms) {
+                ++have_continuous;
+                break;
+            }
         }
     }
-    if (do_init || have_continuous) {
+    if (do_init || have_continuous || capt_num) {
         if (verbose > 1)
             pr2serr("initializing TC\n");
-        if (NULL == ((mmp = get_mmp(mem_fd, tp->tc_ccr, msp))))
-            goto clean_up;
-        *mmp = TC_CCR_CLKDIS;
-        if (verbose > 1)
-            pr2serr("wrote: TC_CCR addr=0x%x, val=0x%x [CLKDIS]\n",
-                    tp->tc_ccr, TC_CCR_CLKDIS);
-
+        for (j = 0; j < nchan; ++j) {
+            if (write_ccr(mem_fd, msp, chans + j, TC_CCR_CLKDIS, "CLKDIS"))
+                goto clean_up;
+        }
+    }
+    /* the '-t' timer counts nothing unless the TCB's PMC clock is on */
+    if (do_init || have_continuous || capt_num || (seg_tc >= 0)) {
         if (peri_id < 32) {
             pmc_s = PMC_PCSR0;
             pmc_ed = PMC_PCER0;
@@ -1086,236 +1688,107 @@ main(int argc, char * argv[])
         }
     }
 
-    for (k = 0, prev_rms = 0, tc_clk_ena = 0;
-         (elem_arr[k].frequency || elem_arr[k].duration_ms); ++k) {
-        ep = elem_arr + k;
-        if (0 != ep->frequency) {
-            if (ep->frequency < 0) {
-                /* period = abs(ep->frequency) / 1000.0 seconds */
-                if (ep->frequency <= -131072000) {
-                    pr2serr("frequency[%d]=%d represent a period of %u "
-                            "seconds which\nis too large (131071.999 seconds "
-                            "is the limit)\n", k + 1, ep->frequency,
-                            (-ep->frequency) / 1000);
-                    goto clean_up;
-                }
-                else if ((-ep->frequency) > (INT_MAX / TIMER_CLOCK5))
-                    rc = ((-ep->frequency) / 1000) * TIMER_CLOCK5;
-                else
-                    rc = (-ep->frequency) * TIMER_CLOCK5 / 1000 ;
-                /* latter gives rc = 32768 for "freq" of -1000
-                 * (i.e. a period of 1000 ms (1 second) */
-                want_clk = 5;
-                if (verbose > 1)
-                    pr2serr("slow clocking from TIMER_CLOCK5 assumed to be %d "
-                            "Hz\n", TIMER_CLOCK5);
-            } else {    /* ep->frequency > 0 so it is an actual frequency */
-                if (! got_div) {
-                    if (NULL == ((mmp = get_mmp(mem_fd, PMC_PCR, msp))))
-                        goto clean_up;
-                    /* write a read cmd for given bn (in the PID field) */
-                    *mmp = peri_id;
-                    /* now read back result, DIV field should be populated */
-                    r = *mmp;
-                    pcr_gckdiv = (PMC_PCR_GCKDIV_MSK & r) >>
-                                 PMC_PCR_GCKDIV_SHIFT;
-                    ++got_div;
-                    if (verbose)
-                        pr2serr("read PMC_PCR: 0x%x, gckdiv=%d\n", r,
-                                pcr_gckdiv);
-                }
-                if (ref_freq)
-                    tc_tclock1 = ref_freq;
-                else if (pcr_gckdiv > 0)
-                    tc_tclock1 /= (pcr_gckdiv + 1);
-
-                /* since the SAMA5D2 has 32 bit counters just divide down the
-                 * highest speed clock (master_ clock/2: 83 MHz) */
-                rc = tc_tclock1 / ep->frequency;
-                if (rc < 2) {
-                    pr2serr("frequency[%d]=%d too high, limit: %d Hz "
-                            "(CLK1)\n", k + 1, ep->frequency, tc_tclock1 / 2);
-                    goto clean_up;
-                }
-                want_clk = 1;       /* 1 Hz to 41.5 MHz */
-                if (verbose > 1)
-                    pr2serr("clocking from TIMER_CLOCK1 assumed to be %d "
-                            "Hz\n", tc_tclock1);
-            }
-            // Check Channel Mode Register (TC_CMR), change if needed
-            switch (want_clk) {
-            case 1:
-                new_cmr = TC_CMR_VAL_CLK1;
-                break;
-            case 5:
-                new_cmr = TC_CMR_VAL_CLK5;
-                break;
-            default:
-                pr2serr("frequency[%d]=%d, bad want_clk=%d\n", k + 1,
-                        ep->frequency, want_clk);
-                goto clean_up;
-            }
-            if (tcclks_given)
-                new_cmr = tcclks;       /* override want_clk, think about */
-            new_cmr |= ((tp->is_tioa == ms_invert) ? TC_CMR_MS_INV_MASK :
-                                                     TC_CMR_MS_MASK);
-            if (NULL == ((mmp = get_mmp(mem_fd, tp->tc_cmr, msp))))
-                goto clean_up;
-            if (new_cmr != *mmp) {
-                *mmp = new_cmr;
-                if (verbose > 1)
-                    pr2serr("wrote: TC_CMR addr=0x%x, val=0x%x\n", tp->tc_cmr,
-                            *mmp);
-            } else if (verbose > 2)
-                pr2serr(" did not write TC_CMR addr=0x%x because val=0x%x "
-                        "already\n", tp->tc_cmr, *mmp);
-            // Caclculate the mark space ratio in order to set RA and RB
-            mps = mark + space;
-            if (rc > USHRT_MAX) {
-                if ((mps > SHRT_MAX) || ((rc / mps) < 100)) {
-                    if (mark >= space)
-                        rms = (rc * space) / mps;
-                    else {
-                        /* (rc * space) may overflow so use mark */
-                        rms = (rc * mark) / mps;
-                        rms = rc - rms;
-                    }
-                } else {
-                    if (mark >= space)
-                        rms = (rc / mps) * space;
-                    else {
-                        rms = (rc / mps) * mark;
-                        rms = rc - rms;
-                    }
-                }
-            } else {
-                if (mark >= space)
-                    rms = (rc * space) / mps;
-                else {
-                    rms = (rc * mark) / mps;
-                    rms = rc - rms;
-                }
-            }
-            if (0 == rms) {
-                pr2serr("mark+space too large, please reduce\n");
-                goto clean_up;
-            }
-            // rms = rc / 2;           // use 1:1 mark space ratio
-            // rms = rc * 1 / 5;       // use 4:1 mark space ratio
-            // rms = rc * 4 / 5;       // use 1:4 mark space ratio
-            if (rc > prev_rms) {
-                // set up RC prior to RA and RB
-                if (NULL == ((mmp = get_mmp(mem_fd, tp->tc_rc, msp))))
-                    goto clean_up;
-                *mmp = rc;
-                if (NULL == ((mmp = get_mmp(mem_fd, tp->tc_ra, msp))))
-                    goto clean_up;
-                *mmp = rms;
-                if (NULL == ((mmp = get_mmp(mem_fd, tp->tc_rb, msp))))
-                    goto clean_up;
-                *mmp = rc - rms;
-                if (verbose > 1) {
-                    pr2serr("TC_RC,A,B addr=0x%x,%x,%x val=%u,%u,%u",
-                            tp->tc_rc, tp->tc_ra, tp->tc_rb,
-                            rc, rms, rc - rms);
-                    if (verbose > 2)
-                        pr2serr("\n       [0x%x,0x%x,0x%x]\n", rc, rms,
-                                rc - rms);
-                    else
-                        pr2serr("\n");
-                }
-            } else {
-                // set up RA and RB prior to RC
-                if (NULL == ((mmp = get_mmp(mem_fd, tp->tc_ra, msp))))
-                    goto clean_up;
-                *mmp = rms;
-                if (NULL == ((mmp = get_mmp(mem_fd, tp->tc_rb, msp))))
-                    goto clean_up;
-                *mmp = rc - rms;
-                if (NULL == ((mmp = get_mmp(mem_fd, tp->tc_rc, msp))))
-                    goto clean_up;
-                *mmp = rc;
-                if (verbose > 1) {
-                    pr2serr("TC_RA,B,C addr=0x%x,0x%x,0x%x val=%u,%u,%u",
-                            tp->tc_ra, tp->tc_rb, tp->tc_rc, rms, rc - rms,
-                            rc);
-                    if (verbose > 2)
-                        pr2serr("\n       [0x%x,0x%x,0x%x]\n", rms, rc - rms,
-                                rc);
-                    else
-                        pr2serr("\n");
-                }
-            }
-            prev_rms = (rms >= (rc - rms)) ? rms : (rc - rms);
-            if (0 == tc_clk_ena) {
-                // everything should be set up, start it ...
-                if (NULL == ((mmp = get_mmp(mem_fd, tp->tc_ccr, msp))))
-                    goto clean_up;
-                *mmp = TC_CCR_SWTRG | TC_CCR_CLKEN;
-                if (verbose > 1)
-                    pr2serr("wrote: TC_CCR addr=0x%x, val=0x%x [SWTRG | "
-                            "CLKEN]\n", tp->tc_ccr,
-                            TC_CCR_SWTRG | TC_CCR_CLKEN);
-                tc_clk_ena = 1;
-            }
-        } else if (tc_clk_ena) {
-            // drive line low
-            if (NULL == ((mmp = get_mmp(mem_fd, tp->tc_ccr, msp))))
-                goto clean_up;
-            *mmp = TC_CCR_SWTRG | TC_CCR_CLKDIS;
-            if (verbose > 1)
-                pr2serr("wrote: TC_CCR addr=0x%x, val=0x%x [SWTRG | "
-                        "CLKDIS]\n", tp->tc_ccr,
-                        TC_CCR_SWTRG | TC_CCR_CLKDIS);
-            tc_clk_ena = 0;
-        }
+    if (! got_div) {
+        if (NULL == ((mmp = get_mmp(mem_fd, PMC_PCR, msp))))
+            goto clean_up;
+        /* write a read cmd for given bn (in the PID field) */
+        *mmp = peri_id;
+        /* now read back result, DIV field should be populated */
+        r = *mmp;
+        pcr_gckdiv = (PMC_PCR_GCKDIV_MSK & r) >> PMC_PCR_GCKDIV_SHIFT;
+        ++got_div;
+        if (verbose)
+            pr2serr("read PMC_PCR: 0x%x, gckdiv=%d\n", r, pcr_gckdiv);
+    }
+    if (ref_freq)
+        tc_tclock1 = ref_freq;
+    else if (pcr_gckdiv > 0)
+        tc_tclock1 /= (pcr_gckdiv + 1);
+    plan_src_hz = (double)tc_tclock1 * (pcr_gckdiv + 1);
+    plan_gckdiv = pcr_gckdiv;
+    if ((seg_tc >= 0) && ((tc_tclock1 / SEG_TCCLK_DIV) < SEG_MIN_HZ)) {
+        pr2serr("'-t %d' counts TIMER_CLOCK1/%d which is %u Hz, needs at "
+                "least %d Hz\nfor millisecond boundaries\n", seg_tc,
+                SEG_TCCLK_DIV, tc_tclock1 / SEG_TCCLK_DIV, SEG_MIN_HZ);
+        goto clean_up;
+    }
 
-        if (ep->duration_ms < 0)
-            break;      /* leave loop when continuous detected */
-        else if (ep->duration_ms > 0) {
-            request.tv_sec = ep->duration_ms / 1000;
-            request.tv_nsec = (ep->duration_ms % 1000) * 1000000;
-            if (nanosleep(&request, NULL) < 0) {
-                perror("nanosleep");
-                goto clean_up;
-            }
-            if (verbose > 1)
-                pr2serr("slept for %d milliseconds\n", ep->duration_ms);
-        }
+    if (capt_num) {
+        res = do_capture(mem_fd, msp, tp, capt_num,
+                         tcclks_given ? tcclks : TC_CMR_TCCLKS_DEF);
+        goto clean_up;
     }
 
-    if ((tc_clk_ena) && (0 == have_continuous)) {
-        // drive line low
-        if (NULL == ((mmp = get_mmp(mem_fd, tp->tc_ccr, msp))))
+    /* all register values are worked out before anything is started */
+    for (j = 0; j < nchan; ++j) {
+        if (calc_chan(chans + j, ms_invert, tcclks_given ? tcclks : -1))
             goto clean_up;
-        *mmp = TC_CCR_SWTRG | TC_CCR_CLKDIS;
-        if (verbose > 1)
-            pr2serr("wrote: TC_CCR addr=0x%x, val=0x%x [SWTRG | CLKDIS]\n",
-                    tp->tc_ccr, TC_CCR_SWTRG | TC_CCR_CLKDIS);
-        tc_clk_ena = 0;
     }
 
-    if (do_uninit) {
-        // disable clock within TC
-        if (NULL == ((mmp = get_mmp(mem_fd, tp->tc_ccr, msp))))
+    if (seg_tc >= 0) {
+        r = tc_addr(seg_tc, TC_CCR_OFF);
+        if (NULL == ((mmp = get_mmp(mem_fd, r, msp))))
             goto clean_up;
         *mmp = TC_CCR_CLKDIS;
+        if (NULL == ((mmp = get_mmp(mem_fd, r + TC_CMR_OFF, msp))))
+            goto clean_up;
+        *mmp = TC_CMR_VAL_SEG;
+        if (NULL == ((stmr.cvp = get_mmp(mem_fd, r + TC_CV_OFF, msp))))
+            goto clean_up;
+        if (NULL == ((mmp = get_mmp(mem_fd, r, msp))))
+            goto clean_up;
+        stmr.tick_hz = tc_tclock1 / SEG_TCCLK_DIV;
+        *mmp = TC_CCR_SWTRG | TC_CCR_CLKEN;
+        stmr.last_cv = *stmr.cvp;
+        if (seg_started(&stmr)) {
+            pr2serr("segment timer TC%d is not counting\n", seg_tc);
+            goto clean_up;
+        }
         if (verbose > 1)
-            pr2serr("wrote: TC_CCR addr=0x%x, val=0x%x [CLKDIS]\n",
-                    tp->tc_ccr, TC_CCR_CLKDIS);
+            pr2serr("segment timer TC%d started at %u Hz\n", seg_tc,
+                    stmr.tick_hz);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t_start);
+
+    if (play_chans(mem_fd, msp, chans, nchan, (seg_tc >= 0) ? &stmr : NULL,
+                   &t_start))
+        goto clean_up;
+    if ((seg_tc >= 0) && verbose)
+        pr2serr("segment timer: %d boundaries, worst overshoot %lld ns\n",
+                stmr.boundaries, (stmr.max_late * 1000000000LL) /
+                                 stmr.tick_hz);
+#ifdef SA_INSTR
+    pr2serr("segment boundaries (%s scheduling, %s):\n",
+            (no_sched ? "normal" : "SCHED_FIFO"),
+            ((seg_tc >= 0) ? "TC timed" : "clock_nanosleep"));
+    sa_stat_print(stderr, "  lateness on waking", &bnd_wake, 1000.0, "us");
+    sa_stat_print(stderr, "  after register writes", &bnd_written, 1000.0,
+                  "us");
+#endif
+
+    if (do_uninit) {
+        // disable clock within TC
+        for (j = 0; j < nchan; ++j) {
+            if (write_ccr(mem_fd, msp, chans + j, TC_CCR_CLKDIS, "CLKDIS"))
+                goto clean_up;
+        }
     }
     res = 0;
 
 clean_up:
-    if (msp->mmap_ok) {
-        if (-1 == munmap(mstat.mmap_ptr, MAP_SIZE)) {
-            pr2serr("mmap_ptr=%p:\n", mstat.mmap_ptr);
-            perror("    munmap");
-            res = 1;
-        } else if (verbose > 2)
-            pr2serr("trailing munmap() ok, mmap_ptr=%p\n", mstat.mmap_ptr);
+    if ((seg_tc >= 0) && stmr.cvp) {
+        mmp = get_mmp(mem_fd, tc_addr(seg_tc, TC_CCR_OFF), msp);
+        if (mmp)
+            *mmp = TC_CCR_CLKDIS;
     }
-    if (mem_fd >= 0)
+    if (mem_fd >= 0) {
+        if (release_mmap_state(msp))
+            res = 1;
         close(mem_fd);
+    }
+    for (j = 0; j < MAX_CHANS; ++j) {
+        free(chans[j].elem_arr);
+        free(chans[j].seg_arr);
+    }
     return res;
 }
@@ -0,0 +1,344 @@
+/*
+ * Copyright (c) 2026 Douglas Gilbert.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+/*****************************************************************
+ * gpio_cdev.c
+ *
+ * Thin wrapper around the GPIO v2 character device uAPI, shared by
+ * gpio_sysfs, readbits and setbits. See gpio_cdev.h .
+ *
+ ****************************************************/
+
+#define _XOPEN_SOURCE 500
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+
+#include "gpio_cdev.h"
+
+
+/* Accepts "PC7", "C7" or "pc7" (offset: bank * 32 + bit number as used by
+ * the SAMA5D2 PIO4 driver's single 128 line chip) or a decimal offset. */
+static int
+gc_parse_line(const char * cp, unsigned int * offp)
+{
+    int k, bank = -1;
+    char * endp;
+
+    if (isalpha((unsigned char)cp[0])) {
+        if (('P' == toupper((unsigned char)cp[0])) &&
+            isalpha((unsigned char)cp[1]))
+            ++cp;
+        bank = toupper((unsigned char)cp[0]) - 'A';
+        if ((bank < 0) || (bank > 3))
+            return -1;
+        ++cp;
+    }
+    if (! isdigit((unsigned char)cp[0]))
+        return -1;
+    k = strtol(cp, &endp, 10);
+    if (('\0' != *endp) || (k < 0) || ((bank >= 0) && (k > 31)))
+        return -1;
+    *offp = (bank >= 0) ? (unsigned int)((bank * 32) + k) : (unsigned int)k;
+    return 0;
+}
+
+int
+gc_parse_lines(const char * list, unsigned int * offsets, int max_num)
+{
+    int num;
+    const char * cp;
+    const char * np;
+    char b[32];
+
+    for (num = 0, cp = list; ; cp = np + 1) {
+        np = strchr(cp, ',');
+        if (NULL == np)
+            np = cp + strlen(cp);
+        if ((np == cp) || ((np - cp) >= (int)sizeof(b)))
+            goto bad;
+        if (num >= max_num) {
+            fprintf(stderr, "at most %d lines in list\n", max_num);
+            return -1;
+        }
+        memcpy(b, cp, np - cp);
+        b[np - cp] = '\0';
+        if (gc_parse_line(b, offsets + num))
+            goto bad;
+        ++num;
+        if ('\0' == *np)
+            break;
+    }
+    return num;
+bad:
+    fprintf(stderr, "bad line list: %s ; expect something like "
+            "'PA3,PC7' or '67,68'\n", list);
+    return -1;
+}
+
+
+#ifdef GPIO_V2_GET_LINE_IOCTL
+
+static uint64_t
+gc_v2_flags(unsigned int flags)
+{
+    uint64_t v2 = 0;
+
+    if (flags & GC_FL_OUTPUT)
+        v2 |= GPIO_V2_LINE_FLAG_OUTPUT;
+    else if (flags & (GC_FL_INPUT | GC_FL_EDGE_RISING | GC_FL_EDGE_FALLING))
+        v2 |= GPIO_V2_LINE_FLAG_INPUT;
+    if (flags & GC_FL_EDGE_RISING)
+        v2 |= GPIO_V2_LINE_FLAG_EDGE_RISING;
+    if (flags & GC_FL_EDGE_FALLING)
+        v2 |= GPIO_V2_LINE_FLAG_EDGE_FALLING;
+    if (flags & GC_FL_OPEN_DRAIN)
+        v2 |= GPIO_V2_LINE_FLAG_OPEN_DRAIN;
+    if (flags & GC_FL_PULL_UP)
+        v2 |= GPIO_V2_LINE_FLAG_BIAS_PULL_UP;
+    else if (flags & GC_FL_PULL_DOWN)
+        v2 |= GPIO_V2_LINE_FLAG_BIAS_PULL_DOWN;
+    return v2;
+}
+
+static void
+gc_build_config(struct gpio_v2_line_config * cfp, int num,
+                unsigned int flags, uint64_t out_vals)
+{
+    memset(cfp, 0, sizeof(*cfp));
+    cfp->flags = gc_v2_flags(flags);
+    if (flags & GC_FL_OUTPUT) {
+        cfp->num_attrs = 1;
+        cfp->attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+        cfp->attrs[0].attr.values = out_vals;
+        cfp->attrs[0].mask = (num < 64) ? ((1ULL << num) - 1) : ~0ULL;
+    }
+}
+
+int
+gc_open_chip(const char * name, int * num_linesp, int verbose)
+{
+    int fd;
+    struct gpiochip_info ci;
+    char b[128];
+
+    if (isdigit((unsigned char)name[0]))
+        snprintf(b, sizeof(b), "/dev/gpiochip%s", name);
+    else if (NULL == strchr(name, '/'))
+        snprintf(b, sizeof(b), "/dev/%s", name);
+    else
+        snprintf(b, sizeof(b), "%s", name);
+    fd = open(b, O_RDWR);
+    if (fd < 0) {
+        fprintf(stderr, "Open %s: %s\n", b, strerror(errno));
+        return -1;
+    }
+    memset(&ci, 0, sizeof(ci));
+    if (ioctl(fd, GPIO_GET_CHIPINFO_IOCTL, &ci) < 0) {
+        fprintf(stderr, "%s: GPIO_GET_CHIPINFO_IOCTL: %s\n", b,
+                strerror(errno));
+        close(fd);
+        return -1;
+    }
+    if (verbose > 1)
+        fprintf(stderr, "%s: name=%s, label=%s, %u lines\n", b, ci.name,
+                ci.label, ci.lines);
+    if (num_linesp)
+        *num_linesp = (int)ci.lines;
+    return fd;
+}
+
+int
+gc_request_lines(int chip_fd, const unsigned int * offsets, int num,
+                 unsigned int flags, uint64_t out_vals, int ev_buf_sz,
+                 int verbose)
+{
+    int k;
+    struct gpio_v2_line_request lr;
+
+    if ((num < 1) || (num > GC_MAX_LINES)) {
+        fprintf(stderr, "%s: can request 1 to %d lines, not %d\n", __func__,
+                GC_MAX_LINES, num);
+        errno = EINVAL;
+        return -1;
+    }
+    memset(&lr, 0, sizeof(lr));
+    for (k = 0; k < num; ++k)
+        lr.offsets[k] = offsets[k];
+    lr.num_lines = num;
+    snprintf(lr.consumer, sizeof(lr.consumer), "%s", GC_CONSUMER);
+    gc_build_config(&lr.config, num, flags, out_vals);
+    if (ev_buf_sz > 0)
+        lr.event_buffer_size = ev_buf_sz;
+    if (ioctl(chip_fd, GPIO_V2_GET_LINE_IOCTL, &lr) < 0) {
+        fprintf(stderr, "GPIO_V2_GET_LINE_IOCTL (offset %u%s) failed (in "
+                "use?): %s\n", offsets[0], ((num > 1) ? ", ..." : ""),
+                strerror(errno));
+        return -1;
+    }
+    if (verbose > 2)
+        fprintf(stderr, "requested %d line(s), flags=0x%x, fd=%d\n", num,
+                flags, lr.fd);
+    return lr.fd;
+}
+
+int
+gc_set_config(int line_fd, int num, unsigned int flags, uint64_t out_vals)
+{
+    struct gpio_v2_line_config cf;
+
+    gc_build_config(&cf, num, flags, out_vals);
+    if (ioctl(line_fd, GPIO_V2_LINE_SET_CONFIG_IOCTL, &cf) < 0) {
+        fprintf(stderr, "GPIO_V2_LINE_SET_CONFIG_IOCTL failed: %s\n",
+                strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+int
+gc_get_values(int line_fd, int num, uint64_t * valsp)
+{
+    struct gpio_v2_line_values lv;
+
+    lv.bits = 0;
+    lv.mask = (num < 64) ? ((1ULL << num) - 1) : ~0ULL;
+    if (ioctl(line_fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &lv) < 0) {
+        fprintf(stderr, "GPIO_V2_LINE_GET_VALUES_IOCTL failed: %s\n",
+                strerror(errno));
+        return -1;
+    }
+    *valsp = lv.bits;
+    return 0;
+}
+
+int
+gc_set_values(int line_fd, uint64_t mask, uint64_t bits)
+{
+    struct gpio_v2_line_values lv;
+
+    lv.bits = bits;
+    lv.mask = mask;
+    if (ioctl(line_fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &lv) < 0) {
+        fprintf(stderr, "GPIO_V2_LINE_SET_VALUES_IOCTL failed: %s\n",
+                strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+int
+gc_read_events(int line_fd, struct gc_event * evp, int max_ev)
+{
+    int k, n;
+    ssize_t res;
+    struct gpio_v2_line_event ev_arr[GC_MAX_EVENTS];
+
+    if (max_ev > (int)(sizeof(ev_arr) / sizeof(ev_arr[0])))
+        max_ev = sizeof(ev_arr) / sizeof(ev_arr[0]);
+    res = read(line_fd, ev_arr, max_ev * sizeof(ev_arr[0]));
+    if (res < 0) {
+        if (EINTR != errno)
+            fprintf(stderr, "read() of line events failed: %s\n",
+                    strerror(errno));
+        return -1;
+    }
+    n = res / sizeof(ev_arr[0]);
+    for (k = 0; k < n; ++k, ++evp) {
+        evp->ts_ns = ev_arr[k].timestamp_ns;
+        evp->offset = ev_arr[k].offset;
+        evp->line_seqno = ev_arr[k].line_seqno;
+        evp->rising = (GPIO_V2_LINE_EVENT_RISING_EDGE == ev_arr[k].id);
+    }
+    return n;
+}
+
+#else   /* kernel headers lack GPIO v2 uAPI */
+
+int
+gc_open_chip(const char * name, int * num_linesp, int verbose)
+{
+    if (num_linesp || verbose) { }      /* suppress warning */
+    fprintf(stderr, "%s: built without GPIO v2 uAPI (needs lk 5.10 "
+            "headers)\n", name);
+    errno = ENOSYS;
+    return -1;
+}
+
+int
+gc_request_lines(int chip_fd, const unsigned int * offsets, int num,
+                 unsigned int flags, uint64_t out_vals, int ev_buf_sz,
+                 int verbose)
+{
+    if (chip_fd || offsets || num || flags || out_vals || ev_buf_sz ||
+        verbose) { }
+    errno = ENOSYS;
+    return -1;
+}
+
+int
+gc_set_config(int line_fd, int num, unsigned int flags, uint64_t out_vals)
+{
+    if (line_fd || num || flags || out_vals) { }
+    errno = ENOSYS;
+    return -1;
+}
+
+int
+gc_get_values(int line_fd, int num, uint64_t * valsp)
+{
+    if (line_fd || num || valsp) { }
+    errno = ENOSYS;
+    return -1;
+}
+
+int
+gc_set_values(int line_fd, uint64_t mask, uint64_t bits)
+{
+    if (line_fd || mask || bits) { }
+    errno = ENOSYS;
+    return -1;
+}
+
+int
+gc_read_events(int line_fd, struct gc_event * evp, int max_ev)
+{
+    if (line_fd || evp || max_ev) { }
+    errno = ENOSYS;
+    return -1;
+}
+
+#endif
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2026 Douglas Gilbert.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+#ifndef GPIO_CDEV_H
+#define GPIO_CDEV_H
+
+/*****************************************************************
+ * gpio_cdev.h
+ *
+ * GPIO access via the Linux GPIO character device (/dev/gpiochipN) using
+ * the version 2 uAPI (lk 5.10 and later). Unlike the sysfs interface no
+ * export or unexport is needed: lines are requested (several at once if
+ * wanted) and released when the returned file descriptor is closed. The
+ * values of up to GC_MAX_LINES lines are read or written with one ioctl
+ * and edge events, each with a kernel timestamp, are read in batches.
+ * The GPIO v2 structures are kept out of this header so callers build
+ * against older kernel headers; then every call fails with ENOSYS.
+ *
+ ****************************************************/
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GC_DEF_CHIP "/dev/gpiochip0"
+#define GC_MAX_LINES 64         /* GPIO_V2_LINES_MAX */
+#define GC_MAX_EVENTS 64        /* most events read() at once */
+#define GC_CONSUMER "sama5d2_utils"
+
+/* Line flags for gc_request_lines() and gc_set_config() */
+#define GC_FL_INPUT 0x1
+#define GC_FL_OUTPUT 0x2
+#define GC_FL_EDGE_RISING 0x4   /* implies input */
+#define GC_FL_EDGE_FALLING 0x8  /* implies input */
+#define GC_FL_OPEN_DRAIN 0x10   /* with GC_FL_OUTPUT */
+#define GC_FL_PULL_UP 0x20
+#define GC_FL_PULL_DOWN 0x40
+
+struct gc_event {
+    uint64_t ts_ns;             /* CLOCK_MONOTONIC, taken in the kernel */
+    uint32_t offset;            /* line offset within chip */
+    uint32_t line_seqno;        /* a gap means the kernel dropped events */
+    int rising;                 /* 1 for rising edge, 0 for falling */
+};
+
+/* Parses a comma separated list of lines, each either a name like "PC7"
+ * or "c7" (offset is bank * 32 + bit number, the SAMA5D2 convention) or a
+ * decimal offset, into offsets[]. Returns number of lines or -1 if
+ * problem (after printing a message). Works without GPIO v2 uAPI. */
+int gc_parse_lines(const char * list, unsigned int * offsets, int max_num);
+
+/* Opens gpio chip 'name' which may be a number ("0"), a device name
+ * ("gpiochip0") or a path. If num_linesp is non-NULL the number of lines
+ * the chip has is written to it. Returns chip fd or -1 if problem. */
+int gc_open_chip(const char * name, int * num_linesp, int verbose);
+
+/* Requests 'num' lines (offsets in offsets[]) from the chip 'chip_fd' with
+ * 'flags' (GC_FL_*). If GC_FL_OUTPUT, bit k of 'out_vals' is the initial
+ * value of offsets[k]. 'ev_buf_sz' is the kernel's event buffer size in
+ * events (0 for its default). Returns line fd or -1 if problem. */
+int gc_request_lines(int chip_fd, const unsigned int * offsets, int num,
+                     unsigned int flags, uint64_t out_vals, int ev_buf_sz,
+                     int verbose);
+
+/* Changes flags (e.g. input to output) of all 'num' lines held by line_fd.
+ * Returns 0 if okay, else -1 . */
+int gc_set_config(int line_fd, int num, unsigned int flags,
+                  uint64_t out_vals);
+
+/* Reads the values of the 'num' lines held by line_fd into *valsp (bit k
+ * for the k-th requested line). Returns 0 if okay, else -1 . */
+int gc_get_values(int line_fd, int num, uint64_t * valsp);
+
+/* Sets the lines held by line_fd, selected by 'mask', to 'bits'. Returns 0
+ * if okay, else -1 . */
+int gc_set_values(int line_fd, uint64_t mask, uint64_t bits);
+
+/* Reads up to 'max_ev' queued edge events with one read() (blocks if none
+ * queued). Returns number of events placed in evp[] or -1 if problem. */
+int gc_read_events(int line_fd, struct gc_event * evp, int max_ev);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
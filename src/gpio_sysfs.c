@@ -33,7 +33,8 @@
  * Utility for testing SAMA5D2 family GPIO pins. Can read, set and toggle
  * GPIO lines. The SAMA5D2 family has 4 banks of 32 pins: PA0-PA31,
  * PB0-PB31, PC0-PC31 and PD0-31. Some GPIO pins may be committed to other
- * uses thus not available. Uses sysfs gpio(lib) interface.
+ * uses thus not available. Uses sysfs gpio(lib) interface or, with
+ * '-C CHIP', the GPIO character device (see gpio_cdev.h).
  *
  ****************************************************/
 
@@ -52,9 +53,14 @@
 #include <errno.h>
 #include <poll.h>
 #include <sched.h>
+#include <stdint.h>
+#include <math.h>
 
+#include "gpio_cdev.h"
+#include "sa_misc.h"
 
-static const char * version_str = "1.12 20180730";
+
+static const char * version_str = "1.14 20261014";
 
 #define EXPORT_FILE "/sys/class/gpio/export"
 #define UNEXPORT_FILE "/sys/class/gpio/unexport"
@@ -74,6 +80,8 @@ static const char * version_str = "1.12 20180730";
 #define DEF_NUM_TOGGLE 1000000
 #define PIO_BANKS_SAMA5D2 4
 #define LINES_PER_BANK 32
+#define CDEV_EV_BUF_SZ 1024     /* kernel's edge event buffer for '-C' */
+#define HIST_BINS 16            /* for '-m MAX' period histogram */
 
 
 static int verbose = 0;
@@ -84,8 +92,9 @@ static void
 usage(void)
 {
     fprintf(stderr, "Usage: "
-            "gpio_sysfs [-b BN] [-c] [-d USEC] [-e] [-f] [-h] [-n NUM]\n"
-            "                  [-p PORT] [-r] [-R] [-s 0|1] [-t] "
+            "gpio_sysfs [-b BN] [-c] [-C CHIP] [-d USEC] [-e] [-f] [-h] "
+            "[-m MAX]\n"
+            "                  [-n NUM] [-p PORT] [-r] [-R] [-s 0|1] [-t] "
             "[-u] [-U]\n"
             "                  [-v] [-V]\n"
             "  where:\n"
@@ -99,6 +108,11 @@ usage(void)
             "twice:\n"
             "                 count falling edges, thrice ('-ccc'): count "
             "all edges\n"
+            "    -C CHIP      use GPIO character device CHIP (e.g. '0' or "
+            "'gpiochip0')\n"
+            "                 rather than sysfs. Line offset is bank*32+BN "
+            "or PORT\n"
+            "                 when a number. '-u' and '-U' ignored\n"
             "    -d USEC      with '-t': delay after each transition (def: "
             "0)\n"
             "                 with '-c': duration to count (def: 1000000 "
@@ -109,6 +123,10 @@ usage(void)
             "for high\n"
             "                 is input mode and assume pullup)\n"
             "    -h           print usage message\n"
+            "    -m MAX       with '-c': timestamp up to MAX edges then "
+            "report period,\n"
+            "                 frequency, jitter (and duty with '-ccc') plus "
+            "a histogram\n"
             "    -n NUM       number of cycles to toggle gpio line (def: "
             "1000000)\n"
             "    -p PORT      port bank ('A' to 'E') or gpio kernel line "
@@ -127,22 +145,13 @@ usage(void)
             "with '-S')\n"
             "    -v           increase verbosity (multiple times for more)\n"
             "    -V           print version string then exit\n\n"
-            "SAMA5D2 SoC family GPIO test program. Uses sysfs interface.\n"
+            "SAMA5D2 SoC family GPIO test program. Uses sysfs interface "
+            "(or gpiochip).\n"
             "Can set and read lines. Can toggle line ('-t') NUM times with "
             "USEC\ndelay after to each transition. Beware: counting over "
             "20,000\nevents per second may starve (freeze) the kernel.\n");
 }
 
-static char *
-get_best_gpio_name(int knum, char * b, int blen)
-{
-    if (gpio_name)
-        snprintf(b, blen, "%s [kn=%d]", gpio_name, blen);
-    else
-        snprintf(b, blen, "knum=%d", knum);
-    return b;
-}
-
 static int
 gs_export(int * exp_fdp, int knum)
 {
@@ -153,7 +162,8 @@ gs_export(int * exp_fdp, int knum)
     res = pwrite(*exp_fdp, b, strlen(b), 0);
     if (res < 0)
         fprintf(stderr, "Unable to export %s (already in use?): %s\n",
-                get_best_gpio_name(knum, b, sizeof(b)), strerror(errno));
+                best_gpio_name(gpio_name, knum, b, sizeof(b)),
+                strerror(errno));
     return res;
 }
 
@@ -167,7 +177,8 @@ gs_unexport(int * unexp_fdp, int knum)
     res = pwrite(*unexp_fdp, b, strlen(b), 0);
     if (res < 0)
         fprintf(stderr, "Unable to unexport %s: %s\n",
-                get_best_gpio_name(knum, b, sizeof(b)), strerror(errno));
+                best_gpio_name(gpio_name, knum, b, sizeof(b)),
+                strerror(errno));
     return res;
 }
 
@@ -217,15 +228,170 @@ millisecs_rem(const struct timespec * fin_tsp)
                 ((fin_tsp->tv_nsec - now_ts.tv_nsec) / 1000000));
 }
 
+/* Edge capture for '-m MAX' (with '-c'). The count loops only store a
+ * timestamp (and level) per edge; all statistics are done afterwards by
+ * report_edges(). */
+struct edge_cap {
+    uint64_t * ts_arr;          /* nanoseconds, CLOCK_MONOTONIC */
+    unsigned char * rise_arr;   /* 1 for rising edge, 0 for falling */
+    int max_edges;
+    int num;                    /* number stored in ts_arr[] */
+    int not_stored;             /* edges seen after ts_arr[] full */
+};
+
+static int
+init_edge_cap(struct edge_cap * ecp, int max_edges)
+{
+    memset(ecp, 0, sizeof(*ecp));
+    ecp->ts_arr = (uint64_t *)calloc(max_edges, sizeof(uint64_t));
+    ecp->rise_arr = (unsigned char *)calloc(max_edges, 1);
+    if ((NULL == ecp->ts_arr) || (NULL == ecp->rise_arr)) {
+        fprintf(stderr, "unable to allocate capture buffer for %d edges\n",
+                max_edges);
+        free(ecp->ts_arr);
+        free(ecp->rise_arr);
+        return -1;
+    }
+    /* touch the pages now rather than in the capture loop */
+    memset(ecp->ts_arr, 0, max_edges * sizeof(uint64_t));
+    memset(ecp->rise_arr, 0, max_edges);
+    ecp->max_edges = max_edges;
+    return 0;
+}
+
+static inline void
+cap_edge(struct edge_cap * ecp, uint64_t ts_ns, int rising)
+{
+    if (ecp->num < ecp->max_edges) {
+        ecp->ts_arr[ecp->num] = ts_ns;
+        ecp->rise_arr[ecp->num++] = (unsigned char)rising;
+    } else
+        ++ecp->not_stored;
+}
+
+/* Period is between successive edges of the same type: rising edges
+ * unless only falling edges were counted ('-cc'). With both edges
+ * ('-ccc') the duty cycle is also calculated. Output goes to stdout. */
+static void
+report_edges(const struct edge_cap * ecp, int param)
+{
+    int k, j, num_per, per_rising, bar;
+    int have_prev = 0;
+    int have_hi_start = 0;
+    int hist[HIST_BINS];
+    uint64_t prev = 0;
+    uint64_t hi_start = 0;
+    uint64_t lo_start = 0;
+    uint64_t per, per_min, per_max, sum_hi, sum_lo;
+    int have_lo_start = 0;
+    double sum, sum_sq, mean, rms, bin_w;
+
+    printf("Captured %d edges", ecp->num);
+    if (ecp->not_stored)
+        printf(" (%d more not stored, see '-m MAX')", ecp->not_stored);
+    printf("\n");
+    per_rising = (2 != param);
+    num_per = 0;
+    per_min = ~(uint64_t)0;
+    per_max = 0;
+    sum = 0.0;
+    sum_sq = 0.0;
+    sum_hi = 0;
+    sum_lo = 0;
+    for (k = 0; k < ecp->num; ++k) {
+        uint64_t t = ecp->ts_arr[k];
+        int r = ecp->rise_arr[k];
+
+        if (param > 2) {
+            if (r) {
+                if (have_lo_start)
+                    sum_lo += t - lo_start;
+                hi_start = t;
+                have_hi_start = 1;
+                have_lo_start = 0;
+            } else {
+                if (have_hi_start)
+                    sum_hi += t - hi_start;
+                lo_start = t;
+                have_lo_start = 1;
+                have_hi_start = 0;
+            }
+        }
+        if (r != per_rising)
+            continue;
+        if (have_prev) {
+            per = t - prev;
+            if (per < per_min)
+                per_min = per;
+            if (per > per_max)
+                per_max = per;
+            sum += (double)per;
+            sum_sq += (double)per * (double)per;
+            ++num_per;
+        }
+        prev = t;
+        have_prev = 1;
+    }
+    if (0 == num_per) {
+        printf("Need at least two %s edges to measure a period\n",
+               per_rising ? "rising" : "falling");
+        return;
+    }
+    mean = sum / num_per;
+    rms = (sum_sq / num_per) - (mean * mean);
+    rms = (rms > 0.0) ? sqrt(rms) : 0.0;
+    printf("Period: min=%.3f us, max=%.3f us, mean=%.3f us [%d periods]\n",
+           per_min / 1000.0, per_max / 1000.0, mean / 1000.0, num_per);
+    printf("Frequency: mean=%.3f Hz, min=%.3f Hz, max=%.3f Hz\n",
+           1e9 / mean, 1e9 / (double)per_max,
+           (per_min > 0) ? 1e9 / (double)per_min : 0.0);
+    printf("Jitter: rms=%.3f us, peak-to-peak=%.3f us\n", rms / 1000.0,
+           (per_max - per_min) / 1000.0);
+    if ((param > 2) && (sum_hi + sum_lo))
+        printf("Duty cycle: %.2f %% (high)\n",
+               (100.0 * sum_hi) / (double)(sum_hi + sum_lo));
+
+    /* second pass over the periods for the jitter histogram */
+    memset(hist, 0, sizeof(hist));
+    bin_w = (double)(per_max - per_min) / HIST_BINS;
+    have_prev = 0;
+    for (k = 0; k < ecp->num; ++k) {
+        if (ecp->rise_arr[k] != per_rising)
+            continue;
+        if (have_prev) {
+            per = ecp->ts_arr[k] - prev;
+            j = (bin_w > 0.0) ? (int)((per - per_min) / bin_w) : 0;
+            if (j >= HIST_BINS)
+                j = HIST_BINS - 1;
+            ++hist[j];
+        }
+        prev = ecp->ts_arr[k];
+        have_prev = 1;
+    }
+    printf("Period histogram (deviation from mean, us):\n");
+    for (j = 0; j < HIST_BINS; ++j) {
+        if ((bin_w <= 0.0) && (j > 0))
+            break;
+        printf("  %+10.3f: %7d  ", (per_min + ((j + 0.5) * bin_w) - mean) /
+               1000.0, hist[j]);
+        bar = (int)((50.0 * hist[j]) / num_per + 0.5);
+        for (k = 0; k < bar; ++k)
+            printf("*");
+        printf("\n");
+    }
+}
+
 /* Returns the number of edges detected (param=1: rising; param=2: falling;
  * otherwise: both) of -1 if problem. See Linux kernel source file:
- * Documentation/gpio.txt for explanation. */
+ * Documentation/gpio.txt for explanation. If ecp is non-NULL each edge is
+ * timestamped when poll() returns, so the times include wakeup latency. */
 static int
 process_count(int param, const char * base_dp,
               const struct timespec * periodp, int * direction_fdp,
-              int *val_fdp)
+              int *val_fdp, struct edge_cap * ecp)
 {
     int res, ret, edge_fd, edges, ms, k;
+    uint64_t ts_ns;
     struct timespec fin_ts;
     struct pollfd a_poll;
     const char * cp;
@@ -317,12 +483,16 @@ process_count(int param, const char * base_dp,
              * to be read to clear the event. */
             ++edges;
 #if 1
+            ts_ns = ecp ? sa_ts_ns(CLOCK_MONOTONIC) : 0;
             if (lseek(*val_fdp, 0, SEEK_SET) < 0) {
                 fprintf(stderr, "lseek to start of value fd failed: %s\n",
                         strerror(errno));
                 goto bbad;
             }
             k = pread(*val_fdp, b, 1, 0);
+            if (ecp)
+                cap_edge(ecp, ts_ns, ((param > 2) ? ('1' == b[0]) :
+                                                    (1 == param)));
 #else
             close(*val_fdp);
             *val_fdp = open(vfn, O_RDONLY);
@@ -412,6 +582,188 @@ process_toggle(const char * base_dp, int num, int force, int have_delay,
 }
 
 
+/* GPIO character device ('-C CHIP') versions of the above. Rather than
+ * one poll()+pread() per edge, events are read from the line request up
+ * to GC_MAX_EVENTS at a time. Returns the number of edges or -1 . Edge
+ * timestamps (for ecp) are taken by the kernel in its interrupt handler. */
+static int
+cdev_count(int chip_fd, unsigned int offset, int param,
+           const struct timespec * periodp, struct edge_cap * ecp)
+{
+    int k, n, res, ms, line_fd;
+    int edges = 0;
+    int dropped = 0;
+    int have_seqno = 0;
+    unsigned int flags;
+    uint32_t prev_seqno = 0;
+    struct timespec fin_ts;
+    struct pollfd a_poll;
+    struct gc_event ev_arr[GC_MAX_EVENTS];
+
+    if (1 == param)
+        flags = GC_FL_EDGE_RISING;
+    else if (2 == param)
+        flags = GC_FL_EDGE_FALLING;
+    else
+        flags = GC_FL_EDGE_RISING | GC_FL_EDGE_FALLING;
+    line_fd = gc_request_lines(chip_fd, &offset, 1, flags, 0,
+                               CDEV_EV_BUF_SZ, verbose);
+    if (line_fd < 0)
+        return -1;
+    a_poll.fd = line_fd;
+    calc_finish_time(&fin_ts, periodp);
+    while ((ms = millisecs_rem(&fin_ts)) > 0) {
+        a_poll.events = POLLIN;
+        a_poll.revents = 0;
+        res = poll(&a_poll, 1, ms);
+        if (res < 0) {
+            fprintf(stderr, "poll() failed: %s\n", strerror(errno));
+            edges = -1;
+            goto fini;
+        } else if (0 == res)
+            break;
+        n = gc_read_events(line_fd, ev_arr, GC_MAX_EVENTS);
+        if (n < 0) {
+            edges = -1;
+            goto fini;
+        }
+        for (k = 0; k < n; ++k) {
+            if (have_seqno && (ev_arr[k].line_seqno != prev_seqno + 1))
+                dropped += ev_arr[k].line_seqno - prev_seqno - 1;
+            prev_seqno = ev_arr[k].line_seqno;
+            have_seqno = 1;
+            if (ecp)
+                cap_edge(ecp, ev_arr[k].ts_ns, ev_arr[k].rising);
+        }
+        edges += n;
+    }
+    if (dropped)
+        fprintf(stderr, "kernel event buffer overflowed: %d edges lost, "
+                "included in count\n", dropped);
+    edges += dropped;
+fini:
+    close(line_fd);
+    return edges;
+}
+
+/* With 'force' drives the line low then high, else drives low then makes
+ * it an input (i.e. pulled up). Each transition is one ioctl. If 'state'
+ * is 0 or 1 the line is driven to that level at the end. Returns 0 if ok,
+ * else -1 */
+static int
+cdev_toggle(int chip_fd, unsigned int offset, int num, int force,
+            int have_delay, const struct timespec * delayp, int state)
+{
+    int k, line_fd;
+    int ret = -1;
+
+    line_fd = gc_request_lines(chip_fd, &offset, 1, GC_FL_OUTPUT, 0, 0,
+                               verbose);
+    if (line_fd < 0)
+        return -1;
+    if (have_delay && verbose)
+        fprintf(stderr, "After each edge delay for %d.%06ld seconds\n",
+                (int)delayp->tv_sec, delayp->tv_nsec / 1000);
+
+    for (k = 0; k < num; ++k) {
+        if (force) {
+            if (gc_set_values(line_fd, 1, 0) < 0)
+                goto fini;
+            if (have_delay)
+                nanosleep(delayp, NULL);
+            if (gc_set_values(line_fd, 1, 1) < 0)
+                goto fini;
+        } else {
+            if (gc_set_config(line_fd, 1, GC_FL_OUTPUT, 0) < 0)
+                goto fini;
+            if (have_delay)
+                nanosleep(delayp, NULL);
+            if (gc_set_config(line_fd, 1, GC_FL_INPUT, 0) < 0)
+                goto fini;
+        }
+        if (have_delay)
+            nanosleep(delayp, NULL);
+    }
+    if (state >= 0) {
+        if (gc_set_config(line_fd, 1, GC_FL_OUTPUT, state) < 0)
+            goto fini;
+    }
+    ret = 0;
+fini:
+    close(line_fd);
+    return ret;
+}
+
+/* Handles '-c', '-r', '-s' and '-t' for the GPIO character device. No
+ * export or unexport is needed. Returns 0 if ok, 1 for '-rr' with a high
+ * line, else -1 */
+static int
+process_cdev(const char * chip_name, unsigned int offset, int count_opt,
+             int toggle, int num_toggle, int force, int read_val, int state,
+             int have_delay, struct timespec * delayp, struct edge_cap * ecp)
+{
+    int chip_fd, line_fd, num_lines, edges;
+    int ret = -1;
+    uint64_t vals;
+    char b[80];
+
+    chip_fd = gc_open_chip(chip_name, &num_lines, verbose);
+    if (chip_fd < 0)
+        return -1;
+    if ((int)offset >= num_lines) {
+        fprintf(stderr, "%s has %d lines so offset %u is too large\n",
+                chip_name, num_lines, offset);
+        goto fini;
+    }
+    if (verbose)
+        fprintf(stderr, "%s: line offset %u\n", chip_name, offset);
+    if (count_opt) {
+        if (0 == have_delay)
+            delayp->tv_sec = 1;         /* default to count for 1 second */
+        edges = cdev_count(chip_fd, offset, count_opt, delayp, ecp);
+        if (edges < 0)
+            goto fini;
+        printf("Count=%d\n", edges);
+        if (ecp)
+            report_edges(ecp, count_opt);
+        ret = 0;
+    }
+    if (toggle) {
+        if (verbose)
+            fprintf(stderr, "Toggling %s\n",
+                    best_gpio_name(gpio_name, offset, b, sizeof(b)));
+        if (cdev_toggle(chip_fd, offset, num_toggle, force, have_delay,
+                        delayp, state) < 0) {
+            ret = -1;
+            goto fini;
+        }
+        ret = 0;
+    } else if (state >= 0) {
+        line_fd = gc_request_lines(chip_fd, &offset, 1, GC_FL_OUTPUT, state,
+                                   0, verbose);
+        if (line_fd < 0)
+            goto fini;
+        close(line_fd);
+        ret = 0;
+    } else if (read_val) {
+        line_fd = gc_request_lines(chip_fd, &offset, 1, GC_FL_INPUT, 0, 0,
+                                   verbose);
+        if (line_fd < 0)
+            goto fini;
+        ret = gc_get_values(line_fd, 1, &vals);
+        close(line_fd);
+        if (ret < 0)
+            goto fini;
+        printf("%c\n", (vals & 1) ? '1' : '0');
+        ret = (read_val > 1) ? (int)(vals & 1) : 0;
+    } else if (! count_opt)
+        ret = 0;
+fini:
+    close(chip_fd);
+    return ret;
+}
+
+
 int
 main(int argc, char ** argv)
 {
@@ -421,6 +773,7 @@ main(int argc, char ** argv)
     int enumerate = 0;
     int force = 0;
     int knum = -1;
+    int max_edges = 0;
     int num_toggle = DEF_NUM_TOGGLE;
     int origin0 = 0;
     int read_val = 0;
@@ -432,17 +785,19 @@ main(int argc, char ** argv)
     int ret = -1;
     int bit_num = -1;
     const char * cp;
+    const char * chip_name = NULL;
     char b[256];
     char base_dir[128];
     char ch;
     char bank = '\0';
     struct timespec delay_req;
+    struct edge_cap ecap;
     struct stat sb;
     struct sched_param spr;
 
     delay_req.tv_sec = 0;
     delay_req.tv_nsec = 0;
-    while ((opt = getopt(argc, argv, "b:cd:efhn:p:rRs:tuUvV")) != -1) {
+    while ((opt = getopt(argc, argv, "b:cC:d:efhm:n:p:rRs:tuUvV")) != -1) {
         switch (opt) {
         case 'b':
             cp = optarg;
@@ -469,6 +824,9 @@ main(int argc, char ** argv)
         case 'c':
             ++count_opt;
             break;
+        case 'C':
+            chip_name = optarg;
+            break;
         case 'd':
             k = atoi(optarg);
             if (k < 0) {
@@ -490,6 +848,14 @@ main(int argc, char ** argv)
             usage();
             exit(EXIT_SUCCESS);
             break;
+        case 'm':
+            max_edges = atoi(optarg);
+            if (max_edges < 1) {
+                fprintf(stderr, "'-m' expects a number of edges greater "
+                        "than 0\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
         case 'n':
             num_toggle = atoi(optarg);
             break;
@@ -580,7 +946,20 @@ main(int argc, char ** argv)
         return 0;
     }
 
-    if ((knum >= 0) && (bit_num >= 0)) {
+    if (chip_name) {
+        if ((knum >= 0) && (bit_num >= 0)) {
+            fprintf(stderr, "Give either '-p PORT' or '-b BN' but not "
+                    "both\n");
+            exit(EXIT_FAILURE);
+        } else if (bank && (bit_num >= 0))
+            knum = ((bank - 'A') * 32) + bit_num;
+        else if (knum < 0) {
+            fprintf(stderr, "Need to give gpio line with '-p PORT' and/or "
+                    "'-b BN'\n");
+            usage();
+            exit(EXIT_FAILURE);
+        }
+    } else if ((knum >= 0) && (bit_num >= 0)) {
         fprintf(stderr, "Give either '-p PORT' or '-b BN' but not both\n");
         exit(EXIT_FAILURE);
     } else if (bank) {
@@ -608,6 +987,13 @@ main(int argc, char ** argv)
         usage();
         exit(EXIT_FAILURE);
     }
+    if (max_edges && (0 == count_opt)) {
+        fprintf(stderr, "'-m MAX' needs '-c'\n");
+        usage();
+        exit(EXIT_FAILURE);
+    }
+    if (max_edges && init_edge_cap(&ecap, max_edges))
+        exit(EXIT_FAILURE);
     if (read_val && (toggle || (state >= 0))) {
         fprintf(stderr, "Can't have '-r' with '-s' or '-t'\n");
         usage();
@@ -632,6 +1018,12 @@ main(int argc, char ** argv)
     unexp_fd = -1;
     direction_fd = -1;
     val_fd = -1;
+    if (chip_name) {
+        ret = process_cdev(chip_name, knum, count_opt, toggle, num_toggle,
+                           force, read_val, state, have_delay, &delay_req,
+                           (max_edges ? &ecap : NULL));
+        goto bad;
+    }
     exp_fd = open(EXPORT_FILE, O_WRONLY);
     if (exp_fd < 0) {
         perror(EXPORT_FILE);
@@ -678,7 +1070,7 @@ main(int argc, char ** argv)
         if (0 == have_delay)
             delay_req.tv_sec = 1;       /* default to count for 1 second */
         edges = process_count(count_opt, base_dir, &delay_req, &direction_fd,
-                              &val_fd);
+                              &val_fd, (max_edges ? &ecap : NULL));
         if (! exported_on_exit) {
             if (gs_unexport(&unexp_fd, knum) < 0)
                 goto bad;
@@ -686,13 +1078,15 @@ main(int argc, char ** argv)
         if (edges < 0)
             goto bad;
         printf("Count=%d\n", edges);
+        if (max_edges)
+            report_edges(&ecap, count_opt);
         ret = 0;
     }
 
     if (toggle) {
         if (verbose)
             fprintf(stderr, "Toggling %s\n",
-                    get_best_gpio_name(knum, b, sizeof(b)));
+                    best_gpio_name(gpio_name, knum, b, sizeof(b)));
         res = process_toggle(base_dir, num_toggle, force, have_delay,
                              &delay_req, &direction_fd, &val_fd);
         if (res < 0)
@@ -775,6 +1169,10 @@ main(int argc, char ** argv)
         ret = 0;
 
 bad:
+    if (max_edges) {
+        free(ecap.ts_arr);
+        free(ecap.rise_arr);
+    }
     if (val_fd >= 0)
         close(val_fd);
     if (direction_fd >= 0)
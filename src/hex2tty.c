@@ -42,7 +42,6 @@
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <stdarg.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <errno.h>
@@ -57,14 +56,22 @@
 #include <fcntl.h>
 #include <signal.h>
 #include <poll.h>
+#include <time.h>
 
 #include <linux/serial.h>       /* for RS485 */
 
+#include "hex_out.h"
+#include "tty_util.h"
+#include "mmap_regs.h"
+#include "a5d2_regs.h"
+#include "sa_misc.h"
 
-static const char * version_str = "1.10 20160121";
+
+static const char * version_str = "1.14 20261014";
 
 #define DEF_BAUD_RATE B38400
 #define DEF_BAUD_RATE_STR "38400"
+#define DEF_BAUD_RATE_NUM 38400
 #define DEF_NON_CANONICAL_TIMEOUT 20     /* unit: 100ms so 20-> 2 seconds */
 
 #ifndef TIOCGRS485
@@ -74,14 +81,30 @@ static const char * version_str = "1.10 20160121";
 #define TIOCSRS485 0x542f
 #endif
 
+#ifndef TIOCSERGETLSR
+#define TIOCSERGETLSR 0x5459
+#endif
+#ifndef TIOCSER_TEMT
+#define TIOCSER_TEMT 0x01
+#endif
+
 #define RS485_MS_NOT_GIVEN -1001
 
+
+#define DE_SPIN_EXTRA_NS 10000000       /* give up spinning on LSR after
+                                         * expected time plus 10 ms */
+
+#define STREAM_IN_SZ 4096       /* '-s': input read and decoded at a time */
+#define STREAM_RING_SZ 65536    /* '-s': receive ring, power of 2 */
+#define STREAM_RING_MASK (STREAM_RING_SZ - 1)
+
 static struct termios tty_saved_attribs;
 static int tty_saved_fd = -1;
 static int timeout_100ms = DEF_NON_CANONICAL_TIMEOUT;
 static int verbose = 0;
 static int warn = 0;
 static int xopen = 0;
+static struct hex_out hout;     /* bytes read from <tty> go here */
 
 #ifndef SER_RS485_RX_DURING_TX
 struct my_serial_rs485 {
@@ -95,36 +118,43 @@ struct my_serial_rs485 {
 #define MY_SERIAL_RS485
 #endif
 
-#ifdef __GNUC__
-static int pr2serr(const char * fmt, ...)
-        __attribute__ ((format (printf, 1, 2)));
-#else
-static int pr2serr(const char * fmt, ...);
-#endif
-
-
-static int
-pr2serr(const char * fmt, ...)
-{
-    va_list args;
-    int n;
+/* Software RS485 turnaround ('-e <de_line>'): the transceiver's driver
+ * enable (DE) line is a PIO line driven via SODR/CODR (as a5d2_pio_set
+ * does). It is set before each write() to <tty>. Afterwards this process
+ * sleeps while all but the last character queued (TIOCOUTQ) is sent, then
+ * spins on TIOCSERGETLSR until the transmitter is empty and immediately
+ * clears DE. Without TIOCSERGETLSR (e.g. a pty) tcdrain() is used.
+ * Compared to '-y <rs485_ms>' the bus is released within tens of
+ * microseconds of the last stop bit rather than a whole millisecond
+ * count later. */
+struct de_line {
+    int port;                   /* 'A' to 'D' */
+    int bit_num;                /* 0 to 31 */
+    int active_low;             /* '-E': DE low while sending */
+    int on;                     /* 1 while DE set (transmit) */
+    int no_lsr;                 /* TIOCSERGETLSR failed, use tcdrain() */
+    unsigned int msk;           /* 1 << bit_num, 0 until mapped */
+    volatile unsigned int * sodr;
+    volatile unsigned int * codr;
+    int64_t char_ns;            /* time to send one character on <tty> */
+};
 
-    va_start(args, fmt);
-    n = vfprintf(stderr, fmt, args);
-    va_end(args);
-    return n;
-}
+static struct de_line de;
+static struct mmap_state mstate;
+static int mem_fd = -1;
 
 static void
 usage(void)
 {
     pr2serr("Usage: hex2tty [-a] [-b <baud>] [-B <nbits>] [-c] [-d] [-D] "
-            "[-F] [-h]\n"
-            "               [-H <hex_file>] [-i <hex_file>] [-n] [-N] "
-            "[-P N|E|O] [-q]\n"
-            "               [-r <num>] [-R] [-S <sbits>] [-T <secs[,rep]>] "
-            "[-v] [-V]\n"
-            "               [-w] [-x] [-y <rs485_ms>] <tty>\n"
+            "[-e <de_line>]\n"
+            "               [-E] [-F] [-h] [-H <hex_file>] [-i <hex_file>] "
+            "[-n] [-N]\n"
+            "               [-o <file>] [-P N|E|O] [-q] [-r <num>] [-R] [-s] "
+            "[-S <sbits>]\n"
+            "               [-T <secs[,rep]>] [-v] [-V] [-w] [-x] "
+            "[-y <rs485_ms>]\n"
+            "               <tty>\n"
             "  where:\n"
             "    -a           with '-r <num>' show bytes in ASCII as well\n"
             "    -b <baud>    baud rate of <tty> (default: %s)\n"
@@ -137,6 +167,11 @@ usage(void)
             "    -D           set DTR, use twice to clear DTR (need '-n' "
             "and '-x'\n"
             "                 to keep level after this utility completes)\n"
+            "    -e <de_line>    PIO line (e.g. PC7) driving RS485 DE: set "
+            "while\n"
+            "                    sending, cleared once transmitter empty "
+            "(/dev/mem)\n"
+            "    -E           DE line is active low (def: active high)\n"
             "    -F           no flush (def: flush input+output after <tty> "
             "open)\n"
             "    -h           print usage message\n"
@@ -148,6 +183,10 @@ usage(void)
             "close)\n"
             "                 use twice: set HUPCL (Hang UP on CLose)\n"
             "    -N           send nothing. Useful with '-r <num>' or '-x'\n"
+            "    -o <file>    write bytes read from <tty> to <file> as is "
+            "(binary),\n"
+            "                 rather than in ASCII hex on stdout. '-' for "
+            "stdout\n"
             "    -P N|E|O     parity: N->none (default), E->even, O->odd\n"
             "    -q           open <tty>, query control lines then exit\n"
             "    -r <num>     read <num> bytes from <tty>, print in ASCII "
@@ -156,6 +195,11 @@ usage(void)
             "send\n"
             "    -R           set RTS, use twice to clear RTS (may need "
             "'-n -x')\n"
+            "    -s           stream: no size limit, send while reading "
+            "<tty> until\n"
+            "                 all sent and <num> read (or <tty> idle for "
+            "'-T' time)\n"
+            "                 then report throughput\n"
             "    -S <sbits>   number of stop bits, 1 (default) or 2\n"
             "    -T <secs[,rep]>    <secs> timeout on reads, <rep> repeats "
             "(def:\n"
@@ -197,6 +241,121 @@ serr(void)
     return strerror(errno);
 }
 
+/* transmit: 1 -> set DE (drive bus); 0 -> clear DE (receive) */
+static inline void
+de_set(int transmit)
+{
+    if (transmit != de.active_low)
+        *de.sodr = de.msk;
+    else
+        *de.codr = de.msk;
+    de.on = transmit;
+}
+
+/* Maps the PIO registers of the DE line, makes it a GPIO output and
+ * leaves it cleared (receive). Return -1 for problems, 0 for okay */
+static int
+de_init(void)
+{
+    unsigned int base, cfgr;
+    unsigned int msk = 1 << de.bit_num;
+    volatile unsigned int * mmp;
+    volatile unsigned int * cfgrp;
+
+    if ((mem_fd = open(DEV_MEM, O_RDWR | O_SYNC)) < 0) {
+        pr2serr("Open %s: %s\n", DEV_MEM, serr());
+        return -1;
+    }
+    init_mmap_state(&mstate, verbose);
+    if (NULL == (mmp = get_mmp(mem_fd, PIO_WPMR, &mstate)))
+        return -1;
+    if (*mmp & 1) {
+        pr2serr("PIO write protected, try 'a5d2_pio_set -w 0' first\n");
+        return -1;
+    }
+    base = pio_addr(de.port - 'A', 0);
+    if ((NULL == (mmp = get_mmp(mem_fd, base + PIO_MSKR_OFF, &mstate))) ||
+        (NULL == (cfgrp = get_mmp(mem_fd, base + PIO_CFGR_OFF, &mstate))) ||
+        (NULL == (de.sodr = get_mmp(mem_fd, base + PIO_SODR_OFF,
+                                    &mstate))) ||
+        (NULL == (de.codr = get_mmp(mem_fd, base + PIO_CODR_OFF, &mstate))))
+        return -1;
+    *mmp = msk;
+    cfgr = *cfgrp;
+    if (cfgr & CFGR_PCFS_MSK) {
+        pr2serr("P%c%d physical configuration frozen, can't use\n",
+                de.port, de.bit_num);
+        return -1;
+    }
+    de.msk = msk;
+    de_set(0);          /* output level first so DE does not glitch */
+    *cfgrp = (cfgr & ~(CFGR_FUNC_MSK | CFGR_OPD_MSK)) | CFGR_DIR_MSK;
+    if (verbose)
+        pr2serr("RS485 DE on P%c%d (active %s), CFGR was 0x%x, one "
+                "character takes %lld ns\n", de.port, de.bit_num,
+                (de.active_low ? "low" : "high"), cfgr,
+                (long long)de.char_ns);
+    return 0;
+}
+
+/* Called after write() to <tty>: waits until the transmitter is empty
+ * (last stop bit sent) then clears DE. A TIOCSERGETLSR spin that takes
+ * longer than expected (e.g. stalled by CTS) gives way to tcdrain(). */
+static void
+de_turnaround(int tty_fd)
+{
+    int outq, lsr;
+    int polls = 0;
+    int64_t t_busy, t_drop, deadline;
+    struct timespec ts;
+
+    t_busy = (int64_t)sa_ts_ns(CLOCK_MONOTONIC);
+    if (ioctl(tty_fd, TIOCOUTQ, &outq) < 0)
+        outq = 0;
+    deadline = t_busy + ((outq + 2) * de.char_ns) + DE_SPIN_EXTRA_NS;
+    if ((! de.no_lsr) && (outq > 1)) {
+        /* sleep while all but the last queued character is sent */
+        t_busy += (outq - 1) * de.char_ns;
+        ts.tv_sec = t_busy / 1000000000;
+        ts.tv_nsec = t_busy % 1000000000;
+        while (EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+                                        &ts, NULL))
+            ;
+    }
+    while (! de.no_lsr) {
+        if (ioctl(tty_fd, TIOCSERGETLSR, &lsr) < 0) {
+            if (verbose)
+                pr2serr("ioctl(TIOCSERGETLSR) failed: %s, so using "
+                        "tcdrain()\n", serr());
+            de.no_lsr = 1;
+            break;
+        }
+        ++polls;
+        if (lsr & TIOCSER_TEMT)
+            break;
+        t_busy = (int64_t)sa_ts_ns(CLOCK_MONOTONIC);
+        if (t_busy > deadline) {
+            if (verbose)
+                pr2serr("transmitter still busy after %d LSR polls, "
+                        "tcdrain()\n", polls);
+            tcdrain(tty_fd);
+            t_busy = (int64_t)sa_ts_ns(CLOCK_MONOTONIC);
+            break;
+        }
+    }
+    if (de.no_lsr) {
+        tcdrain(tty_fd);
+        t_busy = (int64_t)sa_ts_ns(CLOCK_MONOTONIC);
+    }
+    de_set(0);
+    if (verbose > 1) {
+        t_drop = (int64_t)sa_ts_ns(CLOCK_MONOTONIC);
+        pr2serr("DE cleared %.1f us after transmitter last seen busy "
+                "(%d LSR polls, %d characters were queued)\n",
+                (t_drop - t_busy) / 1000.0, polls, outq);
+    }
+}
+
 static void
 termination_handler(int signum)
 {
@@ -216,28 +375,14 @@ termination_handler(int signum)
         /* close(tty_saved_fd); */
         /* tty_saved_fd = -1; */
     }
+    if (de.msk && de.on)
+        de_set(0);
     pr2serr("Termination signal causes exit\n");
     signal(signum, SIG_DFL);
     kill(getpid(), signum);     /* propagate signal */
     /* exit(0); */
 }
 
-static bool
-poll_in_for(int fd, int millisecs)
-{
-    int num;
-    struct pollfd apfd;
-
-    if (fd >= 0) {
-        apfd.fd = fd;
-        apfd.events = POLLIN;
-        apfd.revents = 0;
-        num = poll(&apfd, 1, millisecs);
-        return (num > 0) && (POLLIN & apfd.revents);
-    }
-    return false;
-}
-
 static int
 tty_query(const char * tty_dev)
 {
@@ -280,157 +425,16 @@ tty_query(const char * tty_dev)
     return 0;
 }
 
+/* Opens <tty> as given in *top (see tty_util.h) then, if '-y' was given,
+ * sets up RS485 mode. Returns file descriptor or -1 if problem. */
 static int
-tty_open(const char * tty_dev, int tty_speed, int dtr, int rts,
-         int hhandshake, int no_hupcl, int nbits, int parit, int sbits,
-         int rs485_ms)
+tty_open(const char * tty_dev, const struct tty_opts * top, int rs485_ms)
 {
-    int tty_fd, res, mask, mbits;
-    struct termios new_attributes;
+    int tty_fd;
 
-    // tty_fd = open(tty_dev, (O_RDWR | O_NOCTTY | O_NONBLOCK));
-    if (verbose > 2)
-        pr2serr("%s: about to open(%s)\n", __func__, tty_dev);
-    tty_fd = open(tty_dev, (O_RDWR | O_NOCTTY | O_SYNC));
-    if (tty_fd < 0) {
-        pr2serr("%s: open() of %s failed: %s\n", __func__, tty_dev, serr());
+    tty_fd = tty_open_raw(tty_dev, top, &tty_saved_attribs);
+    if (tty_fd < 0)
         return -1;
-    }
-
-    tcgetattr(tty_fd, &tty_saved_attribs);
-    new_attributes = tty_saved_attribs;
-
-    // Set the new attributes for the serial port, 'man termios'
-    cfsetospeed(&new_attributes, tty_speed);
-    cfsetispeed(&new_attributes, tty_speed);
-
-    // c_cflag
-    new_attributes.c_cflag |= CREAD;        // Enable receiver
-    new_attributes.c_cflag &= ~CSIZE;       // clear size mask
-    switch (nbits) {
-    case 5:
-        new_attributes.c_cflag |= CS5;
-        break;
-    case 6:
-        new_attributes.c_cflag |= CS6;
-        break;
-    case 7:
-        new_attributes.c_cflag |= CS7;
-        break;
-    case 8:
-    default:
-        new_attributes.c_cflag |= CS8;          // 8 data bit
-        break;
-    }
-    switch (parit) {
-    case 'E':
-        new_attributes.c_cflag |= PARENB;
-        new_attributes.c_cflag &= ~PARODD;
-        break;
-    case 'O':
-        new_attributes.c_cflag |= PARENB;
-        new_attributes.c_cflag |= PARODD;
-        break;
-    case 'N':
-        new_attributes.c_cflag &= ~PARENB;
-        break;
-    }
-    if (1 == sbits)
-        new_attributes.c_cflag &= ~CSTOPB;
-    else
-        new_attributes.c_cflag |= CSTOPB;
-    if (no_hupcl) {     // clear Hang Up on CLose (effects DTR+RTS)
-        if (1 == no_hupcl) {
-            new_attributes.c_cflag &= ~HUPCL;
-            if (verbose)
-                pr2serr("clearing HUPCL so RTS+DTR keep setting after "
-                        "close\n");
-        } else {
-            new_attributes.c_cflag |= HUPCL;
-            if (verbose)
-                pr2serr("setting HUPCL so RTS+DTR go inactive after close\n");
-        }
-    }
-    if (hhandshake) {
-        if (1 == hhandshake) {
-            new_attributes.c_cflag |= CRTSCTS;
-            if (verbose)
-                pr2serr("set hardware RTS/CTS handshake; those lines should "
-                        "be wired\n");
-        } else {
-            new_attributes.c_cflag &= ~CRTSCTS;
-            if (verbose)
-                pr2serr("clear hardware RTS/CTS handshake\n");
-        }
-    }
-
-    // c_iflag
-    if ('N' == parit)
-        new_attributes.c_iflag |= IGNPAR;       // Ignore framing and parity
-    // Suggested by Michael Kerrisk [The Linux Programming Interface].
-    // He also included "| PARMRK".
-    new_attributes.c_iflag &= ~(BRKINT | ICRNL | IGNBRK | IGNCR | INLCR |
-                                INPCK | ISTRIP | IXON);
-
-    // c_oflag     [Turn off corrupting output post-processing]
-    new_attributes.c_oflag &= ~(OPOST);
-
-    // c_lflag
-    new_attributes.c_lflag &= ~(ICANON | IEXTEN | ECHO | ECHOE | ISIG);
-
-    // Next two only apply for non-canonical reads (which we have set)
-    new_attributes.c_cc[VMIN] = 0;     // Min chars to read
-    new_attributes.c_cc[VTIME] = timeout_100ms; // units: 100 ms, max 25.5 secs
-
-    res = tcsetattr(tty_fd, TCSANOW, &new_attributes);
-    if (res < 0) {
-        pr2serr("%s: tcsetattr() failed: %s\n", __func__, serr());
-        close(tty_fd);
-        tty_fd = -1;
-    }
-    mbits = -1;
-    if (verbose > 1) {
-        if (ioctl(tty_fd, TIOCMGET, &mbits) >= 0)
-            pr2serr("modem lines set: %s%s%s%s [0x%x]\n",
-                    ((mbits & TIOCM_DSR) ? "DSR," : ""),
-                    ((mbits & TIOCM_RNG) ? "RING," : ""),
-                    ((mbits & TIOCM_CAR) ? "DCD," : ""),
-                    ((mbits & TIOCM_CTS) ? "CTS," : ""),
-                    mbits);
-    }
-    if (dtr) {
-        mask = TIOCM_DTR;
-        if (1 == dtr)
-            ioctl(tty_fd, TIOCMBIS, &mask);
-        else
-            ioctl(tty_fd, TIOCMBIC, &mask);
-    }
-    if (rts) {
-        if (verbose > 1)
-            pr2serr("%s: %sing RTS line\n", __func__,
-                    (1 == rts) ? "sett" : "clear");
-        mask = TIOCM_RTS;
-        if (1 == rts)
-            ioctl(tty_fd, TIOCMBIS, &mask);
-        else
-            ioctl(tty_fd, TIOCMBIC, &mask);
-    }
-    if ((verbose || warn) && (tty_saved_attribs.c_cflag & CRTSCTS) &&
-        (0 == hhandshake)) {
-        int cts_clear = 0;
-
-        if ((-1 != mbits) || (ioctl(tty_fd, TIOCMGET, &mbits) >= 0)) {
-            cts_clear = !(mbits & TIOCM_CTS);
-            pr2serr(">>> hardware RTS/CTS handshake active, not being "
-                    "changed\n>>> and CTS line is %s\n",
-                    cts_clear ? "clear (low), this could cause lockup" :
-                    "set (high), might be okay");
-            if (cts_clear)
-                pr2serr(">>> could use '-cc' to disable RTS/CTS handshake\n");
-        } else
-            pr2serr(">>> hardware RTS/CTS handshake active, not being "
-                    "changed\n");
-    }
 
     if (rs485_ms != RS485_MS_NOT_GIVEN) {
 #ifdef SER_RS485_ENABLED
@@ -457,108 +461,274 @@ tty_open(const char * tty_dev, int tty_speed, int dtr, int rts,
         }
 #endif
     }
-    if ((tty_fd >= 0) && (verbose > 3)) {
-        char b[128];
+    if ((tty_fd >= 0) && (verbose > 3))
+        tty_show_stty(tty_dev);
+    return tty_fd;
+}
+
+/* State for hex_decode() so that input can be decoded in pieces */
+struct hex_dec {
+    int in_comment;     /* skipping to end of line after '#' */
+    int ndig;           /* digits seen of current byte */
+    int val;            /* value of current byte so far */
+};
 
-        snprintf(b, sizeof(b) - 1, "stty -a -F %s", tty_dev);
-        printf(">>> Output from this command line invocation: '%s' is:\n", b);
-        res = system(b);
-        if (WIFSIGNALED(res) &&
-            (WTERMSIG(res) == SIGINT || WTERMSIG(res) == SIGQUIT))
-            raise(WTERMSIG(res));
-        /* ignore res of not a signal */
+/* Incremental form of the ASCII hex (or decimal, if 'as_decimal') decoding
+ * done in main(); the digits of one byte may be split across calls. Same
+ * syntax: up to two hex (three decimal) digits per byte, separated by
+ * whitespace or commas, '#' starts a comment. When 'len' is 0 any pending
+ * digits are flushed. Writes at most 'len' (or 1) bytes to 'out' and
+ * returns how many, or -1 on a syntax error. */
+static int
+hex_decode(struct hex_dec * hdp, const char * in, int len, int as_decimal,
+           unsigned char * out)
+{
+    int k, d;
+    int n = 0;
+    char c;
+
+    if ((0 == len) && hdp->ndig) {
+        out[n++] = hdp->val;
+        hdp->ndig = 0;
     }
-    return tty_fd;
+    for (k = 0; k < len; ++k) {
+        c = in[k];
+        if (hdp->in_comment) {
+            if ('\n' == c)
+                hdp->in_comment = 0;
+            continue;
+        }
+        if (as_decimal)
+            d = isdigit(c) ? (c - '0') : -1;
+        else if (isxdigit(c))
+            d = isdigit(c) ? (c - '0') : (tolower(c) - 'a' + 10);
+        else
+            d = -1;
+        if (d < 0) {
+            if (hdp->ndig) {
+                out[n++] = hdp->val;
+                hdp->ndig = 0;
+            }
+            if ('#' == c)
+                hdp->in_comment = 1;
+            else if (! (isspace(c) || (',' == c))) {
+                pr2serr("bad syntax at '%.*s'\n", (len - k) > 8 ? 8 :
+                        (len - k), in + k);
+                return -1;
+            }
+            continue;
+        }
+        hdp->val = hdp->ndig ? ((hdp->val * (as_decimal ? 10 : 16)) + d) :
+                               d;
+        if (++hdp->ndig < (as_decimal ? 3 : 2))
+            continue;
+        if (hdp->val > 255) {
+            pr2serr("decimals need to be from 0 to 255 inclusive, ending "
+                    "near '%.*s'\n", (len - k) > 8 ? 8 : (len - k), in + k);
+            return -1;
+        }
+        out[n++] = hdp->val;
+        hdp->ndig = 0;
+    }
+    return n;
 }
 
-/* print bytes in ASCII-hex, optionally with leading address and/or
- * trailing ASCII. 'addr_ascii' allows for 4 output types:
- *     > 0     each line has address then up to 16 ASCII-hex bytes
- *     = 0     in addition, the bytes are listed in ASCII to the right
- *     = -1    only the ASCII-hex bytes are listed (i.e. without address)
- *     < -1    ASCII-hex bytes with ASCII to right (and without address) */
+/* Outputs ring[] from *r_tailp to 'r_head', advancing *r_tailp. When
+ * formatting and 'all' is 0, only complete rows of 16 bytes are output
+ * which keeps *r_tailp a multiple of 16 so a row never wraps. The indexes
+ * are free running (they wrap after 4 GiB) so only their difference, or
+ * inequality, is meaningful. */
 static void
-dStrHex(const char * str, int len, int addr_ascii)
+ring_out(const unsigned char * ring, unsigned int r_head,
+         unsigned int * r_tailp, int all, int and_ascii)
+{
+    int num;
+    int whole = (all || hout.raw);
+    unsigned int r_tail = *r_tailp;
+
+    while (whole ? (r_head != r_tail) : ((r_head - r_tail) >= 16U)) {
+        num = whole ? (int)(r_head - r_tail) : 16;
+        if (num > (int)(STREAM_RING_SZ - (r_tail & STREAM_RING_MASK)))
+            num = STREAM_RING_SZ - (r_tail & STREAM_RING_MASK);
+        ho_dump(&hout, ring + (r_tail & STREAM_RING_MASK), num,
+                (and_ascii ? -2 : -1));
+        r_tail += num;
+    }
+    *r_tailp = r_tail;
+}
+
+/* Streaming mode ('-s'). With <tty> non-blocking, a poll() loop overlaps
+ * reading and decoding 'in_fd' (if >= 0) and writing the result to <tty>
+ * with reading <tty> into a ring buffer which is printed (in ASCII hex)
+ * as each row of 16 bytes fills (or copied out as is for '-o'). There is
+ * no limit on the amount sent or received. Ends when all is sent and
+ * either 'to_read' (if > 0) bytes are received or <tty> is idle for the
+ * '-T' timeout ('repeat' + 1 times). Then the byte counts and rates are
+ * reported. Returns 0 if ok, else 1 */
+static int
+stream_tty(int tty_fd, int in_fd, int as_decimal, int to_read, int repeat,
+           int and_ascii)
 {
-    const char* p = str;
-    unsigned char c;
-    char buff[82];
-    int a = 0;
-    const int bpstart = 5;
-    const int cpstart = 60;
-    int cpos = cpstart;
-    int bpos = bpstart;
-    int i, k;
-
-    if (len <= 0)
-        return;
-    memset(buff, ' ', 80);
-    buff[80] = '\0';
-    if (-1 == addr_ascii) {
-        for (k = 0; k < len; k++) {
-            c = *p++;
-            bpos += 3;
-            if (bpos == (bpstart + (9 * 3)))
-                bpos++;
-            sprintf(&buff[bpos], "%.2x", (int)(unsigned char)c);
-            buff[bpos + 2] = ' ';
-            if ((k > 0) && (0 == ((k + 1) % 16))) {
-                printf("%.60s\n", buff);
-                bpos = bpstart;
-                memset(buff, ' ', 80);
+    int num, want, fl, res, n_pfd, idle_ms, tx_done, rx_done;
+    int in_eof = (in_fd < 0);
+    int tx_off = 0;
+    int tx_len = 0;
+    int ret = 1;
+    unsigned int r_head = 0;    /* ring indexes, only masked when used */
+    unsigned int r_tail = 0;
+    int64_t tx_tot = 0;
+    int64_t rx_tot = 0;
+    double secs;
+    struct timespec t_start, t_end;
+    struct pollfd pfd[2];
+    struct hex_dec hd;
+    char inb[STREAM_IN_SZ];
+    unsigned char txb[STREAM_IN_SZ];
+    unsigned char * ring;
+
+    if (NULL == (ring = (unsigned char *)malloc(STREAM_RING_SZ))) {
+        pr2serr("%s: out of memory\n", __func__);
+        return 1;
+    }
+    memset(&hd, 0, sizeof(hd));
+    idle_ms = (timeout_100ms > 0) ? (timeout_100ms * 100) : 1000;
+    fl = fcntl(tty_fd, F_GETFL);
+    if ((fl < 0) || (fcntl(tty_fd, F_SETFL, fl | O_NONBLOCK) < 0)) {
+        pr2serr("%s: unable to make <tty> non-blocking: %s\n", __func__,
+                serr());
+        goto fini;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t_start);
+    while (1) {
+        tx_done = in_eof && (0 == tx_len);
+        rx_done = (to_read > 0) && (rx_tot >= to_read);
+        if (tx_done && rx_done)
+            break;
+        pfd[0].fd = tty_fd;
+        pfd[0].events = (rx_done ? 0 : POLLIN) | (tx_len ? POLLOUT : 0);
+        pfd[0].revents = 0;
+        n_pfd = 1;
+        if ((0 == tx_len) && (! in_eof)) {
+            pfd[1].fd = in_fd;
+            pfd[1].events = POLLIN;
+            pfd[1].revents = 0;
+            n_pfd = 2;
+        }
+        res = poll(pfd, n_pfd, idle_ms);
+        if (res < 0) {
+            if (EINTR == errno)
+                continue;
+            pr2serr("%s: poll() failed: %s\n", __func__, serr());
+            goto fini;
+        }
+        if (0 == res) {
+            if (repeat > 0) {
+                --repeat;
+                continue;
             }
+            if (verbose)
+                pr2serr("<tty> idle for %d ms%s, stop\n", idle_ms,
+                        tx_len ? " while sending" : "");
+            break;
         }
-        if (bpos > bpstart)
-            printf("%.60s\n", buff);
-        return;
-    }
-    /* addr_ascii >= 0, start each line with address (offset) */
-    if (addr_ascii >= 0) {
-        k = sprintf(buff + 1, "%.2x", a);
-        buff[k + 1] = ' ';
-    }
-
-    for (i = 0; i < len; i++) {
-        c = *p++;
-        bpos += 3;
-        if (bpos == (bpstart + (9 * 3)))
-            bpos++;
-        sprintf(&buff[bpos], "%.2x", (int)(unsigned char)c);
-        buff[bpos + 2] = ' ';
-        if (addr_ascii > 0)
-            buff[cpos++] = ' ';
-        else {
-            if ((c < ' ') || (c >= 0x7f))
-                c = '.';
-            buff[cpos++] = c;
-        }
-        if (cpos > (cpstart + 15)) {
-            printf("%.76s\n", buff);
-            bpos = bpstart;
-            cpos = cpstart;
-            a += 16;
-            memset(buff, ' ', 80);
-            if (addr_ascii >= 0) {
-                k = sprintf(buff + 1, "%.2x", a);
-                buff[k + 1] = ' ';
+        if ((n_pfd > 1) && (pfd[1].revents & (POLLIN | POLLHUP | POLLERR))) {
+            num = read(in_fd, inb, sizeof(inb));
+            if (num < 0) {
+                if ((EINTR != errno) && (EAGAIN != errno)) {
+                    pr2serr("read() of input failed: %s\n", serr());
+                    goto fini;
+                }
+            } else {
+                if (0 == num)
+                    in_eof = 1;
+                tx_len = hex_decode(&hd, inb, num, as_decimal, txb);
+                if (tx_len < 0)
+                    goto fini;
+                tx_off = 0;
+            }
+        }
+        if (pfd[0].revents & POLLOUT) {
+            if (de.msk && (! de.on))
+                de_set(1);
+            num = write(tty_fd, txb + tx_off, tx_len);
+            if (num < 0) {
+                if ((EINTR != errno) && (EAGAIN != errno)) {
+                    pr2serr("write() to <tty> failed: %s\n", serr());
+                    goto fini;
+                }
+            } else {
+                tx_off += num;
+                tx_len -= num;
+                tx_tot += num;
+                if (de.msk && (0 == tx_len))
+                    de_turnaround(tty_fd);  /* each decoded chunk a frame */
+            }
+        }
+        if (pfd[0].revents & POLLIN) {
+            /* contiguous free space after r_head */
+            want = STREAM_RING_SZ - (r_head & STREAM_RING_MASK);
+            if (want > (int)(STREAM_RING_SZ - (r_head - r_tail)))
+                want = STREAM_RING_SZ - (r_head - r_tail);
+            if ((to_read > 0) && (want > (to_read - rx_tot)))
+                want = to_read - rx_tot;
+            num = read(tty_fd, ring + (r_head & STREAM_RING_MASK), want);
+            if (num < 0) {
+                if ((EINTR != errno) && (EAGAIN != errno)) {
+                    pr2serr("read() from <tty> failed: %s\n", serr());
+                    goto fini;
+                }
+            } else {
+                if ((verbose > 3) && (num > 0))
+                    pr2serr("read() got %d byte%s\n", num,
+                            (num > 1) ? "s" : "");
+                r_head += num;
+                rx_tot += num;
             }
+        } else if (pfd[0].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+            pr2serr("<tty> error or hangup, stop\n");
+            goto fini;
+        }
+        ring_out(ring, r_head, &r_tail, 0, and_ascii);
+        if (ho_flush(&hout)) {
+            pr2serr("write() of output failed: %s\n", serr());
+            goto fini;
         }
     }
-    if (cpos > cpstart)
-        printf("%.76s\n", buff);
+    ret = 0;
+fini:
+    if (de.msk && de.on)
+        de_turnaround(tty_fd);
+    ring_out(ring, r_head, &r_tail, 1, and_ascii);
+    ho_flush(&hout);
+    if (tx_tot > 0)
+        tcdrain(tty_fd);        /* so the rate covers the last byte sent */
+    clock_gettime(CLOCK_MONOTONIC, &t_end);
+    secs = (t_end.tv_sec - t_start.tv_sec) +
+           ((t_end.tv_nsec - t_start.tv_nsec) / 1e9);
+    if (secs <= 0.0)
+        secs = 1e-9;
+    pr2serr("sent %lld bytes, received %lld bytes in %.3f seconds: "
+            "%.1f and %.1f bytes/second\n", (long long)tx_tot,
+            (long long)rx_tot, secs, tx_tot / secs, rx_tot / secs);
+    free(ring);
+    return ret;
 }
 
-
 int
 main(int argc, char *argv[])
 {
-    int opt, baud, num, k, from;
+    int opt, num, k, from;
+    int baud = DEF_BAUD_RATE_NUM;
+    int in_fd = -1;
+    int ret = EXIT_SUCCESS;
     int ooff = 0;
     const char * tty_dev = NULL;
     const char * hex_file = NULL;
+    const char * raw_file = NULL;
     int rs485_ms = RS485_MS_NOT_GIVEN;
     int and_ascii = 0;
     int as_decimal = 0;
+    int de_active_low = 0;
     int tty_speed = DEF_BAUD_RATE;
     int hhandshake = 0;
     int dtr_num = 0;
@@ -571,34 +741,27 @@ main(int argc, char *argv[])
     int repeat = 0;
     int rts_num = 0;
     int stop_bits = 1;
+    int stream = 0;
     int to_read = 0;
     unsigned char bny[2048];
     char hex[2048];
+    long lv;
     char *cp;
+    char *endp;
     char c1, c2, c3;
+    const char * de_line = NULL;
     FILE * fp = NULL;
+    struct tty_opts t_opts;
 
-    while ((opt = getopt(argc, argv, "ab:B:cdDFhH:i:nNP:qr:RS:T:vVwxy:")) !=
-           -1) {
+    while ((opt = getopt(argc, argv, "ab:B:cdDe:EFhH:i:nNo:P:qr:RsS:T:vVwxy:"))
+           != -1) {
         switch (opt) {
         case 'a':
             ++and_ascii;
             break;
         case 'b':
-            baud = 0;
             baud = atoi(optarg);
-            switch (baud) {
-            case 300: tty_speed = B300; break;
-            case 1200: tty_speed = B1200; break;
-            case 2400: tty_speed = B2400; break;
-            case 4800: tty_speed = B4800; break;
-            case 9600: tty_speed = B9600; break;
-            case 19200: tty_speed = B19200; break;
-            case 38400: tty_speed = B38400; break;
-            case 57600: tty_speed = B57600; break;
-            case 115200: tty_speed = B115200; break;
-            case 230400: tty_speed = B230400; break;
-            default:
+            if ((tty_speed = tty_baud2speed(baud)) < 0) {
                 pr2serr("Allowable rates: 300, 1200, 2400, 4800, 9600, "
                         "19200, 38400, 57600\n115200 or 230400\n");
                 exit(EXIT_FAILURE);
@@ -621,6 +784,12 @@ main(int argc, char *argv[])
         case 'D':
             ++dtr_num;
             break;
+        case 'e':
+            de_line = optarg;
+            break;
+        case 'E':
+            ++de_active_low;
+            break;
         case 'F':
             ++no_flush;
             break;
@@ -639,6 +808,9 @@ main(int argc, char *argv[])
         case 'N':
             ++no_send;
             break;
+        case 'o':
+            raw_file = optarg;
+            break;
         case 'P':
             switch((parity = toupper(optarg[0]))) {
             case 'N':
@@ -655,9 +827,8 @@ main(int argc, char *argv[])
             break;
         case 'r':
             k = atoi(optarg);
-            if ((k < 0) || ( k > (int)sizeof(bny))) {
-                pr2serr("<num> to read cannot exceed %d or be negative\n",
-                        (int)sizeof(bny));
+            if (k < 0) {
+                pr2serr("<num> to read cannot be negative\n");
                 exit(EXIT_FAILURE);
             }
             to_read = k;
@@ -665,6 +836,9 @@ main(int argc, char *argv[])
         case 'R':
             ++rts_num;
             break;
+        case 's':
+            ++stream;
+            break;
         case 'S':
             k = atoi(optarg);
             if ((k < 1) || ( k > 2)) {
@@ -740,6 +914,11 @@ main(int argc, char *argv[])
         usage();
         exit(EXIT_FAILURE);
     }
+    if ((0 == stream) && (to_read > (int)sizeof(bny))) {
+        pr2serr("<num> to read cannot exceed %d (unless '-s' given)\n",
+                (int)sizeof(bny));
+        exit(EXIT_FAILURE);
+    }
 
     if (rs485_ms != RS485_MS_NOT_GIVEN) {
         if (rts_num) {
@@ -751,6 +930,50 @@ main(int argc, char *argv[])
         exit(EXIT_FAILURE);
 #endif
     }
+    if (de_line) {
+        if (rs485_ms != RS485_MS_NOT_GIVEN) {
+            pr2serr("Can't use both '-e <de_line>' and '-y <rs485_ms>'\n");
+            exit(EXIT_FAILURE);
+        }
+        cp = (char *)de_line;
+        if ('P' == toupper(*cp))
+            ++cp;
+        de.port = toupper(*cp);
+        lv = -1;
+        if (isdigit(cp[1])) {
+            errno = 0;
+            lv = strtol(cp + 1, &endp, 10);
+            if (errno || ('\0' != *endp))
+                lv = -1;
+        }
+        if ((de.port < 'A') || (de.port >= ('A' + PIO_BANKS_SAMA5D2)) ||
+            (lv < 0) || (lv > 31)) {
+            pr2serr("'-e' expects a PIO line name like PC7 (PA0 to "
+                    "PD31)\n");
+            exit(EXIT_FAILURE);
+        }
+        de.bit_num = (int)lv;
+        de.active_low = !! de_active_low;
+        /* start bit + data bits + parity bit + stop bits */
+        de.char_ns = ((int64_t)(1 + num_bits + (('N' == parity) ? 0 : 1) +
+                                stop_bits) * 1000000000) / baud;
+    } else if (de_active_low) {
+        pr2serr("'-E' only makes sense with '-e <de_line>'\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (NULL == raw_file)
+        ho_init(&hout, STDOUT_FILENO, 0);
+    else if (0 == strcmp("-", raw_file))
+        ho_init(&hout, STDOUT_FILENO, 1);
+    else {
+        k = open(raw_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (k < 0) {
+            pr2serr("open() of %s failed: %s\n", raw_file, serr());
+            exit(EXIT_FAILURE);
+        }
+        ho_init(&hout, k, 1);
+    }
 
     if (signal(SIGINT, termination_handler) == SIG_IGN)
         signal(SIGINT, SIG_IGN);    /* handler was SIG_IGN, so reinstate */
@@ -761,7 +984,15 @@ main(int argc, char *argv[])
 
     if ((1 == xopen) || no_send || query)
         goto bypass_input_read;
-    else if (hex_file) {
+    else if (stream) {
+        if (NULL == hex_file)
+            in_fd = STDIN_FILENO;
+        else if ((in_fd = open(hex_file, O_RDONLY)) < 0) {
+            pr2serr("open() of %s failed: %s\n", hex_file, serr());
+            exit(EXIT_FAILURE);
+        }
+        goto bypass_input_read;
+    } else if (hex_file) {
         if ((fp = fopen(hex_file, "r")) == NULL) {
             pr2serr("fopen on %s failed with %s\n", hex_file, serr());
             exit(EXIT_FAILURE);
@@ -871,14 +1102,28 @@ bypass_input_read:
         k = tty_query(tty_dev);
         return k ? 1 : 0;
     }
-    if ((tty_saved_fd = tty_open(tty_dev, tty_speed, dtr_num, rts_num,
-                                 hhandshake, no_hupcl, num_bits, parity,
-                                 stop_bits, rs485_ms)) < 0)
+    memset(&t_opts, 0, sizeof(t_opts));
+    t_opts.speed = tty_speed;
+    t_opts.dtr = dtr_num;
+    t_opts.rts = rts_num;
+    t_opts.hhandshake = hhandshake;
+    t_opts.no_hupcl = no_hupcl;
+    t_opts.nbits = num_bits;
+    t_opts.parity = parity;
+    t_opts.sbits = stop_bits;
+    t_opts.timeout_100ms = timeout_100ms;
+    t_opts.warn = warn;
+    t_opts.verbose = verbose;
+    if ((tty_saved_fd = tty_open(tty_dev, &t_opts, rs485_ms)) < 0)
         exit(EXIT_FAILURE);
     else if (verbose)
         pr2serr("opened <tty> %s without problems\n", tty_dev);
     if (1 == xopen)
         goto the_end;
+    if (de_line && de_init()) {
+        ret = EXIT_FAILURE;
+        goto the_end;
+    }
 
     if (! no_flush) {
         if (tcflush(tty_saved_fd, TCIOFLUSH) < 0) {
@@ -888,10 +1133,22 @@ bypass_input_read:
             pr2serr("flushed <tty> without problems\n");
     }
 
+    if (stream) {
+        if (stream_tty(tty_saved_fd, in_fd, as_decimal, to_read, repeat,
+                       and_ascii))
+            ret = EXIT_FAILURE;
+        if ((in_fd >= 0) && (STDIN_FILENO != in_fd))
+            close(in_fd);
+        goto the_end;
+    }
     if (ooff > 0) {
+        if (de.msk)
+            de_set(1);
         num = write(tty_saved_fd, bny, ooff);
         if (num < 0)
             pr2serr("write() to <tty> failed: %s\n", serr());
+        if (de.msk)
+            de_turnaround(tty_saved_fd);
         if (verbose)
             pr2serr("wrote %d bytes to <tty>\n", ooff);
     }
@@ -902,7 +1159,7 @@ bypass_input_read:
             num = 0;
             if (timeout_100ms > 0)
                 num = read(tty_saved_fd, bny + k, to_read - k);
-            else if (poll_in_for(tty_saved_fd, 1000 /* millisecond */))
+            else if (tty_poll_in(tty_saved_fd, 1000 /* millisecond */))
                 num = read(tty_saved_fd, bny + k, to_read - k);
             if ((verbose > 3) && (num > 0))
                 pr2serr("read() got %d byte%s\n", num,
@@ -913,7 +1170,7 @@ bypass_input_read:
                 if (repeat > 0) {
                     --repeat;
                     if (k > from) {
-                        dStrHex((const char *)bny + from , k - from,
+                        ho_dump(&hout, bny + from, k - from,
                                 (and_ascii ? -2 : -1));
                         from = k;
                     }
@@ -925,13 +1182,21 @@ bypass_input_read:
         if (num < 0)
             pr2serr("read() from <tty> failed: %s, exit\n", serr());
         if (k > from)
-            dStrHex((const char *)bny + from, k - from,
+            ho_dump(&hout, bny + from, k - from,
                     (and_ascii ? -2 : -1));
+        if (ho_flush(&hout))
+            pr2serr("write() of output failed: %s\n", serr());
         if (verbose)
             pr2serr("read() fetched %d byte%s\n", k, (1 == k) ? "" : "s");
     }
 
 the_end:
+    if (de.msk && de.on)
+        de_set(0);
+    if (mem_fd >= 0) {
+        release_mmap_state(&mstate);
+        close(mem_fd);
+    }
     if (tty_saved_fd >= 0) {
         if (0 == xopen) {
             if (verbose > 1)
@@ -942,5 +1207,7 @@ the_end:
         close(tty_saved_fd);
         tty_saved_fd = -1;
     }
-    return EXIT_SUCCESS;
+    if (STDOUT_FILENO != hout.fd)
+        close(hout.fd);
+    return ret;
 }
@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2026 Douglas Gilbert.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+/*****************************************************************
+ * hex_out.c
+ *
+ * Buffered, table driven hex dump shared by hex2tty and xbee_api. See
+ * hex_out.h .
+ *
+ ****************************************************/
+
+#define _XOPEN_SOURCE 500
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "hex_out.h"
+
+/* Line layout of the dStrHex() this replaces */
+#define HO_HEX_ONLY_W 60        /* line width without ASCII column */
+#define HO_LINE_W 76
+#define HO_ASCII_COL 60
+#define HO_MAX_LINE (HO_LINE_W + 1)
+
+static const char ho_digits[] = "0123456789abcdef";
+static char ho_hex[256][2];
+static char ho_asc[256];
+static unsigned char ho_col[16];        /* column of each byte's hex */
+static int ho_tables_ok = 0;
+
+
+static void
+ho_make_tables(void)
+{
+    int k;
+
+    for (k = 0; k < 256; ++k) {
+        ho_hex[k][0] = ho_digits[k >> 4];
+        ho_hex[k][1] = ho_digits[k & 0xf];
+        ho_asc[k] = ((k < ' ') || (k >= 0x7f)) ? '.' : k;
+    }
+    /* 8 for the first byte, 3 apart with an extra space after 8 bytes */
+    for (k = 0; k < 16; ++k)
+        ho_col[k] = 8 + (3 * k) + (k > 7);
+    ho_tables_ok = 1;
+}
+
+void
+ho_init(struct hex_out * hop, int fd, int raw)
+{
+    if (! ho_tables_ok)
+        ho_make_tables();
+    hop->fd = fd;
+    hop->raw = raw;
+    hop->len = 0;
+    hop->err = 0;
+}
+
+int
+ho_flush(struct hex_out * hop)
+{
+    int k, n;
+
+    if (STDOUT_FILENO == hop->fd)
+        fflush(stdout);         /* keep order with printf() output */
+    for (k = 0; k < hop->len; k += n) {
+        n = write(hop->fd, hop->buf + k, hop->len - k);
+        if (n < 0) {
+            if (EINTR == errno) {
+                n = 0;
+                continue;
+            }
+            hop->err = 1;
+            break;
+        }
+    }
+    hop->len = 0;
+    return hop->err ? -1 : 0;
+}
+
+/* Like "%.2x": at least two hex digits, placed from 'cp'. Returns number
+ * of digits. */
+static int
+ho_addr(char * cp, unsigned int a)
+{
+    int k, n;
+
+    for (n = 2; (n < 8) && (a >> (4 * n)); ++n)
+        ;
+    for (k = n - 1; k >= 0; --k, a >>= 4)
+        cp[k] = ho_digits[a & 0xf];
+    return n;
+}
+
+int
+ho_dump(struct hex_out * hop, const unsigned char * p, int len,
+        int addr_ascii)
+{
+    int k, n, w;
+    unsigned int a;
+    char * lp;
+
+    if (len <= 0)
+        return hop->err ? -1 : 0;
+    if (hop->raw) {
+        for ( ; len > 0; len -= n, p += n) {
+            if (hop->len >= HO_BUF_SZ)
+                ho_flush(hop);
+            n = HO_BUF_SZ - hop->len;
+            if (n > len)
+                n = len;
+            memcpy(hop->buf + hop->len, p, n);
+            hop->len += n;
+        }
+        return hop->err ? -1 : 0;
+    }
+    w = (-1 == addr_ascii) ? HO_HEX_ONLY_W : HO_LINE_W;
+    for (a = 0; len > 0; len -= n, p += n, a += 16) {
+        if ((hop->len + HO_MAX_LINE) > HO_BUF_SZ)
+            ho_flush(hop);
+        lp = hop->buf + hop->len;
+        memset(lp, ' ', w);
+        n = (len > 16) ? 16 : len;
+        if (addr_ascii >= 0)
+            ho_addr(lp + 1, a);
+        for (k = 0; k < n; ++k) {
+            lp[ho_col[k]] = ho_hex[p[k]][0];
+            lp[ho_col[k] + 1] = ho_hex[p[k]][1];
+        }
+        if ((addr_ascii <= 0) && (-1 != addr_ascii)) {
+            for (k = 0; k < n; ++k)
+                lp[HO_ASCII_COL + k] = ho_asc[p[k]];
+        }
+        lp[w] = '\n';
+        hop->len += w + 1;
+    }
+    return hop->err ? -1 : 0;
+}
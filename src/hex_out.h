@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2026 Douglas Gilbert.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+#ifndef HEX_OUT_H
+#define HEX_OUT_H
+
+/*****************************************************************
+ * hex_out.h
+ *
+ * Hex (and ASCII) dump of bytes read from a serial port, shared by
+ * hex2tty and xbee_api. Output lines are built from lookup tables into
+ * a large buffer which is written out with a single write() when it
+ * fills or when ho_flush() is called, rather than with a printf() per
+ * line. Lines are identical to those of the dStrHex() function these
+ * utilities used previously. Alternatively ('raw') the bytes are copied
+ * to the output unformatted, for capturing binary data.
+ *
+ ****************************************************/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HO_BUF_SZ 65536
+
+struct hex_out {
+    int fd;             /* output file descriptor */
+    int raw;            /* 1: no formatting, bytes copied as is */
+    int len;            /* bytes waiting in buf[] */
+    int err;            /* set when a write() fails */
+    char buf[HO_BUF_SZ];
+};
+
+/* Output goes to 'fd' (e.g. STDOUT_FILENO); formatted unless 'raw'. */
+void ho_init(struct hex_out * hop, int fd, int raw);
+
+/* Appends 'len' bytes from 'p'. Unless raw, each call starts a new line
+ * and 'addr_ascii' selects one of 4 line types:
+ *     > 0     each line has address then up to 16 ASCII-hex bytes
+ *     = 0     in addition, the bytes are listed in ASCII to the right
+ *     = -1    only the ASCII-hex bytes are listed (i.e. without address)
+ *     < -1    ASCII-hex bytes with ASCII to right (and without address)
+ * Returns 0, or -1 if a write() failed. */
+int ho_dump(struct hex_out * hop, const unsigned char * p, int len,
+            int addr_ascii);
+
+/* Writes out whatever is buffered. Returns 0, or -1 if a write() failed
+ * (this or an earlier one). */
+int ho_flush(struct hex_out * hop);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -38,10 +38,12 @@
  * protocol in the user space so it may be scheduled out to allow
  * other processes time to execute.
  * If the '-F' is given then SCL does not need a pull-up, otherwise it does.
+ * Uses the sysfs GPIO interface unless '-m' or '-M' is given, in which
+ * case the PIO registers are accessed directly via /dev/mem .
  *
  ****************************************************/
 
-#define _XOPEN_SOURCE 500
+#define _XOPEN_SOURCE 600
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -54,18 +56,35 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <time.h>
+#include <stdint.h>
 
+#include "mmap_regs.h"
+#include "a5d2_regs.h"
+#include "i2c_bench.h"
+#include "sa_misc.h"
 
-static const char * version_str = "1.01 20130718";
+
+static const char * version_str = "1.03 20261014";
 
 static int force_scl_high = 0;
 static int response_len = 0;
 static int skip_delay = 0;
+static int use_mmap = 0;        /* 1: '-m'; 2: '-M' (hardware open drain) */
 static int verbose = 0;
 
 #define I2C_CMD_WRITE 0
 #define I2C_CMD_READ 1
 
+/* Each SCL cycle calls half_delay() four times */
+#define I2C_DEF_CLK_HZ 100000
+#define I2C_MAX_CLK_HZ 1000000  /* Fast-mode Plus */
+#define CALIB_LOOPS 1000
+#define SCL_TIMER_CYCLES 10000000
+
+static unsigned int i2c_clk_hz = I2C_DEF_CLK_HZ;        /* '-k RATE' */
+static uint64_t quarter_ns;     /* SCL period / 4 */
+static uint64_t next_edge_ns;   /* next half_delay() deadline */
+
 /* Example of this utility with a DS1307 RTC
  * > i2c_bbtest -i "68 0" -r 8
  * 27 47 22 04 01 04 09 03
@@ -139,12 +158,22 @@ static void
 usage(void)
 {
     fprintf(stderr, "Usage: "
-            "i2c_bbtest -c <c_bn> [-C <c_port>] -d <d_bn> [-D <d_port>] "
-            "[-F]\n"
-            "                  [-h] -i <H,H...> [-I] [-r <num>] "
-            "[-R <retries>] [-s <sa>]\n"
-            "                  [-t] [-v] [-V] [-z]\n"
+            "i2c_bbtest [-b <sizes>] -c <c_bn> [-C <c_port>] -d <d_bn> "
+            "[-D <d_port>]\n"
+            "                  [-F] [-h] -i <H,H...> [-I] [-k <rate>] "
+            "[-m|M] [-n <num>]\n"
+            "                  [-r <num>] [-R <retries>] [-s <sa>] [-t] "
+            "[-v] [-V] [-z]\n"
             "  where:\n"
+            "    -b <sizes>   benchmark: for each size (comma separated "
+            "list, '-' for\n"
+            "                 %s) do '-n' transactions; each\n"
+            "                 writes '-i' bytes then <size> bytes (or with "
+            "'-r' reads\n"
+            "                 <size> bytes). Report bytes/s, latency "
+            "percentiles, NAKs\n"
+            "                 and retries. Same report as 'i2c_devtest "
+            "-b'\n"
             "    -c <c_bn>    SCL bit number within c_port. Also accepts\n"
             "                 prefix like 'pb' or just 'b' for <c_port>.\n"
             "    -C <c_port>    SCL port ('A', 'B', 'C' or 'D') or\n"
@@ -163,6 +192,15 @@ usage(void)
             "                   be lower 7 bits in first byte (top bit "
             "ignored)\n"
             "    -I           ignore NAK and continue\n"
+            "    -k <rate>    SCL rate in Hz, 'k' suffix multiplies by 1000 "
+            "(def: 100k)\n"
+            "                 upper limit, sysfs IO is much slower than "
+            "100k\n"
+            "    -m           use PIO registers via /dev/mem rather than "
+            "sysfs; open\n"
+            "                 drain emulated by switching line direction\n"
+            "    -M           like '-m' but use PIO hardware open drain\n"
+            "    -n <num>     transactions per size for '-b' (def: %d)\n"
             "    -r <num>     number of bytes to request from slave (def: "
             "0)\n"
             "                 Uses slave address from '-i' or '-s' option\n"
@@ -174,8 +212,8 @@ usage(void)
             "given to '-i'\n"
             "    -t           ignore other options and cycle SCL 10,000,000 "
             "times\n"
-            "                 Should take 100 seconds if i2c clock is 100 "
-            "kHz\n"
+            "                 then report the rate achieved (100 seconds "
+            "at 100k)\n"
             "                 [when used twice just do timing loop, no IO]\n"
             "                 [when used thrice do IO but skip delays]\n"
             "    -v           increase verbosity (multiple times for more)\n"
@@ -188,13 +226,11 @@ usage(void)
             "either as the\nfirst byte of the '-i' list or "
             "with the '-s' option.\nExample: 24LC256 eeprom with "
             "slave_address=0x50, read byte at 0x123:\n"
-            "\t'i2c_bbtest -c PC12 -d PC13 -i \"50 1 23\" -r 1'\n");
+            "\t'i2c_bbtest -c PC12 -d PC13 -i \"50 1 23\" -r 1'\n",
+            IB_DEF_SIZES, IB_DEF_ITERATIONS);
 }
 
 
-/* Assume SAMA5D2 ARMv7 CPU running at 496 MHz */
-#define DELAY_LOOP_COUNT 10
-
 #define EXPORT_FILE "/sys/class/gpio/export"
 #define UNEXPORT_FILE "/sys/class/gpio/unexport"
 #define GPIO_BASE_FILE "/sys/class/gpio/gpio"
@@ -231,12 +267,155 @@ static int direction_out = 0;
 static int origin0 = 0;
 
 
+/* Memory mapped PIO backend ('-m' or '-M'): the SAMA5D2 PIO4 registers
+ * are written directly via /dev/mem (as a5d2_pio_set does). Each line
+ * is selected once in its bank's MSKR, then a transition is one CFGR
+ * write (open drain emulated by toggling CFGR.DIR with ODSR held low) or,
+ * with '-M' (hardware open drain) or '-F' on SCL, one SODR or CODR write.
+ * There is no OER/ODR in the PIO4 so CFGR.DIR plays that role. */
+struct mm_line {
+    int bank;
+    unsigned int msk;           /* 1 << bit_number */
+    volatile unsigned int * mskr;
+    volatile unsigned int * cfgr;
+    volatile unsigned int * pdsr;
+    volatile unsigned int * sodr;
+    volatile unsigned int * codr;
+    unsigned int cfgr_orig;     /* restored on exit */
+    unsigned int cfgr_rel;      /* line released (pulled high) */
+    unsigned int cfgr_drv;      /* line driven low */
+};
+
+static struct mm_line mm_sda;
+static struct mm_line mm_scl;
+static unsigned int mm_mskr_val[PIO_BANKS_SAMA5D2];
+static struct mmap_state mstate;
+static int mem_fd = -1;
+
+static void
+mm_cfgr_write(struct mm_line * lp, unsigned int val)
+{
+    if (mm_mskr_val[lp->bank] != lp->msk) {
+        *lp->mskr = lp->msk;
+        mm_mskr_val[lp->bank] = lp->msk;
+    }
+    *lp->cfgr = val;
+}
+
+/* state: 0 -> drive low; 1 -> release (or drive high if push-pull) */
+static inline void
+mm_set(struct mm_line * lp, int state)
+{
+    if (lp->cfgr_rel == lp->cfgr_drv) {
+        if (state)
+            *lp->sodr = lp->msk;
+        else
+            *lp->codr = lp->msk;
+    } else
+        mm_cfgr_write(lp, state ? lp->cfgr_rel : lp->cfgr_drv);
+}
+
+// Return -1 for problems, 0 for okay
+static int
+init_mm_line(struct mm_line * lp, int port, int bit_num, int open_drain)
+{
+    unsigned int base, cfg, msk;
+
+    lp->bank = port - 'A';
+    if ((lp->bank < 0) || (lp->bank >= PIO_BANKS_SAMA5D2)) {
+        fprintf(stderr, "P%c%d not available on SAMA5D2\n", port, bit_num);
+        return -1;
+    }
+    msk = 1 << bit_num;
+    base = pio_addr(lp->bank, 0);
+    if ((NULL == (lp->mskr = get_mmp(mem_fd, base + PIO_MSKR_OFF,
+                                     &mstate))) ||
+        (NULL == (lp->cfgr = get_mmp(mem_fd, base + PIO_CFGR_OFF,
+                                     &mstate))) ||
+        (NULL == (lp->pdsr = get_mmp(mem_fd, base + PIO_PDSR_OFF,
+                                     &mstate))) ||
+        (NULL == (lp->sodr = get_mmp(mem_fd, base + PIO_SODR_OFF,
+                                     &mstate))) ||
+        (NULL == (lp->codr = get_mmp(mem_fd, base + PIO_CODR_OFF,
+                                     &mstate))))
+        return -1;
+    *lp->mskr = msk;
+    mm_mskr_val[lp->bank] = msk;
+    lp->cfgr_orig = *lp->cfgr;
+    if (lp->cfgr_orig & CFGR_PCFS_MSK) {
+        fprintf(stderr, "P%c%d physical configuration frozen, can't use\n",
+                port, bit_num);
+        return -1;
+    }
+    cfg = lp->cfgr_orig & ~(CFGR_FUNC_MSK | CFGR_DIR_MSK | CFGR_OPD_MSK);
+    if (! open_drain) {
+        lp->cfgr_rel = cfg | CFGR_DIR_MSK;
+        lp->cfgr_drv = lp->cfgr_rel;
+        *lp->sodr = msk;
+    } else if (use_mmap > 1) {
+        lp->cfgr_rel = cfg | CFGR_DIR_MSK | CFGR_OPD_MSK;
+        lp->cfgr_drv = lp->cfgr_rel;
+        *lp->sodr = msk;
+    } else {
+        lp->cfgr_rel = cfg;
+        lp->cfgr_drv = cfg | CFGR_DIR_MSK;
+        *lp->codr = msk;        /* so when output, drives low */
+    }
+    *lp->cfgr = lp->cfgr_rel;
+    lp->msk = msk;      /* only now may cleanup_mmap_pins() restore it */
+    if (verbose > 1)
+        fprintf(stderr, "P%c%d: CFGR was 0x%x, released=0x%x, driven "
+                "low=0x%x\n", port, bit_num, lp->cfgr_orig, lp->cfgr_rel,
+                lp->cfgr_drv);
+    return 0;
+}
+
+// Return -1 for problems, 0 for okay
+static int
+init_mmap_pins(void)
+{
+    volatile unsigned int * mmp;
+
+    if ((mem_fd = open(DEV_MEM, O_RDWR | O_SYNC)) < 0) {
+        fprintf(stderr, "Open %s: %s\n", DEV_MEM, strerror(errno));
+        return -1;
+    }
+    init_mmap_state(&mstate, verbose);
+    if (NULL == (mmp = get_mmp(mem_fd, PIO_WPMR, &mstate)))
+        return -1;
+    if (*mmp & 1) {
+        fprintf(stderr, "PIO write protected, try 'a5d2_pio_set -w 0' "
+                "first\n");
+        return -1;
+    }
+    if (init_mm_line(&mm_scl, scl_port, scl_pin_in_bank, ! force_scl_high))
+        return -1;
+    if (init_mm_line(&mm_sda, sda_port, sda_pin_in_bank, 1))
+        return -1;      /* cleanup_mmap_pins() restores SCL */
+    return 0;
+}
+
+static void
+cleanup_mmap_pins(void)
+{
+    if (mm_sda.msk)
+        mm_cfgr_write(&mm_sda, mm_sda.cfgr_orig);
+    if (mm_scl.msk)
+        mm_cfgr_write(&mm_scl, mm_scl.cfgr_orig);
+    release_mmap_state(&mstate);
+    if (mem_fd >= 0)
+        close(mem_fd);
+}
+
+
 static int
 sda_getbit(void)
 {
     char b[2];
     int res;
 
+    if (use_mmap)
+        return !! (*mm_sda.pdsr & mm_sda.msk);
     memset(b, 0,  sizeof(b));
     if ((res = pread(val_sda, b, 1, 0)) <= 0) {
         if (0 == res) {
@@ -255,6 +434,11 @@ set_direction_out(void)
 {
     int res;
 
+    direction_out = 1;
+    if (use_mmap) {
+        mm_set(&mm_sda, 0);
+        return;
+    }
     res = pwrite(dir_sda, "out", 3, 0);
     if (res < 0)
         perror("set_direction_out: pwrite");
@@ -266,6 +450,11 @@ set_direction_in(void)
 {
     int res;
 
+    direction_out = 0;
+    if (use_mmap) {
+        mm_set(&mm_sda, 1);
+        return;
+    }
     res = pwrite(dir_sda, "in", 2, 0);
     if (res < 0)
         perror("set_direction_in: pwrite");
@@ -289,6 +478,12 @@ set_scl(int state)
 {
     int res = 0;
 
+    if (use_mmap) {
+        mm_set(&mm_scl, state);
+        half_delay();
+        half_delay();
+        return;
+    }
     if (state) {
         if (force_scl_high)
             res = pwrite(val_scl, "1", 1, 0);
@@ -311,6 +506,10 @@ scl_direction_out(void)
 {
     int res = 0;
 
+    if (use_mmap) {
+        mm_set(&mm_scl, 1);
+        return;
+    }
     res = pwrite(dir_scl, "high", 4, 0);
     if (res < 0)
         perror("scl_direction_out: pwrite");
@@ -450,28 +649,58 @@ cleanup_atmel_pins(void)
         close(exp_i2c);
 }
 
+/* Sets quarter_ns from i2c_clk_hz and measures what reading the clock
+ * costs; that is the resolution of half_delay(). Warns if the requested
+ * rate can not be met. */
+static void
+calibrate_delay(void)
+{
+    int k;
+    uint64_t t0, clk_cost;
+
+    quarter_ns = (1000000000 + (2 * i2c_clk_hz)) / (4 * i2c_clk_hz);
+    t0 = sa_ts_ns(CLOCK_MONOTONIC);
+    for (k = 0; k < CALIB_LOOPS; ++k)
+        sa_ts_ns(CLOCK_MONOTONIC);
+    clk_cost = (sa_ts_ns(CLOCK_MONOTONIC) - t0) / (CALIB_LOOPS + 1);
+    if (verbose)
+        fprintf(stderr, "SCL target %u Hz: %u ns between edge deadlines, "
+                "reading clock takes %u ns\n", i2c_clk_hz,
+                (unsigned int)quarter_ns, (unsigned int)clk_cost);
+    if ((2 * clk_cost) > quarter_ns)
+        fprintf(stderr, "Warning: clock too slow to read (%u ns) for "
+                "%u Hz, SCL will be slower\n", (unsigned int)clk_cost,
+                i2c_clk_hz);
+    next_edge_ns = sa_ts_ns(CLOCK_MONOTONIC);
+}
+
 /*
- * Each clock cycle will end up calling half delay four times.
- * Calling an external function that does something like rand()
- * defeats compiler optimization that can skip traditional
- * timing loops.
- * The DELAY_LOOP_COUNT is chosen so the generate SCL will be
- * around 100 kHz (or less) for this SoC. Note that this user
- * space process could be scheduled out to let the SoC do other
- * work. This will elongate SCL cycles but the I2C protocol should
- * be able to handle that.
+ * Each clock cycle will end up calling half delay four times. Rather than
+ * a loop whose duration depends on the CPU clock (which cpufreq may
+ * change), busy wait until an absolute deadline on CLOCK_MONOTONIC that
+ * advances by quarter_ns each call. So time spent doing IO between calls
+ * is absorbed rather than added. Note that this user space process could
+ * be scheduled out to let the SoC do other work. This will elongate SCL
+ * cycles but the I2C protocol should be able to handle that. When more
+ * than a quarter period late, the schedule restarts from now so there is
+ * no burst of short cycles afterwards.
  */
 static int
 half_delay(void)
 {
-    int k, n;
+    uint64_t now;
 
     if (skip_delay)
         return 0;
-    for (k = 0, n = 0; k < (DELAY_LOOP_COUNT / 2); ++k) {
-        n += rand();
+    next_edge_ns += quarter_ns;
+    now = sa_ts_ns(CLOCK_MONOTONIC);
+    if (now > (next_edge_ns + quarter_ns)) {
+        next_edge_ns = now;
+        return 1;
     }
-    return n;
+    while (now < next_edge_ns)
+        now = sa_ts_ns(CLOCK_MONOTONIC);
+    return 0;
 }
 
 // Read a byte from I2C bus and send the ack sequence
@@ -572,6 +801,86 @@ i2c_outbyte(unsigned char x)
 }
 
 
+/* One benchmark transaction. Writes 'prefix' then <size> bytes of 0x55,
+ * or when 'do_read' writes 'prefix' (if any) then after a repeated start
+ * reads <size> bytes into 'rbuf'. Returns 1 if ok, 0 if NAKed. */
+static int
+bench_xfer(int sa, const unsigned char * prefix, int prefix_len,
+           int do_read, int size, unsigned char * rbuf, int ignore_nak)
+{
+    int k;
+
+    i2c_start();
+    if ((! do_read) || (prefix_len > 0)) {
+        if ((0 == i2c_outbyte((sa << 1) | I2C_CMD_WRITE)) && (! ignore_nak))
+            goto nak;
+        for (k = 0; k < prefix_len; ++k) {
+            if ((0 == i2c_outbyte(prefix[k])) && (! ignore_nak))
+                goto nak;
+        }
+        if (do_read)
+            i2c_start();        /* repeated start */
+        else {
+            for (k = 0; k < size; ++k) {
+                if ((0 == i2c_outbyte(0x55)) && (! ignore_nak))
+                    goto nak;
+            }
+        }
+    }
+    if (do_read) {
+        if ((0 == i2c_outbyte((sa << 1) | I2C_CMD_READ)) && (! ignore_nak))
+            goto nak;
+        for (k = 0; k < size; ++k)
+            rbuf[k] = i2c_inbyte(k == (size - 1));
+    }
+    i2c_stop();
+    return 1;
+nak:
+    i2c_stop();
+    return 0;
+}
+
+/* Benchmark: for each of sizes[] run 'iterations' transactions, then
+ * report via i2c_bench in the same format as 'i2c_devtest -b'. */
+static int
+do_bench(int sa, const unsigned char * prefix, int prefix_len, int do_read,
+         const int * sizes, int num_sizes, int iterations, int ignore_nak)
+{
+    int j, k, tries, ok;
+    uint64_t t0;
+    char bus[64];
+    unsigned char rbuf[IB_MAX_SIZE];
+    struct i2c_bench ib;
+
+    if (ib_init(&ib, iterations))
+        return 1;
+    snprintf(bus, sizeof(bus), "SCL=P%c%d SDA=P%c%d %s at %u Hz", scl_port,
+             scl_pin_in_bank, sda_port, sda_pin_in_bank,
+             (use_mmap ? "mmap" : "sysfs"), i2c_clk_hz);
+    ib_header(&ib, "i2c_bbtest", bus, sa, do_read ? "read" : "write");
+    i2c_init();
+    for (j = 0; j < num_sizes; ++j) {
+        ib_start(&ib);
+        for (k = 0; k < iterations; ++k) {
+            t0 = sa_ts_ns(CLOCK_MONOTONIC);
+            for (tries = IB_RETRIES; ; --tries) {
+                next_edge_ns = sa_ts_ns(CLOCK_MONOTONIC);
+                ok = bench_xfer(sa, prefix, prefix_len, do_read, sizes[j],
+                                rbuf, ignore_nak);
+                if (ok || (0 == ib_nak(&ib, tries)))
+                    break;
+            }
+            ib_record(&ib, sa_ts_ns(CLOCK_MONOTONIC) - t0, ok ? sizes[j] : 0);
+            if ((! ok) && (verbose > 1))
+                fprintf(stderr, "size=%d, transaction %d: NAK after %d "
+                        "retries\n", sizes[j], k + 1, IB_RETRIES);
+        }
+        ib_report(&ib, sizes[j]);
+    }
+    ib_free(&ib);
+    return 0;
+}
+
 /* Read comma (or single space) separated ASCII hex bytes from 'inp' into
  * 'arr'. Number written placed in *arr_len. If first char in 'inp' is "-"
  * reads from stdin instead. With stdin whitespace may be a separator and
@@ -703,15 +1012,28 @@ main(int argc, char ** argv)
     int wait_usecs = 0;
     int zero_test = 0;
     int retries = 0;
+    int num_sizes = 0;
+    int iterations = IB_DEF_ITERATIONS;
     int ret = 1;
+    int sizes[IB_MAX_SIZES];
     const char * cp;
     unsigned char arr[1024];
     struct timespec wait_req;
     struct stat sb;
     int report = 0;
+    uint64_t t_start;
+    long lv;
+    char * endp;
 
-    while ((opt = getopt(argc, argv, "c:C:d:D:Fhi:Ir:R:s:tvVw:z")) != -1) {
+    while ((opt = getopt(argc, argv, "b:c:C:d:D:Fhi:Ik:mMn:r:R:s:tvVw:z"))
+           != -1) {
         switch (opt) {
+        case 'b':
+            num_sizes = ib_parse_sizes(('-' == optarg[0]) ? NULL : optarg,
+                                       sizes, IB_MAX_SIZES);
+            if (num_sizes < 0)
+                exit(EXIT_FAILURE);
+            break;
         case 'c':
             cp = optarg;
             if (isalpha(cp[0])) {
@@ -837,6 +1159,39 @@ main(int argc, char ** argv)
         case 'I':
             ++ignore_nak;
             break;
+        case 'k':
+            errno = 0;
+            lv = strtol(optarg, &endp, 10);
+            if (('k' == *endp) || ('K' == *endp)) {
+                /* range check before multiplying so it cannot overflow */
+                lv = ((lv < 0) || (lv > (I2C_MAX_CLK_HZ / 1000))) ? -1 :
+                     (lv * 1000);
+                ++endp;
+            }
+            if (errno || ('\0' != *endp) || (lv < 100) ||
+                (lv > I2C_MAX_CLK_HZ)) {
+                fprintf(stderr, "'-k' expects a SCL rate from 100 to "
+                        "1000k (Hz)\n");
+                exit(EXIT_FAILURE);
+            }
+            i2c_clk_hz = (int)lv;
+            break;
+        case 'm':
+            if (0 == use_mmap)
+                use_mmap = 1;
+            break;
+        case 'M':
+            use_mmap = 2;
+            break;
+        case 'n':
+            k = atoi(optarg);
+            if ((k < 1) || (k > IB_MAX_ITERATIONS)) {
+                fprintf(stderr, "'-n' expects a number from 1 to %d\n",
+                        IB_MAX_ITERATIONS);
+                exit(EXIT_FAILURE);
+            }
+            iterations = k;
+            break;
         case 'r':
             k = atoi(optarg);
             if ((k < 0) || (k > 31)) {
@@ -896,6 +1251,12 @@ main(int argc, char ** argv)
         }
     }
 
+    if (num_sizes && (scl_timer || zero_test || retries || wait_usecs)) {
+        fprintf(stderr, "'-b <sizes>' is not accepted with '-R', '-t', "
+                "'-w' or '-z'\n");
+        exit(EXIT_FAILURE);
+    }
+
     if (((scl_kpin < 0) && (scl_pin_in_bank  < 0)) ||
         ((sda_kpin < 0) && (sda_pin_in_bank  < 0))) {
         fprintf(stderr, "Need both GPIOs defined for SCL and SDA\n");
@@ -942,10 +1303,14 @@ main(int argc, char ** argv)
             fprintf(stderr, "gpio kernel pin numbers: SCL=%d, SDA=%d\n",
                     scl_kpin, sda_kpin);
     }
-    if (init_atmel_pins() < 0)
+    if (use_mmap) {
+        if (init_mmap_pins() < 0)
+            goto bad;
+    } else if (init_atmel_pins() < 0)
         goto bad;
 
     scl_direction_out();  /* SCL may not be set for output */
+    calibrate_delay();
 
     if (zero_test) {
         fprintf(stderr, "drive SCL and SDA lines low, wait 60 seconds "
@@ -961,25 +1326,31 @@ main(int argc, char ** argv)
                 cmd_len);
 
     if (scl_timer) {
+        t_start = sa_ts_ns(CLOCK_MONOTONIC);
         if (2 == scl_timer) {
             fprintf(stderr, "start SCL timing, without IO\n");
             ch = 0;
-            for (k = 0; k < 10000000; ++k) {
+            next_edge_ns = sa_ts_ns(CLOCK_MONOTONIC);
+            for (k = 0; k < SCL_TIMER_CYCLES; ++k) {
                 ch += half_delay() + half_delay() + half_delay() +
                       half_delay();
             }
-            fprintf(stderr, "cumulative_loop_count=%d\n", ch);
+            fprintf(stderr, "late (rescheduled) %d times\n", ch);
         } else {
             if (3 == scl_timer)
                 ++skip_delay;
             fprintf(stderr, "start SCL timing%s\n",
                     (skip_delay ? ", skip delay" : ""));
-            for (k = 0; k < 10000000; ++k) {
+            next_edge_ns = sa_ts_ns(CLOCK_MONOTONIC);
+            for (k = 0; k < SCL_TIMER_CYCLES; ++k) {
                 set_scl(0);
                 set_scl(1);
             }
         }
-        fprintf(stderr, "finish SCL timing\n");
+        t_start = sa_ts_ns(CLOCK_MONOTONIC) - t_start;
+        fprintf(stderr, "finish SCL timing: %d cycles in %.3f seconds, "
+                "%.1f Hz\n", SCL_TIMER_CYCLES, t_start / 1e9,
+                (SCL_TIMER_CYCLES * 1e9) / t_start);
         goto the_end;
     }
     if (i2c_slave_addr < 0) {
@@ -995,6 +1366,12 @@ main(int argc, char ** argv)
         ++cmd_len;
         command[0] = (i2c_slave_addr << 1) | I2C_CMD_WRITE;
     }
+    if (num_sizes) {
+        ret = do_bench(i2c_slave_addr, command + 1, cmd_len - 1,
+                       (response_len > 0), sizes, num_sizes, iterations,
+                       ignore_nak);
+        goto bad;
+    }
     if (response_len > (int)sizeof(arr)) {
         fprintf(stderr, "'-r' argument (%d) exceeds allowed size (%d)\n",
                 response_len, (int)sizeof(arr));
@@ -1071,6 +1448,9 @@ the_end:
 
 bad:
 
-    cleanup_atmel_pins();
+    if (use_mmap)
+        cleanup_mmap_pins();
+    else
+        cleanup_atmel_pins();
     return ret;
 }
@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2026 Douglas Gilbert.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+/*****************************************************************
+ * i2c_bench.c
+ *
+ * Benchmark statistics and report shared by i2c_devtest and i2c_bbtest.
+ * See i2c_bench.h .
+ *
+ ****************************************************/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "i2c_bench.h"
+#include "sa_misc.h"
+
+
+int
+ib_parse_sizes(const char * arg, int * sizes, int max_sizes)
+{
+    int k;
+    long v;
+    const char * cp;
+    char * endp;
+
+    cp = arg ? arg : IB_DEF_SIZES;
+    for (k = 0; *cp; ++k) {
+        v = strtol(cp, &endp, 10);
+        if ((endp == cp) || (v < 1) || (v > IB_MAX_SIZE) ||
+            ((',' != *endp) && ('\0' != *endp))) {
+            fprintf(stderr, "bad size list: expect numbers from 1 to %d "
+                    "separated by commas\n", IB_MAX_SIZE);
+            return -1;
+        }
+        if (k >= max_sizes) {
+            fprintf(stderr, "size list: no more than %d sizes\n",
+                    max_sizes);
+            return -1;
+        }
+        sizes[k] = (int)v;
+        cp = ('\0' == *endp) ? endp : (endp + 1);
+    }
+    if (0 == k) {
+        fprintf(stderr, "size list is empty\n");
+        return -1;
+    }
+    return k;
+}
+
+int
+ib_init(struct i2c_bench * bp, int iterations)
+{
+    memset(bp, 0, sizeof(*bp));
+    bp->iterations = iterations;
+    bp->lat_ns = (uint64_t *)calloc(iterations, sizeof(uint64_t));
+    if (NULL == bp->lat_ns) {
+        fprintf(stderr, "ib_init: out of memory\n");
+        return -1;
+    }
+    return 0;
+}
+
+void
+ib_free(struct i2c_bench * bp)
+{
+    free(bp->lat_ns);
+    bp->lat_ns = NULL;
+}
+
+void
+ib_header(const struct i2c_bench * bp, const char * tool, const char * bus,
+          int sa, const char * dir)
+{
+    printf("# %s benchmark: %s, slave 0x%x, %s, %d transactions per size, "
+           "%d retries\n", tool, bus, sa, dir, bp->iterations, IB_RETRIES);
+    printf("#  size      bytes/s   min_us   p50_us   p90_us   p99_us   "
+           "max_us   naks  retries  errors\n");
+}
+
+void
+ib_start(struct i2c_bench * bp)
+{
+    bp->num = 0;
+    bp->naks = 0;
+    bp->retries = 0;
+    bp->errors = 0;
+    bp->bytes = 0;
+    bp->start_ns = sa_ts_ns(CLOCK_MONOTONIC);
+}
+
+int
+ib_nak(struct i2c_bench * bp, int tries_left)
+{
+    struct timespec ts;
+
+    ++bp->naks;
+    if (tries_left <= 0)
+        return 0;
+    ts.tv_sec = 0;
+    ts.tv_nsec = IB_RETRY_USEC * 1000;
+    nanosleep(&ts, NULL);
+    ++bp->retries;
+    return 1;
+}
+
+void
+ib_record(struct i2c_bench * bp, uint64_t lat_ns, int bytes)
+{
+    if (bp->num < bp->iterations)
+        bp->lat_ns[bp->num++] = lat_ns;
+    if (bytes > 0)
+        bp->bytes += bytes;
+    else
+        ++bp->errors;
+}
+
+static int
+cmp_u64(const void * a, const void * b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return (x < y) ? -1 : (x > y);
+}
+
+/* nearest rank percentile of sorted lat_ns[], in microseconds */
+static double
+percentile_us(const struct i2c_bench * bp, int pc)
+{
+    int k = ((bp->num * pc) + 99) / 100;
+
+    if (k < 1)
+        k = 1;
+    return bp->lat_ns[k - 1] / 1000.0;
+}
+
+void
+ib_report(struct i2c_bench * bp, int size)
+{
+    uint64_t elapsed = sa_ts_ns(CLOCK_MONOTONIC) - bp->start_ns;
+
+    if (0 == bp->num) {
+        printf("%7d  (no transactions)\n", size);
+        return;
+    }
+    qsort(bp->lat_ns, bp->num, sizeof(uint64_t), cmp_u64);
+    printf("%7d %12.1f %8.1f %8.1f %8.1f %8.1f %8.1f %6d %8d %7d\n", size,
+           elapsed ? ((bp->bytes * 1e9) / elapsed) : 0.0,
+           bp->lat_ns[0] / 1000.0, percentile_us(bp, 50),
+           percentile_us(bp, 90), percentile_us(bp, 99),
+           bp->lat_ns[bp->num - 1] / 1000.0, bp->naks, bp->retries,
+           bp->errors);
+    fflush(stdout);
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2026 Douglas Gilbert.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+#ifndef I2C_BENCH_H
+#define I2C_BENCH_H
+
+/*****************************************************************
+ * i2c_bench.h
+ *
+ * Benchmark bookkeeping shared by i2c_devtest (kernel adapter via
+ * /dev/i2c-<n>) and i2c_bbtest (bit banged). Each tool sweeps a list of
+ * transfer sizes, runs the same transaction a number of times at each
+ * size and reports through this module so the two reports have the same
+ * format and can be compared line by line. A NAKed transaction is retried
+ * up to IB_RETRIES times, IB_RETRY_USEC apart (long enough for an eeprom
+ * to finish its write cycle); one still NAKed after that is an error.
+ *
+ ****************************************************/
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IB_DEF_SIZES "1,2,4,8,16,32,64,128,256"
+#define IB_DEF_ITERATIONS 100
+#define IB_MAX_SIZES 32
+#define IB_MAX_SIZE 1024        /* largest transfer, in bytes */
+#define IB_MAX_ITERATIONS 1000000
+#define IB_RETRIES 5
+#define IB_RETRY_USEC 1000
+
+struct i2c_bench {
+    int iterations;     /* transactions per size */
+    int num;            /* latencies held in lat_ns[] */
+    int naks;           /* NAKs seen, including those later retried ok */
+    int retries;        /* transactions repeated after a NAK */
+    int errors;         /* transactions that failed (after retries) */
+    uint64_t bytes;     /* payload bytes moved by successful transactions */
+    uint64_t start_ns;  /* when ib_start() called */
+    uint64_t * lat_ns;  /* latency of each transaction, retries included */
+};
+
+/* Parses a comma separated list of sizes (each 1 to IB_MAX_SIZE) into
+ * sizes[]. NULL 'arg' gives IB_DEF_SIZES. Returns number of sizes or -1. */
+int ib_parse_sizes(const char * arg, int * sizes, int max_sizes);
+
+/* Allocates room for 'iterations' latencies. Returns 0 or -1 . */
+int ib_init(struct i2c_bench * bp, int iterations);
+
+void ib_free(struct i2c_bench * bp);
+
+/* Prints the two line report header to stdout. 'tool' is the utility
+ * name, 'bus' the device or SCL/SDA pins, 'dir' is "write" or "read". */
+void ib_header(const struct i2c_bench * bp, const char * tool,
+               const char * bus, int sa, const char * dir);
+
+/* Zeroes the counters and notes the start time; call before each size. */
+void ib_start(struct i2c_bench * bp);
+
+/* Counts a NAK. If 'tries_left' > 0 sleeps IB_RETRY_USEC, counts a retry
+ * and returns 1 (so the caller repeats the transaction), else returns 0 . */
+int ib_nak(struct i2c_bench * bp, int tries_left);
+
+/* Records one transaction that took 'lat_ns'; 'bytes' of 0 counts as an
+ * error. */
+void ib_record(struct i2c_bench * bp, uint64_t lat_ns, int bytes);
+
+/* Prints the line for transfer 'size' to stdout. */
+void ib_report(struct i2c_bench * bp, int size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -60,12 +60,23 @@
 #include <linux/i2c.h>
 #include <linux/i2c-dev.h>
 
-static const char * version_str = "2.02 20180731";
+#include "i2c_bench.h"
+#include "sa_misc.h"
+
+static const char * version_str = "2.04 20261014";
 
 #ifndef I2C_FUNC_NOSTART
 #define I2C_FUNC_NOSTART 0x00000010
 #endif
 
+#ifdef I2C_RDWR_IOCTL_MAX_MSGS
+#define SCRIPT_MAX_MSGS I2C_RDWR_IOCTL_MAX_MSGS
+#else
+#define SCRIPT_MAX_MSGS 42
+#endif
+#define SCRIPT_MAX_WLEN 256     /* bytes written by one script step */
+#define SCRIPT_MAX_RLEN 1024    /* bytes read by one script step */
+
 
 /* Example of this utility with a DS1307 RTC
  * # Read the stored date time stamp
@@ -138,17 +149,42 @@ usage(int help_val)
         fprintf(stderr, "# writes 0x55 into address 0x123\n");
         fprintf(stderr, " > i2c_devtest -d0 -s 50 -i \"1 23\" -r 1\n");
         fprintf(stderr, " 55\n");
-        fprintf(stderr, "# reads 55 (0x55) from address 0x123\n");
+        fprintf(stderr, "# reads 55 (0x55) from address 0x123\n\n");
+        fprintf(stderr, "# Script ('-f -') reading two thermometers and "
+                "an RTC with two\n# ioctls: the DS1631 needs 750 ms "
+                "after a start convert:\n");
+        fprintf(stderr, " > printf '48 51 d=750000\\n48 aa r=2\\n49 aa "
+                "r=2\\n68 0 r=7\\n' |\n      i2c_devtest -d0 -f -\n");
+        fprintf(stderr, " 2 48 17 40\n 3 49 16 c0\n 4 68 27 47 22 05 02 "
+                "04 09\n");
         return;
     }
     fprintf(stderr, "Usage: "
-            "i2c_devtest [-d <dev>] [-F] [-h] [-H] -i <H,H...> [-I] "
-            "[-r <num>]\n"
-            "                   [-s <sa>] [-t] [-T] [-v] [-V] [-w <usec>]\n"
+            "i2c_devtest [-b <sizes>] [-d <dev>] [-f <file>] [-F] [-h] [-H] "
+            "-i <H,H...>\n"
+            "                   [-I] [-n <num>] [-r <num>] [-s <sa>] [-t] "
+            "[-T] [-v] [-V]\n"
+            "                   [-w <usec>]\n"
             "  where:\n"
+            "    -b <sizes>   benchmark: for each size (comma separated "
+            "list, '-' for\n"
+            "                 %s) do '-n' transactions; each\n"
+            "                 writes '-i' bytes then <size> bytes (or with "
+            "'-r' reads\n"
+            "                 <size> bytes). Report bytes/s, latency "
+            "percentiles, NAKs\n"
+            "                 and retries. Same report as 'i2c_bbtest -b'\n"
             "    -d <dev>     if <dev> starts with digit then open device\n"
             "                 '/dev/i2c-<num>' else open device '<dev>'\n"
             "                 (default: '/dev/i2c-0')\n"
+            "    -f <file>    script: each line '<sa> [<H> ...] [r=<num>] "
+            "[d=<usec>]'\n"
+            "                 writes <H>s then reads <num> bytes from slave "
+            "<sa>, then\n"
+            "                 delays. Steps without delay share one "
+            "ioctl. Output per\n"
+            "                 read: '<line> <sa> <H> ...'. <file> of '-' "
+            "is stdin\n"
             "    -F           print functionality of I2C master; use twice "
             "to\n"
             "                 additionally show (indented) what is not "
@@ -163,6 +199,7 @@ usage(int help_val)
             "ignored)\n"
             "    -I           ignore NAKs (twice: ignore NAKs on write "
             "transfer)\n"
+            "    -n <num>     transactions per size for '-b' (def: %d)\n"
             "    -r <num>     number of bytes in decimal to request from "
             "slave\n"
             "                 (def: 0). Uses slave address from '-i' or "
@@ -184,7 +221,8 @@ usage(int help_val)
             "I2C device test program. The (7 bit) slave address can be "
             "given either\nas the first byte of the '-i' list or "
             "with the '-s' option.\nExample: DS1307 slave_address=68h, so "
-            "either -i '68,...' or '-s 68'\n");
+            "either -i '68,...' or '-s 68'\n", IB_DEF_SIZES,
+            IB_DEF_ITERATIONS);
 }
 
 /* Read comma (or single space) separated ASCII hex bytes from 'inp' into
@@ -305,6 +343,331 @@ read_hex(const char * inp, unsigned char * arr, int max_arr_len,
     return 0;
 }
 
+/* Script mode ('-f FILE'). Each line is one step:
+ *     <sa> [<H> ...] [r=<num>] [d=<usec>]
+ * where <sa> is the slave address in hex, <H> are bytes (hex) to write,
+ * r=<num> bytes (decimal) are then read and d=<usec> is a delay after
+ * the step. Steps run in order; consecutive steps without a delay go into
+ * one I2C_RDWR ioctl (a combined transfer with repeated starts). */
+struct i2c_step {
+    int sa;
+    int wlen;
+    int rlen;
+    int delay_us;
+    int line_num;
+    unsigned char * wbuf;
+    unsigned char * rbuf;
+};
+
+static void
+free_steps(struct i2c_step * sp, int num)
+{
+    int k;
+
+    for (k = 0; k < num; ++k) {
+        free(sp[k].wbuf);
+        free(sp[k].rbuf);
+    }
+    free(sp);
+}
+
+/* Returns 0 if ok, else 1 after printing a message */
+static int
+parse_step(char * line, int line_num, int ten_bit_sa, struct i2c_step * sp)
+{
+    int k;
+    unsigned int h;
+    char * cp;
+    const char * msg;
+    char * savep;
+    char * endp;
+    unsigned char wb[SCRIPT_MAX_WLEN];
+
+    memset(sp, 0, sizeof(*sp));
+    sp->line_num = line_num;
+    sp->sa = -1;
+    for (cp = strtok_r(line, " ,\t", &savep); cp;
+         cp = strtok_r(NULL, " ,\t", &savep)) {
+        if (sp->sa < 0) {
+            h = strtoul(cp, &endp, 16);
+            if (('\0' != *endp) || (h > (ten_bit_sa ? 0x3ffU : 0x77U)))
+                goto bad;
+            sp->sa = h;
+        } else if (('r' == tolower(cp[0])) && ('=' == cp[1])) {
+            k = strtol(cp + 2, &endp, 10);
+            if (('\0' != *endp) || (k < 0) || (k > SCRIPT_MAX_RLEN))
+                goto bad;
+            sp->rlen = k;
+        } else if (('d' == tolower(cp[0])) && ('=' == cp[1])) {
+            k = strtol(cp + 2, &endp, 10);
+            if (('\0' != *endp) || (k < 0))
+                goto bad;
+            sp->delay_us = k;
+        } else {
+            h = strtoul(cp, &endp, 16);
+            if (('\0' != *endp) || (h > 0xff) ||
+                (sp->wlen >= SCRIPT_MAX_WLEN))
+                goto bad;
+            wb[sp->wlen++] = h;
+        }
+    }
+    if (sp->sa < 0)
+        return 0;               /* blank line */
+    if ((0 == sp->wlen) && (0 == sp->rlen)) {
+        msg = "nothing to write or read";
+        goto bad_msg;
+    }
+    if (sp->wlen) {
+        if (NULL == (sp->wbuf = (unsigned char *)malloc(sp->wlen)))
+            goto nomem;
+        memcpy(sp->wbuf, wb, sp->wlen);
+    }
+    if (sp->rlen) {
+        if (NULL == (sp->rbuf = (unsigned char *)calloc(sp->rlen, 1)))
+            goto nomem;
+    }
+    return 0;
+bad:
+    fprintf(stderr, "script line %d: bad token: %s\n", line_num, cp);
+    return 1;
+bad_msg:
+    fprintf(stderr, "script line %d: %s\n", line_num, msg);
+    return 1;
+nomem:
+    fprintf(stderr, "script line %d: out of memory\n", line_num);
+    return 1;
+}
+
+/* Reads script from file 'fn' ('-' for stdin) into a newly allocated
+ * array placed in *stepsp with *nump elements. Returns 0 if ok, else 1 */
+static int
+read_script(const char * fn, int ten_bit_sa, struct i2c_step ** stepsp,
+            int * nump)
+{
+    int k, num, max_num, line_num;
+    int ret = 1;
+    FILE * fp;
+    struct i2c_step * sp = NULL;
+    struct i2c_step * nsp;
+    char * cp;
+    char line[1024];
+
+    if (('-' == fn[0]) && ('\0' == fn[1]))
+        fp = stdin;
+    else if (NULL == (fp = fopen(fn, "r"))) {
+        fprintf(stderr, "unable to open %s: %s\n", fn, strerror(errno));
+        return 1;
+    }
+    for (num = 0, max_num = 0, line_num = 1;
+         fgets(line, sizeof(line), fp); ++line_num) {
+        if ((cp = strchr(line, '\n')))
+            *cp = '\0';
+        else if ((k = getc(fp)) != EOF) {
+            /* a split line would run its tail as a step of its own */
+            fprintf(stderr, "script line %d: too long\n", line_num);
+            goto fini;
+        }
+        if ((cp = strchr(line, '#')))
+            *cp = '\0';
+        if (num >= max_num) {
+            max_num = max_num ? (2 * max_num) : 32;
+            nsp = (struct i2c_step *)realloc(sp, max_num * sizeof(*sp));
+            if (NULL == nsp) {
+                fprintf(stderr, "read_script: out of memory\n");
+                goto fini;
+            }
+            sp = nsp;
+        }
+        k = parse_step(line, line_num, ten_bit_sa, sp + num);
+        ++num;
+        if (k)
+            goto fini;
+        if (sp[num - 1].sa < 0)
+            --num;              /* blank or comment line */
+    }
+    if (0 == num) {
+        fprintf(stderr, "read_script: no steps found in %s\n", fn);
+        goto fini;
+    }
+    ret = 0;
+fini:
+    if (stdin != fp)
+        fclose(fp);
+    if (ret) {
+        if (sp)
+            free_steps(sp, num);
+    } else {
+        *stepsp = sp;
+        *nump = num;
+    }
+    return ret;
+}
+
+/* Fills msg[] from steps [first, last) which must fit. Returns number of
+ * messages. */
+static int
+add_step_msgs(struct i2c_msg * msg, const struct i2c_step * sp, int first,
+              int last, int flags)
+{
+    int k, n;
+
+    for (k = first, n = 0; k < last; ++k) {
+        if (sp[k].wlen) {
+            msg[n].addr = sp[k].sa;
+            msg[n].flags = flags;
+            msg[n].len = sp[k].wlen;
+            msg[n].buf = sp[k].wbuf;
+            ++n;
+        }
+        if (sp[k].rlen) {
+            msg[n].addr = sp[k].sa;
+            msg[n].flags = flags | I2C_M_RD;
+            msg[n].len = sp[k].rlen;
+            msg[n].buf = sp[k].rbuf;
+            ++n;
+        }
+    }
+    return n;
+}
+
+/* Runs all steps, merging them into as few I2C_RDWR ioctls as delays and
+ * the kernel's message limit allow. Then outputs one line per step that
+ * read: "<line_num> <sa> <H> ...". Returns 0 if ok, else 1 */
+static int
+do_script(int fd, struct i2c_step * sp, int num, int flags, int verbose)
+{
+    int k, first, nmsgs, n_ioctl;
+    struct i2c_msg msg[SCRIPT_MAX_MSGS];
+    struct i2c_rdwr_ioctl_data rdwr_arg;
+    struct timespec wait_req, rem;
+
+    for (first = 0, n_ioctl = 0; first < num; first = k) {
+        /* each step needs at most 2 messages */
+        for (k = first, nmsgs = 0; k < num; ) {
+            nmsgs += (!! sp[k].wlen) + (!! sp[k].rlen);
+            if (nmsgs > SCRIPT_MAX_MSGS)
+                break;
+            if (sp[k++].delay_us)
+                break;
+        }
+        nmsgs = add_step_msgs(msg, sp, first, k, flags);
+        rdwr_arg.msgs = msg;
+        rdwr_arg.nmsgs = nmsgs;
+        if (verbose > 1)
+            fprintf(stderr, "ioctl(I2C_RDWR): script lines %d to %d, %d "
+                    "messages\n", sp[first].line_num, sp[k - 1].line_num,
+                    nmsgs);
+        if (ioctl(fd, I2C_RDWR, &rdwr_arg) < 0) {
+            fprintf(stderr, "ioctl(I2C_RDWR) for script lines %d to %d "
+                    "failed: %s\n", sp[first].line_num, sp[k - 1].line_num,
+                    strerror(errno));
+            return 1;
+        }
+        ++n_ioctl;
+        if (sp[k - 1].delay_us) {
+            wait_req.tv_sec = sp[k - 1].delay_us / 1000000;
+            wait_req.tv_nsec = (sp[k - 1].delay_us % 1000000) * 1000;
+            while ((nanosleep(&wait_req, &rem) < 0) && (EINTR == errno))
+                wait_req = rem;
+        }
+    }
+    if (verbose)
+        fprintf(stderr, "%d script steps took %d ioctl(I2C_RDWR) calls\n",
+                num, n_ioctl);
+    for (k = 0; k < num; ++k) {
+        if (0 == sp[k].rlen)
+            continue;
+        printf("%d %02x", sp[k].line_num, sp[k].sa);
+        for (first = 0; first < sp[k].rlen; ++first)
+            printf(" %02x", sp[k].rbuf[first]);
+        printf("\n");
+    }
+    return 0;
+}
+
+/* Benchmark: for each of sizes[] run 'iterations' transactions each as a
+ * single I2C_RDWR ioctl. A write transaction sends 'prefix' followed by
+ * <size> bytes of 0x55; a read transaction sends 'prefix' (if any) then,
+ * after a repeated start, reads <size> bytes. Report via i2c_bench.
+ * Returns 0 if ok, else 1 */
+static int
+do_bench(int fd, const char * dev_name, int sa, const unsigned char * prefix,
+         int prefix_len, int do_read, const int * sizes, int num_sizes,
+         int iterations, int flags, int verbose)
+{
+    int j, k, n, size, tries, res;
+    int ret = 1;
+    uint64_t t0;
+    unsigned char * wbuf;
+    unsigned char * rbuf;
+    struct i2c_bench ib;
+    struct i2c_msg msg[2];
+    struct i2c_rdwr_ioctl_data rdwr_arg;
+
+    if (ib_init(&ib, iterations))
+        return 1;
+    wbuf = (unsigned char *)malloc(prefix_len + IB_MAX_SIZE);
+    rbuf = (unsigned char *)malloc(IB_MAX_SIZE);
+    if ((NULL == wbuf) || (NULL == rbuf)) {
+        fprintf(stderr, "do_bench: out of memory\n");
+        goto fini;
+    }
+    memcpy(wbuf, prefix, prefix_len);
+    memset(wbuf + prefix_len, 0x55, IB_MAX_SIZE);
+    memset(msg, 0, sizeof(msg));
+    ib_header(&ib, "i2c_devtest", dev_name, sa, do_read ? "read" : "write");
+    for (j = 0; j < num_sizes; ++j) {
+        size = sizes[j];
+        n = 0;
+        if ((! do_read) || (prefix_len > 0)) {
+            msg[n].addr = sa;
+            msg[n].flags = flags;
+            msg[n].len = prefix_len + (do_read ? 0 : size);
+            msg[n].buf = wbuf;
+            ++n;
+        }
+        if (do_read) {
+            msg[n].addr = sa;
+            msg[n].flags = flags | I2C_M_RD;
+            msg[n].len = size;
+            msg[n].buf = rbuf;
+            ++n;
+        }
+        rdwr_arg.msgs = msg;
+        rdwr_arg.nmsgs = n;
+        ib_start(&ib);
+        for (k = 0; k < iterations; ++k) {
+            t0 = sa_ts_ns(CLOCK_MONOTONIC);
+            for (tries = IB_RETRIES; ; --tries) {
+                res = ioctl(fd, I2C_RDWR, &rdwr_arg);
+                if (res >= 0)
+                    break;
+                /* i2c-gpio reports a NAK with ENXIO, i2c-at91 with
+                 * EREMOTEIO; give up on anything else */
+                if ((ENXIO != errno) && (EREMOTEIO != errno)) {
+                    fprintf(stderr, "ioctl(I2C_RDWR) size=%d failed: %s\n",
+                            size, strerror(errno));
+                    goto fini;
+                }
+                if (0 == ib_nak(&ib, tries))
+                    break;
+            }
+            ib_record(&ib, sa_ts_ns(CLOCK_MONOTONIC) - t0,
+                      (res < 0) ? 0 : size);
+            if ((res < 0) && (verbose > 1))
+                fprintf(stderr, "size=%d, transaction %d: NAK after %d "
+                        "retries\n", size, k + 1, IB_RETRIES);
+        }
+        ib_report(&ib, size);
+    }
+    ret = 0;
+fini:
+    free(rbuf);
+    free(wbuf);
+    ib_free(&ib);
+    return ret;
+}
+
 /* perhaps the kernel doesn't like writing back to the stack */
 static unsigned char command[1024];
 static unsigned char arr[1024 + 4];
@@ -326,6 +689,13 @@ main(int argc, char ** argv)
     int cmd_len = 0;
     int verbose = 0;
     int wait_usecs = 0;
+    int num_steps = 0;
+    int num_sizes = 0;
+    int iterations = IB_DEF_ITERATIONS;
+    int ret;
+    int sizes[IB_MAX_SIZES];
+    const char * script_fn = NULL;
+    struct i2c_step * steps = NULL;
     unsigned long funcs;
     struct i2c_msg msg[11];
     struct i2c_rdwr_ioctl_data rdwr_arg;
@@ -333,14 +703,23 @@ main(int argc, char ** argv)
 
     memset(dev_name, 0, sizeof(dev_name));
     memset(msg, 0, sizeof(msg));
-    while ((opt = getopt(argc, argv, "d:FhHi:Ir:R:s:tTvVw:")) != -1) {
+    while ((opt = getopt(argc, argv, "b:d:f:FhHi:In:r:R:s:tTvVw:")) != -1) {
         switch (opt) {
+        case 'b':
+            num_sizes = ib_parse_sizes(('-' == optarg[0]) ? NULL : optarg,
+                                       sizes, IB_MAX_SIZES);
+            if (num_sizes < 0)
+                exit(EXIT_FAILURE);
+            break;
         case 'd':
             if (isdigit(*optarg))
                 snprintf(dev_name, sizeof(dev_name), "/dev/i2c-%s", optarg);
             else
                 strncpy(dev_name, optarg, sizeof(dev_name) - 1);
             break;
+        case 'f':
+            script_fn = optarg;
+            break;
         case 'F':
             ++functionality;
             break;
@@ -359,6 +738,15 @@ main(int argc, char ** argv)
         case 'I':
             ++ignore_nak;
             break;
+        case 'n':
+            k = atoi(optarg);
+            if ((k < 1) || (k > IB_MAX_ITERATIONS)) {
+                fprintf(stderr, "'-n' expects a number from 1 to %d\n",
+                        IB_MAX_ITERATIONS);
+                exit(EXIT_FAILURE);
+            }
+            iterations = k;
+            break;
         case 'r':
             k = atoi(optarg);
             if ((k < 0) || (k > 1024)) {
@@ -518,6 +906,37 @@ main(int argc, char ** argv)
         return 0;
     }
 
+    if (script_fn) {
+        if (cmd_len || test || (i2c_slave_addr >= 0) || i2c_response_len ||
+            wait_usecs || (1 != times) || num_sizes) {
+            fprintf(stderr, "'-f FILE' holds the slave addresses and data "
+                    "so '-b', '-i', '-r',\n'-R', '-s', '-t' and '-w' are "
+                    "not accepted\n");
+            exit(EXIT_FAILURE);
+        }
+        if (read_script(script_fn, ten_bit_sa, &steps, &num_steps))
+            exit(EXIT_FAILURE);
+        if ((fd = open(dev_name, O_RDWR)) < 0) {
+            perror("open failed");
+            fprintf(stderr, "Tried to open %s; may need to load modules "
+                    "i2c_dev and/or i2c_gpio\n", dev_name);
+            free_steps(steps, num_steps);
+            exit(EXIT_FAILURE);
+        }
+        ret = do_script(fd, steps, num_steps,
+                        (ignore_nak ? I2C_M_IGNORE_NAK : 0) |
+                        (ten_bit_sa ? I2C_M_TEN : 0), verbose);
+        free_steps(steps, num_steps);
+        close(fd);
+        return ret ? EXIT_FAILURE : 0;
+    }
+
+    if (num_sizes && (test || wait_usecs || (1 != times))) {
+        fprintf(stderr, "'-b <sizes>' is not accepted with '-R', '-t' or "
+                "'-w'\n");
+        exit(EXIT_FAILURE);
+    }
+
     if ((1 != times) && ((i2c_response_len > 0) || (wait_usecs > 0))) {
         fprintf(stderr, "when '-R <times>' is other than 1, '-r <num>' "
                 "and '-w <usec>' options\nare not accepted.\n");
@@ -553,6 +972,20 @@ main(int argc, char ** argv)
                 i2c_response_len, (int)sizeof(arr));
         exit(EXIT_FAILURE);
     }
+    if (num_sizes) {
+        if ((fd = open(dev_name, O_RDWR)) < 0) {
+            perror("open failed");
+            fprintf(stderr, "Tried to open %s; may need to load modules "
+                    "i2c_dev and/or i2c_gpio\n", dev_name);
+            exit(EXIT_FAILURE);
+        }
+        ret = do_bench(fd, dev_name, i2c_slave_addr, command, cmd_len,
+                       (i2c_response_len > 0), sizes, num_sizes, iterations,
+                       (ignore_nak ? I2C_M_IGNORE_NAK : 0) |
+                       (ten_bit_sa ? I2C_M_TEN : 0), verbose);
+        close(fd);
+        return ret ? EXIT_FAILURE : 0;
+    }
     if (test) {
         if (verbose)
             fprintf(stderr, "In test mode, sending 1024 bytes of 0x%x\n",
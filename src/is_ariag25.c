@@ -43,11 +43,13 @@
 #include <unistd.h>
 #include <string.h>
 
+#include "soc_id.h"
 
-static const char * version_str = "0.94 20150317";
+
+static const char * version_str = "0.95 20261014";
 
 #define CPUINFO "/proc/cpuinfo"
-#define DEVTREE_MODEL "/proc/device-tree/model"
+#define SOC_FAM SOC_FAM_AT91SAM9G25
 
 static int verbose = 0;
 
@@ -56,8 +58,10 @@ static void
 usage(void)
 {
     fprintf(stderr, "Usage: "
-            "is_ariag25 [-h] [-p] [-v] [-V]\n"
+            "is_ariag25 [-c] [-h] [-p] [-v] [-V]\n"
             "  where:\n"
+            "    -c           use, or create, the result cached in "
+            SOC_DEF_CACHE "\n"
             "    -h           print usage message\n"
             "    -p           prints '0' to stdout if Aria G25 else prints "
             "'1'\n"
@@ -76,17 +80,15 @@ main(int argc, char *argv[])
 {
     int opt;
     int print_stdout = 0;
+    int use_cache = 0;
     int ret = 1;
-#ifdef __ARM_EABI__
-    int num;
-    FILE *fp;
-    char b[1024];
-    char * cp;
-    char * c2p;
-#endif
+    struct soc_id sid;
 
-    while ((opt = getopt(argc, argv, "hpvV")) != -1) {
+    while ((opt = getopt(argc, argv, "chpvV")) != -1) {
         switch (opt) {
+        case 'c':
+            ++use_cache;
+            break;
         case 'h':
             usage();
             exit(EXIT_SUCCESS);
@@ -114,52 +116,13 @@ main(int argc, char *argv[])
             exit(EXIT_FAILURE);
         }
     }
-#ifdef __ARM_EABI__
-    if ((fp = fopen(CPUINFO, "r"))) {
-        num = fread(b, 1, sizeof(b) - 1, fp);
-        if (num > 10) {
-            b[num] = '\0';
-            if ((cp = strstr(b, "\nHardware"))) {
-                cp += 9;
-                if ((c2p = strchr(cp, '\n'))) {
-                    *c2p = '\0';
-                    if (verbose > 2)
-                        fprintf(stderr, "Checking this line: %s\n", cp);
-                    if (strstr(cp, "G25"))
-                        ret = 0;
-                }
-            }
-            if (0 != ret) {
-                if (verbose > 2)
-                    fprintf(stderr, "Didn't find 'G25' in %s, now check %s "
-                            "file\n", CPUINFO, DEVTREE_MODEL);
-                fclose(fp);
-                if ((fp = fopen(DEVTREE_MODEL, "r"))) {
-                    num = fread(b, 1, sizeof(b) - 1, fp);
-                    if (num > 2) {
-                        b[num] = '\0';
-                        if (strstr(b, "G25")) {
-                            if (verbose > 2)
-                                fprintf(stderr, "'G25' found in model line: "
-                                        "%s\n", b);
-                            ret = 0;
-                        }
-                    } else if (verbose && ferror(fp))
-                        fprintf(stderr, "Failed to read: %s\n",
-                                DEVTREE_MODEL);
-                } else if (verbose)
-                    fprintf(stderr, "Failed to open: %s\n", DEVTREE_MODEL);
-            }
-        } else if (verbose && ferror(fp))
-            fprintf(stderr, "Failed to read: %s\n", CPUINFO);
-        fclose(fp);
-    } else if (verbose)
-        fprintf(stderr, "Failed to open: %s\n", CPUINFO);
-#endif
+    if (SOC_FAM == soc_identify(&sid, (use_cache ? SOC_DEF_CACHE : NULL),
+                                verbose))
+        ret = 0;
     if (verbose)
-        fprintf(stderr, "'G25' string %sfound in %s or %s\nso assume this "
-                "is %sa Aria G25\n", ret ? "not " : "", CPUINFO,
-                DEVTREE_MODEL, ret ? "not " : "");
+        fprintf(stderr, "'G25' %sfound%s%s\nso assume this is %san Aria G25\n",
+                ret ? "not " : "", (sid.src[0] ? " in " : ""), sid.src,
+                ret ? "not " : "");
     if (print_stdout)
         printf("%d\n", ret);
     return ret;
@@ -44,15 +44,15 @@
 #include <unistd.h>
 #include <string.h>
 
+#include "soc_id.h"
 
-static const char * version_str = "0.91 20160104";
+
+static const char * version_str = "0.92 20261014";
 
 #define FAM_NAME "SAMA5D4"
 #define FAM_NAME_LC "sama5d4"
 
-#define CPUINFO "/proc/cpuinfo"
-#define DEVTREE_MODEL "/proc/device-tree/model"
-#define DEVTREE_COMPAT "/proc/device-tree/compatible"
+#define SOC_FAM SOC_FAM_SAMA5D4
 
 static int verbose = 0;
 
@@ -61,8 +61,10 @@ static void
 usage(void)
 {
     fprintf(stderr, "Usage: "
-            "is_%s [-h] [-p] [-v] [-V]\n"
+            "is_%s [-c] [-h] [-p] [-v] [-V]\n"
             "  where:\n"
+            "    -c           use, or create, the result cached in "
+            SOC_DEF_CACHE "\n"
             "    -h           print usage message\n"
             "    -p           prints '0' to stdout if in %s family "
             "else prints '1'\n"
@@ -81,17 +83,15 @@ main(int argc, char *argv[])
 {
     int opt;
     int print_stdout = 0;
+    int use_cache = 0;
     int ret = 1;
-#ifdef __ARM_EABI__
-    int n, num;
-    FILE *fp;
-    char b[1024];
-    const char * ccp;
-    struct stat a_stat;
-#endif
+    struct soc_id sid;
 
-    while ((opt = getopt(argc, argv, "hpvV")) != -1) {
+    while ((opt = getopt(argc, argv, "chpvV")) != -1) {
         switch (opt) {
+        case 'c':
+            ++use_cache;
+            break;
         case 'h':
             usage();
             exit(EXIT_SUCCESS);
@@ -119,53 +119,14 @@ main(int argc, char *argv[])
             exit(EXIT_FAILURE);
         }
     }
-#ifdef __ARM_EABI__
-    if (0 == stat(DEVTREE_MODEL, &a_stat)) {
-        if ((fp = fopen(DEVTREE_MODEL, "r"))) {
-            num = fread(b, 1, sizeof(b) - 1, fp);
-            if (num > 2) {
-                b[num] = '\0';
-                if (strstr(b, FAM_NAME) || strstr(b, FAM_NAME_LC)) {
-                    if (verbose > 2)
-                        fprintf(stderr, "'%s' found in model line: %s\n",
-                                FAM_NAME, b);
-                    ret = 0;
-                }
-            } else if (verbose && ferror(fp))
-                fprintf(stderr, "Failed to read: %s\n", DEVTREE_MODEL);
-            fclose(fp);
-        } else if (verbose)
-            fprintf(stderr, "Failed to open: %s\n", DEVTREE_MODEL);
-        if (1 == ret) {
-            if ((fp = fopen(DEVTREE_COMPAT, "r"))) {
-                num = fread(b, 1, sizeof(b) - 1, fp);
-                b[num] = '\0';
-                ccp = b;
-                while (num > 1) {
-                    if (strstr(ccp, FAM_NAME_LC)) {
-                        if (verbose > 2)
-                            fprintf(stderr, "'%s' found in compatible "
-                                    "string: %s\n", FAM_NAME, ccp);
-                        ret = 0;
-                        break;
-                    }
-                    n = strlen(ccp) + 1;
-                    num -= n;
-                    ccp += n;
-                }
-                if (verbose && ferror(fp))
-                    fprintf(stderr, "Failed to read: %s\n", DEVTREE_COMPAT);
-                fclose(fp);
-            } else if (verbose)
-                fprintf(stderr, "Failed to open: %s\n", DEVTREE_COMPAT);
-        }
-    } else if (verbose)
-        fprintf(stderr, "Failed to stat: %s\n", DEVTREE_MODEL);
-#endif
+    if (SOC_FAM == soc_identify(&sid, (use_cache ? SOC_DEF_CACHE : NULL),
+                                verbose))
+        ret = 0;
     if (verbose)
-        fprintf(stderr, "'%s' string %sfound in %s or %s\nso assume this "
-                "is %sa %s family SoC\n", FAM_NAME, ret ? "not " : "",
-                DEVTREE_MODEL, DEVTREE_COMPAT, ret ? "not " : "", FAM_NAME);
+        fprintf(stderr, "'" FAM_NAME "' %sfound%s%s\nso assume this is "
+                "%sa " FAM_NAME " family SoC\n",
+                ret ? "not " : "", (sid.src[0] ? " in " : ""), sid.src,
+                ret ? "not " : "");
     if (print_stdout)
         printf("%d\n", ret);
     return ret;
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2026 Douglas Gilbert.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+/* This utility reports which of the SoC families known to soc_id.c this
+ * is. With '-f' (or '--family') the family name is printed. With
+ * '-i FAM' the exit status is 0 when the SoC is in family FAM, like the
+ * separate is_* utilities. Unlike them, the result is cached (in
+ * SOC_DEF_CACHE) by default.
+ */
+
+#define _XOPEN_SOURCE 500
+#define _GNU_SOURCE 1
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "soc_id.h"
+
+
+static const char * version_str = "1.00 20261014";
+
+static int verbose = 0;
+
+static struct option long_options[] = {
+        {"cache", required_argument, 0, 'C'},
+        {"family", no_argument, 0, 'f'},
+        {"help", no_argument, 0, 'h'},
+        {"is", required_argument, 0, 'i'},
+        {"model", no_argument, 0, 'm'},
+        {"no-cache", no_argument, 0, 'n'},
+        {"verbose", no_argument, 0, 'v'},
+        {"version", no_argument, 0, 'V'},
+        {0, 0, 0, 0},
+};
+
+
+static void
+usage(void)
+{
+    int k;
+
+    fprintf(stderr, "Usage: "
+            "is_soc [-C FILE] [-f] [-h] [-i FAM] [-m] [-n] [-v] [-V]\n"
+            "  where:\n"
+            "    -C FILE      cache file name (def: %s)\n"
+            "    -f           print SoC family name (also '--family'); "
+            "exit\n"
+            "                 status 0 if family known, else 1\n"
+            "    -h           print usage message\n"
+            "    -i FAM       exit status 0 if SoC in family FAM, else 1\n"
+            "    -m           print device tree model string (if any)\n"
+            "    -n           no cache: neither read nor write FILE\n"
+            "    -v           increase verbosity\n"
+            "    -V           print version string then exit\n\n"
+            "Identifies the SoC family from the device tree model and "
+            "compatible\nstrings or from the Hardware line in "
+            "/proc/cpuinfo. The result is\nkept in FILE (on tmpfs) until "
+            "the next boot so later calls (from\nthis utility or the "
+            "is_* utilities given '-c') do not repeat the\nchecks. With "
+            "no options acts as if '-f' was given. FAM is one of:\n   ",
+            SOC_DEF_CACHE);
+    for (k = 1; k < SOC_FAM_NUM; ++k)
+        fprintf(stderr, " %s", soc_family_str(k));
+    fprintf(stderr, "\n");
+}
+
+
+int
+main(int argc, char *argv[])
+{
+    int opt;
+    int do_family = 0;
+    int do_model = 0;
+    int no_cache = 0;
+    int want_fam = -1;
+    int ret = 0;
+    const char * cache_fn = SOC_DEF_CACHE;
+    struct soc_id sid;
+
+    while ((opt = getopt_long(argc, argv, "C:fhi:mnvV", long_options,
+                              NULL)) != -1) {
+        switch (opt) {
+        case 'C':
+            cache_fn = optarg;
+            break;
+        case 'f':
+            ++do_family;
+            break;
+        case 'h':
+            usage();
+            exit(EXIT_SUCCESS);
+        case 'i':
+            if ((want_fam = soc_family_from_str(optarg)) < 1) {
+                fprintf(stderr, "'-i' expects a known family name, see "
+                        "usage\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'm':
+            ++do_model;
+            break;
+        case 'n':
+            ++no_cache;
+            break;
+        case 'v':
+            ++verbose;
+            break;
+        case 'V':
+            printf("%s\n", version_str);
+            exit(EXIT_SUCCESS);
+            break;
+        default: /* '?' */
+            usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (optind < argc) {
+        for (; optind < argc; ++optind)
+            fprintf(stderr, "Unexpected extra argument: %s\n",
+                    argv[optind]);
+        usage();
+        exit(EXIT_FAILURE);
+    }
+    if ((want_fam < 0) && (0 == do_model))
+        ++do_family;
+    soc_identify(&sid, (no_cache ? NULL : cache_fn), verbose);
+    if (verbose)
+        fprintf(stderr, "family: %s%s%s%s\n", soc_family_str(sid.family),
+                (sid.src[0] ? " [from " : ""), sid.src,
+                (sid.src[0] ? "]" : ""));
+    if (do_family) {
+        printf("%s\n", soc_family_str(sid.family));
+        if (SOC_FAM_UNKNOWN == sid.family)
+            ret = 1;
+    }
+    if (do_model && sid.model[0])
+        printf("%s\n", sid.model);
+    if ((want_fam > 0) && (want_fam != sid.family))
+        ret = 1;
+    return ret;
+}
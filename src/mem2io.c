@@ -32,10 +32,13 @@
  *
  * Utility to read or write multiple 32 bit values from/to the given
  * addresses. Memory maps page size chunks (assumed to be 4 KB) containing
- * an address into this process's ram. If the next address is also in
- * this page then the same map is used, otherwise the previous map is
- * unmapped and a new chunk is mmapped. Time delays can replace an address
- * value pair in a write.
+ * an address into this process's ram. Pages stay mapped (see mmap_regs.c)
+ * so a script that alternates between several macrocells only mmaps each
+ * page once. Time delays can replace an address value pair in a write.
+ * With '-S RATE' the read addresses are instead sampled repeatedly into
+ * a ring buffer which is written in binary to a file. A script can be
+ * checked once and saved in binary with '-C <cfile>', then run with
+ * '-x <cfile>' without parsing text each time.
  *
  * Targets the AT91SAM9G20 microcontroller but should be useful on
  * any microcontroller that uses memory-mapped IO in a similar
@@ -85,10 +88,11 @@
  ****************************************************************/
 
 
-#define _XOPEN_SOURCE 500
+#define _XOPEN_SOURCE 600
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <ctype.h>
 #include <string.h>
 #include <unistd.h>
@@ -98,23 +102,24 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <time.h>
+#include <signal.h>
+#include <pthread.h>
+
+#include "mmap_regs.h"
 
 // #include <sys/ioctl.h>
 
 
-static const char * version_str = "1.09 20160121";
+static const char * version_str = "1.12 20261014";
 
 #define MAJOR_TYP_READ 1
 #define MAJOR_TYP_WRITE 2
-#define MAX_ELEMS 256
+#define ELEM_ARR_INIT_LEN 256   /* grows (doubles) as needed */
 #define ELEM_TYP_NULL 0
 #define ELEM_TYP_READ MAJOR_TYP_READ
 #define ELEM_TYP_WRITE MAJOR_TYP_WRITE
 #define ELEM_TYP_WAIT_MS 3
 #define DEF_MIN_ADDR 0xf0000000
-#define DEV_MEM "/dev/mem"
-#define MAP_SIZE 4096   /* assume to be power of 2 */
-#define MAP_MASK (MAP_SIZE - 1)
 
 struct elem_t {
     int typ;
@@ -122,22 +127,83 @@ struct elem_t {
     unsigned int val;
 };
 
-static struct elem_t elem_arr[MAX_ELEMS];
+/* Compiled script ('-C <cfile>', executed with '-x <cfile>'): this header
+ * followed by num_elems + 1 struct elem_t (the last one has typ
+ * ELEM_TYP_NULL), in host byte order. The element order is kept exactly
+ * as given since register writes may depend on it. */
+#define M2IO_BIN_MAGIC "M2IC"
+#define M2IO_BIN_VERSION 1
+
+struct m2io_bin_hdr {
+    char magic[4];              /* M2IO_BIN_MAGIC (not NUL terminated) */
+    uint16_t version;           /* M2IO_BIN_VERSION */
+    uint16_t elem_sz;           /* sizeof(struct elem_t) */
+    uint32_t num_elems;         /* excluding terminator */
+    uint32_t reserved;
+};
+
+static struct elem_t * elem_arr;       /* terminated by ELEM_TYP_NULL */
+static int elem_arr_len;                /* allocated elements */
 static unsigned int min_addr = DEF_MIN_ADDR;
 static int force_nm4 = 0;
 
 static int verbose = 0;
 
+/* Sample mode ('-S RATE'): the read addresses are sampled in a tight loop
+ * into a ring buffer that a second thread drains to the '-o <file>'. The
+ * file starts with a struct samp_hdr, then num_addrs 32 bit addresses,
+ * then records each being a 64 bit timestamp (nanoseconds since the first
+ * sample, from CLOCK_MONOTONIC_RAW) followed by num_addrs 32 bit values.
+ * All fields are in the host's byte order. */
+#define SAMP_MAGIC "M2IS"
+#define SAMP_VERSION 1
+#define SAMP_MAX_ADDRS 16
+#define SAMP_DEF_SLOTS 16384
+#define SAMP_SPIN_NS 200000     /* waits longer than this may sleep */
+
+struct samp_hdr {
+    char magic[4];              /* SAMP_MAGIC (not NUL terminated) */
+    uint16_t version;           /* SAMP_VERSION */
+    uint16_t num_addrs;
+    uint32_t period_ns;         /* requested, 0 -> as fast as possible */
+    uint32_t reserved;
+};
+
+struct samp_ring {
+    unsigned char * buf;
+    unsigned int rec_sz;        /* bytes per record */
+    unsigned int slots;         /* records buf can hold */
+    volatile unsigned int head; /* next slot sampler fills */
+    volatile unsigned int tail; /* next slot writer drains */
+    volatile int done;          /* set by sampler when finished */
+    int write_err;
+    FILE * ofp;
+};
+
+static volatile sig_atomic_t sample_stop = 0;
+
 
 static void
 usage(void)
 {
     fprintf(stderr, "Usage: "
-            "mem2io [-d] [-f <file>] [-F] [-h] [-i X1[,X2...]] "
-            "[-m <addr>]\n"
-            "              [-M <mask>] [-q] [-r] [-s <shift_r>] [-v] [-V] "
+            "mem2io [-B <slots>] [-c <count>] [-C <cfile>] [-d] [-f <file>] "
+            "[-F]\n"
+            "              [-h] [-i X1[,X2...]] [-m <addr>] [-M <mask>] "
+            "[-o <ofile>]\n"
+            "              [-q] [-r] [-s <shift_r>] [-S <rate>] [-v] [-V] "
             "[-w]\n"
+            "              [-x <cfile>]\n"
             "  where:\n"
+            "    -B <slots>   ring buffer size, in samples, for '-S' "
+            "(def: %d)\n"
+            "    -c <count>   number of samples to take with '-S' (def: 0 "
+            "-> until\n"
+            "                 interrupted (e.g. with control-C))\n"
+            "    -C <cfile>   compile: check input from '-f' or '-i' (with "
+            "'-r' or '-w')\n"
+            "                 then write it to <cfile> in binary and exit. "
+            "No memory IO\n"
             "    -d           dummy mode: decode input, print it then "
             "exit, no memory IO\n"
             "    -f <file>    obtain input from <file>. <file> of '-' "
@@ -162,6 +228,7 @@ usage(void)
             "stdout\n"
             "                 If result non-zero, exit status true(0), else "
             "false(1)\n"
+            "    -o <ofile>   binary output file for '-S' ('-' for stdout)\n"
             "    -q           quiet: suppress '-M <mask>' output to stdout\n"
             "    -r           Uses addresses to read from corresponding "
             "memory\n"
@@ -172,36 +239,33 @@ usage(void)
             "option\n"
             "                 <shift_r> bits to the right; can be 0 to 31 "
             "(def: 0)\n"
+            "    -S <rate>    sample the '-r' addresses <rate> times per "
+            "second (decimal,\n"
+            "                 'k' suffix multiplies by 1000); 0 -> as fast "
+            "as possible.\n"
+            "                 Needs '-o <ofile>'; at most %d addresses\n"
             "    -v           increase verbosity (multiple times for more)\n"
             "    -V           print version string then exit\n"
             "    -w           for each address,value pair writes value to "
             "corresponding\n"
             "                 address. If address is 't' or 'T', value is "
-            "delay in ms\n\n"
+            "delay in ms\n"
+            "    -x <cfile>   execute compiled script <cfile> (from '-C'); "
+            "skips text\n"
+            "                 parsing. Replaces '-f', '-i', '-r' and '-w'\n\n"
             "Designed for systems with memory mapped IO. Requires superuser "
             "permissions.\n"
             "Read 32 bit words from given memory addresses; or write "
             "given 32 bit values\nto the given addresses. Mmaps /dev/mem "
             "to do this. Note all values are\nin hex apart from time delays "
-            "which are in decimal (unit: milliseconds).\n");
-}
-
-#ifdef __cplusplus
-
-static inline volatile unsigned int *
-mmp_add(void * p, unsigned int v)
-{
-    return (volatile unsigned int *)((unsigned char *)p + v);
-}
-
-#else
-
-static inline volatile unsigned int *
-mmp_add(unsigned char * p, unsigned int v)
-{
-    return (volatile unsigned int *)(p + v);
+            "which are in decimal (unit: milliseconds).\n\n"
+            "The '-S' output file is a 16 byte header (\"" SAMP_MAGIC "\", "
+            "16 bit version,\n16 bit number of addresses, 32 bit period in "
+            "ns, 32 bit reserved), the\n32 bit addresses, then one record "
+            "per sample: a 64 bit timestamp in ns\n(CLOCK_MONOTONIC_RAW, "
+            "from first sample) followed by the 32 bit values.\nAll in "
+            "host byte order.\n", SAMP_DEF_SLOTS, SAMP_MAX_ADDRS);
 }
-#endif
 
 /* If decodes hex number okay then returns it and if errp is non-NULL places
  * 0 at *errp. If cannot decode hex number returns 0 and if errp is non-NULL
@@ -237,23 +301,49 @@ get_hnum(const char * buf, int len, int * errp)
     return unum;
 }
 
+/* Makes sure (*arrp)[ind] exists, growing (and zero filling) *arrp when
+ * needed. Returns *arrp or NULL if out of memory. */
+static struct elem_t *
+elem_grow(struct elem_t ** arrp, int * arr_lenp, int ind)
+{
+    int n;
+    struct elem_t * arr;
+
+    if (ind < *arr_lenp)
+        return *arrp;
+    for (n = (*arr_lenp > 0) ? *arr_lenp : ELEM_ARR_INIT_LEN; n <= ind;
+         n *= 2)
+        ;
+    arr = (struct elem_t *)realloc(*arrp, n * sizeof(*arr));
+    if (NULL == arr) {
+        fprintf(stderr, "elem_grow: unable to allocate %d elements\n", n);
+        return NULL;
+    }
+    memset(arr + *arr_lenp, 0, (n - *arr_lenp) * sizeof(*arr));
+    *arrp = arr;
+    *arr_lenp = n;
+    return arr;
+}
+
 /* Read hex numbers (up to 32 bits in size) from command line (comma (or
  * (single) space) separated list) or from stdin or file (one or two per
  * line, comma separated list or space separated list). If
  * MAJOR_TYP_WRITE==major_typ then address field may be 't' or 'T' in
- * which case value is decimal time delay in milliseconds.
- * Returns 0 if ok, or 1 if error. */
+ * which case value is decimal time delay in milliseconds. The array at
+ * *arrp (with *arr_lenp elements allocated) is grown as needed so there
+ * is no limit on the number of elements. Returns 0 if ok, or 1 if error. */
 static int
-build_arr(FILE * fp, const char * inp, int major_typ, struct elem_t * arr,
-          int max_arr_len)
+build_arr(FILE * fp, const char * inp, int major_typ, struct elem_t ** arrp,
+          int * arr_lenp)
 {
     int in_len, k, j, m, wr, ad, got_addr;
     int err = 0;
     unsigned int u, ms;
     const char * lcp;
     const char * allowp;
+    struct elem_t * arr;
 
-    if ((NULL == arr) || (max_arr_len < 1))
+    if (NULL == (arr = elem_grow(arrp, arr_lenp, 0)))
         return 1;
     wr = (MAJOR_TYP_WRITE == major_typ);
     allowp = wr ?  "0123456789aAbBcCdDeEfFtTxX ,\t" :
@@ -262,7 +352,7 @@ build_arr(FILE * fp, const char * inp, int major_typ, struct elem_t * arr,
         char line[512];
         int off = 0;
 
-        for (j = 0, ad = 0; j < 512; ++j) {
+        for (j = 0, ad = 0; ; ++j) {
             if (NULL == fgets(line, sizeof(line), fp))
                 break;
             in_len = strlen(line);
@@ -293,6 +383,8 @@ build_arr(FILE * fp, const char * inp, int major_typ, struct elem_t * arr,
                     --k;
                     break;
                 }
+                if (NULL == (arr = elem_grow(arrp, arr_lenp, off + k)))
+                    return 1;
                 if (wr && ('t' == tolower(*lcp))) {
                     lcp = strpbrk(lcp, " ,\t");
                     if (NULL == lcp) {
@@ -318,10 +410,6 @@ build_arr(FILE * fp, const char * inp, int major_typ, struct elem_t * arr,
                                 "as a hex number\n", lcp);
                         return 1;
                     }
-                    if ((off + k) >= max_arr_len) {
-                        fprintf(stderr, "build_arr: array length exceeded\n");
-                        return 1;
-                    }
                     got_addr = 0;
                     if (wr) {
                         if (ad) {
@@ -364,8 +452,9 @@ build_arr(FILE * fp, const char * inp, int major_typ, struct elem_t * arr,
             fprintf(stderr, "build_arr: write address but missing value\n");
             return 1;
         }
-        if (off < max_arr_len)
-            arr[off].typ = ELEM_TYP_NULL;
+        if (NULL == (arr = elem_grow(arrp, arr_lenp, off)))
+            return 1;
+        arr[off].typ = ELEM_TYP_NULL;
     } else if (inp) {        /* list of numbers on command line */
         lcp = inp;
         in_len = strlen(inp);
@@ -378,7 +467,9 @@ build_arr(FILE * fp, const char * inp, int major_typ, struct elem_t * arr,
             fprintf(stderr, "build_arr: error at pos %d\n", k + 1);
             return 1;
         }
-        for (k = 0, ad = 0; k < max_arr_len; ++k) {
+        for (k = 0, ad = 0; ; ++k) {
+            if (NULL == (arr = elem_grow(arrp, arr_lenp, k)))
+                return 1;
             if (wr && ('t' == tolower(*lcp))) {
                 lcp = strpbrk(lcp, " ,\t");
                 if (NULL == lcp) {
@@ -444,17 +535,288 @@ build_arr(FILE * fp, const char * inp, int major_typ, struct elem_t * arr,
             fprintf(stderr, "build_arr: write address but missing value\n");
             return 1;
         }
-        if (k == max_arr_len) {
-            fprintf(stderr, "build_arr: array length exceeded\n");
+        if (NULL == (arr = elem_grow(arrp, arr_lenp, k + 1)))
             return 1;
-        }
-        if (k < (max_arr_len - 1))
-            arr[k + 1].typ = ELEM_TYP_NULL;
+        arr[k + 1].typ = ELEM_TYP_NULL;
     }
     return 0;
 }
 
 
+
+
+/* Writes elements in arr[] (up to and including the ELEM_TYP_NULL
+ * terminator) to file 'ofname' as a compiled script. Returns 0 if ok,
+ * else 1 . */
+static int
+write_compiled(const char * ofname, const struct elem_t * arr)
+{
+    int k, num;
+    struct m2io_bin_hdr hdr;
+    FILE * ofp;
+
+    for (num = 0; arr[num].typ > 0; ++num)
+        ;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, M2IO_BIN_MAGIC, sizeof(hdr.magic));
+    hdr.version = M2IO_BIN_VERSION;
+    hdr.elem_sz = sizeof(struct elem_t);
+    hdr.num_elems = num;
+    if (NULL == (ofp = fopen(ofname, "wb"))) {
+        fprintf(stderr, "failed to open %s:  ", ofname);
+        perror("fopen()");
+        return 1;
+    }
+    k = ((1 != fwrite(&hdr, sizeof(hdr), 1, ofp)) ||
+         ((size_t)(num + 1) != fwrite(arr, sizeof(*arr), num + 1, ofp)));
+    if (fclose(ofp) || k) {
+        fprintf(stderr, "failed writing %s:  ", ofname);
+        perror("fwrite()");
+        return 1;
+    }
+    if (verbose)
+        fprintf(stderr, "compiled %d elements into %s\n", num, ofname);
+    return 0;
+}
+
+/* Maps compiled script 'bfname' (made by '-C') into memory, privately so
+ * read results can be stored in it. The elements are checked as build_arr()
+ * would (e.g. against '-m <addr>'). Returns pointer to the first element
+ * and sets *map_pp and *map_lenp; returns NULL if error. */
+static struct elem_t *
+map_compiled(const char * bfname, void ** map_pp, size_t * map_lenp)
+{
+    int fd;
+    unsigned int k;
+    void * p;
+    struct elem_t * arr;
+    const struct m2io_bin_hdr * hp;
+    struct stat st;
+
+    if ((fd = open(bfname, O_RDONLY)) < 0) {
+        fprintf(stderr, "failed to open %s:  ", bfname);
+        perror("open()");
+        return NULL;
+    }
+    if ((fstat(fd, &st) < 0) ||
+        (st.st_size < (off_t)(sizeof(*hp) + sizeof(*arr)))) {
+        fprintf(stderr, "%s: too short for a compiled script\n", bfname);
+        close(fd);
+        return NULL;
+    }
+    p = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (MAP_FAILED == p) {
+        perror("mmap() of compiled script");
+        return NULL;
+    }
+    hp = (const struct m2io_bin_hdr *)p;
+    arr = (struct elem_t *)((unsigned char *)p + sizeof(*hp));
+    if (memcmp(hp->magic, M2IO_BIN_MAGIC, sizeof(hp->magic)) ||
+        (M2IO_BIN_VERSION != hp->version) ||
+        (sizeof(*arr) != hp->elem_sz) ||
+        /* in 64 bits: a 32 bit size_t product could wrap to st_size */
+        ((uint64_t)sizeof(*hp) +
+         (((uint64_t)hp->num_elems + 1) * sizeof(*arr)) !=
+         (uint64_t)st.st_size)) {
+        fprintf(stderr, "%s: not a compiled script from this version\n",
+                bfname);
+        goto bad;
+    }
+    for (k = 0; k < hp->num_elems; ++k) {
+        if (ELEM_TYP_WAIT_MS == arr[k].typ)
+            continue;
+        if ((ELEM_TYP_READ != arr[k].typ) && (ELEM_TYP_WRITE != arr[k].typ)) {
+            fprintf(stderr, "%s: element %u bad type\n", bfname, k);
+            goto bad;
+        }
+        if (arr[k].addr < min_addr) {
+            fprintf(stderr, "%s: 0x%x less than minimum address, see '-m "
+                    "<addr>'\n", bfname, arr[k].addr);
+            goto bad;
+        } else if ((! force_nm4) && (arr[k].addr & 0x3)) {
+            fprintf(stderr, "%s: 0x%x not module 4\n", bfname, arr[k].addr);
+            goto bad;
+        }
+    }
+    if (ELEM_TYP_NULL != arr[k].typ) {
+        fprintf(stderr, "%s: missing terminator\n", bfname);
+        goto bad;
+    }
+    *map_pp = p;
+    *map_lenp = st.st_size;
+    return arr;
+bad:
+    munmap(p, st.st_size);
+    return NULL;
+}
+
+static void
+sample_sig_handler(int signum)
+{
+    if (signum)
+        sample_stop = 1;
+}
+
+static uint64_t
+ts_ns(const struct timespec * tsp)
+{
+    return ((uint64_t)tsp->tv_sec * 1000000000) + tsp->tv_nsec;
+}
+
+/* Writer thread: drains the ring buffer to rp->ofp until the sampler is
+ * done and the ring is empty. */
+static void *
+samp_writer(void * vp)
+{
+    unsigned int head, tail, n;
+    struct samp_ring * rp = (struct samp_ring *)vp;
+    struct timespec request;
+
+    request.tv_sec = 0;
+    request.tv_nsec = 1000000;
+    while (1) {
+        head = rp->head;
+        __sync_synchronize();   /* read records after reading head */
+        tail = rp->tail;
+        if (head == tail) {
+            if (rp->done && (head == rp->head))
+                break;
+            nanosleep(&request, NULL);
+            continue;
+        }
+        n = (head > tail) ? (head - tail) : (rp->slots - tail);
+        if ((0 == rp->write_err) &&
+            (n != fwrite(rp->buf + ((size_t)tail * rp->rec_sz), rp->rec_sz,
+                         n, rp->ofp)))
+            rp->write_err = errno ? errno : EIO;
+        __sync_synchronize();   /* finish with slots before freeing them */
+        rp->tail = (tail + n) % rp->slots;
+    }
+    return NULL;
+}
+
+/* Samples the 'num' addresses in addr_arr[] 'count' times (0 -> until
+ * SIGINT or SIGTERM), every 'period_ns' nanoseconds (0 -> back to back),
+ * writing records to 'ofp' via a ring buffer of 'slots' records. When the
+ * ring is full a sample is dropped (and counted) rather than delaying the
+ * sampler. Returns 0 if okay, else 1 . */
+static int
+do_sample(int mem_fd, struct mmap_state * msp, const unsigned int * addr_arr,
+          int num, unsigned int period_ns, unsigned long count,
+          unsigned int slots, FILE * ofp)
+{
+    int k;
+    int res = 1;
+    unsigned int head, next_head;
+    unsigned long n, dropped;
+    uint64_t t0, deadline, now_ns;
+    unsigned char * bp;
+    uint32_t * vp;
+    volatile unsigned int * mmp_arr[SAMP_MAX_ADDRS];
+    struct samp_hdr hdr;
+    struct samp_ring ring;
+    struct timespec ts, request;
+    struct sigaction sa;
+    pthread_t wthr;
+
+    for (k = 0; k < num; ++k) {    /* map every page before sampling */
+        if (NULL == ((mmp_arr[k] = get_mmp(mem_fd, addr_arr[k], msp))))
+            return 1;
+    }
+    memset(&ring, 0, sizeof(ring));
+    ring.rec_sz = sizeof(uint64_t) + (num * sizeof(uint32_t));
+    ring.slots = slots;
+    ring.ofp = ofp;
+    if (NULL == (ring.buf = (unsigned char *)malloc((size_t)slots *
+                                                     ring.rec_sz))) {
+        fprintf(stderr, "unable to allocate ring buffer of %u records\n",
+                slots);
+        return 1;
+    }
+    memset(ring.buf, 0, (size_t)slots * ring.rec_sz);  /* fault pages in */
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, SAMP_MAGIC, sizeof(hdr.magic));
+    hdr.version = SAMP_VERSION;
+    hdr.num_addrs = num;
+    hdr.period_ns = period_ns;
+    if ((1 != fwrite(&hdr, sizeof(hdr), 1, ofp)) ||
+        ((size_t)num != fwrite(addr_arr, sizeof(uint32_t), num, ofp))) {
+        perror("writing sample file header");
+        goto fini;
+    }
+    if ((k = pthread_create(&wthr, NULL, samp_writer, &ring))) {
+        fprintf(stderr, "pthread_create: %s\n", strerror(k));
+        goto fini;
+    }
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sample_sig_handler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    dropped = 0;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    t0 = ts_ns(&ts);
+    deadline = t0;
+    for (n = 0; ((0 == count) || (n < count)) && (! sample_stop); ++n) {
+        if (period_ns && (n > 0)) {
+            deadline += period_ns;
+            while (1) {
+                clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+                now_ns = ts_ns(&ts);
+                if (now_ns >= deadline)
+                    break;
+                if ((deadline - now_ns) > SAMP_SPIN_NS) {
+                    /* give up the cpu (e.g. to the writer) for most of it */
+                    request.tv_sec = 0;
+                    request.tv_nsec = (deadline - now_ns) - (SAMP_SPIN_NS / 2);
+                    if (request.tv_nsec >= 1000000000) {
+                        request.tv_sec = request.tv_nsec / 1000000000;
+                        request.tv_nsec %= 1000000000;
+                    }
+                    nanosleep(&request, NULL);
+                }
+            }
+        } else {
+            clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+            now_ns = ts_ns(&ts);
+        }
+        head = ring.head;
+        next_head = (head + 1) % ring.slots;
+        if (next_head == ring.tail) {
+            ++dropped;          /* ring full: writer is behind */
+            continue;
+        }
+        bp = ring.buf + ((size_t)head * ring.rec_sz);
+        now_ns -= t0;
+        memcpy(bp, &now_ns, sizeof(now_ns));    /* may be unaligned */
+        vp = (uint32_t *)(bp + sizeof(uint64_t));
+        for (k = 0; k < num; ++k)
+            vp[k] = *mmp_arr[k];
+        __sync_synchronize();   /* record complete before publishing it */
+        ring.head = next_head;
+    }
+    ring.done = 1;
+    pthread_join(wthr, NULL);
+    if (ring.write_err)
+        fprintf(stderr, "writing samples: %s\n", strerror(ring.write_err));
+    else
+        res = 0;
+    if (dropped)
+        fprintf(stderr, "%lu samples dropped because ring buffer was full "
+                "(see '-B <slots>')\n", dropped);
+    if (verbose) {
+        clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+        fprintf(stderr, "%lu samples of %d address%s in %.6f seconds\n",
+                n - dropped, num, ((1 == num) ? "" : "es"),
+                (ts_ns(&ts) - t0) / 1e9);
+    }
+fini:
+    free(ring.buf);
+    return res;
+}
+
 int
 main(int argc, char * argv[])
 {
@@ -468,19 +830,49 @@ main(int argc, char * argv[])
     unsigned int user_mask_result;
     const char * fname = NULL;
     const char * istring = NULL;
+    const char * ofname = NULL;
+    const char * cfname = NULL;
+    const char * xfname = NULL;
+    void * map_p = NULL;
+    size_t map_len = 0;
+    char * cp;
     struct elem_t * ep;
-    void * mmap_ptr;
     volatile unsigned int * mmp;
     struct timespec request;
-    off_t mask_addr, prev_mask_addr;
-    int have_prev_mask = 0;
     unsigned long ul;
+    unsigned long rate = 0;
+    unsigned long count = 0;
+    unsigned int slots = SAMP_DEF_SLOTS;
+    int do_sample_mode = 0;
+    int num_samp_addr;
+    unsigned int samp_addr_arr[SAMP_MAX_ADDRS];
+    FILE * ofp;
+    struct mmap_state mstat;
     FILE * input_filep = NULL;
 
     mem_fd = -1;
-    while ((opt = getopt(argc, argv, "df:hi:m:M:qrs:vVw")) != -1) {
+    while ((opt = getopt(argc, argv, "B:c:C:df:hi:m:M:o:qrs:S:vVwx:")) != -1) {
         switch (opt) {
             break;
+        case 'B':
+            ul = strtoul(optarg, &cp, 10);
+            if ((cp == optarg) || ('\0' != *cp) || (ul < 2) ||
+                (ul > 0x1000000)) {
+                fprintf(stderr, "'-B' expects <slots> from 2 to 16777216\n");
+                return 1;
+            }
+            slots = (unsigned int)ul;
+            break;
+        case 'c':
+            count = strtoul(optarg, &cp, 10);
+            if ((cp == optarg) || ('\0' != *cp)) {
+                fprintf(stderr, "'-c' unable to decode <count>\n");
+                return 1;
+            }
+            break;
+        case 'C':
+            cfname = optarg;
+            break;
         case 'd':
             ++dummy;
             break;
@@ -507,6 +899,9 @@ main(int argc, char * argv[])
             }
             ++user_mask_given;
             break;
+        case 'o':
+            ofname = optarg;
+            break;
         case 'q':
             ++do_quiet;
             break;
@@ -520,6 +915,19 @@ main(int argc, char * argv[])
                 return 1;
             }
             break;
+        case 'S':
+            rate = strtoul(optarg, &cp, 10);
+            if ('k' == tolower(*cp)) {
+                rate *= 1000;
+                ++cp;
+            }
+            if ((cp == optarg) || ('\0' != *cp) || (rate > 1000000000)) {
+                fprintf(stderr, "'-S' unable to decode <rate> or too "
+                        "large\n");
+                return 1;
+            }
+            ++do_sample_mode;
+            break;
         case 'v':
             ++verbose;
             break;
@@ -529,6 +937,9 @@ main(int argc, char * argv[])
         case 'w':
             ++do_write;
             break;
+        case 'x':
+            xfname = optarg;
+            break;
         default:
             fprintf(stderr, "unrecognised option code 0x%x ??\n", opt);
             usage();
@@ -545,18 +956,32 @@ main(int argc, char * argv[])
         }
     }
 
-    if (do_read && do_write) {
+    if (xfname) {
+        if (fname || istring || do_read || do_write || cfname ||
+            do_sample_mode) {
+            fprintf(stderr, "'-x <cfile>' holds the script so '-f', '-i', "
+                    "'-r', '-w', '-C'\nand '-S' are not permitted\n\n");
+            usage();
+            return 1;
+        }
+    } else if (do_read && do_write) {
         fprintf(stderr, "can either read ('-r') or write ('w'), "
                 "but not both\n\n");
         usage();
         return 1;
-    }
-    if ((0 == do_read) && (0 == do_write)) {
+    } else if ((0 == do_read) && (0 == do_write)) {
         fprintf(stderr, "nothing to read ('-r') or write ('w'), "
                 "so exit\n\n");
         usage();
         return 1;
     }
+    if (do_sample_mode && ((! do_read) || user_mask_given ||
+                           (NULL == ofname))) {
+        fprintf(stderr, "'-S <rate>' needs '-r' and '-o <ofile>', and "
+                "cannot be used with\n'-M <mask>'\n\n");
+        usage();
+        return 1;
+    }
     if (user_mask_given && do_write) {
         fprintf(stderr, "'-M <mask>' can only be used with '-r'\n\n");
         usage();
@@ -573,18 +998,26 @@ main(int argc, char * argv[])
                 return 1;
             }
         }
-    } else if (NULL == istring) {
+    } else if ((NULL == istring) && (NULL == xfname)) {
         fprintf(stderr, "expecting either '-i' or '-f'  but got neither\n");
         usage();
         return 1;
     }
 
-    mtyp = do_read ? MAJOR_TYP_READ : MAJOR_TYP_WRITE;
-    res = build_arr(input_filep, istring, mtyp, elem_arr, MAX_ELEMS);
-    if (res) {
-        fprintf(stderr, "build_arr() failed\n");
-        return 1;
+    if (xfname) {
+        if (NULL == (elem_arr = map_compiled(xfname, &map_p, &map_len)))
+            return 1;
+    } else {
+        mtyp = do_read ? MAJOR_TYP_READ : MAJOR_TYP_WRITE;
+        res = build_arr(input_filep, istring, mtyp, &elem_arr,
+                        &elem_arr_len);
+        if (res) {
+            fprintf(stderr, "build_arr() failed\n");
+            return 1;
+        }
     }
+    if (cfname)
+        return write_compiled(cfname, elem_arr);
 
     if (dummy || (verbose > 1)) {
         printf("build_arr after command line input processing:\n");
@@ -609,9 +1042,39 @@ main(int argc, char * argv[])
     } else if (verbose)
         printf("open(" DEV_MEM ", O_RDWR | O_SYNC) okay\n");
 
-    mmap_ptr = (void *)-1;
-    prev_mask_addr = 0;
-    have_prev_mask = 0;
+    init_mmap_state(&mstat, verbose);
+    if (do_sample_mode) {
+        for (k = 0, num_samp_addr = 0; elem_arr[k].typ > 0; ++k) {
+            if (ELEM_TYP_READ != elem_arr[k].typ)
+                continue;
+            if (num_samp_addr >= SAMP_MAX_ADDRS) {
+                fprintf(stderr, "'-S' can sample at most %d addresses\n",
+                        SAMP_MAX_ADDRS);
+                res = 1;
+                goto cleanup;
+            }
+            samp_addr_arr[num_samp_addr++] = elem_arr[k].addr;
+        }
+        if ((1 == strlen(ofname)) && ('-' == ofname[0]))
+            ofp = stdout;
+        else if (NULL == (ofp = fopen(ofname, "wb"))) {
+            fprintf(stderr, "failed to open %s:  ", ofname);
+            perror("fopen()");
+            res = 1;
+            goto cleanup;
+        }
+        res = do_sample(mem_fd, &mstat, samp_addr_arr, num_samp_addr,
+                        (rate ? (unsigned int)(1000000000 / rate) : 0),
+                        count, slots, ofp);
+        if (ofp != stdout) {
+            if (fclose(ofp)) {
+                perror("fclose() of output file");
+                res = 1;
+            }
+        } else
+            fflush(stdout);
+        goto cleanup;
+    }
     for (k = 0; elem_arr[k].typ > 0; ++k) {
         ep = elem_arr + k;
         if (ELEM_TYP_WAIT_MS == ep->typ) {
@@ -628,33 +1091,10 @@ main(int argc, char * argv[])
                 fprintf(stderr, "slept for %d milliseconds\n", ep->val);
             continue;
         }
-        mask_addr = (ep->addr & ~MAP_MASK);
-        if (((void *)-1 == mmap_ptr) ||
-            (have_prev_mask && (prev_mask_addr != mask_addr))) {
-            if ((void *)-1 != mmap_ptr) {
-                if (-1 == munmap(mmap_ptr, MAP_SIZE)) {
-                    fprintf(stderr, "mmap_ptr=%p:\n", mmap_ptr);
-                    perror("    munmap");
-                    res = 1;
-                    goto cleanup;
-                } else if (verbose > 2)
-                    fprintf(stderr, "munmap() ok, mmap_ptr=%p\n", mmap_ptr);
-            }
-            mmap_ptr = mmap(0, MAP_SIZE, PROT_READ | PROT_WRITE,
-                            MAP_SHARED, mem_fd, mask_addr);
-            if ((void *)-1 == mmap_ptr) {
-                fprintf(stderr, "addr=0x%x, mask_addr=0x%lx :\n", ep->addr,
-                        mask_addr);
-                perror("    mmap");
-                res = 1;
-                goto cleanup;
-            } else if (verbose > 2)
-                fprintf(stderr, "mmap() ok, mask_addr=0x%lx, mmap_ptr=%p\n",
-                        mask_addr, mmap_ptr);
-            have_prev_mask = 1;
-            prev_mask_addr = mask_addr;
+        if (NULL == ((mmp = get_mmp(mem_fd, ep->addr, &mstat)))) {
+            res = 1;
+            goto cleanup;
         }
-        mmp = mmp_add(mmap_ptr, ep->addr & MAP_MASK);
         if (ELEM_TYP_WRITE == ep->typ) {
             *mmp = ep->val;
             if (1 == verbose)
@@ -662,8 +1102,8 @@ main(int argc, char * argv[])
                         ep->addr, ep->val);
             else if (verbose > 1)
                 fprintf(stderr, "wrote: addr=0x%x, val=0x%x "
-                        "[mask_addr=0x%lx]\n", ep->addr, ep->val,
-                        mask_addr);
+                        "[mask_addr=0x%x]\n", ep->addr, ep->val,
+                        ep->addr & ~MAP_MASK);
         } else if (ELEM_TYP_READ == ep->typ) {
             ul = *mmp;
             ep->val = (unsigned int)ul;
@@ -676,7 +1116,7 @@ main(int argc, char * argv[])
                         ep->addr, ep->val);
             else if (verbose > 1)
                 fprintf(stderr, "read: addr=0x%x, val=0x%x [mask_addr="
-                        "0x%lx]\n", ep->addr, ep->val, mask_addr);
+                        "0x%x]\n", ep->addr, ep->val, ep->addr & ~MAP_MASK);
         }
     }
 
@@ -692,20 +1132,17 @@ main(int argc, char * argv[])
         }
     }
 
-    if ((void *)-1 != mmap_ptr) {
-        if (-1 == munmap(mmap_ptr, MAP_SIZE)) {
-            fprintf(stderr, "mmap_ptr=%p:\n", mmap_ptr);
-            perror("    munmap");
-            res = 1;
-            goto cleanup;
-        } else if (verbose > 2)
-            fprintf(stderr, "trailing munmap() ok, mmap_ptr=%p\n", mmap_ptr);
-    }
     res = 0;
 
 cleanup:
+    if (release_mmap_state(&mstat))
+        res = 1;
     if (mem_fd >= 0)
         close(mem_fd);
+    if (map_p)
+        munmap(map_p, map_len);
+    else
+        free(elem_arr);
     if ((0 == res) && user_mask_given)
         return !user_mask_result;
     else
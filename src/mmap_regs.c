@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2016-2020 Douglas Gilbert.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+/*****************************************************************
+ * mmap_regs.c
+ *
+ * Keeps a small table of /dev/mem pages mapped into this process so
+ * that utilities which alternate between macrocells (e.g. PMC, PIO and
+ * TC on the SAMA5D2) do not pay a munmap()+mmap() pair on each access.
+ * See mmap_regs.h .
+ *
+ ****************************************************/
+
+#define _XOPEN_SOURCE 500
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+
+#include "mmap_regs.h"
+
+
+void
+init_mmap_state(struct mmap_state * msp, int verbose)
+{
+    memset(msp, 0, sizeof(*msp));
+    msp->verbose = verbose;
+}
+
+void *
+check_mmap(int mem_fd, unsigned int wanted_addr, struct mmap_state * msp)
+{
+    int k;
+    off_t mask_addr;
+    void * mmap_ptr;
+    struct mmap_page * mpp;
+
+    mask_addr = (wanted_addr & ~MAP_MASK);
+#ifdef SA_INSTR
+    ++msp->n_miss;
+#endif
+    for (k = 0, mpp = msp->page_arr; k < msp->num_pages; ++k, ++mpp) {
+        if (mpp->mask_addr == mask_addr) {
+            msp->last_ind = k;
+            return mpp->mmap_ptr;
+        }
+    }
+    mmap_ptr = mmap(0, MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED,
+                    mem_fd, mask_addr);
+    if ((void *)-1 == mmap_ptr) {
+        fprintf(stderr, "addr=0x%x, mask_addr=0x%lx :\n", wanted_addr,
+                (unsigned long)mask_addr);
+        perror("    mmap");
+        return NULL;
+    }
+#ifdef SA_INSTR
+    ++msp->n_mmap;
+#endif
+    if (msp->num_pages < MMAP_MAX_PAGES)
+        k = msp->num_pages++;
+    else {      /* table full, replace oldest entry */
+        k = msp->next_evict;
+        msp->next_evict = (k + 1) % MMAP_MAX_PAGES;
+        mpp = msp->page_arr + k;
+#ifdef SA_INSTR
+        ++msp->n_munmap;
+#endif
+        if (-1 == munmap(mpp->mmap_ptr, MAP_SIZE)) {
+            fprintf(stderr, "mmap_ptr=%p:\n", mpp->mmap_ptr);
+            perror("    munmap");
+        } else if (msp->verbose > 2)
+            fprintf(stderr, "munmap() ok, mask_addr=0x%lx, mmap_ptr=%p\n",
+                    (unsigned long)mpp->mask_addr, mpp->mmap_ptr);
+    }
+    mpp = msp->page_arr + k;
+    mpp->mmap_ptr = mmap_ptr;
+    mpp->mask_addr = mask_addr;
+    msp->last_ind = k;
+    if (msp->verbose > 2)
+        fprintf(stderr, "mmap() ok, addr=0x%x, mask_addr=0x%lx, "
+                "mmap_ptr=%p [%d pages mapped]\n", wanted_addr,
+                (unsigned long)mask_addr, mmap_ptr, msp->num_pages);
+    return mmap_ptr;
+}
+
+int
+release_mmap_state(struct mmap_state * msp)
+{
+    int k;
+    int res = 0;
+    struct mmap_page * mpp;
+
+    for (k = 0, mpp = msp->page_arr; k < msp->num_pages; ++k, ++mpp) {
+#ifdef SA_INSTR
+        ++msp->n_munmap;
+#endif
+        if (-1 == munmap(mpp->mmap_ptr, MAP_SIZE)) {
+            fprintf(stderr, "mmap_ptr=%p:\n", mpp->mmap_ptr);
+            perror("    munmap");
+            res = 1;
+        } else if (msp->verbose > 2)
+            fprintf(stderr, "trailing munmap() ok, mmap_ptr=%p\n",
+                    mpp->mmap_ptr);
+    }
+#ifdef SA_INSTR
+    if (msp->verbose >= 0)
+        fprintf(stderr, "mmap_regs: %lu get_mmp() calls, %lu not on last "
+                "page, %lu mmap(), %lu munmap()\n", msp->n_get,
+                msp->n_miss, msp->n_mmap, msp->n_munmap);
+#endif
+    msp->num_pages = 0;
+    msp->last_ind = 0;
+    msp->next_evict = 0;
+    return res;
+}
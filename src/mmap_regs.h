@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2016-2020 Douglas Gilbert.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+#ifndef MMAP_REGS_H
+#define MMAP_REGS_H
+
+/*****************************************************************
+ * mmap_regs.h
+ *
+ * Register access via /dev/mem shared by the utilities that use memory
+ * mapped IO. Rather than keeping one page mapped and calling munmap()
+ * then mmap() each time the next register falls in a different page,
+ * a small table of mapped pages is kept. Once a page is mapped it stays
+ * mapped until release_mmap_state() is called (or the table overflows,
+ * in which case the oldest entry is replaced).
+ *
+ ****************************************************/
+
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MAP_SIZE 4096   /* assume to be power of 2 */
+#define MAP_MASK (MAP_SIZE - 1)
+#define DEV_MEM "/dev/mem"
+
+/* Enough for PMC, the PIO (normal and secure) and both TC blocks with
+ * plenty to spare for mem2io scripts. */
+#define MMAP_MAX_PAGES 16
+
+struct mmap_page {
+    void * mmap_ptr;
+    off_t mask_addr;
+};
+
+struct mmap_state {
+    int num_pages;      /* number of valid entries in page_arr[] */
+    int last_ind;       /* index of the most recently used entry */
+    int next_evict;     /* when page_arr[] full, replace this entry */
+    int verbose;        /* > 2 reports mmap() and munmap() calls */
+    struct mmap_page page_arr[MMAP_MAX_PAGES];
+#ifdef SA_INSTR
+    unsigned long n_get;        /* get_mmp() calls */
+    unsigned long n_miss;       /* of those, not on the last used page */
+    unsigned long n_mmap;
+    unsigned long n_munmap;
+#endif
+};
+
+#ifdef __cplusplus
+
+static inline volatile unsigned int *
+mmp_add(void * p, unsigned int v)
+{
+    return (volatile unsigned int *)((unsigned char *)p + v);
+}
+
+#else
+
+static inline volatile unsigned int *
+mmp_add(unsigned char * p, unsigned int v)
+{
+    return (volatile unsigned int *)(p + v);
+}
+#endif
+
+/* Zeroes *msp and records the verbosity used for mmap related messages. */
+void init_mmap_state(struct mmap_state * msp, int verbose);
+
+/* Returns pointer to the mmapped page containing 'wanted_addr', mapping
+ * that page if it is not already in the table. Returns NULL if problem. */
+void * check_mmap(int mem_fd, unsigned int wanted_addr,
+                  struct mmap_state * msp);
+
+/* Unmaps all pages held in *msp. Returns 0 if okay, else 1 . With
+ * SA_INSTR defined also reports the counters to stderr (unless verbose
+ * is negative). */
+int release_mmap_state(struct mmap_state * msp);
+
+/* Returns pointer to the 32 bit register at 'wanted_addr' or NULL if
+ * problem. The common case (same page as the previous call) is a compare
+ * and a pointer add. */
+static inline volatile unsigned int *
+get_mmp(int mem_fd, unsigned int wanted_addr, struct mmap_state * msp)
+{
+    void * mmap_ptr;
+    const struct mmap_page * mpp = msp->page_arr + msp->last_ind;
+
+#ifdef SA_INSTR
+    ++msp->n_get;
+#endif
+    if ((msp->num_pages > 0) &&
+        (mpp->mask_addr == (off_t)(wanted_addr & ~MAP_MASK)))
+        mmap_ptr = mpp->mmap_ptr;
+    else if (NULL == (mmap_ptr = check_mmap(mem_fd, wanted_addr, msp)))
+        return NULL;
+    return mmp_add((unsigned char *)mmap_ptr, wanted_addr & MAP_MASK);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
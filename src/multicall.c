@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2026 Douglas Gilbert.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+/*****************************************************************
+ * multicall.c
+ *
+ * main() of sama5d2_utils, a single (busybox style) executable holding
+ * every utility in this package. The utility to run is chosen by the
+ * name it is invoked with (e.g. via a symlink named 'setbits') or,
+ * when invoked as sama5d2_utils, by its first argument. Each utility's
+ * source is compiled a second time with main renamed <utility>_main
+ * (see the 'multicall' target in the Makefile) and the shared modules
+ * (mmap_regs, gpio_cdev, sa_misc, ...) are linked once. A boot script
+ * that runs many utilities in a row then pages in one binary from the
+ * (slow) SD card rather than one per utility.
+ *
+ ****************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+static const char * version_str = "1.00 20261014";
+
+#define MC_NAME "sama5d2_utils"
+
+struct mc_applet {
+    const char * name;
+    int (*main_fn)(int argc, char * argv[]);
+};
+
+/* Keep in step with PROGS in the Makefile */
+#define MC_APPLET_LIST \
+    MC_APPLET(a5d2_pio_set) \
+    MC_APPLET(a5d2_pio_status) \
+    MC_APPLET(a5d2_pmc) \
+    MC_APPLET(a5d2_regd) \
+    MC_APPLET(a5d2_tc_freq) \
+    MC_APPLET(gpio_sysfs) \
+    MC_APPLET(hex2tty) \
+    MC_APPLET(i2c_bbtest) \
+    MC_APPLET(i2c_devtest) \
+    MC_APPLET(is_ariag25) \
+    MC_APPLET(is_arm) \
+    MC_APPLET(is_foxg20) \
+    MC_APPLET(is_foxlx) \
+    MC_APPLET(is_sama5d2) \
+    MC_APPLET(is_sama5d3) \
+    MC_APPLET(is_sama5d4) \
+    MC_APPLET(is_soc) \
+    MC_APPLET(mem2io) \
+    MC_APPLET(readbits) \
+    MC_APPLET(setbits) \
+    MC_APPLET(w1_temp) \
+    MC_APPLET(xbee_api)
+
+#define MC_APPLET(nm) int nm ## _main(int argc, char * argv[]);
+MC_APPLET_LIST
+#undef MC_APPLET
+
+#define MC_APPLET(nm) {#nm, nm ## _main},
+static struct mc_applet applet_arr[] = {
+    MC_APPLET_LIST
+    {NULL, NULL},
+};
+#undef MC_APPLET
+
+
+static void
+usage(void)
+{
+    const struct mc_applet * ap;
+
+    fprintf(stderr, "Usage: " MC_NAME " [--list] [--version]\n"
+            "       " MC_NAME " UTILITY [ARGS...]\n"
+            "       UTILITY [ARGS...]\n"
+            "  where:\n"
+            "    --list       list the utilities, one per line, then exit\n"
+            "    --version    print version string then exit\n\n"
+            "Multicall binary holding the sama5d2_utils utilities. Either "
+            "invoke it\nvia a symlink named after the utility or give the "
+            "utility as the first\nargument. The utilities are:\n");
+    for (ap = applet_arr; ap->name; ++ap)
+        fprintf(stderr, "%s%s", ((ap == applet_arr) ? "    " :
+                (((ap - applet_arr) % 5) ? ", " : ",\n    ")), ap->name);
+    fprintf(stderr, "\n");
+}
+
+int
+main(int argc, char * argv[])
+{
+    const char * cp;
+    const char * name;
+    const struct mc_applet * ap;
+
+    name = argv[0] ? argv[0] : MC_NAME;
+    if ((cp = strrchr(name, '/')))
+        name = cp + 1;
+    if (0 == strncmp(name, MC_NAME, sizeof(MC_NAME) - 1)) {
+        /* invoked as sama5d2_utils (perhaps with a suffix like "-1.0") */
+        if (argc < 2) {
+            usage();
+            return 1;
+        }
+        if (0 == strcmp(argv[1], "--list")) {
+            for (ap = applet_arr; ap->name; ++ap)
+                printf("%s\n", ap->name);
+            return 0;
+        }
+        if (0 == strcmp(argv[1], "--version")) {
+            fprintf(stderr, "version: %s\n", version_str);
+            return 0;
+        }
+        if ((0 == strcmp(argv[1], "--help")) || (0 == strcmp(argv[1], "-h"))) {
+            usage();
+            return 0;
+        }
+        if ('-' == argv[1][0]) {
+            fprintf(stderr, "unrecognised option: %s\n", argv[1]);
+            usage();
+            return 1;
+        }
+        --argc;
+        ++argv;
+        name = argv[0];
+    }
+    for (ap = applet_arr; ap->name; ++ap) {
+        if (0 == strcmp(name, ap->name))
+            return ap->main_fn(argc, argv);
+    }
+    fprintf(stderr, "%s: utility not found\n", name);
+    usage();
+    return 1;
+}
@@ -31,7 +31,8 @@
  * readbits.c
  *
  * Utility for reading a GPIO line on a AT91SAM9G20/25/45 and SAMA5D3/D2 in
- * Linux. Uses sysfs interface. The target hardware is a FoxG20, the Aria
+ * Linux. Uses sysfs interface or, with '-C CHIP', the GPIO character
+ * device (see gpio_cdev.h). The target hardware is a FoxG20, the Aria
  * G25 and SAMA5D3/D2 family. This utility mimics the actions of a utility of
  * the same name for the FoxLX board. The Aria G25, FoxG20 and FoxLX
  * boards are made by Acme Systems. The SoCs are made by Atmel.
@@ -51,9 +52,13 @@
 #include <fcntl.h>
 #include <time.h>
 #include <errno.h>
+#include <stdint.h>
 
+#include "gpio_cdev.h"
+#include "sa_misc.h"
 
-static const char * version_str = "1.08 20160121";
+
+static const char * version_str = "1.09 20261014";
 
 #define EXPORT_FILE "/sys/class/gpio/export"
 #define UNEXPORT_FILE "/sys/class/gpio/unexport"
@@ -79,20 +84,30 @@ static void
 usage(void)
 {
     fprintf(stderr, "Usage: "
-            "readbits [-b BN] [-h] [-i] [-p PORT] [-r] [-u] [-U] [-v] [-V]\n"
+            "readbits [-b BN] [-C CHIP] [-h] [-i] [-l LIST] [-p PORT] "
+            "[-r] [-u]\n"
+            "                [-U] [-v] [-V]\n"
             "  where:\n"
             "    -b BN        bit number within a port (0 to 31). Also\n"
             "                 accepts prefix like 'pb' or just 'b' for "
             "PORT.\n"
+            "    -C CHIP      use GPIO character device CHIP (e.g. '0' or "
+            "'gpiochip0')\n"
+            "                 rather than sysfs; line offset is bank*32+BN\n"
             "    -h           print usage message\n"
             "    -i           ignore line direction before reading (def: "
             "make input)\n"
+            "    -l LIST      read several lines (e.g. 'PA3,PC7') with one "
+            "ioctl, one\n"
+            "                 value per line of output. Implies '-C 0' if "
+            "'-C' not given\n"
             "    -p PORT      port ('a' to 'e') or gpio kernel line number "
             "(0 or more)\n"
             "    -r           print bit value to stdout (which is default "
             "action)\n"
             "                 used twice: exit value 0 for low, 1 for "
             "high\n"
+            "                 (with '-l': 1 if any line high)\n"
             "    -u           unexport gpio line prior to reading bit\n"
             "    -U           leave line exported on exit\n"
             "    -v           increase verbosity (multiple times for more)\n"
@@ -105,14 +120,36 @@ usage(void)
             "Example: 'readbits -b PC7'\n");
 }
 
-static char *
-get_best_gpio_name(int knum, char * b, int blen)
+
+/* Reads the 'num' lines in offsets[] from GPIO character device chip_name
+ * with one ioctl and prints their values, one per line. Returns 0 if ok,
+ * 1 for '-rr' with any line high, else -1 */
+static int
+process_cdev(const char * chip_name, const unsigned int * offsets, int num,
+             int ignore_dir, int read_val)
 {
-    if (gpio_name)
-        snprintf(b, blen, "%s [kn=%d]", gpio_name, blen);
-    else
-        snprintf(b, blen, "knum=%d", knum);
-    return b;
+    int k, chip_fd, line_fd;
+    int ret = -1;
+    uint64_t vals;
+
+    chip_fd = gc_open_chip(chip_name, NULL, verbose);
+    if (chip_fd < 0)
+        return -1;
+    /* with no direction flag the kernel leaves direction as is */
+    line_fd = gc_request_lines(chip_fd, offsets, num,
+                               (ignore_dir ? 0 : GC_FL_INPUT), 0, 0,
+                               verbose);
+    if (line_fd < 0)
+        goto fini;
+    if (0 == gc_get_values(line_fd, num, &vals)) {
+        for (k = 0; k < num; ++k)
+            printf("%c\n", ((vals >> k) & 1) ? '1' : '0');
+        ret = (read_val > 1) ? (0 != vals) : 0;
+    }
+    close(line_fd);
+fini:
+    close(chip_fd);
+    return ret;
 }
 
 
@@ -130,13 +167,17 @@ main(int argc, char ** argv)
     int exported_on_exit = 0;
     int exported = 0;
     int ret = -1;
+    int num_lines = 1;
     const char * cp;
+    const char * chip_name = NULL;
+    const char * line_list = NULL;
+    unsigned int offsets[GC_MAX_LINES];
     char b[256];
     char base_dir[128];
     char ch;
     char bank = '\0';
 
-    while ((opt = getopt(argc, argv, "b:hip:ruUvV")) != -1) {
+    while ((opt = getopt(argc, argv, "b:C:hil:p:ruUvV")) != -1) {
         switch (opt) {
         case 'b':
             cp = optarg;
@@ -160,6 +201,9 @@ main(int argc, char ** argv)
             }
             bn = k;
             break;
+        case 'C':
+            chip_name = optarg;
+            break;
         case 'h':
             usage();
             exit(EXIT_SUCCESS);
@@ -167,6 +211,9 @@ main(int argc, char ** argv)
         case 'i':
             ++ignore_dir;
             break;
+        case 'l':
+            line_list = optarg;
+            break;
         case 'p':
             if (isalpha(*optarg)) {
                 ch = toupper(*optarg);
@@ -221,6 +268,26 @@ main(int argc, char ** argv)
         }
     }
 
+    if (line_list && (NULL == chip_name))
+        chip_name = GC_DEF_CHIP;
+    if (chip_name) {
+        if (line_list) {
+            num_lines = gc_parse_lines(line_list, offsets, GC_MAX_LINES);
+            if (num_lines < 0)
+                exit(EXIT_FAILURE);
+        } else if (knum >= 0)
+            offsets[0] = knum;
+        else if ((bank >= 'A') && (bn >= 0))
+            offsets[0] = ((bank - 'A') * 32) + bn;
+        else {
+            fprintf(stderr, "Expect '-l LIST', '-p PORT' or '-b BN'\n");
+            usage();
+            exit(EXIT_FAILURE);
+        }
+        ret = process_cdev(chip_name, offsets, num_lines, ignore_dir,
+                           read_val);
+        return ret ? EXIT_FAILURE : 0;
+    }
     if (! ((knum >= 0) || ((bank >= 'A') && (bn >= 0)))) {
         fprintf(stderr, "Expect either '-p PORT' or '-b BN'\n");
         usage();
@@ -269,14 +336,16 @@ main(int argc, char ** argv)
         snprintf(b, sizeof(b), "%d", knum);
         if (pwrite(unexp_fd, b, strlen(b), 0) < 0) {
             fprintf(stderr, "Unable to unexport %s: %s\n",
-                    get_best_gpio_name(knum, b, sizeof(b)), strerror(errno));
+                    best_gpio_name(gpio_name, knum, b, sizeof(b)),
+                    strerror(errno));
             fprintf(stderr, "continue ...\n");
         }
     }
     snprintf(b, sizeof(b), "%d", knum);
     if (pwrite(exp_fd, b, strlen(b), 0) < 0) {
         fprintf(stderr, "Unable to export %s (already in use?): %s\n",
-                get_best_gpio_name(knum, b, sizeof(b)), strerror(errno));
+                best_gpio_name(gpio_name, knum, b, sizeof(b)),
+                strerror(errno));
         goto bad;
     }
     exported = 1;
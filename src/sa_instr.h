@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2026 Douglas Gilbert.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+#ifndef SA_INSTR_H
+#define SA_INSTR_H
+
+/*****************************************************************
+ * sa_instr.h
+ *
+ * Optional instrumentation, compiled in when SA_INSTR is defined (e.g.
+ * 'make clean; make INSTR=1'). Then mmap_regs counts get_mmp() lookups
+ * (that is register accesses, apart from loops that keep the pointer),
+ * page table misses and mmap()/munmap() calls, and reports them from
+ * release_mmap_state(); a5d2_tc_freq reports segment boundary lateness.
+ * Cycle timing uses CLOCK_MONOTONIC_RAW unless SA_INSTR_PMU is also
+ * defined, in which case the ARMv7 PMU cycle counter (PMCCNTR) is read
+ * directly. That needs the kernel (or a module) to have set PMUSERENR.EN
+ * and enabled the counter, otherwise the read faults with SIGILL.
+ *
+ ****************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "sa_misc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(SA_INSTR_PMU) && defined(__ARM_ARCH_7A__)
+#define SA_CYCLES_UNIT "cycles"
+#else
+#define SA_CYCLES_UNIT "ns"
+#endif
+
+/* Running statistics of a series of (signed) samples */
+struct sa_stat {
+    unsigned long n;
+    long long min;
+    long long max;
+    double sum;
+};
+
+/* Free running count in SA_CYCLES_UNIT units, for differences only */
+static inline uint64_t
+sa_cycles(void)
+{
+#if defined(SA_INSTR_PMU) && defined(__ARM_ARCH_7A__)
+    uint32_t c;
+
+    __asm__ __volatile__ ("mrc p15, 0, %0, c9, c13, 0" : "=r" (c));
+    return c;   /* 32 bit count of CPU clocks: wraps in ~8.6 s at 498 MHz */
+#else
+    return sa_ts_ns(CLOCK_MONOTONIC_RAW);
+#endif
+}
+
+/* Difference of two sa_cycles() values, allowing for one wrap */
+static inline uint64_t
+sa_cycles_diff(uint64_t from, uint64_t to)
+{
+#if defined(SA_INSTR_PMU) && defined(__ARM_ARCH_7A__)
+    return (uint32_t)(to - from);
+#else
+    return to - from;
+#endif
+}
+
+static inline void
+sa_stat_add(struct sa_stat * sp, long long v)
+{
+    if ((0 == sp->n) || (v < sp->min))
+        sp->min = v;
+    if ((0 == sp->n) || (v > sp->max))
+        sp->max = v;
+    sp->sum += v;
+    ++sp->n;
+}
+
+/* One line: "<name>: n=<n> min=.. mean=.. max=.. p-p=.. <unit>" with each
+ * value divided by 'div' (e.g. 1000 to show ns as us) */
+static inline void
+sa_stat_print(FILE * fp, const char * name, const struct sa_stat * sp,
+              double div, const char * unit)
+{
+    if (0 == sp->n) {
+        fprintf(fp, "%s: no samples\n", name);
+        return;
+    }
+    fprintf(fp, "%s: n=%lu min=%.1f mean=%.1f max=%.1f p-p=%.1f %s\n",
+            name, sp->n, sp->min / div, (sp->sum / sp->n) / div,
+            sp->max / div, (sp->max - sp->min) / div, unit);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
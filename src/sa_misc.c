@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2026 Douglas Gilbert.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+/*****************************************************************
+ * sa_misc.c
+ *
+ * Helpers shared by most utilities in this package. See sa_misc.h .
+ *
+ ****************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "sa_misc.h"
+
+
+int cl_foreground = 1;
+
+
+int
+pr2serr(const char * fmt, ...)
+{
+    va_list args;
+    int n;
+
+    va_start(args, fmt);
+    n = vfprintf(stderr, fmt, args);
+    va_end(args);
+    return n;
+}
+
+char *
+best_gpio_name(const char * gpio_name, int knum, char * b, int blen)
+{
+    if (gpio_name)
+        snprintf(b, blen, "%s [kn=%d]", gpio_name, knum);
+    else
+        snprintf(b, blen, "knum=%d", knum);
+    return b;
+}
+
+void
+cl_print(int priority, const char * fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    if (cl_foreground)
+        vfprintf(stderr, fmt, ap);
+    else
+        vsyslog(priority, fmt, ap);
+    va_end(ap);
+}
+
+void
+cl_daemonize(const char * name, int no_chdir, int no_varrunpid, int verbose)
+{
+    pid_t pid, sid, my_pid;
+    char b[64];
+    FILE * fp;
+
+    /* already a daemon */
+    if (getppid() == 1 )
+        return;
+
+    pid = fork();
+    if (pid < 0) {
+        snprintf(b, sizeof(b), "%s fork", name);
+        perror(b);
+        exit(EXIT_FAILURE);
+    }
+    if (pid > 0)
+        exit(EXIT_SUCCESS);
+
+    /* Cancel certain signals */
+    signal(SIGCHLD, SIG_DFL);   /* A child process dies */
+    signal(SIGTSTP, SIG_IGN);   /* Various TTY signals */
+    signal(SIGTTOU, SIG_IGN);
+    signal(SIGTTIN, SIG_IGN);
+    signal(SIGHUP, SIG_IGN);    /* Ignore hangup signal */
+    signal(SIGTERM, SIG_DFL);   /* Die on SIGTERM */
+
+    umask(022);
+
+    sid = setsid();
+    if (sid < 0) {
+        cl_print(LOG_ERR, "setsid: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    if (! no_chdir) {
+        if ((chdir("/")) < 0) {
+            cl_print(LOG_ERR, "chdir(/): %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    fp = freopen("/dev/null", "r", stdin);
+    fp = freopen("/dev/null", "w", stdout);
+    fp = freopen("/dev/null", "w", stderr);
+    /* ignoring handle */
+    cl_foreground = 0;
+
+    if (! no_varrunpid) {
+        my_pid = getpid();
+        snprintf(b, sizeof(b), "/var/run/%s.pid", name);
+        fp = fopen(b, "w+");
+        if (fp) {
+            snprintf(b, sizeof(b), "%d\n", my_pid);
+            fputs(b, fp);
+            fclose(fp);
+        } else if (verbose)
+            cl_print(LOG_WARNING, "Unable to open %s to put my pid(%d) in\n",
+                     b, my_pid);
+    }
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2026 Douglas Gilbert.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+#ifndef SA_MISC_H
+#define SA_MISC_H
+
+/*****************************************************************
+ * sa_misc.h
+ *
+ * Small helpers that each utility used to carry its own static copy of.
+ * They are linked once into each utility, and once into the multicall
+ * binary (sama5d2_utils) for all of them.
+ *
+ ****************************************************/
+
+#include <stdint.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* fprintf(stderr, ...) returning the number of characters written */
+#ifdef __GNUC__
+int pr2serr(const char * fmt, ...) __attribute__ ((format (printf, 1, 2)));
+#else
+int pr2serr(const char * fmt, ...);
+#endif
+
+/* Places a name for GPIO kernel line number 'knum' in b[] (at most 'blen'
+ * bytes): 'gpio_name' (e.g. "PC7", as given by the user) if not NULL
+ * then the kernel number, else just the kernel number. Returns b . */
+char * best_gpio_name(const char * gpio_name, int knum, char * b, int blen);
+
+/* Clock 'clk_id' (e.g. CLOCK_MONOTONIC) in nanoseconds */
+static inline uint64_t
+sa_ts_ns(clockid_t clk_id)
+{
+    struct timespec ts;
+
+    clock_gettime(clk_id, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+/* Daemon support. cl_print() goes to stderr while cl_foreground is set,
+ * otherwise to syslog with the given LOG_* 'priority'. cl_daemonize()
+ * forks (the parent exits), detaches from the terminal, redirects the
+ * standard streams to /dev/null and clears cl_foreground. Unless
+ * 'no_chdir' it changes to "/" and unless 'no_varrunpid' writes its pid
+ * to /var/run/<name>.pid . Exits on failure. */
+extern int cl_foreground;       /* initially 1 */
+
+#ifdef __GNUC__
+void cl_print(int priority, const char * fmt, ...)
+              __attribute__ ((format (printf, 2, 3)));
+#else
+void cl_print(int priority, const char * fmt, ...);
+#endif
+
+void cl_daemonize(const char * name, int no_chdir, int no_varrunpid,
+                  int verbose);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -31,7 +31,8 @@
  * setbits.c
  *
  * Utility for setting a GPIO line on a AT91SAM9G20/25/45 and SAMA5D3/D2 in
- * Linux. Uses sysfs interface. The target hardware is a FoxG20, the Aria
+ * Linux. Uses sysfs interface or, with '-C CHIP', the GPIO character
+ * device (see gpio_cdev.h). The target hardware is a FoxG20, the Aria
  * G25 and SAMA5D3/D2 family. This utility mimics the actions of a utility of
  * the same name for the FoxLX board. The Aria G25, FoxG20 and FoxLX
  * boards are made by Acme Systems. The SoCs are made by Atmel.
@@ -51,9 +52,13 @@
 #include <fcntl.h>
 #include <time.h>
 #include <errno.h>
+#include <stdint.h>
 
+#include "gpio_cdev.h"
+#include "sa_misc.h"
 
-static const char * version_str = "1.09 20200502";
+
+static const char * version_str = "1.10 20261014";
 
 #define EXPORT_FILE "/sys/class/gpio/export"
 #define UNEXPORT_FILE "/sys/class/gpio/unexport"
@@ -78,15 +83,21 @@ static void
 usage(void)
 {
     fprintf(stderr, "Usage: "
-            "setbits [-b BN] [-h] [-p PORT] [-s 0|1] [-S 0|1] [-t] [-T] "
-            "[-u] [-U]\n"
-            "               [-v] [-V]\n"
+            "setbits [-b BN] [-C CHIP] [-h] [-l LIST] [-p PORT] [-s 0|1] "
+            "[-S 0|1]\n"
+            "               [-t] [-T] [-u] [-U] [-v] [-V]\n"
             "  where:\n"
             "    -b BN        bit number within a port (0 to 31). Also "
             "accepts\n"
             "                 prefix like 'pc' or just 'c' for PORT (e.g. "
             "'-b c7').\n"
+            "    -C CHIP      use GPIO character device CHIP (e.g. '0' or "
+            "'gpiochip0')\n"
+            "                 rather than sysfs; line offset is bank*32+BN\n"
             "    -h           print usage message\n"
+            "    -l LIST      act on several lines (e.g. 'PA3,PC7') with "
+            "one ioctl per\n"
+            "                 step. Implies '-C 0' if '-C' not given\n"
             "    -p PORT      port ('a' to 'e') or gpio kernel line number "
             "(0 or more)\n"
             "    -s 0|1       state to set, 0 for low, 1 for high\n"
@@ -107,14 +118,42 @@ usage(void)
             "Example: 'setbits -b PC7 -s 1'\n");
 }
 
-static char *
-get_best_gpio_name(int knum, char * b, int blen)
+
+/* Sets the 'num' lines in offsets[] of GPIO character device chip_name as
+ * the sysfs code below does for one line. Each step acts on all lines with
+ * one ioctl. Returns 0 if ok, else -1 */
+static int
+process_cdev(const char * chip_name, const unsigned int * offsets, int num,
+             int state, int toggle)
 {
-    if (gpio_name)
-        snprintf(b, blen, "%s [kn=%d]", gpio_name, blen);
+    int chip_fd, line_fd;
+    int ret = -1;
+    uint64_t all = (num < 64) ? ((1ULL << num) - 1) : ~0ULL;
+
+    chip_fd = gc_open_chip(chip_name, NULL, verbose);
+    if (chip_fd < 0)
+        return -1;
+    if ((state < 0) && (0 == toggle))
+        line_fd = gc_request_lines(chip_fd, offsets, num, GC_FL_INPUT, 0, 0,
+                                   verbose);
+    else if (state >= 0)
+        line_fd = gc_request_lines(chip_fd, offsets, num, GC_FL_OUTPUT,
+                                   (state ? all : 0), 0, verbose);
     else
-        snprintf(b, blen, "knum=%d", knum);
-    return b;
+        line_fd = gc_request_lines(chip_fd, offsets, num, GC_FL_OUTPUT,
+                                   ((1 == toggle) ? all : 0), 0, verbose);
+    if (line_fd < 0)
+        goto fini;
+    if ((state < 0) && toggle) {
+        if (gc_set_values(line_fd, all, ((1 == toggle) ? 0 : all)) < 0)
+            goto close_line;
+    }
+    ret = 0;
+close_line:
+    close(line_fd);
+fini:
+    close(chip_fd);
+    return ret;
 }
 
 
@@ -132,13 +171,17 @@ main(int argc, char ** argv)
     int exported = 0;
     int origin0 = 0;
     int ret = -1;
+    int num_lines = 1;
     const char * cp;
+    const char * chip_name = NULL;
+    const char * line_list = NULL;
+    unsigned int offsets[GC_MAX_LINES];
     char b[256];
     char base_dir[128];
     char ch;
     char bank = '\0';
 
-    while ((opt = getopt(argc, argv, "b:hp:s:S:tTuUvV")) != -1) {
+    while ((opt = getopt(argc, argv, "b:C:hl:p:s:S:tTuUvV")) != -1) {
         switch (opt) {
         case 'b':
             cp = optarg;
@@ -162,10 +205,16 @@ main(int argc, char ** argv)
             }
             bn = k;
             break;
+        case 'C':
+            chip_name = optarg;
+            break;
         case 'h':
             usage();
             exit(EXIT_SUCCESS);
             break;
+        case 'l':
+            line_list = optarg;
+            break;
         case 'p':
             if (isalpha(*optarg)) {
                 ch = toupper(*optarg);
@@ -231,6 +280,25 @@ main(int argc, char ** argv)
         }
     }
 
+    if (line_list && (NULL == chip_name))
+        chip_name = GC_DEF_CHIP;
+    if (chip_name) {
+        if (line_list) {
+            num_lines = gc_parse_lines(line_list, offsets, GC_MAX_LINES);
+            if (num_lines < 0)
+                exit(EXIT_FAILURE);
+        } else if (knum >= 0)
+            offsets[0] = knum;
+        else if ((bank >= 'A') && (bn >= 0))
+            offsets[0] = ((bank - 'A') * 32) + bn;
+        else {
+            fprintf(stderr, "Expect '-l LIST', '-p PORT' or '-b BN'\n");
+            usage();
+            exit(EXIT_FAILURE);
+        }
+        ret = process_cdev(chip_name, offsets, num_lines, state, toggle);
+        return ret ? EXIT_FAILURE : 0;
+    }
     if (! ((knum >= 0) || ((bank >= 'A') && (bn >= 0)))) {
         fprintf(stderr, "Expect either '-p PORT' or '-b BN'\n");
         usage();
@@ -280,14 +348,16 @@ main(int argc, char ** argv)
         snprintf(b, sizeof(b), "%d", knum);
         if (pwrite(unexp_fd, b, strlen(b), 0) < 0) {
             fprintf(stderr, "Unable to unexport %s: %s\n",
-                    get_best_gpio_name(knum, b, sizeof(b)), strerror(errno));
+                    best_gpio_name(gpio_name, knum, b, sizeof(b)),
+                    strerror(errno));
             fprintf(stderr, "continue ...\n");
         }
     }
     snprintf(b, sizeof(b), "%d", knum);
     if (pwrite(exp_fd, b, strlen(b), 0) < 0) {
         fprintf(stderr, "Unable to export %s (already in use?): %s\n",
-                get_best_gpio_name(knum, b, sizeof(b)), strerror(errno));
+                best_gpio_name(gpio_name, knum, b, sizeof(b)),
+                strerror(errno));
         goto bad;
     }
     exported = 1;
@@ -0,0 +1,395 @@
+/*
+ * Copyright (c) 2026 Douglas Gilbert.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+/*****************************************************************
+ * soc_id.c
+ *
+ * SoC family identification with an optional tmpfs cache. See soc_id.h .
+ *
+ * Cache file layout (two text lines):
+ *     soc_id <boot_id> <boot_time> <family>
+ *     <model>
+ * where <boot_time> is CLOCK_REALTIME less CLOCK_BOOTTIME in seconds.
+ * If that still matches (within SOC_BTIME_SLACK seconds) the cache is
+ * taken as valid without any other check. Otherwise (e.g. the real time
+ * clock was set since) the kernel's boot_id decides. A cache file that is
+ * a symlink, not a regular file, not owned by root or the caller, or is
+ * writable by group or others is ignored.
+ *
+ ****************************************************/
+
+#define _XOPEN_SOURCE 600
+#define _GNU_SOURCE 1
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "soc_id.h"
+
+#ifndef CLOCK_BOOTTIME
+#define CLOCK_BOOTTIME 7        /* lk 2.6.39 */
+#endif
+
+#define CPUINFO "/proc/cpuinfo"
+#define DEVTREE_MODEL "/proc/device-tree/model"
+#define DEVTREE_COMPAT "/proc/device-tree/compatible"
+#define BOOT_ID "/proc/sys/kernel/random/boot_id"
+
+#define SOC_BOOT_ID_LEN 36
+#define SOC_BTIME_SLACK 2
+
+struct soc_fam_desc {
+    const char * name;          /* lower case, as in compatible strings */
+    const char * model_str;     /* look for this in device tree model */
+    const char * cpuinfo_str;   /* look for this in cpuinfo Hardware line */
+    const char * compat_str;    /* look for this in compatible strings */
+};
+
+/* Indexed by SOC_FAM_* . The sama5d2 and sama5d4 families were not
+ * looked for in /proc/cpuinfo, and "SAMA5" in cpuinfo means sama5d3, as
+ * the separate is_* utilities did. */
+static const struct soc_fam_desc fam_arr[SOC_FAM_NUM] = {
+    {"unknown", NULL, NULL, NULL},
+    {"sama5d2", "SAMA5D2", NULL, "sama5d2"},
+    {"sama5d3", "SAMA5D3", "SAMA5", "sama5d3"},
+    {"sama5d4", "SAMA5D4", NULL, "sama5d4"},
+    {"at91sam9g25", "G25", "G25", "at91sam9g25"},
+    {"at91sam9g20", "G20", "G20", "at91sam9g20"},
+};
+
+
+const char *
+soc_family_str(int family)
+{
+    if ((family < 0) || (family >= SOC_FAM_NUM))
+        family = SOC_FAM_UNKNOWN;
+    return fam_arr[family].name;
+}
+
+int
+soc_family_from_str(const char * cp)
+{
+    int k;
+
+    for (k = 0; k < SOC_FAM_NUM; ++k) {
+        if (0 == strcasecmp(cp, fam_arr[k].name))
+            return k;
+    }
+    return -1;
+}
+
+/* Reads up to blen - 1 bytes of 'fn' into b[] and NUL terminates.
+ * Returns number of bytes read or -1 if it could not be opened. */
+static int
+read_small_file(const char * fn, char * b, int blen, int verbose)
+{
+    int num;
+    FILE * fp;
+
+    if (NULL == (fp = fopen(fn, "r"))) {
+        if (verbose > 1)
+            fprintf(stderr, "Failed to open: %s\n", fn);
+        return -1;
+    }
+    num = fread(b, 1, blen - 1, fp);
+    if (verbose && ferror(fp))
+        fprintf(stderr, "Failed to read: %s\n", fn);
+    fclose(fp);
+    b[num] = '\0';
+    return num;
+}
+
+#ifdef __ARM_EABI__
+
+/* FAM_NAME upper or lower case in the model, as is_sama5d2 and friends */
+static int
+match_model(const char * model)
+{
+    int k;
+    const struct soc_fam_desc * fdp;
+
+    for (k = 1, fdp = fam_arr + 1; k < SOC_FAM_NUM; ++k, ++fdp) {
+        if (strstr(model, fdp->model_str) || strstr(model, fdp->name))
+            return k;
+    }
+    return SOC_FAM_UNKNOWN;
+}
+
+/* Device tree compatible property: NUL separated strings */
+static int
+match_compat(const char * b, int num)
+{
+    int k, n;
+    const char * ccp;
+
+    for (ccp = b; num > 1; num -= n, ccp += n) {
+        for (k = 1; k < SOC_FAM_NUM; ++k) {
+            if (strstr(ccp, fam_arr[k].compat_str))
+                return k;
+        }
+        n = strlen(ccp) + 1;
+    }
+    return SOC_FAM_UNKNOWN;
+}
+
+static int
+match_cpuinfo(char * b)
+{
+    int k;
+    char * cp;
+    char * c2p;
+
+    if (NULL == (cp = strstr(b, "\nHardware")))
+        return SOC_FAM_UNKNOWN;
+    cp += 9;
+    if ((c2p = strchr(cp, '\n')))
+        *c2p = '\0';
+    for (k = 1; k < SOC_FAM_NUM; ++k) {
+        if (fam_arr[k].cpuinfo_str && strstr(cp, fam_arr[k].cpuinfo_str))
+            return k;
+    }
+    return SOC_FAM_UNKNOWN;
+}
+
+#endif
+
+static void
+soc_detect(struct soc_id * sip, int verbose)
+{
+#ifdef __ARM_EABI__
+    int n, num;
+    char b[1024];
+
+    num = read_small_file(DEVTREE_MODEL, b, sizeof(b), verbose);
+    if (num >= 0) {
+        for (n = 0; (n < num) && (n < (SOC_MODEL_LEN - 1)) && b[n] &&
+                    ('\n' != b[n]); ++n)
+            sip->model[n] = b[n];
+        sip->model[n] = '\0';
+        sip->src = DEVTREE_MODEL;
+        if (num > 2)
+            sip->family = match_model(b);
+        if (verbose > 2)
+            fprintf(stderr, "model line: %s\n", sip->model);
+        if (SOC_FAM_UNKNOWN == sip->family) {
+            num = read_small_file(DEVTREE_COMPAT, b, sizeof(b), verbose);
+            if (num > 0) {
+                sip->src = DEVTREE_COMPAT;
+                sip->family = match_compat(b, num);
+            }
+        }
+    } else {
+        num = read_small_file(CPUINFO, b, sizeof(b), verbose);
+        if (num > 10) {
+            sip->src = CPUINFO;
+            sip->family = match_cpuinfo(b);
+        }
+    }
+#else
+    if (verbose > 1)
+        fprintf(stderr, "__ARM_EABI__ not defined so not an ARM based "
+                "SoC\n");
+    sip->family = SOC_FAM_UNKNOWN;
+#endif
+}
+
+static long long
+boot_time_s(void)
+{
+    struct timespec rt, bt;
+
+    if (clock_gettime(CLOCK_REALTIME, &rt) ||
+        clock_gettime(CLOCK_BOOTTIME, &bt))
+        return -1;
+    return (long long)rt.tv_sec - (long long)bt.tv_sec;
+}
+
+static int
+get_boot_id(char * b, int blen, int verbose)
+{
+    int n;
+
+    n = read_small_file(BOOT_ID, b, blen, verbose);
+    if (n < SOC_BOOT_ID_LEN)
+        return -1;
+    b[SOC_BOOT_ID_LEN] = '\0';
+    return 0;
+}
+
+/* Reads up to blen-1 bytes of 'cache_fn' into b, as read_small_file(), but
+ * only if it can be trusted (see above). Returns bytes read or -1. */
+static int
+read_cache_file(const char * cache_fn, char * b, int blen, int verbose)
+{
+    int fd, num;
+    struct stat st;
+
+    fd = open(cache_fn, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) {
+        if (verbose > 1)
+            fprintf(stderr, "Failed to open: %s\n", cache_fn);
+        return -1;
+    }
+    if ((fstat(fd, &st) < 0) || (! S_ISREG(st.st_mode)) ||
+        ((0 != st.st_uid) && (geteuid() != st.st_uid)) ||
+        (st.st_mode & (S_IWGRP | S_IWOTH))) {
+        if (verbose)
+            fprintf(stderr, "%s: not trusted (owner or mode), ignored\n",
+                    cache_fn);
+        close(fd);
+        return -1;
+    }
+    num = read(fd, b, blen - 1);
+    close(fd);
+    if (num < 0) {
+        if (verbose)
+            fprintf(stderr, "Failed to read: %s\n", cache_fn);
+        return -1;
+    }
+    b[num] = '\0';
+    return num;
+}
+
+/* Returns true if 'cache_fn' holds a result for this boot, which is
+ * placed in *sip */
+static bool
+read_cache(const char * cache_fn, struct soc_id * sip, long long btime,
+           int verbose)
+{
+    int n, fam;
+    long long c_btime;
+    char * cp;
+    char b[256];
+    char c_boot_id[SOC_BOOT_ID_LEN + 1];
+    char boot_id[SOC_BOOT_ID_LEN + 8];
+    char fam_str[24];
+
+    if (read_cache_file(cache_fn, b, sizeof(b), verbose) < 10)
+        return false;
+    if (3 != sscanf(b, "soc_id %36s %lld %23s", c_boot_id, &c_btime,
+                    fam_str)) {
+        if (verbose)
+            fprintf(stderr, "%s: bad header\n", cache_fn);
+        return false;
+    }
+    if ((fam = soc_family_from_str(fam_str)) < 0)
+        return false;
+    if ((btime < 0) || (llabs(btime - c_btime) > SOC_BTIME_SLACK)) {
+        /* clock set since (or a stale file): ask the kernel */
+        if (get_boot_id(boot_id, sizeof(boot_id), verbose) ||
+            strcmp(boot_id, c_boot_id)) {
+            if (verbose > 1)
+                fprintf(stderr, "%s: from an earlier boot\n", cache_fn);
+            return false;
+        }
+    }
+    sip->family = fam;
+    sip->model[0] = '\0';
+    if ((cp = strchr(b, '\n'))) {
+        ++cp;
+        for (n = 0; (n < (SOC_MODEL_LEN - 1)) && cp[n] && ('\n' != cp[n]);
+             ++n)
+            sip->model[n] = cp[n];
+        sip->model[n] = '\0';
+    }
+    sip->from_cache = true;
+    sip->src = cache_fn;
+    return true;
+}
+
+static void
+write_cache(const char * cache_fn, const struct soc_id * sip,
+            long long btime, int verbose)
+{
+    int fd;
+    FILE * fp;
+    char boot_id[SOC_BOOT_ID_LEN + 8];
+    char tmp_fn[256];
+
+    if (get_boot_id(boot_id, sizeof(boot_id), verbose))
+        return;
+    /* mkstemp() name, not <cache_fn>.<pid> which others could plant */
+    if (snprintf(tmp_fn, sizeof(tmp_fn), "%s.XXXXXX", cache_fn) >=
+        (int)sizeof(tmp_fn))
+        return;
+    if ((fd = mkstemp(tmp_fn)) < 0) {
+        if (verbose)
+            fprintf(stderr, "Unable to write cache %s: %s\n", tmp_fn,
+                    strerror(errno));
+        return;
+    }
+    if (fchmod(fd, 0644) || (NULL == (fp = fdopen(fd, "w")))) {
+        if (verbose)
+            fprintf(stderr, "Unable to write cache %s: %s\n", tmp_fn,
+                    strerror(errno));
+        close(fd);
+        unlink(tmp_fn);
+        return;
+    }
+    fprintf(fp, "soc_id %s %lld %s\n%s\n", boot_id, btime,
+            soc_family_str(sip->family), sip->model);
+    if (fclose(fp) || rename(tmp_fn, cache_fn)) {
+        if (verbose)
+            fprintf(stderr, "Unable to write cache %s: %s\n", cache_fn,
+                    strerror(errno));
+        unlink(tmp_fn);
+    } else if (verbose > 1)
+        fprintf(stderr, "wrote %s to cache %s\n",
+                soc_family_str(sip->family), cache_fn);
+}
+
+int
+soc_identify(struct soc_id * sip, const char * cache_fn, int verbose)
+{
+    long long btime = -1;
+
+    memset(sip, 0, sizeof(*sip));
+    sip->src = "";
+    if (cache_fn) {
+        btime = boot_time_s();
+        if (read_cache(cache_fn, sip, btime, verbose)) {
+            if (verbose > 1)
+                fprintf(stderr, "%s read from cache %s\n",
+                        soc_family_str(sip->family), cache_fn);
+            return sip->family;
+        }
+    }
+    soc_detect(sip, verbose);
+    if (cache_fn)
+        write_cache(cache_fn, sip, btime, verbose);
+    return sip->family;
+}
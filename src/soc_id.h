@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2026 Douglas Gilbert.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+#ifndef SOC_ID_H
+#define SOC_ID_H
+
+/*****************************************************************
+ * soc_id.h
+ *
+ * SoC family identification shared by the is_* utilities (is_sama5d2,
+ * is_sama5d3, is_sama5d4, is_ariag25, is_foxg20 and is_soc). The device
+ * tree model and compatible strings (or, without a device tree, the
+ * Hardware line of /proc/cpuinfo) are each read at most once and
+ * matched against all the families. Optionally the result is kept in a
+ * small file on tmpfs keyed on the kernel's boot_id; while the system
+ * stays up later calls answer from that file without reading procfs or
+ * the device tree.
+ *
+ ****************************************************/
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SOC_DEF_CACHE "/dev/shm/sama5d2_utils.soc"
+#define SOC_MODEL_LEN 128
+
+/* In the order they are checked */
+#define SOC_FAM_UNKNOWN 0
+#define SOC_FAM_SAMA5D2 1
+#define SOC_FAM_SAMA5D3 2
+#define SOC_FAM_SAMA5D4 3
+#define SOC_FAM_AT91SAM9G25 4   /* Aria G25 */
+#define SOC_FAM_AT91SAM9G20 5   /* FoxG20 */
+#define SOC_FAM_NUM 6
+
+struct soc_id {
+    int family;                 /* SOC_FAM_* */
+    bool from_cache;
+    const char * src;           /* file that decided it (or the cache) */
+    char model[SOC_MODEL_LEN];  /* device tree model, "" if none */
+};
+
+/* Identifies the SoC family, placing the result in *sip, and returns
+ * sip->family. If 'cache_fn' is not NULL a valid cache file by that name
+ * is used instead of the detection, and when the detection is done the
+ * result is written (best effort) to that file. Without __ARM_EABI__
+ * (i.e. not built for an ARM target) the family is SOC_FAM_UNKNOWN. */
+int soc_identify(struct soc_id * sip, const char * cache_fn, int verbose);
+
+/* Lower case family name (e.g. "sama5d2"), "unknown" if not known */
+const char * soc_family_str(int family);
+
+/* Inverse of soc_family_str(), case insensitive. Returns -1 if no match */
+int soc_family_from_str(const char * cp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
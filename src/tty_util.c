@@ -0,0 +1,256 @@
+/*
+ * Copyright (c) 2026 Douglas Gilbert.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+/*****************************************************************
+ * tty_util.c
+ *
+ * Serial port setup shared by hex2tty and xbee_api. See tty_util.h .
+ *
+ ****************************************************/
+
+#define _XOPEN_SOURCE 500
+#define _GNU_SOURCE 1
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <signal.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+
+#include "tty_util.h"
+#include "sa_misc.h"
+
+
+int
+tty_baud2speed(int baud)
+{
+    switch (baud) {
+    case 300: return B300;
+    case 1200: return B1200;
+    case 2400: return B2400;
+    case 4800: return B4800;
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    default: return -1;
+    }
+}
+
+int
+tty_open_raw(const char * tty_dev, const struct tty_opts * top,
+             struct termios * saved_p)
+{
+    int tty_fd, mask, mbits;
+    int verbose = top->verbose;
+    struct termios new_attributes;
+
+    if (verbose > 2)
+        pr2serr("%s: about to open(%s)\n", __func__, tty_dev);
+    tty_fd = open(tty_dev, (O_RDWR | O_NOCTTY | O_SYNC));
+    if (tty_fd < 0) {
+        pr2serr("%s: open() of %s failed: %s\n", __func__, tty_dev,
+                strerror(errno));
+        return -1;
+    }
+
+    tcgetattr(tty_fd, saved_p);
+    new_attributes = *saved_p;
+
+    // Set the new attributes for the serial port, 'man termios'
+    cfsetospeed(&new_attributes, top->speed);
+    cfsetispeed(&new_attributes, top->speed);
+
+    // c_cflag
+    new_attributes.c_cflag |= CREAD;        // Enable receiver
+    new_attributes.c_cflag &= ~CSIZE;       // clear size mask
+    switch (top->nbits) {
+    case 5:
+        new_attributes.c_cflag |= CS5;
+        break;
+    case 6:
+        new_attributes.c_cflag |= CS6;
+        break;
+    case 7:
+        new_attributes.c_cflag |= CS7;
+        break;
+    case 8:
+    default:
+        new_attributes.c_cflag |= CS8;          // 8 data bit
+        break;
+    }
+    switch (top->parity) {
+    case 'E':
+        new_attributes.c_cflag |= PARENB;
+        new_attributes.c_cflag &= ~PARODD;
+        break;
+    case 'O':
+        new_attributes.c_cflag |= PARENB;
+        new_attributes.c_cflag |= PARODD;
+        break;
+    case 'N':
+        new_attributes.c_cflag &= ~PARENB;
+        break;
+    }
+    if (1 == top->sbits)
+        new_attributes.c_cflag &= ~CSTOPB;
+    else
+        new_attributes.c_cflag |= CSTOPB;
+    if (top->no_hupcl) {     // clear Hang Up on CLose (effects DTR+RTS)
+        if (1 == top->no_hupcl) {
+            new_attributes.c_cflag &= ~HUPCL;
+            if (verbose)
+                pr2serr("clearing HUPCL so RTS+DTR keep setting after "
+                        "close\n");
+        } else {
+            new_attributes.c_cflag |= HUPCL;
+            if (verbose)
+                pr2serr("setting HUPCL so RTS+DTR go inactive after close\n");
+        }
+    }
+    if (top->hhandshake) {
+        if (1 == top->hhandshake) {
+            new_attributes.c_cflag |= CRTSCTS;
+            if (verbose)
+                pr2serr("set hardware RTS/CTS handshake; those lines should "
+                        "be wired\n");
+        } else {
+            new_attributes.c_cflag &= ~CRTSCTS;
+            if (verbose)
+                pr2serr("clear hardware RTS/CTS handshake\n");
+        }
+    }
+
+    // c_iflag
+    if ('N' == top->parity)
+        new_attributes.c_iflag |= IGNPAR;       // Ignore framing and parity
+    // Suggested by Michael Kerrisk [The Linux Programming Interface].
+    // He also included "| PARMRK".
+    new_attributes.c_iflag &= ~(BRKINT | ICRNL | IGNBRK | IGNCR | INLCR |
+                                INPCK | ISTRIP | IXON);
+
+    // c_oflag     [Turn off corrupting output post-processing]
+    new_attributes.c_oflag &= ~(OPOST);
+
+    // c_lflag
+    new_attributes.c_lflag &= ~(ICANON | IEXTEN | ECHO | ECHOE | ISIG);
+
+    // Next two only apply for non-canonical reads (which we have set)
+    new_attributes.c_cc[VMIN] = 0;     // Min chars to read
+    new_attributes.c_cc[VTIME] = top->timeout_100ms;    // max 25.5 secs
+
+    if (tcsetattr(tty_fd, TCSANOW, &new_attributes) < 0) {
+        pr2serr("%s: tcsetattr() failed: %s\n", __func__, strerror(errno));
+        close(tty_fd);
+        return -1;
+    }
+    mbits = -1;
+    if (verbose > 1) {
+        if (ioctl(tty_fd, TIOCMGET, &mbits) >= 0)
+            pr2serr("modem lines set: %s%s%s%s [0x%x]\n",
+                    ((mbits & TIOCM_DSR) ? "DSR," : ""),
+                    ((mbits & TIOCM_RNG) ? "RING," : ""),
+                    ((mbits & TIOCM_CAR) ? "DCD," : ""),
+                    ((mbits & TIOCM_CTS) ? "CTS," : ""),
+                    mbits);
+    }
+    if (top->dtr) {
+        mask = TIOCM_DTR;
+        if (1 == top->dtr)
+            ioctl(tty_fd, TIOCMBIS, &mask);
+        else
+            ioctl(tty_fd, TIOCMBIC, &mask);
+    }
+    if (top->rts) {
+        if (verbose > 1)
+            pr2serr("%s: %sing RTS line\n", __func__,
+                    (1 == top->rts) ? "sett" : "clear");
+        mask = TIOCM_RTS;
+        if (1 == top->rts)
+            ioctl(tty_fd, TIOCMBIS, &mask);
+        else
+            ioctl(tty_fd, TIOCMBIC, &mask);
+    }
+    if ((verbose || top->warn) && (saved_p->c_cflag & CRTSCTS) &&
+        (0 == top->hhandshake)) {
+        int cts_clear = 0;
+
+        if ((-1 != mbits) || (ioctl(tty_fd, TIOCMGET, &mbits) >= 0)) {
+            cts_clear = !(mbits & TIOCM_CTS);
+            pr2serr(">>> hardware RTS/CTS handshake active, not being "
+                    "changed\n>>> and CTS line is %s\n",
+                    cts_clear ? "clear (low), this could cause lockup" :
+                    "set (high), might be okay");
+            if (cts_clear)
+                pr2serr(">>> could use '-cc' to disable RTS/CTS handshake\n");
+        } else
+            pr2serr(">>> hardware RTS/CTS handshake active, not being "
+                    "changed\n");
+    }
+    return tty_fd;
+}
+
+void
+tty_show_stty(const char * tty_dev)
+{
+    int res;
+    char b[128];
+
+    snprintf(b, sizeof(b) - 1, "stty -a -F %s", tty_dev);
+    printf(">>> Output from this command line invocation: '%s' is:\n", b);
+    fflush(stdout);
+    res = system(b);
+    if (WIFSIGNALED(res) &&
+        (WTERMSIG(res) == SIGINT || WTERMSIG(res) == SIGQUIT))
+        raise(WTERMSIG(res));
+    /* ignore res of not a signal */
+}
+
+bool
+tty_poll_in(int fd, int millisecs)
+{
+    int num;
+    struct pollfd apfd;
+
+    if (fd >= 0) {
+        apfd.fd = fd;
+        apfd.events = POLLIN;
+        apfd.revents = 0;
+        num = poll(&apfd, 1, millisecs);
+        return (num > 0) && (POLLIN & apfd.revents);
+    }
+    return false;
+}
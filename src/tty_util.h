@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2026 Douglas Gilbert.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+#ifndef TTY_UTIL_H
+#define TTY_UTIL_H
+
+/*****************************************************************
+ * tty_util.h
+ *
+ * Serial port (<tty>) setup shared by hex2tty and xbee_api: baud rate
+ * decoding, opening the port in raw (non-canonical) mode with the given
+ * framing, handshake and modem line settings, and a poll() for input.
+ *
+ ****************************************************/
+
+#include <stdbool.h>
+#include <termios.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct tty_opts {
+    int speed;          /* termios speed (e.g. B9600) */
+    int dtr;            /* 0: leave as is, 1: set DTR, > 1: clear it */
+    int rts;            /* 0: leave as is, 1: set RTS, > 1: clear it */
+    int hhandshake;     /* 0: leave CRTSCTS as is, 1: set, > 1: clear */
+    int no_hupcl;       /* 0: leave HUPCL as is, 1: clear, > 1: set */
+    int nbits;          /* data bits: 5, 6, 7 or 8 */
+    int parity;         /* 'N', 'E' or 'O' */
+    int sbits;          /* stop bits: 1 or 2 */
+    int timeout_100ms;  /* VTIME: read() timeout, units of 100 ms */
+    int warn;           /* warn if CRTSCTS left set while CTS is clear */
+    int verbose;
+};
+
+/* Returns the termios speed for 'baud' (300 to 230400) or -1 if it is not
+ * one of the rates these utilities accept. */
+int tty_baud2speed(int baud);
+
+/* Opens 'tty_dev' and sets it up as given in *top. Its previous settings
+ * are written to *saved_p so the caller can restore them. Returns the
+ * file descriptor or -1 if problem. */
+int tty_open_raw(const char * tty_dev, const struct tty_opts * top,
+                 struct termios * saved_p);
+
+/* Runs 'stty -a' on 'tty_dev' so its settings appear on stdout */
+void tty_show_stty(const char * tty_dev);
+
+/* Returns true if 'fd' has input within 'millisecs' */
+bool tty_poll_in(int fd, int millisecs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2026 Douglas Gilbert.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+#ifndef W1_SHM_H
+#define W1_SHM_H
+
+/*****************************************************************
+ * w1_shm.h
+ *
+ * Layout of the file that 'w1_temp -D' keeps memory mapped and rewrites
+ * after each sampling sweep. Readers mmap() the same file (read only)
+ * then take snapshots with w1_shm_snapshot() which needs no system calls
+ * and never blocks the daemon: the writer makes 'seq' odd while it
+ * updates and even again when done, a reader retries if 'seq' was odd
+ * or changed while it copied (a seqlock). Readers should check that the
+ * file is at least sizeof(struct w1_shm) bytes long before mapping it:
+ * touching a page beyond the end of a (truncated) file raises SIGBUS.
+ *
+ ****************************************************/
+
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define W1_SHM_MAGIC 0x57315450         /* "W1TP" */
+#define W1_SHM_VERSION 1
+#define W1_DEF_SHM_FILE "/dev/shm/w1_temp"
+
+#define W1_MAX_DEVS 64
+
+/* w1_shm_snapshot() spins this many times on an odd 'seq' then sleeps a
+ * millisecond between tries, giving up after W1_SHM_MAX_WAIT_MS or as
+ * soon as the writer's pid no longer exists (it died mid update). */
+#define W1_SHM_SPINS 1000
+#define W1_SHM_MAX_WAIT_MS 1000
+
+/* One per sensor */
+struct w1_ent {
+    char dev[20];       /* sysfs name, e.g. "28-0000055a1b2c" */
+    int ok;             /* 0 if the read failed */
+    int milli;          /* degrees C * 1000 */
+    long long ts_ms;    /* CLOCK_REALTIME when read, in milliseconds */
+};
+
+struct w1_shm {
+    unsigned int magic;         /* W1_SHM_MAGIC once initialized */
+    unsigned int version;       /* W1_SHM_VERSION */
+    volatile unsigned int seq;  /* odd while the writer is updating */
+    int pid;                    /* of writer, 0 after it exits */
+    int interval_ms;            /* sampling period */
+    int num_ent;                /* valid entries in ent_arr[] */
+    unsigned int sweeps;        /* number of completed sweeps */
+    long long sweep_ts_ms;      /* CLOCK_REALTIME at end of last sweep */
+    struct w1_ent ent_arr[W1_MAX_DEVS];
+};
+
+/* Writer side: bracket each update of *shp with these. */
+static inline void
+w1_shm_write_begin(struct w1_shm * shp)
+{
+    ++shp->seq;
+    __sync_synchronize();
+}
+
+static inline void
+w1_shm_write_end(struct w1_shm * shp)
+{
+    __sync_synchronize();
+    ++shp->seq;
+}
+
+/* Copies a consistent snapshot of *shp into *outp. Returns 0 if okay,
+ * -1 if the writer stayed in an update too long or died during one. */
+static inline int
+w1_shm_snapshot(const struct w1_shm * shp, struct w1_shm * outp)
+{
+    int tries = 0;
+    unsigned int s;
+    struct timespec ms = {0, 1000000};
+
+    do {
+        while ((s = shp->seq) & 1) {
+            if (++tries <= W1_SHM_SPINS)
+                continue;
+            if ((tries > (W1_SHM_SPINS + W1_SHM_MAX_WAIT_MS)) ||
+                ((shp->pid > 0) && (kill(shp->pid, 0) < 0) &&
+                 (ESRCH == errno)))
+                return -1;
+            nanosleep(&ms, NULL);
+        }
+        __sync_synchronize();
+        memcpy(outp, (const void *)shp, sizeof(*outp));
+        __sync_synchronize();
+    } while (s != shp->seq);
+    outp->seq = s;
+    return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -14,14 +14,30 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
+#include <stddef.h>
+#include <time.h>
+#include <signal.h>
+#include <syslog.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
+#include "w1_shm.h"
+#include "sa_misc.h"
 
-static const char * version_str = "0.98 20160121";
+
+static const char * version_str = "1.00 20261014";
 
 #define SYSFS_W1_DEVS "/sys/bus/w1/devices"
+#define W1_MASTER_PREFIX "w1_bus_master"
+#define W1_BULK_READ "therm_bulk_read"
 #define DS18S20_DS1820_FAM 0x10
 #define DS18B20_FAM 0x28
 
+#define W1_DEF_MAX_AGE_MS 5000
+#define W1_DEF_INTERVAL_MS 10000
+#define W1_MIN_INTERVAL_MS 100
+
 struct opts_t {
     int both;
     int dev_fam;
@@ -31,47 +47,61 @@ struct opts_t {
     const char * new_fn;
     int verbose;
     int serial_num;
+    int parallel;
+    int max_age_ms;
+    const char * cfile;
+    const char * mfile;
+    int interval_ms;
     FILE * out_fp;
+    int num_ent;
+    struct w1_ent ent_arr[W1_MAX_DEVS];
 };
 
 
-#ifdef __GNUC__
-static int pr2serr(const char * fmt, ...)
-        __attribute__ ((format (printf, 1, 2)));
-#else
-static int pr2serr(const char * fmt, ...);
-#endif
-
+static volatile sig_atomic_t stop_sig;
 
-static int
-pr2serr(const char * fmt, ...)
-{
-    va_list args;
-    int n;
-
-    va_start(args, fmt);
-    n = vfprintf(stderr, fmt, args);
-    va_end(args);
-    return n;
-}
 
 static void
 usage(void)
 {
-    pr2serr("Usage: w1_temp [-a <afile>] [-b] [-f] [-F] [-h] [-o <ofile>] "
-            "[-r <new_fn>]\n"
-            "               [-s] [-v] [-V] [-w <fcode>]\n"
+    pr2serr("Usage: w1_temp [-a <afile>] [-b] [-c <cfile>] [-D] [-f] [-F] "
+            "[-h]\n"
+            "               [-i <ms>] [-m <ms>] [-M <mfile>] [-o <ofile>] "
+            "[-p]\n"
+            "               [-r <new_fn>] [-s] [-v] [-V] [-w <fcode>]\n"
             "  where:\n"
             "    -a <afile>   reads W1 addresses from <afile> then outputs "
             "temperature\n"
             "                 of corresponding device or '-' if not "
             "found\n"
             "    -b           check both 0x10 and 0x28 families\n"
+            "    -c <cfile>   answer from cache file <cfile> if no entry is "
+            "older than\n"
+            "                 '-m <ms>', otherwise do a '-p' sweep and "
+            "rewrite <cfile>\n"
+            "    -D           run as daemon: find sensors once, then every "
+            "'-i <ms>'\n"
+            "                 do a '-p' sweep and publish results in "
+            "<mfile>\n"
             "    -f           fixed point, up to 3 decimal places (def: "
             "rounded integer)\n"
             "    -F           print family before serial number\n"
             "    -h           print usage message\n"
+            "    -i <ms>      sampling interval of '-D' in milliseconds "
+            "(def: %d)\n"
+            "    -m <ms>      maximum age of '-c' cache entries in "
+            "milliseconds\n"
+            "                 (def: %d)\n"
+            "    -M <mfile>   memory mapped file written by '-D' (def: "
+            "%s).\n"
+            "                 Without '-D' answer from <mfile> if its "
+            "daemon is\n"
+            "                 running and its last sweep is recent\n"
             "    -o <ofile>    send output to <ofile> rather than stdout\n"
+            "    -p           parallel: start conversions on all selected "
+            "sensors at once\n"
+            "                 (bus master '%s' if present, and one\n"
+            "                 thread per sensor) then print results\n"
             "    -r <new_fn>   unlink <new_fn> and rename <ofile> to "
             "<new_fn> just\n"
             "                  before exiting. Ignored unless '-o <ofile>' "
@@ -86,7 +116,8 @@ usage(void)
             "Fetch temperature from one wire (w1) device and write to "
             "<ofile> or stdout.\nUses Linux sysfs interface and assumes "
             "W1_SLAVE_THERM is configured in\nkernel. Default fcode is "
-            "0x10 for the DS18S20 and DS1820.\n");
+            "0x10 for the DS18S20 and DS1820.\n", W1_DEF_INTERVAL_MS,
+            W1_DEF_MAX_AGE_MS, W1_DEF_SHM_FILE, W1_BULK_READ);
 }
 
 #if 0
@@ -105,40 +136,19 @@ mod(int a, int b)
 }
 #endif
 
+/* Reads <pathp>/<dev>/w1_slave and decodes the "t=" value into *millip
+ * (degrees C * 1000). Only uses locals so worker threads may call it.
+ * Returns 0 if okay, else 1 . */
 static int
-get_temp(const char * dev, const char * pathp, struct opts_t * op)
+read_milli(const char * dev, const char * pathp, int verbose, int * millip)
 {
-    int fd, milliTemp, mt, t;
+    int fd, milliTemp;
     ssize_t numRead;
-    const char * ccp;
     char * cp;
     char buf[256];     // Data from device
-    char tmpData[5];   // Temp C * 1000 reported by device
+    char tmpData[8];   // Temp C * 1000 reported by device
     char devPath[128];
 
-    if (op->verbose)
-        pr2serr("found W1 temperature device: %s\n", dev);
-    if (op->serial_num) {
-        if ((ccp = strchr(dev, '-'))) {
-            if (1 == sscanf(ccp + 1, "%14s", buf)) {
-                if (op->out_fp)
-                    ;
-                else if (op->ofile) {
-                    op->out_fp = fopen(op->ofile, "w");
-                    if (NULL == op->out_fp) {
-                        pr2serr("Unable to open %s\n", op->ofile);
-                        return 1;
-                    }
-                } else
-                    op->out_fp = stdout;
-                if (op->family)
-                    fprintf(op->out_fp, "%.20s\n", dev);
-                else
-                    fprintf(op->out_fp, "%s\n", buf);
-            }
-        }
-        return 0;
-    }
     snprintf(devPath, sizeof(devPath), "%s/%s/w1_slave", pathp, dev);
     fd = open(devPath, O_RDONLY);
     if(fd < 0) {
@@ -147,6 +157,7 @@ get_temp(const char * dev, const char * pathp, struct opts_t * op)
         return 1;
     }
     numRead = read(fd, buf, 255);
+    close(fd);
     if (numRead < 0) {
         perror("failed reading W1 temperature device\n");
         return 1;
@@ -155,22 +166,501 @@ get_temp(const char * dev, const char * pathp, struct opts_t * op)
         return 1;
     }
     buf[numRead] = '\0';
-    close(fd);
     cp = strstr(buf, "t=");
     if (NULL == cp) {
         pr2serr("unable to find 't=' string\n");
         return 1;
     }
-    strcpy(tmpData, cp + 2);
+    snprintf(tmpData, sizeof(tmpData), "%s", cp + 2);
     cp = strchr(tmpData, '\n');
     if (cp)
         *cp = '\0';
-    if (op->verbose)
+    if (verbose)
         pr2serr("Raw temperature string: %s\n", tmpData);
     if (1 != sscanf(tmpData, "%d", &milliTemp)) {
         pr2serr("unable to decode temperature raw string\n");
         return 1;
     }
+    *millip = milliTemp;
+    return 0;
+}
+
+static long long
+now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ((long long)ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+}
+
+static const struct w1_ent *
+find_ent(const struct opts_t * op, const char * dev)
+{
+    int k;
+
+    for (k = 0; k < op->num_ent; ++k) {
+        if (0 == strcmp(dev, op->ent_arr[k].dev))
+            return op->ent_arr + k;
+    }
+    return NULL;
+}
+
+/* Selected families as for the non-parallel path: op->dev_fam and, if
+ * '-b', the other one. */
+static int
+fam_wanted(const struct opts_t * op, int fam)
+{
+    return (op->both && ((DS18S20_DS1820_FAM == fam) ||
+                         (DS18B20_FAM == fam))) || (fam == op->dev_fam);
+}
+
+/* Writes "trigger" to each bus master's therm_bulk_read attribute. The
+ * kernel then issues one CONVERT T to all sensors on that bus and later
+ * w1_slave reads wait for it rather than starting their own conversion.
+ * Returns the number of bus masters triggered. */
+static int
+bulk_trigger(const char * pathp, int verbose)
+{
+    int fd, num;
+    DIR * dir;
+    struct dirent * dirent;
+    char b[256];
+
+    dir = opendir(pathp);
+    if (NULL == dir)
+        return 0;
+    for (num = 0; (dirent = readdir(dir)); ) {
+        if (strncmp(dirent->d_name, W1_MASTER_PREFIX,
+                    sizeof(W1_MASTER_PREFIX) - 1))
+            continue;
+        snprintf(b, sizeof(b), "%s/%.64s/%s", pathp, dirent->d_name,
+                 W1_BULK_READ);
+        fd = open(b, O_WRONLY);
+        if (fd < 0) {
+            if (verbose > 1)
+                pr2serr("%s: no %s\n", dirent->d_name, W1_BULK_READ);
+            continue;
+        }
+        if (write(fd, "trigger\n", 8) < 0) {
+            if (verbose)
+                perror("therm_bulk_read trigger");
+        } else {
+            ++num;
+            if (verbose)
+                pr2serr("bulk conversion triggered on %s\n",
+                        dirent->d_name);
+        }
+        close(fd);
+    }
+    (void) closedir(dir);
+    return num;
+}
+
+static void *
+read_worker(void * arg)
+{
+    struct w1_ent * ep = (struct w1_ent *)arg;
+
+    ep->ok = (0 == read_milli(ep->dev, SYSFS_W1_DEVS, 0, &ep->milli));
+    ep->ts_ms = now_ms();
+    return NULL;
+}
+
+/* Places the name of each selected sensor in op->ent_arr[]. Returns 0 if
+ * okay, else 1 . */
+static int
+scan_devs(const char * pathp, struct opts_t * op)
+{
+    int fam;
+    unsigned int u;
+    DIR * dir;
+    struct dirent * dirent;
+    struct w1_ent * ep;
+
+    op->num_ent = 0;
+    dir = opendir(pathp);
+    if (NULL == dir) {
+        perror("Couldn't open the w1 devices directory");
+        pr2serr("  [%s]\n", pathp);
+        return 1;
+    }
+    while ((dirent = readdir(dir))) {
+        // W1 devices are links starting with 28- (S part) or 10-
+        if ((dirent->d_type != DT_LNK) ||
+            (1 != sscanf(dirent->d_name, "%2x-", &u)))
+            continue;
+        fam = (int)u;
+        if ((dirent->d_name[2] != '-') || (! fam_wanted(op, fam)))
+            continue;
+        if (op->num_ent >= W1_MAX_DEVS) {
+            pr2serr("more than %d sensors, ignoring %s\n", W1_MAX_DEVS,
+                    dirent->d_name);
+            continue;
+        }
+        ep = op->ent_arr + op->num_ent++;
+        memset(ep, 0, sizeof(*ep));
+        snprintf(ep->dev, sizeof(ep->dev), "%.19s", dirent->d_name);
+    }
+    (void) closedir(dir);
+    return 0;
+}
+
+/* Starts conversions of all sensors in op->ent_arr[] together then fills
+ * in their readings. Conversion takes up to 750 ms (12 bit resolution) so
+ * reading N sensors one after another takes N times as long. Where the
+ * bus master lacks therm_bulk_read, one thread per sensor still lets the
+ * kernel overlap conversions of externally powered sensors. */
+static void
+convert_all(const char * pathp, struct opts_t * op)
+{
+    int k, num_thr, res;
+    struct w1_ent * ep;
+    pthread_t thr_arr[W1_MAX_DEVS];
+
+    if (0 == op->num_ent)
+        return;
+    bulk_trigger(pathp, op->verbose);
+    for (k = 0, num_thr = 0; k < op->num_ent; ++k, ++num_thr) {
+        res = pthread_create(thr_arr + k, NULL, read_worker,
+                             op->ent_arr + k);
+        if (res) {
+            cl_print(LOG_WARNING, "pthread_create: %s, reading rest in "
+                     "turn\n", strerror(res));
+            break;
+        }
+    }
+    for (k = num_thr; k < op->num_ent; ++k)
+        read_worker(op->ent_arr + k);
+    for (k = 0; k < num_thr; ++k)
+        pthread_join(thr_arr[k], NULL);
+    if (op->verbose) {
+        for (k = 0, ep = op->ent_arr; k < op->num_ent; ++k, ++ep) {
+            if (ep->ok)
+                pr2serr("%s: temperature in C x1000: %d\n", ep->dev,
+                        ep->milli);
+            else
+                pr2serr("%s: read failed\n", ep->dev);
+        }
+    }
+}
+
+/* Finds the selected sensors then reads them with convert_all(). Returns
+ * 0 if okay, else 1 . */
+static int
+sweep(const char * pathp, struct opts_t * op)
+{
+    if (scan_devs(pathp, op))
+        return 1;
+    convert_all(pathp, op);
+    return 0;
+}
+
+/* Maps <mfile> read only and, if its writer is alive and its last sweep
+ * ended less than two intervals (plus a conversion time) ago, copies the
+ * readings into op->ent_arr[]. Returns 0 if that was done, else 1 . */
+static int
+load_shm(struct opts_t * op)
+{
+    int fd, k, res;
+    long long age;
+    void * p;
+    struct stat st;
+    struct w1_shm snap;
+
+    fd = open(op->mfile, O_RDONLY);
+    if (fd < 0) {
+        if (op->verbose)
+            pr2serr("%s: %s\n", op->mfile, strerror(errno));
+        return 1;
+    }
+    if (fstat(fd, &st) < 0) {
+        pr2serr("%s: fstat: %s\n", op->mfile, strerror(errno));
+        close(fd);
+        return 1;
+    }
+    if (st.st_size < (off_t)sizeof(struct w1_shm)) {
+        pr2serr("%s: too short (%lld bytes) for a w1_temp mapped file\n",
+                op->mfile, (long long)st.st_size);
+        close(fd);
+        return 1;
+    }
+    p = mmap(NULL, sizeof(struct w1_shm), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (MAP_FAILED == p) {
+        perror("mmap");
+        return 1;
+    }
+    res = w1_shm_snapshot((const struct w1_shm *)p, &snap);
+    munmap(p, sizeof(struct w1_shm));
+    if (res) {
+        pr2serr("%s: writer stuck or died while updating\n", op->mfile);
+        return 1;
+    }
+    if ((W1_SHM_MAGIC != snap.magic) || (W1_SHM_VERSION != snap.version)) {
+        pr2serr("%s: not a w1_temp mapped file\n", op->mfile);
+        return 1;
+    }
+    age = now_ms() - snap.sweep_ts_ms;
+    if ((0 == snap.pid) || (0 == snap.sweeps) || (age < 0) ||
+        (age > (2LL * snap.interval_ms) + 1000)) {
+        if (op->verbose)
+            pr2serr("%s: daemon %s, last sweep %lld ms ago\n", op->mfile,
+                    snap.pid ? "running" : "stopped", age);
+        return 1;
+    }
+    if (snap.num_ent > W1_MAX_DEVS)
+        snap.num_ent = W1_MAX_DEVS;
+    for (k = 0; k < snap.num_ent; ++k)
+        op->ent_arr[k] = snap.ent_arr[k];
+    op->num_ent = snap.num_ent;
+    if (op->verbose)
+        pr2serr("%s: using %d entries from sweep %u, %lld ms ago\n",
+                op->mfile, snap.num_ent, snap.sweeps, age);
+    return 0;
+}
+
+static void
+stop_handler(int sig)
+{
+    stop_sig = sig;
+}
+
+/* Creates a new, empty file named <fn>.XXXXXX (in the same directory as
+ * <fn>, see mkstemp()) with mode 0644, puts its name in b and returns its
+ * file descriptor, or -1. The caller renames it over <fn>: that replaces
+ * rather than follows anything planted there (e.g. a symlink in the world
+ * writable /dev/shm) which open(O_CREAT) or fopen("w") would not. */
+static int
+open_tmp_beside(const char * fn, char * b, int blen)
+{
+    int fd;
+
+    if (snprintf(b, blen, "%s.XXXXXX", fn) >= blen) {
+        pr2serr("%s: name too long\n", fn);
+        return -1;
+    }
+    if ((fd = mkstemp(b)) < 0) {
+        pr2serr("%s: mkstemp: %s\n", b, strerror(errno));
+        return -1;
+    }
+    if (fchmod(fd, 0644) < 0) {
+        pr2serr("%s: fchmod: %s\n", b, strerror(errno));
+        close(fd);
+        unlink(b);
+        return -1;
+    }
+    return fd;
+}
+
+/* Daemon main loop: maps <mfile>, finds sensors once then samples them
+ * every op->interval_ms (on CLOCK_MONOTONIC deadlines so the period does
+ * not drift by the sweep time) until SIGTERM or SIGINT. */
+static int
+run_daemon(const char * pathp, struct opts_t * op)
+{
+    int fd, k;
+    struct w1_shm * shp;
+    struct timespec next, now;
+    struct sigaction sa;
+    char b[256];
+
+    /* a fresh file each start, never one already at <mfile> */
+    if ((fd = open_tmp_beside(op->mfile, b, sizeof(b))) < 0)
+        return 1;
+    if (ftruncate(fd, sizeof(struct w1_shm)) < 0) {
+        perror("daemon: ftruncate");
+        close(fd);
+        unlink(b);
+        return 1;
+    }
+    shp = (struct w1_shm *)mmap(NULL, sizeof(struct w1_shm),
+                                PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (MAP_FAILED == (void *)shp) {
+        perror("daemon: mmap");
+        unlink(b);
+        return 1;
+    }
+    if (rename(b, op->mfile) < 0) {
+        perror("daemon: rename mapped file");
+        pr2serr("  [%s]\n", op->mfile);
+        unlink(b);
+        return 1;
+    }
+    if (scan_devs(pathp, op))
+        return 1;
+    if (0 == op->num_ent)
+        pr2serr("daemon: warning, no W1 temperature sensors found\n");
+    else if (op->verbose)
+        pr2serr("daemon: %d sensors, sampling every %d ms\n", op->num_ent,
+                op->interval_ms);
+
+    cl_daemonize("w1_temp", 0, 1, op->verbose);
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = stop_handler;
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+
+    w1_shm_write_begin(shp);
+    /* keep seq (readers may be spinning on it), clear the rest */
+    memset((char *)shp + offsetof(struct w1_shm, pid), 0,
+           sizeof(*shp) - offsetof(struct w1_shm, pid));
+    shp->magic = W1_SHM_MAGIC;
+    shp->version = W1_SHM_VERSION;
+    shp->pid = getpid();
+    shp->interval_ms = op->interval_ms;
+    w1_shm_write_end(shp);
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (! stop_sig) {
+        convert_all(pathp, op);
+        w1_shm_write_begin(shp);
+        for (k = 0; k < op->num_ent; ++k)
+            shp->ent_arr[k] = op->ent_arr[k];
+        shp->num_ent = op->num_ent;
+        shp->sweep_ts_ms = now_ms();
+        ++shp->sweeps;
+        w1_shm_write_end(shp);
+
+        next.tv_sec += op->interval_ms / 1000;
+        next.tv_nsec += (op->interval_ms % 1000) * 1000000;
+        if (next.tv_nsec >= 1000000000) {
+            ++next.tv_sec;
+            next.tv_nsec -= 1000000000;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if ((now.tv_sec > next.tv_sec) || ((now.tv_sec == next.tv_sec) &&
+                                           (now.tv_nsec > next.tv_nsec))) {
+            cl_print(LOG_WARNING, "sweep overran %d ms interval\n",
+                     op->interval_ms);
+            next = now;         /* skip missed samples */
+        } else
+            while ((clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next,
+                                    NULL) == EINTR) && (! stop_sig))
+                ;
+    }
+    w1_shm_write_begin(shp);
+    shp->pid = 0;
+    w1_shm_write_end(shp);
+    munmap(shp, sizeof(struct w1_shm));
+    cl_print(LOG_INFO, "w1_temp daemon stopped by signal %d\n",
+             (int)stop_sig);
+    return 0;
+}
+
+/* Cache file is text, one line per sensor: <dev> <milli>|- <ts_ms> where
+ * ts_ms is milliseconds since the epoch. Loads op->ent_arr[] and returns
+ * 0 if there is at least one entry and none older than op->max_age_ms,
+ * else returns 1 (and op->num_ent is zeroed). */
+static int
+load_cache(struct opts_t * op)
+{
+    int n;
+    long long now, age;
+    FILE * fp;
+    struct w1_ent * ep;
+    char b[128];
+    char t[16];
+
+    op->num_ent = 0;
+    if (NULL == (fp = fopen(op->cfile, "r")))
+        return 1;
+    now = now_ms();
+    while (fgets(b, sizeof(b), fp) && (op->num_ent < W1_MAX_DEVS)) {
+        ep = op->ent_arr + op->num_ent;
+        n = sscanf(b, "%19s %15s %lld", ep->dev, t, &ep->ts_ms);
+        if (3 != n)
+            continue;
+        age = now - ep->ts_ms;
+        if ((age < 0) || (age > op->max_age_ms)) {
+            if (op->verbose)
+                pr2serr("%s: cache entry for %s is stale (%lld ms)\n",
+                        op->cfile, ep->dev, age);
+            op->num_ent = 0;
+            break;
+        }
+        ep->ok = (1 == sscanf(t, "%d", &ep->milli));
+        ++op->num_ent;
+    }
+    fclose(fp);
+    if (op->verbose && (op->num_ent > 0))
+        pr2serr("%s: using %d cached entries\n", op->cfile, op->num_ent);
+    return (op->num_ent > 0) ? 0 : 1;
+}
+
+/* Writes to <cfile>.XXXXXX then renames it over <cfile> so that concurrent
+ * readers see either the old or the new contents, never a mix. */
+static int
+save_cache(const struct opts_t * op)
+{
+    int k, fd;
+    FILE * fp;
+    const struct w1_ent * ep;
+    char b[256];
+
+    if ((fd = open_tmp_beside(op->cfile, b, sizeof(b))) < 0)
+        return 1;
+    if (NULL == (fp = fdopen(fd, "w"))) {
+        pr2serr("Unable to open %s\n", b);
+        close(fd);
+        unlink(b);
+        return 1;
+    }
+    for (k = 0, ep = op->ent_arr; k < op->num_ent; ++k, ++ep) {
+        if (ep->ok)
+            fprintf(fp, "%s %d %lld\n", ep->dev, ep->milli, ep->ts_ms);
+        else
+            fprintf(fp, "%s - %lld\n", ep->dev, ep->ts_ms);
+    }
+    if (fclose(fp) || rename(b, op->cfile)) {
+        perror("writing cache file");
+        unlink(b);
+        return 1;
+    }
+    return 0;
+}
+
+static int
+get_temp(const char * dev, const char * pathp, struct opts_t * op)
+{
+    int milliTemp, mt, t;
+    const char * ccp;
+    const struct w1_ent * ep;
+    char buf[256];
+
+    if (op->verbose)
+        pr2serr("found W1 temperature device: %s\n", dev);
+    if (op->serial_num) {
+        if ((ccp = strchr(dev, '-'))) {
+            if (1 == sscanf(ccp + 1, "%14s", buf)) {
+                if (op->out_fp)
+                    ;
+                else if (op->ofile) {
+                    op->out_fp = fopen(op->ofile, "w");
+                    if (NULL == op->out_fp) {
+                        pr2serr("Unable to open %s\n", op->ofile);
+                        return 1;
+                    }
+                } else
+                    op->out_fp = stdout;
+                if (op->family)
+                    fprintf(op->out_fp, "%.20s\n", dev);
+                else
+                    fprintf(op->out_fp, "%s\n", buf);
+            }
+        }
+        return 0;
+    }
+    ep = find_ent(op, dev);
+    if (ep) {
+        if (! ep->ok) {
+            pr2serr("no temperature for %s from last sweep\n", dev);
+            return 1;
+        }
+        milliTemp = ep->milli;
+    } else if (read_milli(dev, pathp, op->verbose, &milliTemp))
+        return 1;
     if (op->verbose)
         pr2serr("temperature in C x1000: %d\n", milliTemp);
 
@@ -205,6 +695,7 @@ int
 main(int argc, char *argv[])
 {
     int opt, len, ch, k, n, found;
+    int do_daemon = 0;
     DIR *dir;
     FILE * fip;
     struct dirent *dirent;
@@ -222,7 +713,9 @@ main(int argc, char *argv[])
     op = &opts;
     memset(op, 0, sizeof(opts));
     op->dev_fam = DS18S20_DS1820_FAM;        /* default */
-    while ((opt = getopt(argc, argv, "a:bfFho:r:svVw:")) != -1) {
+    op->max_age_ms = W1_DEF_MAX_AGE_MS;
+    op->interval_ms = W1_DEF_INTERVAL_MS;
+    while ((opt = getopt(argc, argv, "a:bc:DfFhi:m:M:o:pr:svVw:")) != -1) {
         switch (opt) {
         case 'a':
             if (afilep) {
@@ -234,6 +727,12 @@ main(int argc, char *argv[])
         case 'b':
             ++op->both;
             break;
+        case 'c':
+            op->cfile = optarg;
+            break;
+        case 'D':
+            ++do_daemon;
+            break;
         case 'f':
             ++op->fixed_pnt;
             break;
@@ -243,9 +742,30 @@ main(int argc, char *argv[])
         case 'h':
             usage();
             exit(EXIT_SUCCESS);
+        case 'i':
+            if ((1 != sscanf(optarg, "%d", &op->interval_ms)) ||
+                (op->interval_ms < W1_MIN_INTERVAL_MS)) {
+                pr2serr("-i expects milliseconds (%d or more)\n",
+                        W1_MIN_INTERVAL_MS);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'm':
+            if ((1 != sscanf(optarg, "%d", &op->max_age_ms)) ||
+                (op->max_age_ms < 0)) {
+                pr2serr("-m expects milliseconds (0 or more)\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'M':
+            op->mfile = optarg;
+            break;
         case 'o':
             op->ofile = optarg;
             break;
+        case 'p':
+            ++op->parallel;
+            break;
         case 'r':
             op->new_fn = optarg;
             break;
@@ -314,6 +834,27 @@ main(int argc, char *argv[])
             exit(EXIT_FAILURE);
         }
     }
+    if (do_daemon) {
+        if (afilep || op->serial_num || op->cfile) {
+            pr2serr("'-D' cannot be used with '-a', '-c' or '-s'\n");
+            exit(EXIT_FAILURE);
+        }
+        if (NULL == op->mfile)
+            op->mfile = W1_DEF_SHM_FILE;
+        return run_daemon(path, op) ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+    if (op->mfile && (! op->serial_num) && (0 == load_shm(op)))
+        ;
+    else if ((op->parallel || op->cfile) && (! op->serial_num)) {
+        if (op->cfile && (0 == load_cache(op)))
+            ;
+        else {
+            if (sweep(path, op))
+                exit(EXIT_FAILURE);
+            if (op->cfile && save_cache(op))
+                exit(EXIT_FAILURE);
+        }
+    }
 
     if (afilep) {
         if (! ((fip = fopen(afilep, "r")))) {
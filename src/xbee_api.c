@@ -56,32 +56,56 @@
 #include <fcntl.h>
 #include <signal.h>
 #include <poll.h>
+#include <time.h>
 
+#include "hex_out.h"
+#include "tty_util.h"
+#include "sa_misc.h"
 
-static const char * version_str = "1.02 20160121";
+
+static const char * version_str = "1.05 20261014";
 
 #define DEF_BAUD_RATE B9600
 #define DEF_BAUD_RATE_STR "9600"
 #define DEF_NON_CANONICAL_TIMEOUT 20     /* unit: 100ms so 20-> 2 seconds */
 
+/* API frames: 0x7e, 2 byte length, frame data, checksum. With AP=2 the
+ * bytes after the 0x7e that equal one of these are sent as 0x7d then the
+ * byte XORed with 0x20. */
+#define XB_SOF 0x7e
+#define XB_ESC 0x7d
+#define XB_XON 0x11
+#define XB_XOFF 0x13
+#define XB_MAX_FRAME 1024       /* frame data length limit, 8 bit ids ok */
+#define XB_DEF_WINDOW 8         /* '-W' default: requests in flight */
+
+/* Received frame types that echo the request's frame ID, which is then
+ * the second byte of the frame data */
+#define XB_AT_RESP 0x88
+#define XB_TX_STATUS 0x89
+#define XB_ZB_TX_STATUS 0x8b
+#define XB_REMOTE_AT_RESP 0x97
+
 static struct termios tty_saved_attribs;
 static int tty_saved_fd = -1;
 static int timeout_100ms = DEF_NON_CANONICAL_TIMEOUT;
 static int verbose = 0;
 static int warn = 0;
 static int xopen = 0;
+static struct hex_out hout;     /* bytes read from <tty> go here */
 
 
 static void
 usage(void)
 {
     fprintf(stderr, "Usage: "
-            "xbee_api [-a] [-b <baud>] [-B <nbits>] [-c] [-D] [-F] [-h]\n"
+            "xbee_api [-a] [-b <baud>] [-B <nbits>] [-c] [-D] [-e] [-F] "
+            "[-h]\n"
             "                [-H <hex_file>] [-i <hex_file>] [-n] [-N] "
-            "[-P N|E|O]\n"
-            "                [-r <num>] [-R] [-S <sbits>] [-T <secs[,rep]>] "
-            "[-v] [-V]\n"
-            "                [-w] [-x] <tty>\n"
+            "[-o <file>] [-p]\n"
+            "                [-P N|E|O] [-r <num>] [-R] [-S <sbits>] "
+            "[-T <secs[,rep]>]\n"
+            "                [-v] [-V] [-w] [-W <num>] [-x] <tty>\n"
             "  where:\n"
             "    -a           with '-r <num>' show bytes in ASCII as well\n"
             "    -b <baud>    baud rate of <tty> (default: %s)\n"
@@ -91,6 +115,9 @@ usage(void)
             "    -D           set DTR, use twice to clear DTR (need '-n' "
             "and '-x'\n"
             "                 to keep level after this utility completes)\n"
+            "    -e           escaped API mode (AP=2): 0x7d escapes 0x7e, "
+            "0x7d, 0x11\n"
+            "                 and 0x13 after the leading 0x7e\n"
             "    -F           no flush (def: flush input+output after <tty> "
             "open)\n"
             "    -h           print usage message\n"
@@ -102,6 +129,18 @@ usage(void)
             "close)\n"
             "                 use twice: set HUPCL (Hang UP on CLose)\n"
             "    -N           send nothing. Useful with '-r <num>' or '-x'\n"
+            "    -o <file>    write bytes read from <tty> to <file> as is "
+            "(binary),\n"
+            "                 rather than in ASCII hex on stdout. '-' for "
+            "stdout\n"
+            "    -p           pipelined: each input line is a request (API "
+            "id then\n"
+            "                 frame data after the frame ID). Frame IDs are "
+            "assigned,\n"
+            "                 '-W' requests kept in flight, responses "
+            "matched by ID\n"
+            "                 and each request times out after '-T' "
+            "<secs>\n"
             "    -P N|E|O     parity: N->none (default), E->even, O->odd\n"
             "    -r <num>     read <num> bytes from <tty>, print in ASCII "
             "hex on\n"
@@ -119,6 +158,8 @@ usage(void)
             "    -V           print version string then exit\n"
             "    -w           warn about hardware RTS/CTS handshake with "
             "clear CTS\n"
+            "    -W <num>     requests in flight with '-p' (def: %d, max: "
+            "255)\n"
             "    -x           will not restore previous settings on exit; "
             "if used\n"
             "                 only once will not send nor read\n\n"
@@ -137,8 +178,12 @@ usage(void)
             "    echo 8 1 4e 44 | xbee_api -a -b 9600 -r 200 -T 0,60 -w "
             "/dev/ttyS1\n"
             "  leave settings on <tty> after exit:\n"
-            "    xbee_api -b 38400 -c -n -x /dev/ttyS1\n",
-            DEF_BAUD_RATE_STR);
+            "    xbee_api -b 38400 -c -n -x /dev/ttyS1\n"
+            "  query DB (RSSI) of many remote nodes, one remote AT request "
+            "per line:\n"
+            "    echo '17 0 13 a2 0 40 a1 b2 c3 ff fe 0 44 42' >> nodes.txt\n"
+            "    xbee_api -p -T 5 -i nodes.txt /dev/ttyS1\n",
+            DEF_BAUD_RATE_STR, XB_DEF_WINDOW);
 }
 
 static char *
@@ -172,264 +217,404 @@ termination_handler(int signum)
     /* exit(0); */
 }
 
-static bool
-poll_in_for(int fd, int millisecs)
+enum xb_pstate {XB_P_SOF, XB_P_LEN_HI, XB_P_LEN_LO, XB_P_DATA, XB_P_CSUM};
+
+struct xb_parser {
+    enum xb_pstate state;
+    int escaped;        /* AP=2 */
+    int esc_next;       /* previous byte was XB_ESC */
+    int len;            /* frame data length from header */
+    int pos;            /* frame data bytes held in buf[] */
+    uint8_t sum;
+    int n_bad_sum;
+    int n_resync;       /* frames abandoned due to a 0x7e or bad length */
+    int n_skipped;      /* bytes discarded looking for a 0x7e */
+    unsigned char buf[XB_MAX_FRAME];
+};
+
+/* One line of '-p' input */
+struct xb_req {
+    int line_num;
+    int len;            /* frame data length, including the frame ID */
+    int fid;            /* 0 until sent */
+    uint64_t sent_ns;
+    unsigned char * data;
+};
+
+static inline int
+xb_needs_esc(unsigned char c)
 {
-    int num;
-    struct pollfd apfd;
+    return (XB_SOF == c) || (XB_ESC == c) || (XB_XON == c) ||
+           (XB_XOFF == c);
+}
 
-    if (fd >= 0) {
-        apfd.fd = fd;
-        apfd.events = POLLIN;
-        apfd.revents = 0;
-        num = poll(&apfd, 1, millisecs);
-        return (num > 0) && (POLLIN & apfd.revents);
+/* Builds an API frame around 'fd_len' bytes of frame data in 'out' (room
+ * for (2 * fd_len) + 7 bytes needed when escaped). Returns frame length. */
+static int
+xb_build_frame(const unsigned char * fdata, int fd_len, int escaped,
+               unsigned char * out)
+{
+    int k, n;
+    uint8_t t;
+    unsigned char c;
+    unsigned char hdr[2];
+
+    out[0] = XB_SOF;
+    n = 1;
+    hdr[0] = (fd_len >> 8) & 0xff;
+    hdr[1] = fd_len & 0xff;
+    for (k = 0, t = 0; k < (fd_len + 3); ++k) {
+        if (k < 2)
+            c = hdr[k];
+        else if (k < (fd_len + 2)) {
+            c = fdata[k - 2];
+            t += c;
+        } else
+            c = 0xff - t;
+        if (escaped && xb_needs_esc(c)) {
+            out[n++] = XB_ESC;
+            c ^= 0x20;
+        }
+        out[n++] = c;
     }
-    return false;
+    return n;
 }
 
+/* Feeds one received byte to the parser. Returns frame data length once a
+ * frame with a valid checksum is complete (frame data in xpp->buf), else
+ * 0 . */
 static int
-xb_tty_open(const char * tty_dev, int tty_speed, int dtr, int rts,
-            int hhandshake, int no_hupcl, int nbits, int parit, int sbits)
+xb_parse_byte(struct xb_parser * xpp, unsigned char c)
 {
-    int tty_fd, res, mask, mbits;
-    struct termios new_attributes;
-
-    // tty_fd = open(tty_dev, (O_RDWR | O_NOCTTY | O_NONBLOCK));
-    if (verbose > 2)
-        fprintf(stderr, "%s: about to open(%s)\n", __func__, tty_dev);
-    tty_fd = open(tty_dev, (O_RDWR | O_NOCTTY | O_SYNC));
-    if (tty_fd < 0) {
-        fprintf(stderr, "%s: open() of %s failed: %s\n", __func__,
-                tty_dev, strerror(errno));
-        return -1;
+    if (XB_SOF == c) {
+        /* unescaped 0x7e always starts a frame in AP=2 */
+        if ((XB_P_SOF == xpp->state) || xpp->escaped) {
+            if (XB_P_SOF != xpp->state)
+                ++xpp->n_resync;
+            xpp->state = XB_P_LEN_HI;
+            xpp->esc_next = 0;
+            return 0;
+        }
     }
-
-    tcgetattr(tty_fd, &tty_saved_attribs);
-    new_attributes = tty_saved_attribs;
-
-    // Set the new attributes for the serial port, 'man termios'
-    cfsetospeed(&new_attributes, tty_speed);
-    cfsetispeed(&new_attributes, tty_speed);
-
-    // c_cflag
-    new_attributes.c_cflag |= CREAD;        // Enable receiver
-    new_attributes.c_cflag &= ~CSIZE;       // clear size mask
-    switch (nbits) {
-    case 5:
-        new_attributes.c_cflag |= CS5;
-        break;
-    case 6:
-        new_attributes.c_cflag |= CS6;
-        break;
-    case 7:
-        new_attributes.c_cflag |= CS7;
+    if (XB_P_SOF == xpp->state) {
+        ++xpp->n_skipped;
+        return 0;
+    }
+    if (xpp->escaped) {
+        if (XB_ESC == c) {
+            xpp->esc_next = 1;
+            return 0;
+        }
+        if (xpp->esc_next) {
+            c ^= 0x20;
+            xpp->esc_next = 0;
+        }
+    }
+    switch (xpp->state) {
+    case XB_P_LEN_HI:
+        xpp->len = c << 8;
+        xpp->state = XB_P_LEN_LO;
         break;
-    case 8:
-    default:
-        new_attributes.c_cflag |= CS8;          // 8 data bit
+    case XB_P_LEN_LO:
+        xpp->len |= c;
+        if ((0 == xpp->len) || (xpp->len > XB_MAX_FRAME)) {
+            ++xpp->n_resync;
+            xpp->state = XB_P_SOF;
+            break;
+        }
+        xpp->pos = 0;
+        xpp->sum = 0;
+        xpp->state = XB_P_DATA;
         break;
-    }
-    switch (parit) {
-    case 'E':
-        new_attributes.c_cflag |= PARENB;
-        new_attributes.c_cflag &= ~PARODD;
+    case XB_P_DATA:
+        xpp->buf[xpp->pos++] = c;
+        xpp->sum += c;
+        if (xpp->pos >= xpp->len)
+            xpp->state = XB_P_CSUM;
         break;
-    case 'O':
-        new_attributes.c_cflag |= PARENB;
-        new_attributes.c_cflag |= PARODD;
+    case XB_P_CSUM:
+        xpp->state = XB_P_SOF;
+        if (0xff == (uint8_t)(xpp->sum + c))
+            return xpp->len;
+        ++xpp->n_bad_sum;
+        if (verbose)
+            fprintf(stderr, "bad checksum on frame type 0x%x, length %d\n",
+                    xpp->buf[0], xpp->len);
         break;
-    case 'N':
-        new_attributes.c_cflag &= ~PARENB;
+    default:
+        xpp->state = XB_P_SOF;
         break;
     }
-    if (1 == sbits)
-        new_attributes.c_cflag &= ~CSTOPB;
-    else
-        new_attributes.c_cflag |= CSTOPB;
-    if (no_hupcl) {     // clear Hang Up on CLose (effects DTR+RTS)
-        if (1 == no_hupcl) {
-            new_attributes.c_cflag &= ~HUPCL;
-            if (verbose)
-                fprintf(stderr, "clearing HUPCL so RTS+DTR keep setting "
-                        "after close\n");
-        } else {
-            new_attributes.c_cflag |= HUPCL;
-            if (verbose)
-                fprintf(stderr, "setting HUPCL so RTS+DTR go inactive "
-                        "after close\n");
+    return 0;
+}
+
+/* Decodes one line of ASCII hex bytes, separated by whitespace or commas
+ * with '#' starting a comment, into 'out'. Returns number of bytes, 0 for
+ * blank or comment, -1 if error. */
+static int
+xb_decode_line(const char * line, int line_num, unsigned char * out,
+               int max_out)
+{
+    int n = 0;
+    unsigned int h;
+    const char * cp = line;
+    char * endp;
+
+    while (1) {
+        cp += strspn(cp, " ,\t\r\n");
+        if (('\0' == *cp) || ('#' == *cp))
+            return n;
+        h = strtoul(cp, &endp, 16);
+        if ((endp == cp) || (h > 0xff) ||
+            ((*endp) && (! strchr(" ,\t\r\n#", *endp)))) {
+            fprintf(stderr, "line %d: bad hex at '%.8s'\n", line_num, cp);
+            return -1;
         }
-    }
-    if (hhandshake) {
-        if (1 == hhandshake) {
-            new_attributes.c_cflag |= CRTSCTS;
-            if (verbose)
-                fprintf(stderr, "set hardware RTS/CTS handshake; those "
-                        "lines should be wired\n");
-        } else {
-            new_attributes.c_cflag &= ~CRTSCTS;
-            if (verbose)
-                fprintf(stderr, "clear hardware RTS/CTS handshake\n");
+        if (n >= max_out) {
+            fprintf(stderr, "line %d: too long\n", line_num);
+            return -1;
         }
+        out[n++] = h;
+        cp = endp;
     }
+}
 
-    // c_iflag
-    if ('N' == parit)
-        new_attributes.c_iflag |= IGNPAR;       // Ignore framing and parity
-    // Suggested by Michael Kerrisk [The Linux Programming Interface].
-    // He also included "| PARMRK".
-    new_attributes.c_iflag &= ~(BRKINT | ICRNL | IGNBRK | IGNCR | INLCR |
-                                INPCK | ISTRIP | IXON);
-
-    // c_oflag     [Turn off corrupting output post-processing]
-    new_attributes.c_oflag &= ~(OPOST);
-
-    // c_lflag
-    new_attributes.c_lflag &= ~(ICANON | IEXTEN | ECHO | ECHOE | ISIG);
-
-    // Next two only apply for non-canonical reads (which we have set)
-    new_attributes.c_cc[VMIN] = 0;     // Min chars to read
-    new_attributes.c_cc[VTIME] = timeout_100ms; // units: 100 ms, max 25.5 secs
-
-    res = tcsetattr(tty_fd, TCSANOW, &new_attributes);
-    if (res < 0) {
-        fprintf(stderr, "%s: tcsetattr() failed: %s\n", __func__,
-                strerror(errno));
-        close(tty_fd);
-        tty_fd = -1;
-    }
-    if (verbose > 1) {
-        if (ioctl(tty_fd, TIOCMGET, &mbits) >= 0)
-            fprintf(stderr, "modem lines set: %s%s%s%s [0x%x]\n",
-                    ((mbits & TIOCM_DSR) ? "DSR," : ""),
-                    ((mbits & TIOCM_RNG) ? "RING," : ""),
-                    ((mbits & TIOCM_CAR) ? "DCD," : ""),
-                    ((mbits & TIOCM_CTS) ? "CTS," : ""),
-                    mbits);
-    }
-    if (dtr) {
-        mask = TIOCM_DTR;
-        if (1 == dtr)
-            ioctl(tty_fd, TIOCMBIS, &mask);
-        else
-            ioctl(tty_fd, TIOCMBIC, &mask);
-    }
-    if (rts) {
-        mask = TIOCM_RTS;
-        if (1 == rts)
-            ioctl(tty_fd, TIOCMBIS, &mask);
-        else
-            ioctl(tty_fd, TIOCMBIC, &mask);
-    }
-    if ((verbose || warn) && (tty_saved_attribs.c_cflag & CRTSCTS) &&
-        (0 == hhandshake)) {
-        int cts_clear = 0;
-
-        if ((-1 != mbits) || (ioctl(tty_fd, TIOCMGET, &mbits) >= 0)) {
-            cts_clear = !(mbits & TIOCM_CTS);
-            fprintf(stderr, ">>> hardware RTS/CTS handshake active, not "
-                    "being changed\n>>> and CTS line is %s\n",
-                    cts_clear ? "clear (low), this could cause lockup" :
-                    "set (high), might be okay");
-            if (cts_clear)
-                fprintf(stderr, ">>> could use '-cc' to disable RTS/CTS "
-                        "handshake\n");
-        } else
-            fprintf(stderr, ">>> hardware RTS/CTS handshake active, not "
-                    "being changed\n");
-    }
-    if ((tty_fd >= 0) && (verbose > 3)) {
-        char b[128];
-
-        snprintf(b, sizeof(b) - 1, "stty -a -F %s", tty_dev);
-        printf(">>> Output from this command line invocation: '%s' is:\n", b);
-        res = system(b);
-        if (WIFSIGNALED(res) &&
-            (WTERMSIG(res) == SIGINT || WTERMSIG(res) == SIGQUIT))
-            raise(WTERMSIG(res));
-        /* ignore res of not a signal */
+/* Reads '-p' requests, one per line: API identifier then the rest of the
+ * frame data after the frame ID (which is assigned when sent). Returns
+ * number of requests (array in *reqpp) or -1 . */
+static int
+xb_read_reqs(FILE * fp, struct xb_req ** reqpp)
+{
+    int n, line_num;
+    int num = 0;
+    int max_num = 0;
+    struct xb_req * rp = NULL;
+    struct xb_req * nrp;
+    char line[1024];
+    unsigned char b[XB_MAX_FRAME];
+
+    for (line_num = 1; fgets(line, sizeof(line), fp); ++line_num) {
+        n = xb_decode_line(line, line_num, b + 1, sizeof(b) - 1);
+        if (n < 0)
+            goto bad;
+        if (0 == n)
+            continue;
+        if (num >= max_num) {
+            max_num = max_num ? (2 * max_num) : 32;
+            nrp = (struct xb_req *)realloc(rp, max_num * sizeof(*rp));
+            if (NULL == nrp)
+                goto oom;
+            rp = nrp;
+        }
+        /* frame ID goes after the API identifier */
+        b[0] = b[1];
+        b[1] = 0;
+        memset(rp + num, 0, sizeof(*rp));
+        rp[num].line_num = line_num;
+        rp[num].len = n + 1;
+        if (NULL == (rp[num].data = (unsigned char *)malloc(n + 1)))
+            goto oom;
+        memcpy(rp[num].data, b, n + 1);
+        ++num;
     }
-    return tty_fd;
+    *reqpp = rp;
+    return num;
+oom:
+    fprintf(stderr, "%s: out of memory\n", __func__);
+bad:
+    for (n = 0; n < num; ++n)
+        free(rp[n].data);
+    free(rp);
+    return -1;
 }
 
-/* print bytes in ASCII-hex, optionally with leading address and/or
- * trailing ASCII. 'addr_ascii' allows for 4 output types:
- *     > 0     each line has address then up to 16 ASCII-hex bytes
- *     = 0     in addition, the bytes are listed in ASCII to the right
- *     = -1    only the ASCII-hex bytes are listed (i.e. without address)
- *     < -1    ASCII-hex bytes with ASCII to right (and without address) */
 static void
-dStrHex(const char * str, int len, int addr_ascii)
+xb_print_frame(const char * lead, const unsigned char * b, int len)
 {
-    const char* p = str;
-    unsigned char c;
-    char buff[82];
-    int a = 0;
-    const int bpstart = 5;
-    const int cpstart = 60;
-    int cpos = cpstart;
-    int bpos = bpstart;
-    int i, k;
-
-    if (len <= 0)
-        return;
-    memset(buff, ' ', 80);
-    buff[80] = '\0';
-    if (-1 == addr_ascii) {
-        for (k = 0; k < len; k++) {
-            c = *p++;
-            bpos += 3;
-            if (bpos == (bpstart + (9 * 3)))
-                bpos++;
-            sprintf(&buff[bpos], "%.2x", (int)(unsigned char)c);
-            buff[bpos + 2] = ' ';
-            if ((k > 0) && (0 == ((k + 1) % 16))) {
-                printf("%.60s\n", buff);
-                bpos = bpstart;
-                memset(buff, ' ', 80);
+    int k;
+
+    printf("%s", lead);
+    for (k = 0; k < len; ++k)
+        printf(" %02x", b[k]);
+    printf("\n");
+}
+
+/* Pipelined mode ('-p'). Sends the requests, each with its own frame ID,
+ * keeping up to 'window' of them waiting for a response. Frames read from
+ * <tty> are parsed incrementally and responses matched to requests via
+ * the frame ID. Each request counts as timed out when no response comes
+ * within the '-T' time. The frame ID of a timed out request is not reused
+ * until the other 254 have been assigned, so a late response is reported
+ * as such rather than matched to a newer request. Output is one line per
+ * response (or timeout); frames that do not carry a frame ID (e.g. 0x90
+ * receive packet) or do not match are printed as unsolicited. Returns 0
+ * if all requests got a response, else 1 */
+static int
+xb_pipeline(int tty_fd, struct xb_req * reqs, int num_reqs, int window,
+            int escaped)
+{
+    int k, n, fid, res, tmo_ms, wait_ms, len, ri, has_fid;
+    int next = 0;               /* next request to send */
+    int n_out = 0;              /* requests in flight */
+    int n_resp = 0;
+    int n_tmo = 0;
+    int n_unsol = 0;
+    int n_late = 0;
+    int last_fid = 0;
+    int ret = 1;
+    unsigned int fid_seq = 0;   /* frame IDs assigned so far */
+    uint64_t now, t, deadline;
+    int in_flight[256];         /* frame ID -> index in reqs[] or -1 */
+    int timed_out[256];         /* frame ID -> index of timed out request */
+    unsigned int reserved[256]; /* timed out ID free once fid_seq reaches */
+    struct pollfd apfd;
+    struct xb_parser xp;
+    char lead[80];
+    unsigned char rb[512];
+    unsigned char fb[(2 * XB_MAX_FRAME) + 8];
+
+    memset(&xp, 0, sizeof(xp));
+    xp.escaped = escaped;
+    for (k = 0; k < 256; ++k) {
+        in_flight[k] = -1;
+        timed_out[k] = -1;
+        reserved[k] = 0;
+    }
+    tmo_ms = (timeout_100ms > 0) ? (timeout_100ms * 100) : 1000;
+    while ((next < num_reqs) || (n_out > 0)) {
+        /* top up the window */
+        while ((n_out < window) && (next < num_reqs)) {
+            /* frame IDs 1 to 255; 0 would suppress the response. Skip IDs
+             * in flight and those reserved after a timeout, unless every
+             * ID not in flight is reserved; then take the first of those */
+            for (fid = last_fid, n = 0, k = 0; k < 255; ++k) {
+                fid = (fid % 255) + 1;
+                if (in_flight[fid] >= 0)
+                    continue;
+                if (0 == n)
+                    n = fid;
+                if ((timed_out[fid] < 0) ||
+                    ((int)(fid_seq - reserved[fid]) >= 0))
+                    break;
+            }
+            if (k >= 255) {
+                fid = n;
+                if (verbose)
+                    fprintf(stderr, "all free frame IDs reserved, reusing "
+                            "0x%x early\n", fid);
+            }
+            timed_out[fid] = -1;
+            last_fid = fid;
+            ++fid_seq;
+            reqs[next].fid = fid;
+            reqs[next].data[1] = fid;
+            n = xb_build_frame(reqs[next].data, reqs[next].len, escaped, fb);
+            reqs[next].sent_ns = sa_ts_ns(CLOCK_MONOTONIC);
+            if (write(tty_fd, fb, n) < n) {
+                fprintf(stderr, "write() to <tty> failed: %s\n", serr());
+                goto fini;
             }
+            if (verbose > 1)
+                fprintf(stderr, "sent line %d as frame ID 0x%x\n",
+                        reqs[next].line_num, fid);
+            in_flight[fid] = next++;
+            ++n_out;
         }
-        if (bpos > bpstart)
-            printf("%.60s\n", buff);
-        return;
-    }
-    /* addr_ascii >= 0, start each line with address (offset) */
-    if (addr_ascii >= 0) {
-        k = sprintf(buff + 1, "%.2x", a);
-        buff[k + 1] = ' ';
-    }
-
-    for (i = 0; i < len; i++) {
-        c = *p++;
-        bpos += 3;
-        if (bpos == (bpstart + (9 * 3)))
-            bpos++;
-        sprintf(&buff[bpos], "%.2x", (int)(unsigned char)c);
-        buff[bpos + 2] = ' ';
-        if (addr_ascii > 0)
-            buff[cpos++] = ' ';
-        else {
-            if ((c < ' ') || (c >= 0x7f))
-                c = '.';
-            buff[cpos++] = c;
+        /* wait no longer than the earliest deadline */
+        deadline = 0;
+        for (k = 1; k < 256; ++k) {
+            if (in_flight[k] < 0)
+                continue;
+            t = reqs[in_flight[k]].sent_ns + (tmo_ms * 1000000ULL);
+            if ((0 == deadline) || (t < deadline))
+                deadline = t;
         }
-        if (cpos > (cpstart + 15)) {
-            printf("%.76s\n", buff);
-            bpos = bpstart;
-            cpos = cpstart;
-            a += 16;
-            memset(buff, ' ', 80);
-            if (addr_ascii >= 0) {
-                k = sprintf(buff + 1, "%.2x", a);
-                buff[k + 1] = ' ';
+        now = sa_ts_ns(CLOCK_MONOTONIC);
+        wait_ms = (deadline > now) ? (int)((deadline - now) / 1000000) + 1 :
+                                     0;
+        apfd.fd = tty_fd;
+        apfd.events = POLLIN;
+        apfd.revents = 0;
+        res = poll(&apfd, 1, wait_ms);
+        if (res < 0) {
+            if (EINTR == errno)
+                continue;
+            fprintf(stderr, "poll() failed: %s\n", serr());
+            goto fini;
+        }
+        if ((res > 0) && (apfd.revents & POLLIN)) {
+            n = read(tty_fd, rb, sizeof(rb));
+            if (n < 0) {
+                if ((EINTR == errno) || (EAGAIN == errno))
+                    continue;
+                fprintf(stderr, "read() from <tty> failed: %s\n", serr());
+                goto fini;
+            }
+            for (k = 0; k < n; ++k) {
+                len = xb_parse_byte(&xp, rb[k]);
+                if (len <= 0)
+                    continue;
+                /* only these frame types carry a frame ID in byte 1 */
+                has_fid = ((len > 1) && ((XB_AT_RESP == xp.buf[0]) ||
+                                         (XB_TX_STATUS == xp.buf[0]) ||
+                                         (XB_ZB_TX_STATUS == xp.buf[0]) ||
+                                         (XB_REMOTE_AT_RESP == xp.buf[0])));
+                ri = has_fid ? in_flight[xp.buf[1]] : -1;
+                if ((ri < 0) && has_fid &&
+                    ((ri = timed_out[xp.buf[1]]) >= 0)) {
+                    snprintf(lead, sizeof(lead), "line %d, frame ID 0x%02x, "
+                             "late, %.1f ms:", reqs[ri].line_num,
+                             reqs[ri].fid, (sa_ts_ns(CLOCK_MONOTONIC) -
+                                            reqs[ri].sent_ns) / 1e6);
+                    xb_print_frame(lead, xp.buf, len);
+                    timed_out[xp.buf[1]] = -1;
+                    ++n_late;
+                    continue;
+                }
+                if (ri < 0) {
+                    ++n_unsol;
+                    xb_print_frame("unsolicited:", xp.buf, len);
+                    continue;
+                }
+                snprintf(lead, sizeof(lead), "line %d, frame ID 0x%02x, "
+                         "%.1f ms:", reqs[ri].line_num, reqs[ri].fid,
+                         (sa_ts_ns(CLOCK_MONOTONIC) - reqs[ri].sent_ns) / 1e6);
+                xb_print_frame(lead, xp.buf, len);
+                in_flight[xp.buf[1]] = -1;
+                --n_out;
+                ++n_resp;
             }
+        } else if (res > 0) {
+            fprintf(stderr, "<tty> error or hangup, stop\n");
+            goto fini;
+        }
+        now = sa_ts_ns(CLOCK_MONOTONIC);
+        for (k = 1; k < 256; ++k) {
+            if (in_flight[k] < 0)
+                continue;
+            if (now < (reqs[in_flight[k]].sent_ns + (tmo_ms * 1000000ULL)))
+                continue;
+            printf("line %d, frame ID 0x%02x: timed out\n",
+                   reqs[in_flight[k]].line_num, k);
+            timed_out[k] = in_flight[k];
+            reserved[k] = fid_seq + 254;
+            in_flight[k] = -1;
+            --n_out;
+            ++n_tmo;
         }
+        fflush(stdout);
     }
-    if (cpos > cpstart)
-        printf("%.76s\n", buff);
+    ret = (n_resp < num_reqs);
+fini:
+    fflush(stdout);
+    if (verbose || ret)
+        fprintf(stderr, "%d requests: %d responses, %d timed out (%d "
+                "answered late), %d unsolicited frames,\n%d bad checksums, "
+                "%d resyncs, %d bytes skipped\n", num_reqs, n_resp, n_tmo,
+                n_late, n_unsol, xp.n_bad_sum, xp.n_resync, xp.n_skipped);
+    return ret;
 }
 
-
 int
 main(int argc, char *argv[])
 {
@@ -448,38 +633,34 @@ main(int argc, char *argv[])
     int rts = 0;
     int stop_bits = 1;
     int to_read = 0;
+    int escaped = 0;
+    int pipeline = 0;
+    int window = XB_DEF_WINDOW;
+    int num_reqs = 0;
+    int ret = EXIT_SUCCESS;
+    struct xb_req * reqs = NULL;
     char c1, c2;
     uint8_t t;
     unsigned char bny[2048];
     char hex[2048];
     char *cp;
     FILE * fp = NULL;
+    struct tty_opts t_opts;
     const char * tty_dev = NULL;
     const char * hex_file = NULL;
+    const char * raw_file = NULL;
 
     memset(bny, 0, sizeof(bny));
     memset(hex, 0, sizeof(bny));
-    while ((opt = getopt(argc, argv, "ab:B:cDFhH:i:nNP:r:RS:T:vVwx")) !=
+    while ((opt = getopt(argc, argv, "ab:B:cDeFhH:i:nNo:pP:r:RS:T:vVwW:x")) !=
            -1) {
         switch (opt) {
         case 'a':
             ++and_ascii;
             break;
         case 'b':
-            baud = 0;
             baud = atoi(optarg);
-            switch (baud) {
-            case 300: tty_speed = B300; break;
-            case 1200: tty_speed = B1200; break;
-            case 2400: tty_speed = B2400; break;
-            case 4800: tty_speed = B4800; break;
-            case 9600: tty_speed = B9600; break;
-            case 19200: tty_speed = B19200; break;
-            case 38400: tty_speed = B38400; break;
-            case 57600: tty_speed = B57600; break;
-            case 115200: tty_speed = B115200; break;
-            case 230400: tty_speed = B230400; break;
-            default:
+            if ((tty_speed = tty_baud2speed(baud)) < 0) {
                 fprintf(stderr, "Allowable rates: 300, 1200, 2400, 4800, "
                         "9600, 19200, 38400, 57600\n115200 or 230400\n");
                 exit(EXIT_FAILURE);
@@ -499,6 +680,9 @@ main(int argc, char *argv[])
         case 'D':
             ++dtr;
             break;
+        case 'e':
+            ++escaped;
+            break;
         case 'F':
             ++no_flush;
             break;
@@ -517,6 +701,12 @@ main(int argc, char *argv[])
         case 'N':
             ++no_send;
             break;
+        case 'o':
+            raw_file = optarg;
+            break;
+        case 'p':
+            ++pipeline;
+            break;
         case 'P':
             switch((parity = toupper(optarg[0]))) {
             case 'N':
@@ -575,6 +765,14 @@ main(int argc, char *argv[])
         case 'w':
             ++warn;
             break;
+        case 'W':
+            k = atoi(optarg);
+            if ((k < 1) || (k > 255)) {
+                fprintf(stderr, "'-W' expects a number from 1 to 255\n");
+                exit(EXIT_FAILURE);
+            }
+            window = k;
+            break;
         case 'x':
             ++xopen;
             break;
@@ -602,6 +800,19 @@ main(int argc, char *argv[])
         exit(EXIT_FAILURE);
     }
 
+    if (NULL == raw_file)
+        ho_init(&hout, STDOUT_FILENO, 0);
+    else if (0 == strcmp("-", raw_file))
+        ho_init(&hout, STDOUT_FILENO, 1);
+    else {
+        k = open(raw_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (k < 0) {
+            fprintf(stderr, "open() of %s failed: %s\n", raw_file, serr());
+            exit(EXIT_FAILURE);
+        }
+        ho_init(&hout, k, 1);
+    }
+
     if (signal(SIGINT, termination_handler) == SIG_IGN)
         signal(SIGINT, SIG_IGN);    /* handler was SIG_IGN, so reinstate */
     if (signal(SIGHUP, termination_handler) == SIG_IGN)
@@ -609,9 +820,32 @@ main(int argc, char *argv[])
     if (signal(SIGTERM, termination_handler) == SIG_IGN)
         signal(SIGTERM, SIG_IGN);
 
+    if (pipeline && (no_send || to_read)) {
+        fprintf(stderr, "'-p' reads the responses itself so '-N' and '-r' "
+                "are not accepted\n");
+        exit(EXIT_FAILURE);
+    }
+
     if ((1 == xopen) || no_send)
         goto bypass_input_read;
-    else if (hex_file) {
+    else if (pipeline) {
+        if (hex_file && (NULL == (fp = fopen(hex_file, "r")))) {
+            fprintf(stderr, "fopen on %s failed with %s\n", hex_file,
+                    strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        num_reqs = xb_read_reqs(fp ? fp : stdin, &reqs);
+        if (fp)
+            fclose(fp);
+        if (num_reqs <= 0) {
+            if (0 == num_reqs)
+                fprintf(stderr, "no requests found in input\n");
+            exit(EXIT_FAILURE);
+        }
+        if (verbose > 1)
+            fprintf(stderr, "read %d requests from input\n", num_reqs);
+        goto bypass_input_read;
+    } else if (hex_file) {
         if ((fp = fopen(hex_file, "r")) == NULL) {
             fprintf(stderr, "fopen on %s failed with %s\n", hex_file,
                     strerror(errno));
@@ -682,6 +916,14 @@ main(int argc, char *argv[])
         for (k = 0, t = 0; k < n; ++k)
             t += bny[3 + k];
         bny[ooff++] = 0xff - t;
+        if (escaped) {
+            if (((2 * n) + 7) > (int)sizeof(hex)) {
+                fprintf(stderr, "too long to escape\n");
+                exit(EXIT_FAILURE);
+            }
+            ooff = xb_build_frame(bny + 3, n, 1, (unsigned char *)hex);
+            memcpy(bny, hex, ooff);
+        }
     } else
         ooff = 0;       /* don't sent degenerate packet */
     if (verbose > 1) {
@@ -700,12 +942,25 @@ main(int argc, char *argv[])
     }
 
 bypass_input_read:
-    if ((tty_saved_fd = xb_tty_open(tty_dev, tty_speed, dtr, rts, hhandshake,
-                                    no_hupcl, num_bits, parity, stop_bits))
-        < 0)
+    memset(&t_opts, 0, sizeof(t_opts));
+    t_opts.speed = tty_speed;
+    t_opts.dtr = dtr;
+    t_opts.rts = rts;
+    t_opts.hhandshake = hhandshake;
+    t_opts.no_hupcl = no_hupcl;
+    t_opts.nbits = num_bits;
+    t_opts.parity = parity;
+    t_opts.sbits = stop_bits;
+    t_opts.timeout_100ms = timeout_100ms;
+    t_opts.warn = warn;
+    t_opts.verbose = verbose;
+    if ((tty_saved_fd = tty_open_raw(tty_dev, &t_opts,
+                                     &tty_saved_attribs)) < 0)
         exit(EXIT_FAILURE);
-    else if (verbose)
+    if (verbose)
         fprintf(stderr, "opened <tty> %s without problems\n", tty_dev);
+    if (verbose > 3)
+        tty_show_stty(tty_dev);
     if (1 == xopen)
         goto the_end;
 
@@ -718,6 +973,14 @@ bypass_input_read:
             fprintf(stderr, "flushed <tty> without problems\n");
     }
 
+    if (pipeline) {
+        if (xb_pipeline(tty_saved_fd, reqs, num_reqs, window, escaped))
+            ret = EXIT_FAILURE;
+        for (k = 0; k < num_reqs; ++k)
+            free(reqs[k].data);
+        free(reqs);
+        goto the_end;
+    }
     if (ooff > 0) {
         num = write(tty_saved_fd, bny, ooff);
         if (num < 0)
@@ -732,7 +995,7 @@ bypass_input_read:
             num = 0;
             if (timeout_100ms > 0)
                 num = read(tty_saved_fd, bny + k, to_read - k);
-            else if (poll_in_for(tty_saved_fd, 1000 /* millisecond */))
+            else if (tty_poll_in(tty_saved_fd, 1000 /* millisecond */))
                 num = read(tty_saved_fd, bny + k, to_read - k);
             if ((verbose > 3) && (num > 0))
                 fprintf(stderr, "read() got %d byte%s\n", num,
@@ -743,7 +1006,7 @@ bypass_input_read:
                 if (repeat > 0) {
                     --repeat;
                     if (k > from) {
-                        dStrHex((const char *)bny + from , k - from,
+                        ho_dump(&hout, bny + from, k - from,
                                 (and_ascii ? -2 : -1));
                         from = k;
                     }
@@ -755,8 +1018,10 @@ bypass_input_read:
         if (num < 0)
             fprintf(stderr, "read() from <tty> failed: %s, exit\n", serr());
         if (k > from)
-            dStrHex((const char *)bny + from, k - from,
+            ho_dump(&hout, bny + from, k - from,
                     (and_ascii ? -2 : -1));
+        if (ho_flush(&hout))
+            fprintf(stderr, "write() of output failed: %s\n", serr());
         if (verbose)
             fprintf(stderr, "read() fetched %d byte%s\n", k,
                     (1 == k) ? "" : "s");
@@ -774,5 +1039,7 @@ the_end:
         close(tty_saved_fd);
         tty_saved_fd = -1;
     }
-    return EXIT_SUCCESS;
+    if (STDOUT_FILENO != hout.fd)
+        close(hout.fd);
+    return ret;
 }